@@ -702,6 +702,8 @@ $(eval $(call TunableKernelConfigC,SUPPORT_LARGE_GENERAL_HEAP,))
 $(eval $(call TunableKernelConfigC,SUPPORT_OLD_ION_API,))
 $(eval $(call TunableKernelConfigC,TTRACE,))
 $(eval $(call TunableKernelConfigC,TTRACE_LARGE_BUFFER,))
+$(eval $(call TunableKernelConfigC,PVRSRV_ALLOC_TRACE,))
+$(eval $(call TunableKernelConfigC,PVRSRV_BRIDGE_CAPTURE,))
 $(eval $(call TunableKernelConfigC,SUPPORT_PDUMP_SYNC_DEBUG,))
 $(eval $(call TunableKernelConfigC,SUPPORT_PER_SYNC_DEBUG,))
 $(eval $(call TunableKernelConfigC,SUPPORT_FORCE_SYNC_DUMP,))
@@ -724,6 +726,8 @@ $(eval $(call TunableBothConfigMake,SUPPORT_PVRSRV_DEVICE_CLASS,))
 
 
 $(eval $(call TunableKernelConfigMake,TTRACE,))
+$(eval $(call TunableKernelConfigMake,PVRSRV_ALLOC_TRACE,))
+$(eval $(call TunableKernelConfigMake,PVRSRV_BRIDGE_CAPTURE,))
 
 
 $(if $(USE_CCACHE),$(if $(USE_DISTCC),$(error\
@@ -282,9 +282,33 @@ extern "C" {
 #define PVRSRV_BRIDGE_FREE_SYNC_INFO            PVRSRV_IOWR(PVRSRV_BRIDGE_SYNC_OPS_CMD_FIRST+9)
 #define PVRSRV_BRIDGE_SYNC_OPS_CMD_LAST			(PVRSRV_BRIDGE_SYNC_OPS_CMD_FIRST+9)
 
+/* Batched calls */
+#define PVRSRV_BRIDGE_BATCH_CMD_FIRST			(PVRSRV_BRIDGE_SYNC_OPS_CMD_LAST+1)
+#define PVRSRV_BRIDGE_BATCH						PVRSRV_IOWR(PVRSRV_BRIDGE_BATCH_CMD_FIRST+0)	/*!< run several calls under one ioctl */
+#define PVRSRV_BRIDGE_BATCH_CMD_LAST			(PVRSRV_BRIDGE_BATCH_CMD_FIRST+0)
+
 /* For sgx_bridge.h (msvdx_bridge.h should probably use these defines too) */
 #define PVRSRV_BRIDGE_LAST_NON_DEVICE_CMD		(PVRSRV_BRIDGE_SYNC_OPS_CMD_LAST+1)
 
+/* The last command of the device bridge, from its header */
+#if defined(SUPPORT_VGX)
+#define PVRSRV_BRIDGE_LAST_DEVICE_CMD			PVRSRV_BRIDGE_LAST_VGX_CMD
+#elif defined(SUPPORT_MSVDX)
+#define PVRSRV_BRIDGE_LAST_DEVICE_CMD			PVRSRV_BRIDGE_LAST_MSVDX_CMD
+#elif defined(SUPPORT_SGX)
+#define PVRSRV_BRIDGE_LAST_DEVICE_CMD			PVRSRV_BRIDGE_LAST_SGX_CMD
+#else
+#define PVRSRV_BRIDGE_LAST_DEVICE_CMD			PVRSRV_BRIDGE_LAST_NON_DEVICE_CMD
+#endif
+
+/* Submission ring.  These come after the device commands, as there was no
+ * room for them before without moving every device bridge ID. */
+#define PVRSRV_BRIDGE_SUBMIT_RING_CMD_FIRST		(PVRSRV_BRIDGE_LAST_DEVICE_CMD+1)
+#define PVRSRV_BRIDGE_CREATE_SUBMIT_RING		PVRSRV_IOWR(PVRSRV_BRIDGE_SUBMIT_RING_CMD_FIRST+0)
+#define PVRSRV_BRIDGE_DESTROY_SUBMIT_RING		PVRSRV_IOWR(PVRSRV_BRIDGE_SUBMIT_RING_CMD_FIRST+1)
+#define PVRSRV_BRIDGE_SUBMIT_RING_DOORBELL		PVRSRV_IOWR(PVRSRV_BRIDGE_SUBMIT_RING_CMD_FIRST+2)	/*!< make the calls posted to the ring */
+#define PVRSRV_BRIDGE_SUBMIT_RING_CMD_LAST		(PVRSRV_BRIDGE_SUBMIT_RING_CMD_FIRST+2)
+
 
 /******************************************************************************
  * Bridge flags
@@ -1681,6 +1705,130 @@ typedef struct IMG_COMPAT PVRSRV_BRIDGE_IN_CHG_DEV_MEM_ATTRIBS_TAG
 } PVRSRV_BRIDGE_IN_CHG_DEV_MEM_ATTRIBS;
 
 
+/******************************************************************************
+ *	'bridge in' batch
+ *
+ *	The calls are made in order for the connection the batch is made on, so
+ *	each call's hKernelServices is ignored.  Connecting, disconnecting and
+ *	nested batches are refused.  Only the first ui32NumCalls entries of
+ *	asCalls need be passed.
+ *****************************************************************************/
+#define PVRSRV_BRIDGE_BATCH_MAX_CALLS			32
+
+/* Don't make the calls after one that fails */
+#define PVRSRV_BRIDGE_BATCH_FLAGS_STOP_ON_ERROR	(1U << 0)
+
+typedef struct PVRSRV_BRIDGE_IN_BATCH_TAG
+{
+	IMG_UINT32				ui32Flags;
+	IMG_UINT32				ui32NumCalls;
+	PVRSRV_BRIDGE_PACKAGE	asCalls[PVRSRV_BRIDGE_BATCH_MAX_CALLS];
+} PVRSRV_BRIDGE_IN_BATCH;
+
+/******************************************************************************
+ *	'bridge out' batch
+ *
+ *	ai32Results holds what the ioctl would have returned for each call made,
+ *	so 0 or a negative errno.  As for a single call, a call's PVRSRV_ERROR is
+ *	returned in its own output structure.  Only the first ui32NumCalls
+ *	entries of ai32Results need be passed.
+ *****************************************************************************/
+typedef struct PVRSRV_BRIDGE_OUT_BATCH_TAG
+{
+	IMG_UINT32				ui32NumCallsMade;
+	IMG_INT32				ai32Results[PVRSRV_BRIDGE_BATCH_MAX_CALLS];
+} PVRSRV_BRIDGE_OUT_BATCH;
+
+
+/******************************************************************************
+ *	submission ring
+ *
+ *	A connection may have one submission ring: pages shared between the
+ *	client and the kernel, into which the client posts bridge calls to be
+ *	made by a later PVRSRV_BRIDGE_SUBMIT_RING_DOORBELL.  Each call, with
+ *	its parameters, is written to a slot, and ui32WriteOffset is then
+ *	advanced past it.  The doorbell makes the calls posted since the last
+ *	one, in order, writing each call's output and the result the ioctl
+ *	would have returned back to its slot before advancing ui32ReadOffset
+ *	past it.  Offsets count calls and are never wrapped; the slot for
+ *	offset n is n & (ui32NumSlots - 1).  Slots between ui32ReadOffset and
+ *	ui32WriteOffset belong to the kernel.
+ *
+ *	Calls are made for the connection the doorbell is rung on.  As for a
+ *	batch, connecting, disconnecting, batches and ring calls can't be
+ *	posted, nor can the calls that depend on the file they are made on.
+ *	Input structures are copied, not referred to, so anything they point
+ *	at must still be passed in the client's own memory.
+ *****************************************************************************/
+#define PVRSRV_SUBMIT_RING_MAX_SLOTS			256
+#define PVRSRV_SUBMIT_RING_SLOT_IN_SIZE			0x300
+#define PVRSRV_SUBMIT_RING_SLOT_OUT_SIZE		0xF0
+
+typedef struct PVRSRV_SUBMIT_RING_SLOT_TAG
+{
+	IMG_UINT32			ui32BridgeID;
+	IMG_UINT32			ui32InBufferSize;
+	IMG_UINT32			ui32OutBufferSize;
+	IMG_INT32			i32Result;			/*!< written by the kernel */
+	IMG_UINT8			aui8In[PVRSRV_SUBMIT_RING_SLOT_IN_SIZE];
+	IMG_UINT8			aui8Out[PVRSRV_SUBMIT_RING_SLOT_OUT_SIZE];	/*!< written by the kernel */
+} PVRSRV_SUBMIT_RING_SLOT;
+
+typedef struct PVRSRV_SUBMIT_RING_TAG
+{
+	/* Written by the client */
+	IMG_UINT32			ui32WriteOffset;
+	IMG_UINT32			aui32Pad0[15];
+
+	/* Written by the kernel, on separate cache lines */
+	IMG_UINT32			ui32ReadOffset;
+	IMG_UINT32			ui32NumSlots;
+	IMG_UINT32			aui32Pad1[14];
+
+	PVRSRV_SUBMIT_RING_SLOT	asSlots[1];
+} PVRSRV_SUBMIT_RING;
+
+/* Size of a ring of ui32NumSlots slots */
+#define PVRSRV_SUBMIT_RING_SIZE(ui32NumSlots) \
+	(sizeof(PVRSRV_SUBMIT_RING) + ((ui32NumSlots) - 1) * sizeof(PVRSRV_SUBMIT_RING_SLOT))
+
+/******************************************************************************
+ *	'bridge in' create submission ring
+ *
+ *	ui32NumSlots must be a power of 2 no larger than
+ *	PVRSRV_SUBMIT_RING_MAX_SLOTS.
+ *****************************************************************************/
+typedef struct PVRSRV_BRIDGE_IN_CREATE_SUBMIT_RING_TAG
+{
+	IMG_UINT32			ui32NumSlots;
+} PVRSRV_BRIDGE_IN_CREATE_SUBMIT_RING;
+
+/******************************************************************************
+ *	'bridge out' create submission ring
+ *
+ *	hRing is mapped into the client with PVRSRV_BRIDGE_MHANDLE_TO_MMAP_DATA.
+ *	The ring is destroyed with PVRSRV_BRIDGE_DESTROY_SUBMIT_RING, which
+ *	fails while the ring is mapped, or when the connection is closed.
+ *****************************************************************************/
+typedef struct PVRSRV_BRIDGE_OUT_CREATE_SUBMIT_RING_TAG
+{
+	PVRSRV_ERROR		eError;
+	IMG_HANDLE			hRing;
+} PVRSRV_BRIDGE_OUT_CREATE_SUBMIT_RING;
+
+/******************************************************************************
+ *	'bridge out' submission ring doorbell
+ *
+ *	The doorbell takes no input.  ui32NumCallsMade is how far it advanced
+ *	ui32ReadOffset; each call's result is in its slot.
+ *****************************************************************************/
+typedef struct PVRSRV_BRIDGE_OUT_SUBMIT_RING_DOORBELL_TAG
+{
+	PVRSRV_ERROR		eError;
+	IMG_UINT32			ui32NumCallsMade;
+} PVRSRV_BRIDGE_OUT_SUBMIT_RING_DOORBELL;
+
+
 #if defined (__cplusplus)
 }
 #endif
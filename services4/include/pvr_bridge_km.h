@@ -56,6 +56,7 @@ extern "C" {
 #if defined(__linux__)
 PVRSRV_ERROR LinuxBridgeInit(IMG_VOID);
 IMG_VOID LinuxBridgeDeInit(IMG_VOID);
+IMG_VOID LinuxBridgeReleaseFile(IMG_VOID *pvPrivData);
 
 #if defined(SUPPORT_MEMINFO_IDS)
 extern IMG_UINT64 g_ui64MemInfoID;
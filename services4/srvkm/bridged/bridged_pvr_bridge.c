@@ -89,6 +89,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "env_data.h"
 #include "ttrace.h"
 #include "ttrace_tokens.h"
+#include "bridge_capture.h"
 
 #if defined (__linux__) || defined(__QNXNTO__)
 #include "mmap.h"
@@ -3716,6 +3717,9 @@ _SetDispatchTableEntry(IMG_UINT32 ui32Index,
 	}
 
 	g_BridgeDispatchTable[ui32Index].pfFunction = pfFunction;
+	g_BridgeDispatchTable[ui32Index].ui32InSize = BRIDGE_BUFFER_SIZE_UNKNOWN;
+	g_BridgeDispatchTable[ui32Index].ui32OutSize = BRIDGE_BUFFER_SIZE_UNKNOWN;
+	g_BridgeDispatchTable[ui32Index].pfCompatCopyIn = IMG_NULL;
 #if defined(DEBUG_BRIDGE_KM)
 	g_BridgeDispatchTable[ui32Index].pszIOCName = pszIOCName;
 	g_BridgeDispatchTable[ui32Index].pszFunctionName = pszFunctionName;
@@ -3726,6 +3730,96 @@ _SetDispatchTableEntry(IMG_UINT32 ui32Index,
 	uiPrevIndex = ui32Index;
 }
 
+IMG_VOID
+_SetDispatchTableConcurrent(IMG_UINT32 ui32Index)
+{
+	PVR_ASSERT(g_BridgeDispatchTable[ui32Index].pfFunction != IMG_NULL);
+
+	g_BridgeDispatchTable[ui32Index].bConcurrent = IMG_TRUE;
+}
+
+/*!
+******************************************************************************
+
+ @Function	_SetDispatchTableBufferSizes
+
+ @Description	Record how much of its parameter buffers a call's wrapper
+		uses, so that the OS layer can give small calls small
+		buffers.  A call with no sizes recorded gets buffers of
+		the maximum size.
+
+ @Input		ui32Index - the bridge ID
+ @Input		ui32InSize - size of the wrapper's input structure
+ @Input		ui32OutSize - size of the wrapper's output structure
+
+ @Return	None
+
+******************************************************************************/
+IMG_VOID
+_SetDispatchTableBufferSizes(IMG_UINT32 ui32Index,
+							 IMG_UINT32 ui32InSize,
+							 IMG_UINT32 ui32OutSize)
+{
+	PVR_ASSERT(g_BridgeDispatchTable[ui32Index].pfFunction != IMG_NULL);
+
+	g_BridgeDispatchTable[ui32Index].ui32InSize = ui32InSize;
+	g_BridgeDispatchTable[ui32Index].ui32OutSize = ui32OutSize;
+}
+
+/*!
+******************************************************************************
+
+ @Function	_SetDispatchTableCompatCopyIn
+
+ @Description	Record how to read a call's input structure from a 32-bit
+		caller whose layout of it differs from the native one.
+		Calls with nothing recorded take a 32-bit caller's input
+		as it is.
+
+ @Input		ui32Index - the bridge ID
+ @Input		pfCompatCopyIn - reads the 32-bit layout into the native one
+
+ @Return	None
+
+******************************************************************************/
+IMG_VOID
+_SetDispatchTableCompatCopyIn(IMG_UINT32 ui32Index,
+							  BridgeCompatCopyInFunction pfCompatCopyIn)
+{
+	PVR_ASSERT(g_BridgeDispatchTable[ui32Index].pfFunction != IMG_NULL);
+
+	g_BridgeDispatchTable[ui32Index].pfCompatCopyIn = pfCompatCopyIn;
+}
+
+/*!
+******************************************************************************
+
+ @Function	BridgeCallIsConcurrent
+
+ @Description	Decide whether a bridge call may run alongside others.
+		Concurrent calls only look up handles, which is lockless,
+		and read driver state that only non-concurrent calls
+		change, so the OS layer need only exclude non-concurrent
+		calls while they run.
+
+ @Input		psBridgePackageKM - the call, copied into the kernel
+
+ @Return	IMG_TRUE if the call may run concurrently
+
+******************************************************************************/
+IMG_BOOL BridgeCallIsConcurrent(PVRSRV_BRIDGE_PACKAGE *psBridgePackageKM)
+{
+	IMG_UINT32 ui32BridgeID = PVRSRV_GET_BRIDGE_ID(psBridgePackageKM->ui32BridgeID);
+
+	if (ui32BridgeID >= BRIDGE_DISPATCH_TABLE_ENTRY_COUNT ||
+		!g_BridgeDispatchTable[ui32BridgeID].bConcurrent)
+	{
+		return IMG_FALSE;
+	}
+
+	return IMG_TRUE;
+}
+
 static IMG_INT
 PVRSRVInitSrvConnectBW(IMG_UINT32 ui32BridgeID,
 					   IMG_VOID *psBridgeIn,
@@ -4837,6 +4931,68 @@ CommonBridgeInit(IMG_VOID)
 	SetDispatchTableEntry(PVRSRV_BRIDGE_ALLOC_SYNC_INFO, PVRSRVAllocSyncInfoBW);
 	SetDispatchTableEntry(PVRSRV_BRIDGE_FREE_SYNC_INFO, PVRSRVFreeSyncInfoBW);
 
+	/* Batches are unpacked by the OS layer, so never reach the table */
+	SetDispatchTableEntry(PVRSRV_BRIDGE_BATCH, DummyBW);
+
+	/* Calls made every frame, whose parameters can go on the stack */
+	SetDispatchTableBufferSizes(PVRSRV_BRIDGE_ALLOC_DEVICEMEM,
+								sizeof(PVRSRV_BRIDGE_IN_ALLOCDEVICEMEM),
+								sizeof(PVRSRV_BRIDGE_OUT_ALLOCDEVICEMEM));
+	SetDispatchTableBufferSizes(PVRSRV_BRIDGE_FREE_DEVICEMEM,
+								sizeof(PVRSRV_BRIDGE_IN_FREEDEVICEMEM),
+								sizeof(PVRSRV_BRIDGE_OUT_FREEDEVICEMEM));
+	SetDispatchTableBufferSizes(PVRSRV_BRIDGE_GETFREE_DEVICEMEM,
+								sizeof(PVRSRV_BRIDGE_IN_GETFREEDEVICEMEM),
+								sizeof(PVRSRV_BRIDGE_OUT_GETFREEDEVICEMEM));
+	SetDispatchTableBufferSizes(PVRSRV_BRIDGE_MAP_DEV_MEMORY,
+								sizeof(PVRSRV_BRIDGE_IN_MAP_DEV_MEMORY),
+								sizeof(PVRSRV_BRIDGE_OUT_MAP_DEV_MEMORY));
+	SetDispatchTableBufferSizes(PVRSRV_BRIDGE_MAP_DEV_MEMORY_2,
+								sizeof(PVRSRV_BRIDGE_IN_MAP_DEV_MEMORY),
+								sizeof(PVRSRV_BRIDGE_OUT_MAP_DEV_MEMORY));
+	SetDispatchTableBufferSizes(PVRSRV_BRIDGE_UNMAP_DEV_MEMORY,
+								sizeof(PVRSRV_BRIDGE_IN_UNMAP_DEV_MEMORY),
+								sizeof(PVRSRV_BRIDGE_RETURN));
+	SetDispatchTableBufferSizes(PVRSRV_BRIDGE_EVENT_OBJECT_WAIT,
+								sizeof(PVRSRV_BRIDGE_IN_EVENT_OBJECT_WAIT),
+								sizeof(PVRSRV_BRIDGE_RETURN));
+	SetDispatchTableBufferSizes(PVRSRV_BRIDGE_MODIFY_PENDING_SYNC_OPS,
+								sizeof(PVRSRV_BRIDGE_IN_MODIFY_PENDING_SYNC_OPS),
+								sizeof(PVRSRV_BRIDGE_OUT_MODIFY_PENDING_SYNC_OPS));
+	SetDispatchTableBufferSizes(PVRSRV_BRIDGE_MODIFY_COMPLETE_SYNC_OPS,
+								sizeof(PVRSRV_BRIDGE_IN_MODIFY_COMPLETE_SYNC_OPS),
+								sizeof(PVRSRV_BRIDGE_RETURN));
+	SetDispatchTableBufferSizes(PVRSRV_BRIDGE_SYNC_OPS_TAKE_TOKEN,
+								sizeof(PVRSRV_BRIDGE_IN_SYNC_OPS_TAKE_TOKEN),
+								sizeof(PVRSRV_BRIDGE_OUT_SYNC_OPS_TAKE_TOKEN));
+	SetDispatchTableBufferSizes(PVRSRV_BRIDGE_SYNC_OPS_FLUSH_TO_TOKEN,
+								sizeof(PVRSRV_BRIDGE_IN_SYNC_OPS_FLUSH_TO_TOKEN),
+								sizeof(PVRSRV_BRIDGE_RETURN));
+	SetDispatchTableBufferSizes(PVRSRV_BRIDGE_SYNC_OPS_FLUSH_TO_MOD_OBJ,
+								sizeof(PVRSRV_BRIDGE_IN_SYNC_OPS_FLUSH_TO_MOD_OBJ),
+								sizeof(PVRSRV_BRIDGE_RETURN));
+	SetDispatchTableBufferSizes(PVRSRV_BRIDGE_SYNC_OPS_FLUSH_TO_DELTA,
+								sizeof(PVRSRV_BRIDGE_IN_SYNC_OPS_FLUSH_TO_DELTA),
+								sizeof(PVRSRV_BRIDGE_RETURN));
+	SetDispatchTableBufferSizes(PVRSRV_BRIDGE_ALLOC_SYNC_INFO,
+								sizeof(PVRSRV_BRIDGE_IN_ALLOC_SYNC_INFO),
+								sizeof(PVRSRV_BRIDGE_OUT_ALLOC_SYNC_INFO));
+	SetDispatchTableBufferSizes(PVRSRV_BRIDGE_FREE_SYNC_INFO,
+								sizeof(PVRSRV_BRIDGE_IN_FREE_SYNC_INFO),
+								sizeof(PVRSRV_BRIDGE_RETURN));
+
+#if !defined(PDUMP)
+	/*
+	 * Waiting for and polling sync objects.  Not in PDump builds, as
+	 * the PDump capture relies on calls being serialised.
+	 */
+	SetDispatchTableConcurrent(PVRSRV_BRIDGE_EVENT_OBJECT_WAIT);
+	SetDispatchTableConcurrent(PVRSRV_BRIDGE_SYNC_OPS_TAKE_TOKEN);
+	SetDispatchTableConcurrent(PVRSRV_BRIDGE_SYNC_OPS_FLUSH_TO_TOKEN);
+	SetDispatchTableConcurrent(PVRSRV_BRIDGE_SYNC_OPS_FLUSH_TO_MOD_OBJ);
+	SetDispatchTableConcurrent(PVRSRV_BRIDGE_SYNC_OPS_FLUSH_TO_DELTA);
+#endif
+
 #if defined (SUPPORT_SGX)
 	SetSGXDispatchTableEntry();
 #endif
@@ -4847,6 +5003,12 @@ CommonBridgeInit(IMG_VOID)
 	SetMSVDXDispatchTableEntry();
 #endif
 
+	/* The submission ring calls, after the device's, are unpacked by the
+	 * OS layer too */
+	SetDispatchTableEntry(PVRSRV_BRIDGE_CREATE_SUBMIT_RING, DummyBW);
+	SetDispatchTableEntry(PVRSRV_BRIDGE_DESTROY_SUBMIT_RING, DummyBW);
+	SetDispatchTableEntry(PVRSRV_BRIDGE_SUBMIT_RING_DOORBELL, DummyBW);
+
 	/* A safety net to help ensure there won't be any un-initialised dispatch
 	 * table entries... */
 	/* Note: This is specifically done _after_ setting all the dispatch entries
@@ -4870,24 +5032,39 @@ CommonBridgeInit(IMG_VOID)
 	return PVRSRV_OK;
 }
 
-IMG_INT BridgedDispatchKM(PVRSRV_PER_PROCESS_DATA * psPerProc,
-					  PVRSRV_BRIDGE_PACKAGE   * psBridgePackageKM)
-{
-	IMG_VOID   * psBridgeIn;
-	IMG_VOID   * psBridgeOut;
-	BridgeWrapperFunction pfBridgeHandler;
-	IMG_UINT32   ui32BridgeID = psBridgePackageKM->ui32BridgeID;
-	IMG_INT      err          = -EFAULT;
+/*!
+******************************************************************************
 
-#if defined(DEBUG_TRACE_BRIDGE_KM)
-	PVR_DPF((PVR_DBG_ERROR, "%s: %s",
-			 __FUNCTION__,
-			 g_BridgeDispatchTable[ui32BridgeID].pszIOCName));
-#endif
+ @Function	BridgedCallKM
 
-#if defined(DEBUG_BRIDGE_KM)
-	g_BridgeDispatchTable[ui32BridgeID].ui32CallCount++;
-	g_BridgeGlobalStats.ui32IOCTLCount++;
+ @Description	Make a bridge call whose parameters are already in kernel
+		memory.  The caller has checked the bridge ID and sized the
+		buffers for it.
+
+ @Input		psPerProc - the caller's per-process data
+ @Input		ui32BridgeID - the bridge ID
+ @Input		psBridgeIn - the call's input structure
+ @Input		ui32InBufferSize - bytes of input the client passed
+ @Output	psBridgeOut - the call's output structure
+ @Input		ui32OutBufferSize - bytes of output the client wants
+
+ @Return	0, or a negative error if the call couldn't be made
+
+******************************************************************************/
+IMG_INT BridgedCallKM(PVRSRV_PER_PROCESS_DATA *psPerProc,
+					  IMG_UINT32 ui32BridgeID,
+					  IMG_VOID *psBridgeIn,
+					  IMG_UINT32 ui32InBufferSize,
+					  IMG_VOID *psBridgeOut,
+					  IMG_UINT32 ui32OutBufferSize)
+{
+	BridgeWrapperFunction pfBridgeHandler;
+	IMG_INT err = 0;
+#if defined(PVRSRV_BRIDGE_CAPTURE)
+	IMG_VOID *pvCapture = IMG_NULL;
+#else
+	PVR_UNREFERENCED_PARAMETER(ui32InBufferSize);
+	PVR_UNREFERENCED_PARAMETER(ui32OutBufferSize);
 #endif
 
 	if(!psPerProc->bInitProcess)
@@ -4898,7 +5075,7 @@ IMG_INT BridgedDispatchKM(PVRSRV_PER_PROCESS_DATA * psPerProc,
 			{
 				PVR_DPF((PVR_DBG_ERROR, "%s: Initialisation failed.  Driver unusable.",
 						 __FUNCTION__));
-				goto return_fault;
+				return -EFAULT;
 			}
 		}
 		else
@@ -4907,7 +5084,7 @@ IMG_INT BridgedDispatchKM(PVRSRV_PER_PROCESS_DATA * psPerProc,
 			{
 				PVR_DPF((PVR_DBG_ERROR, "%s: Initialisation is in progress",
 						 __FUNCTION__));
-				goto return_fault;
+				return -EFAULT;
 			}
 			else
 			{
@@ -4923,22 +5100,83 @@ IMG_INT BridgedDispatchKM(PVRSRV_PER_PROCESS_DATA * psPerProc,
 					default:
 						PVR_DPF((PVR_DBG_ERROR, "%s: Driver initialisation not completed yet.",
 								 __FUNCTION__));
-						goto return_fault;
+						return -EFAULT;
 				}
 			}
 		}
 	}
 
+	PVR_DPF((PVR_DBG_MESSAGE, "ui32BridgeID = %d (%s) being called.", ui32BridgeID, g_BridgeDispatchTable[ui32BridgeID].pszFunctionName));
+
+#if defined(PVRSRV_BRIDGE_CAPTURE)
+	if(gbPVRSRVBridgeCaptureEnabled)
+	{
+		pvCapture = PVRSRVBridgeCaptureBegin(psPerProc->ui32PID, ui32BridgeID,
+											 psBridgeIn, ui32InBufferSize,
+											 psBridgeOut, ui32OutBufferSize);
+	}
+#endif
+
+	if( ui32BridgeID == PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_UM_KM_COMPAT_CHECK))
+		PVRSRVCompatCheckKM(psBridgeIn, psBridgeOut);
+	else
+	{
+		pfBridgeHandler =
+			(BridgeWrapperFunction)g_BridgeDispatchTable[ui32BridgeID].pfFunction;
+		err = pfBridgeHandler(ui32BridgeID,
+						  psBridgeIn,
+						  psBridgeOut,
+						  psPerProc);
+	}
+
+	ReleaseHandleBatch(psPerProc);
+
+#if defined(PVRSRV_BRIDGE_CAPTURE)
+	if(pvCapture != IMG_NULL)
+	{
+		PVRSRVBridgeCaptureEnd(pvCapture, err);
+	}
+#endif
+
+	return err;
+}
+
+IMG_INT BridgedDispatchKM(PVRSRV_PER_PROCESS_DATA * psPerProc,
+					  PVRSRV_BRIDGE_PACKAGE   * psBridgePackageKM,
+					  IMG_BOOL bCompat)
+{
+	IMG_VOID   * psBridgeIn;
+	IMG_VOID   * psBridgeOut;
+	IMG_UINT32   ui32BridgeID = psBridgePackageKM->ui32BridgeID;
+	IMG_INT      err          = -EFAULT;
 #if defined(__linux__)
+	IMG_UINT64   aui64StackData[PVRSRV_BRIDGE_STACK_BUFFER_SIZE / sizeof(IMG_UINT64)];
+	IMG_VOID   * pvPoolBuffer = IMG_NULL;
+#endif
+
+	if(ui32BridgeID >= (BRIDGE_DISPATCH_TABLE_ENTRY_COUNT))
 	{
-		/* This should be moved into the linux specific code */
-		SYS_DATA *psSysData;
+		PVR_DPF((PVR_DBG_ERROR, "%s: ui32BridgeID = %d is out if range!",
+				 __FUNCTION__, ui32BridgeID));
+		goto return_fault;
+	}
 
-		SysAcquireData(&psSysData);
+#if defined(DEBUG_TRACE_BRIDGE_KM)
+	PVR_DPF((PVR_DBG_ERROR, "%s: %s",
+			 __FUNCTION__,
+			 g_BridgeDispatchTable[ui32BridgeID].pszIOCName));
+#endif
+
+#if defined(DEBUG_BRIDGE_KM)
+	g_BridgeDispatchTable[ui32BridgeID].ui32CallCount++;
+	g_BridgeGlobalStats.ui32IOCTLCount++;
+#endif
 
-		/* We have already set up some static buffers to store our ioctl data... */
-		psBridgeIn = ((ENV_DATA *)psSysData->pvEnvSpecificData)->pvBridgeData;
-		psBridgeOut = (IMG_PVOID)((IMG_PBYTE)psBridgeIn + PVRSRV_MAX_BRIDGE_IN_SIZE);
+#if defined(__linux__)
+	{
+		/* This should be moved into the linux specific code */
+		IMG_UINT32 ui32InSize = g_BridgeDispatchTable[ui32BridgeID].ui32InSize;
+		IMG_UINT32 ui32OutSize = g_BridgeDispatchTable[ui32BridgeID].ui32OutSize;
 
 		/* check we are not using a bigger bridge than allocated */
 		if((psBridgePackageKM->ui32InBufferSize > PVRSRV_MAX_BRIDGE_IN_SIZE) || 
@@ -4947,6 +5185,46 @@ IMG_INT BridgedDispatchKM(PVRSRV_PER_PROCESS_DATA * psPerProc,
 			goto return_fault;
 		}
 
+		/*
+		 * The buffers must hold both what the caller passes and what the
+		 * wrapper uses, which may be more if the caller passes too little.
+		 */
+		ui32InSize = MAX(ui32InSize, psBridgePackageKM->ui32InBufferSize);
+		ui32OutSize = MAX(ui32OutSize, psBridgePackageKM->ui32OutBufferSize);
+
+		if(ui32InSize <= PVRSRV_BRIDGE_STACK_BUFFER_SIZE)
+		{
+			/* Keep the output structure aligned */
+			ui32InSize = (ui32InSize + sizeof(IMG_UINT64) - 1) & ~(IMG_UINT32)(sizeof(IMG_UINT64) - 1);
+		}
+
+		if((ui32InSize <= PVRSRV_BRIDGE_STACK_BUFFER_SIZE) &&
+		   (ui32OutSize <= PVRSRV_BRIDGE_STACK_BUFFER_SIZE - ui32InSize))
+		{
+			psBridgeIn = (IMG_VOID *)aui64StackData;
+			psBridgeOut = (IMG_VOID *)((IMG_PBYTE)psBridgeIn + ui32InSize);
+
+			/* Don't let the call see, or copy out, old stack contents */
+			OSMemSet((IMG_PBYTE)psBridgeIn + psBridgePackageKM->ui32InBufferSize, 0,
+					 ui32InSize - psBridgePackageKM->ui32InBufferSize);
+			OSMemSet(psBridgeOut, 0, ui32OutSize);
+		}
+		else
+		{
+			if(OSAcquireBridgeBuffer(&pvPoolBuffer) != PVRSRV_OK)
+			{
+				PVR_DPF((PVR_DBG_ERROR, "%s: Couldn't get a bridge buffer", __FUNCTION__));
+				err = -ENOMEM;
+				goto return_fault;
+			}
+
+			psBridgeIn = pvPoolBuffer;
+			psBridgeOut = (IMG_VOID *)((IMG_PBYTE)psBridgeIn + PVRSRV_MAX_BRIDGE_IN_SIZE);
+
+			/* Don't copy out what an earlier call left in the buffer */
+			OSMemSet(psBridgeOut, 0, psBridgePackageKM->ui32OutBufferSize);
+		}
+
 
 		if(psBridgePackageKM->ui32InBufferSize > 0)
 		{
@@ -4957,7 +5235,22 @@ IMG_INT BridgedDispatchKM(PVRSRV_PER_PROCESS_DATA * psPerProc,
 				PVR_DPF((PVR_DBG_ERROR, "%s: Invalid pvParamIn pointer", __FUNCTION__));
 			}
 
-			if(CopyFromUserWrapper(psPerProc,
+			if(bCompat && g_BridgeDispatchTable[ui32BridgeID].pfCompatCopyIn != IMG_NULL)
+			{
+				/* Read the 32-bit layout straight into the wrapper's structure */
+				if(g_BridgeDispatchTable[ui32BridgeID].pfCompatCopyIn(psBridgeIn,
+																	  psBridgePackageKM->hParamIn,
+																	  psBridgePackageKM->ui32InBufferSize)
+				  != PVRSRV_OK)
+				{
+					goto return_fault;
+				}
+#if defined(DEBUG_BRIDGE_KM)
+				g_BridgeDispatchTable[ui32BridgeID].ui32CopyFromUserTotalBytes += psBridgePackageKM->ui32InBufferSize;
+				g_BridgeGlobalStats.ui32TotalCopyFromUserBytes += psBridgePackageKM->ui32InBufferSize;
+#endif
+			}
+			else if(CopyFromUserWrapper(psPerProc,
 					               ui32BridgeID,
 								   psBridgeIn,
 								   psBridgePackageKM->hParamIn,
@@ -4969,35 +5262,19 @@ IMG_INT BridgedDispatchKM(PVRSRV_PER_PROCESS_DATA * psPerProc,
 		}
 	}
 #else
+	PVR_UNREFERENCED_PARAMETER(bCompat);
 	psBridgeIn  = (IMG_VOID*)(IMG_UINTPTR_T)psBridgePackageKM->hParamIn;
 	psBridgeOut = (IMG_VOID*)(IMG_UINTPTR_T)psBridgePackageKM->hParamOut;
 #endif
 
-	if(ui32BridgeID >= (BRIDGE_DISPATCH_TABLE_ENTRY_COUNT))
+	err = BridgedCallKM(psPerProc, ui32BridgeID,
+						psBridgeIn, psBridgePackageKM->ui32InBufferSize,
+						psBridgeOut, psBridgePackageKM->ui32OutBufferSize);
+	if(err < 0)
 	{
-		PVR_DPF((PVR_DBG_ERROR, "%s: ui32BridgeID = %d is out if range!",
-				 __FUNCTION__, ui32BridgeID));
 		goto return_fault;
 	}
 
-	PVR_DPF((PVR_DBG_MESSAGE, "ui32BridgeID = %d (%s) being called.", ui32BridgeID, g_BridgeDispatchTable[ui32BridgeID].pszFunctionName));
-
-	if( ui32BridgeID == PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_UM_KM_COMPAT_CHECK))
-		PVRSRVCompatCheckKM(psBridgeIn, psBridgeOut);
-	else
-	{
-		pfBridgeHandler =
-			(BridgeWrapperFunction)g_BridgeDispatchTable[ui32BridgeID].pfFunction;
-		err = pfBridgeHandler(ui32BridgeID,
-						  psBridgeIn,
-						  psBridgeOut,
-						  psPerProc);
-		if(err < 0)
-		{
-			goto return_fault;
-		}
-	}
-
 #if defined(__linux__)
 	/* This should be moved into the linux specific code */
 	if(CopyToUserWrapper(psPerProc,
@@ -5018,6 +5295,13 @@ return_fault:
 		PVR_DPF((PVR_DBG_MESSAGE, "ui32BridgeID = %d Failed!", ui32BridgeID));
 	}
 
+#if defined(__linux__)
+	if(pvPoolBuffer != IMG_NULL)
+	{
+		OSReleaseBridgeBuffer(pvPoolBuffer);
+	}
+#endif
+
 	ReleaseHandleBatch(psPerProc);
 	return err;
 }
@@ -171,10 +171,24 @@ typedef IMG_INT (*BridgeWrapperFunction)(IMG_UINT32 ui32BridgeID,
 									 IMG_VOID *psBridgeOut,
 									 PVRSRV_PER_PROCESS_DATA *psPerProc);
 
+/* Reads a 32-bit caller's input structure, laid out as that caller built
+ * it, into the structure the wrapper takes */
+typedef PVRSRV_ERROR (*BridgeCompatCopyInFunction)(IMG_VOID *psBridgeIn,
+												   IMG_VOID *pvParamIn,
+												   IMG_UINT32 ui32InBufferSize);
+
 typedef struct _PVRSRV_BRIDGE_DISPATCH_TABLE_ENTRY
 {
 	BridgeWrapperFunction pfFunction; /*!< The wrapper function that validates the ioctl
 										arguments before calling into srvkm proper */
+	IMG_BOOL bConcurrent; /*!< The call may run alongside other concurrent calls;
+							see BridgeCallIsConcurrent */
+	IMG_UINT32 ui32InSize; /*!< Bytes of the input buffer the wrapper reads,
+							 or BRIDGE_BUFFER_SIZE_UNKNOWN */
+	IMG_UINT32 ui32OutSize; /*!< Bytes of the output buffer the wrapper writes,
+							  or BRIDGE_BUFFER_SIZE_UNKNOWN */
+	BridgeCompatCopyInFunction pfCompatCopyIn; /*!< Converts a 32-bit caller's input,
+												 or IMG_NULL if the layouts match */
 #if defined(DEBUG_BRIDGE_KM)
 	const IMG_CHAR *pszIOCName; /*!< Name of the ioctl: e.g. "PVRSRV_BRIDGE_CONNECT_SERVICES" */
 	const IMG_CHAR *pszFunctionName; /*!< Name of the wrapper function: e.g. "PVRSRVConnectBW" */
@@ -186,23 +200,8 @@ typedef struct _PVRSRV_BRIDGE_DISPATCH_TABLE_ENTRY
 #endif
 }PVRSRV_BRIDGE_DISPATCH_TABLE_ENTRY;
 
-#if defined(SUPPORT_VGX) || defined(SUPPORT_MSVDX)
-	#if defined(SUPPORT_VGX)
-		#define BRIDGE_DISPATCH_TABLE_ENTRY_COUNT (PVRSRV_BRIDGE_LAST_VGX_CMD+1)
-		#define PVRSRV_BRIDGE_LAST_DEVICE_CMD	   PVRSRV_BRIDGE_LAST_VGX_CMD
-	#else
-		#define BRIDGE_DISPATCH_TABLE_ENTRY_COUNT (PVRSRV_BRIDGE_LAST_MSVDX_CMD+1)
-		#define PVRSRV_BRIDGE_LAST_DEVICE_CMD	   PVRSRV_BRIDGE_LAST_MSVDX_CMD
-	#endif
-#else
-	#if defined(SUPPORT_SGX)
-		#define BRIDGE_DISPATCH_TABLE_ENTRY_COUNT (PVRSRV_BRIDGE_LAST_SGX_CMD+1)
-		#define PVRSRV_BRIDGE_LAST_DEVICE_CMD	   PVRSRV_BRIDGE_LAST_SGX_CMD
-	#else
-		#define BRIDGE_DISPATCH_TABLE_ENTRY_COUNT (PVRSRV_BRIDGE_LAST_NON_DEVICE_CMD+1)
-		#define PVRSRV_BRIDGE_LAST_DEVICE_CMD	   PVRSRV_BRIDGE_LAST_NON_DEVICE_CMD
-	#endif
-#endif
+/* The submission ring calls follow the device's */
+#define BRIDGE_DISPATCH_TABLE_ENTRY_COUNT (PVRSRV_BRIDGE_SUBMIT_RING_CMD_LAST+1)
 
 extern PVRSRV_BRIDGE_DISPATCH_TABLE_ENTRY g_BridgeDispatchTable[BRIDGE_DISPATCH_TABLE_ENTRY_COUNT];
 
@@ -240,11 +239,46 @@ typedef struct _PVRSRV_BRIDGE_GLOBAL_STATS
 extern PVRSRV_BRIDGE_GLOBAL_STATS g_BridgeGlobalStats;
 #endif
 
+IMG_VOID
+_SetDispatchTableConcurrent(IMG_UINT32 ui32Index);
+
+/* Mark a call that only looks up handles and reads driver state */
+#define SetDispatchTableConcurrent(ui32Index) \
+	_SetDispatchTableConcurrent(PVRSRV_GET_BRIDGE_ID(ui32Index))
+
+IMG_BOOL BridgeCallIsConcurrent(PVRSRV_BRIDGE_PACKAGE *psBridgePackageKM);
+
+#define BRIDGE_BUFFER_SIZE_UNKNOWN	0xFFFFFFFFU
+
+IMG_VOID
+_SetDispatchTableBufferSizes(IMG_UINT32 ui32Index,
+							 IMG_UINT32 ui32InSize,
+							 IMG_UINT32 ui32OutSize);
+
+/* Record the sizes of the structures a call's wrapper takes */
+#define SetDispatchTableBufferSizes(ui32Index, ui32InSize, ui32OutSize) \
+	_SetDispatchTableBufferSizes(PVRSRV_GET_BRIDGE_ID(ui32Index), ui32InSize, ui32OutSize)
+
+IMG_VOID
+_SetDispatchTableCompatCopyIn(IMG_UINT32 ui32Index,
+							  BridgeCompatCopyInFunction pfCompatCopyIn);
+
+/* Record how to read a call's input from a 32-bit caller whose layout differs */
+#define SetDispatchTableCompatCopyIn(ui32Index, pfCompatCopyIn) \
+	_SetDispatchTableCompatCopyIn(PVRSRV_GET_BRIDGE_ID(ui32Index), pfCompatCopyIn)
 
 PVRSRV_ERROR CommonBridgeInit(IMG_VOID);
 
 IMG_INT BridgedDispatchKM(PVRSRV_PER_PROCESS_DATA * psPerProc,
-					  PVRSRV_BRIDGE_PACKAGE   * psBridgePackageKM);
+					  PVRSRV_BRIDGE_PACKAGE   * psBridgePackageKM,
+					  IMG_BOOL bCompat);
+
+IMG_INT BridgedCallKM(PVRSRV_PER_PROCESS_DATA *psPerProc,
+					  IMG_UINT32 ui32BridgeID,
+					  IMG_VOID *psBridgeIn,
+					  IMG_UINT32 ui32InBufferSize,
+					  IMG_VOID *psBridgeOut,
+					  IMG_UINT32 ui32OutBufferSize);
 
 #if defined (__cplusplus)
 }
@@ -93,6 +93,7 @@ PVRSRVLookupOSMemHandle(PVRSRV_HANDLE_BASE *psHandleBase, IMG_HANDLE *phOSMemHan
 			break;
 		}
 		case  PVRSRV_HANDLE_TYPE_SOC_TIMER:
+		case  PVRSRV_HANDLE_TYPE_SUBMIT_RING:
 		{
 			*phOSMemHandle = (IMG_VOID *)hMHandleInt;
 			break;
@@ -65,6 +65,18 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "buffer_manager.h"
 #include "pdump_km.h"
 
+/*
+ * Handle lookups made together by SGXDoKickBW: device node, CCB, three
+ * syncs, memory context, source syncs and the TA and 3D status values.
+ */
+#define	SGX_DOKICK_MAX_LOOKUPS	9
+
+/*
+ * Handle lookups made together by SGXSubmitTransferBW: memory context,
+ * device node, CCB, two syncs, and the source and destination syncs.
+ */
+#define	SGX_SUBMITTRANSFER_MAX_LOOKUPS	7
+
 static IMG_INT
 SGXGetClientInfoBW(IMG_UINT32 ui32BridgeID,
 				   PVRSRV_BRIDGE_IN_GETCLIENTINFO *psGetClientInfoIN,
@@ -176,168 +188,98 @@ SGXDoKickBW(IMG_UINT32 ui32BridgeID,
 			PVRSRV_PER_PROCESS_DATA *psPerProc)
 {
 	IMG_HANDLE hDevCookieInt;
-	IMG_UINT32 i;
+	IMG_UINT32 ui32NumLookups = 0;
+	PVRSRV_HANDLE_LOOKUP asLookup[SGX_DOKICK_MAX_LOOKUPS];
 	IMG_INT ret = 0;
 	IMG_UINT32 ui32NumDstSyncs;
 	IMG_HANDLE *phKernelSyncInfoHandles = IMG_NULL;
-	IMG_HANDLE *pahDstSyncHandles;
 
 	PVRSRV_BRIDGE_ASSERT_CMD(ui32BridgeID, PVRSRV_BRIDGE_SGX_DOKICK);
 
-	psRetOUT->eError =
-		PVRSRVLookupHandle(psPerProc->psHandleBase,
-						   &hDevCookieInt,
-						   psDoKickIN->hDevCookie,
-						   PVRSRV_HANDLE_TYPE_DEV_NODE);
-
-	if(psRetOUT->eError != PVRSRV_OK)
+	/* texture dependency and status value counts */
+	if (psDoKickIN->sCCBKick.ui32NumSrcSyncs > SGX_MAX_SRC_SYNCS_TA ||
+		psDoKickIN->sCCBKick.ui32NumTAStatusVals > SGX_MAX_TA_STATUS_VALS ||
+		psDoKickIN->sCCBKick.ui32Num3DStatusVals > SGX_MAX_3D_STATUS_VALS)
 	{
+		psRetOUT->eError = PVRSRV_ERROR_INVALID_PARAMS;
 		return 0;
 	}
 
-	psRetOUT->eError =
-		PVRSRVLookupHandle(psPerProc->psHandleBase,
-						   &psDoKickIN->sCCBKick.hCCBKernelMemInfo,
-						   psDoKickIN->sCCBKick.hCCBKernelMemInfo,
-						   PVRSRV_HANDLE_TYPE_MEM_INFO);
+	hDevCookieInt = psDoKickIN->hDevCookie;
+	PVRSRVSetHandleLookup(&asLookup[ui32NumLookups++],
+						  &hDevCookieInt, 1, sizeof(IMG_HANDLE),
+						  PVRSRV_HANDLE_TYPE_DEV_NODE);
 
-	if(psRetOUT->eError != PVRSRV_OK)
-	{
-		return 0;
-	}
+	PVRSRVSetHandleLookup(&asLookup[ui32NumLookups++],
+						  &psDoKickIN->sCCBKick.hCCBKernelMemInfo, 1, sizeof(IMG_HANDLE),
+						  PVRSRV_HANDLE_TYPE_MEM_INFO);
 
 	if(psDoKickIN->sCCBKick.hTA3DSyncInfo != IMG_NULL)
 	{
-		psRetOUT->eError =
-			PVRSRVLookupHandle(psPerProc->psHandleBase,
-							   &psDoKickIN->sCCBKick.hTA3DSyncInfo,
-							   psDoKickIN->sCCBKick.hTA3DSyncInfo,
-							   PVRSRV_HANDLE_TYPE_SYNC_INFO);
-
-		if(psRetOUT->eError != PVRSRV_OK)
-		{
-			return 0;
-		}
+		PVRSRVSetHandleLookup(&asLookup[ui32NumLookups++],
+							  &psDoKickIN->sCCBKick.hTA3DSyncInfo, 1, sizeof(IMG_HANDLE),
+							  PVRSRV_HANDLE_TYPE_SYNC_INFO);
 	}
 
 	if(psDoKickIN->sCCBKick.hTASyncInfo != IMG_NULL)
 	{
-		psRetOUT->eError =
-			PVRSRVLookupHandle(psPerProc->psHandleBase,
-							   &psDoKickIN->sCCBKick.hTASyncInfo,
-							   psDoKickIN->sCCBKick.hTASyncInfo,
-							   PVRSRV_HANDLE_TYPE_SYNC_INFO);
-
-		if(psRetOUT->eError != PVRSRV_OK)
-		{
-			return 0;
-		}
+		PVRSRVSetHandleLookup(&asLookup[ui32NumLookups++],
+							  &psDoKickIN->sCCBKick.hTASyncInfo, 1, sizeof(IMG_HANDLE),
+							  PVRSRV_HANDLE_TYPE_SYNC_INFO);
 	}
 
 #if defined(FIX_HW_BRN_31620)
 	/* We need to lookup the mem context and pass it through */
-	psRetOUT->eError =
-		PVRSRVLookupHandle(psPerProc->psHandleBase,
-						   &psDoKickIN->sCCBKick.hDevMemContext,
-						   psDoKickIN->sCCBKick.hDevMemContext,
-						   PVRSRV_HANDLE_TYPE_DEV_MEM_CONTEXT);
-
-	if(psRetOUT->eError != PVRSRV_OK)
-	{
-		return 0;
-	}
+	PVRSRVSetHandleLookup(&asLookup[ui32NumLookups++],
+						  &psDoKickIN->sCCBKick.hDevMemContext, 1, sizeof(IMG_HANDLE),
+						  PVRSRV_HANDLE_TYPE_DEV_MEM_CONTEXT);
 #endif
 
 	if(psDoKickIN->sCCBKick.h3DSyncInfo != IMG_NULL)
 	{
-		psRetOUT->eError =
-			PVRSRVLookupHandle(psPerProc->psHandleBase,
-							   &psDoKickIN->sCCBKick.h3DSyncInfo,
-							   psDoKickIN->sCCBKick.h3DSyncInfo,
-							   PVRSRV_HANDLE_TYPE_SYNC_INFO);
-
-		if(psRetOUT->eError != PVRSRV_OK)
-		{
-			return 0;
-		}
-	}
-
-	/* texture dependency details */
-	if (psDoKickIN->sCCBKick.ui32NumSrcSyncs > SGX_MAX_SRC_SYNCS_TA)
-	{
-		psRetOUT->eError = PVRSRV_ERROR_INVALID_PARAMS;
-		return 0;
+		PVRSRVSetHandleLookup(&asLookup[ui32NumLookups++],
+							  &psDoKickIN->sCCBKick.h3DSyncInfo, 1, sizeof(IMG_HANDLE),
+							  PVRSRV_HANDLE_TYPE_SYNC_INFO);
 	}
 
 #if !(defined(PVR_ANDROID_NATIVE_WINDOW_HAS_SYNC) || defined(PVR_ANDROID_NATIVE_WINDOW_HAS_FENCE))
-	for(i=0; i<psDoKickIN->sCCBKick.ui32NumSrcSyncs; i++)
-	{
-		psRetOUT->eError =
-			PVRSRVLookupHandle(psPerProc->psHandleBase,
-							   &psDoKickIN->sCCBKick.ahSrcKernelSyncInfo[i],
-							   psDoKickIN->sCCBKick.ahSrcKernelSyncInfo[i],
-							   PVRSRV_HANDLE_TYPE_SYNC_INFO);
-
-		if(psRetOUT->eError != PVRSRV_OK)
-		{
-			return 0;
-		}
-	}
+	PVRSRVSetHandleLookup(&asLookup[ui32NumLookups++],
+						  psDoKickIN->sCCBKick.ahSrcKernelSyncInfo,
+						  psDoKickIN->sCCBKick.ui32NumSrcSyncs, sizeof(IMG_HANDLE),
+						  PVRSRV_HANDLE_TYPE_SYNC_INFO);
 #endif /* !defined(PVR_ANDROID_NATIVE_WINDOW_HAS_SYNC) */
 
-	if (psDoKickIN->sCCBKick.ui32NumTAStatusVals > SGX_MAX_TA_STATUS_VALS)
-	{
-		psRetOUT->eError = PVRSRV_ERROR_INVALID_PARAMS;
-		return 0;
-	}
-	for (i = 0; i < psDoKickIN->sCCBKick.ui32NumTAStatusVals; i++)
-	{
-		psRetOUT->eError =
 #if defined(SUPPORT_SGX_NEW_STATUS_VALS)
-			PVRSRVLookupHandle(psPerProc->psHandleBase,
-							   &psDoKickIN->sCCBKick.asTAStatusUpdate[i].hKernelMemInfo,
-							   psDoKickIN->sCCBKick.asTAStatusUpdate[i].hKernelMemInfo,
-							   PVRSRV_HANDLE_TYPE_MEM_INFO);
-
-
+	PVRSRVSetHandleLookup(&asLookup[ui32NumLookups++],
+						  &psDoKickIN->sCCBKick.asTAStatusUpdate[0].hKernelMemInfo,
+						  psDoKickIN->sCCBKick.ui32NumTAStatusVals,
+						  sizeof(psDoKickIN->sCCBKick.asTAStatusUpdate[0]),
+						  PVRSRV_HANDLE_TYPE_MEM_INFO);
+
+	PVRSRVSetHandleLookup(&asLookup[ui32NumLookups++],
+						  &psDoKickIN->sCCBKick.as3DStatusUpdate[0].hKernelMemInfo,
+						  psDoKickIN->sCCBKick.ui32Num3DStatusVals,
+						  sizeof(psDoKickIN->sCCBKick.as3DStatusUpdate[0]),
+						  PVRSRV_HANDLE_TYPE_MEM_INFO);
 #else
-			PVRSRVLookupHandle(psPerProc->psHandleBase,
-							   &psDoKickIN->sCCBKick.ahTAStatusSyncInfo[i],
-							   psDoKickIN->sCCBKick.ahTAStatusSyncInfo[i],
-							   PVRSRV_HANDLE_TYPE_SYNC_INFO);
+	PVRSRVSetHandleLookup(&asLookup[ui32NumLookups++],
+						  psDoKickIN->sCCBKick.ahTAStatusSyncInfo,
+						  psDoKickIN->sCCBKick.ui32NumTAStatusVals, sizeof(IMG_HANDLE),
+						  PVRSRV_HANDLE_TYPE_SYNC_INFO);
+
+	PVRSRVSetHandleLookup(&asLookup[ui32NumLookups++],
+						  psDoKickIN->sCCBKick.ah3DStatusSyncInfo,
+						  psDoKickIN->sCCBKick.ui32Num3DStatusVals, sizeof(IMG_HANDLE),
+						  PVRSRV_HANDLE_TYPE_SYNC_INFO);
 #endif
-		if(psRetOUT->eError != PVRSRV_OK)
-		{
-			return 0;
-		}
-	}
 
-	if (psDoKickIN->sCCBKick.ui32Num3DStatusVals > SGX_MAX_3D_STATUS_VALS)
+	PVR_ASSERT(ui32NumLookups <= SGX_DOKICK_MAX_LOOKUPS);
+
+	psRetOUT->eError = PVRSRVLookupHandles(psPerProc->psHandleBase, asLookup, ui32NumLookups);
+	if(psRetOUT->eError != PVRSRV_OK)
 	{
-		psRetOUT->eError = PVRSRV_ERROR_INVALID_PARAMS;
 		return 0;
 	}
-	for(i = 0; i < psDoKickIN->sCCBKick.ui32Num3DStatusVals; i++)
-	{
-		psRetOUT->eError =
-#if defined(SUPPORT_SGX_NEW_STATUS_VALS)
-			PVRSRVLookupHandle(psPerProc->psHandleBase,
-							   &psDoKickIN->sCCBKick.as3DStatusUpdate[i].hKernelMemInfo,
-							   psDoKickIN->sCCBKick.as3DStatusUpdate[i].hKernelMemInfo,
-							   PVRSRV_HANDLE_TYPE_MEM_INFO);
-							   
-#else
-			PVRSRVLookupHandle(psPerProc->psHandleBase,
-							   &psDoKickIN->sCCBKick.ah3DStatusSyncInfo[i],
-							   psDoKickIN->sCCBKick.ah3DStatusSyncInfo[i],
-							   PVRSRV_HANDLE_TYPE_SYNC_INFO);
-#endif
-
-		if(psRetOUT->eError != PVRSRV_OK)
-		{
-			return 0;
-		}
-	}
 
 	ui32NumDstSyncs = psDoKickIN->sCCBKick.ui32NumDstSyncObjects;
 
@@ -374,28 +316,16 @@ SGXDoKickBW(IMG_UINT32 ui32BridgeID,
 
 		/* Set sCCBKick.hDstSyncHandles to point to the local memory */
 		psDoKickIN->sCCBKick.hDstSyncHandles = (IMG_HANDLE)phKernelSyncInfoHandles;
-		pahDstSyncHandles = psDoKickIN->sCCBKick.hDstSyncHandles;
-		for( i = 0; i < ui32NumDstSyncs; i++)
-		{
-			psRetOUT->eError =
-				PVRSRVLookupHandle(psPerProc->psHandleBase,
-									&pahDstSyncHandles[i],
-									pahDstSyncHandles[i],
-									PVRSRV_HANDLE_TYPE_SYNC_INFO);
-
-			if(psRetOUT->eError != PVRSRV_OK)
-			{
-				goto PVRSRV_BRIDGE_SGX_DOKICK_RETURN_RESULT;
-			}
 
-		}
+		PVRSRVSetHandleLookup(&asLookup[0],
+							  phKernelSyncInfoHandles, ui32NumDstSyncs, sizeof(IMG_HANDLE),
+							  PVRSRV_HANDLE_TYPE_SYNC_INFO);
 
-		psRetOUT->eError =
-					PVRSRVLookupHandle(psPerProc->psHandleBase,
-									   &psDoKickIN->sCCBKick.hKernelHWSyncListMemInfo,
-									   psDoKickIN->sCCBKick.hKernelHWSyncListMemInfo,
-									   PVRSRV_HANDLE_TYPE_MEM_INFO);
+		PVRSRVSetHandleLookup(&asLookup[1],
+							  &psDoKickIN->sCCBKick.hKernelHWSyncListMemInfo, 1, sizeof(IMG_HANDLE),
+							  PVRSRV_HANDLE_TYPE_MEM_INFO);
 
+		psRetOUT->eError = PVRSRVLookupHandles(psPerProc->psHandleBase, asLookup, 2);
 		if(psRetOUT->eError != PVRSRV_OK)
 		{
 			goto PVRSRV_BRIDGE_SGX_DOKICK_RETURN_RESULT;
@@ -456,108 +386,66 @@ SGXSubmitTransferBW(IMG_UINT32 ui32BridgeID,
 {
 	IMG_HANDLE hDevCookieInt;
 	PVRSRV_TRANSFER_SGX_KICK *psKick;
-	IMG_UINT32 i;
+	IMG_UINT32 ui32NumLookups = 0;
+	PVRSRV_HANDLE_LOOKUP asLookup[SGX_SUBMITTRANSFER_MAX_LOOKUPS];
 
 	PVRSRV_BRIDGE_ASSERT_CMD(ui32BridgeID, PVRSRV_BRIDGE_SGX_SUBMITTRANSFER);
 	PVR_UNREFERENCED_PARAMETER(ui32BridgeID);
 
 	psKick = &psSubmitTransferIN->sKick;
 
-#if defined(FIX_HW_BRN_31620)
-	/* We need to lookup the mem context and pass it through */
-	psRetOUT->eError =
-		PVRSRVLookupHandle(psPerProc->psHandleBase,
-						   &psKick->hDevMemContext,
-						   psKick->hDevMemContext,
-						   PVRSRV_HANDLE_TYPE_DEV_MEM_CONTEXT);
-
-	if(psRetOUT->eError != PVRSRV_OK)
+	if (psKick->ui32NumSrcSync > SGX_MAX_TRANSFER_SYNC_OPS ||
+		psKick->ui32NumDstSync > SGX_MAX_TRANSFER_SYNC_OPS)
 	{
+		psRetOUT->eError = PVRSRV_ERROR_INVALID_PARAMS;
 		return 0;
 	}
+
+#if defined(FIX_HW_BRN_31620)
+	/* We need to lookup the mem context and pass it through */
+	PVRSRVSetHandleLookup(&asLookup[ui32NumLookups++],
+						  &psKick->hDevMemContext, 1, sizeof(IMG_HANDLE),
+						  PVRSRV_HANDLE_TYPE_DEV_MEM_CONTEXT);
 #endif
 
-	psRetOUT->eError =
-		PVRSRVLookupHandle(psPerProc->psHandleBase,
-						   &hDevCookieInt,
-						   psSubmitTransferIN->hDevCookie,
-						   PVRSRV_HANDLE_TYPE_DEV_NODE);
-	if(psRetOUT->eError != PVRSRV_OK)
-	{
-		return 0;
-	}
+	hDevCookieInt = psSubmitTransferIN->hDevCookie;
+	PVRSRVSetHandleLookup(&asLookup[ui32NumLookups++],
+						  &hDevCookieInt, 1, sizeof(IMG_HANDLE),
+						  PVRSRV_HANDLE_TYPE_DEV_NODE);
 
-	psRetOUT->eError =
-		PVRSRVLookupHandle(psPerProc->psHandleBase,
-						   &psKick->hCCBMemInfo,
-						   psKick->hCCBMemInfo,
-						   PVRSRV_HANDLE_TYPE_MEM_INFO);
-	if(psRetOUT->eError != PVRSRV_OK)
-	{
-		return 0;
-	}
+	PVRSRVSetHandleLookup(&asLookup[ui32NumLookups++],
+						  &psKick->hCCBMemInfo, 1, sizeof(IMG_HANDLE),
+						  PVRSRV_HANDLE_TYPE_MEM_INFO);
 
 	if (psKick->hTASyncInfo != IMG_NULL)
 	{
-		psRetOUT->eError =
-			PVRSRVLookupHandle(psPerProc->psHandleBase,
-							   &psKick->hTASyncInfo,
-							   psKick->hTASyncInfo,
-							   PVRSRV_HANDLE_TYPE_SYNC_INFO);
-		if(psRetOUT->eError != PVRSRV_OK)
-		{
-			return 0;
-		}
+		PVRSRVSetHandleLookup(&asLookup[ui32NumLookups++],
+							  &psKick->hTASyncInfo, 1, sizeof(IMG_HANDLE),
+							  PVRSRV_HANDLE_TYPE_SYNC_INFO);
 	}
 
 	if (psKick->h3DSyncInfo != IMG_NULL)
 	{
-		psRetOUT->eError =
-			PVRSRVLookupHandle(psPerProc->psHandleBase,
-							   &psKick->h3DSyncInfo,
-							   psKick->h3DSyncInfo,
-							   PVRSRV_HANDLE_TYPE_SYNC_INFO);
-		if(psRetOUT->eError != PVRSRV_OK)
-		{
-			return 0;
-		}
+		PVRSRVSetHandleLookup(&asLookup[ui32NumLookups++],
+							  &psKick->h3DSyncInfo, 1, sizeof(IMG_HANDLE),
+							  PVRSRV_HANDLE_TYPE_SYNC_INFO);
 	}
 
-	if (psKick->ui32NumSrcSync > SGX_MAX_TRANSFER_SYNC_OPS)
-	{
-		psRetOUT->eError = PVRSRV_ERROR_INVALID_PARAMS;
-		return 0;
-	}
-	for (i = 0; i < psKick->ui32NumSrcSync; i++)
-	{
-		psRetOUT->eError =
-			PVRSRVLookupHandle(psPerProc->psHandleBase,
-							   &psKick->ahSrcSyncInfo[i],
-							   psKick->ahSrcSyncInfo[i],
-							   PVRSRV_HANDLE_TYPE_SYNC_INFO);
-		if(psRetOUT->eError != PVRSRV_OK)
-		{
-			return 0;
-		}
-	}
+	PVRSRVSetHandleLookup(&asLookup[ui32NumLookups++],
+						  psKick->ahSrcSyncInfo, psKick->ui32NumSrcSync, sizeof(IMG_HANDLE),
+						  PVRSRV_HANDLE_TYPE_SYNC_INFO);
+
+	PVRSRVSetHandleLookup(&asLookup[ui32NumLookups++],
+						  psKick->ahDstSyncInfo, psKick->ui32NumDstSync, sizeof(IMG_HANDLE),
+						  PVRSRV_HANDLE_TYPE_SYNC_INFO);
 
-	if (psKick->ui32NumDstSync > SGX_MAX_TRANSFER_SYNC_OPS)
+	PVR_ASSERT(ui32NumLookups <= SGX_SUBMITTRANSFER_MAX_LOOKUPS);
+
+	psRetOUT->eError = PVRSRVLookupHandles(psPerProc->psHandleBase, asLookup, ui32NumLookups);
+	if(psRetOUT->eError != PVRSRV_OK)
 	{
-		psRetOUT->eError = PVRSRV_ERROR_INVALID_PARAMS;
 		return 0;
 	}
-	for (i = 0; i < psKick->ui32NumDstSync; i++)
-	{
-		psRetOUT->eError =
-			PVRSRVLookupHandle(psPerProc->psHandleBase,
-							   &psKick->ahDstSyncInfo[i],
-							   psKick->ahDstSyncInfo[i],
-							   PVRSRV_HANDLE_TYPE_SYNC_INFO);
-		if(psRetOUT->eError != PVRSRV_OK)
-		{
-			return 0;
-		}
-	}
 
 	psRetOUT->eError = SGXSubmitTransferKM(hDevCookieInt, psKick);
 
@@ -3008,15 +2896,31 @@ IMG_VOID SetSGXDispatchTableEntry(IMG_VOID)
 	SetDispatchTableEntry(PVRSRV_BRIDGE_SGX_RELEASECLIENTINFO, SGXReleaseClientInfoBW);
 	SetDispatchTableEntry(PVRSRV_BRIDGE_SGX_GETINTERNALDEVINFO, SGXGetInternalDevInfoBW);
 	SetDispatchTableEntry(PVRSRV_BRIDGE_SGX_DOKICK, SGXDoKickBW);
+	SetDispatchTableBufferSizes(PVRSRV_BRIDGE_SGX_DOKICK,
+								sizeof(PVRSRV_BRIDGE_IN_DOKICK),
+								sizeof(PVRSRV_BRIDGE_RETURN));
 	SetDispatchTableEntry(PVRSRV_BRIDGE_SGX_GETPHYSPAGEADDR, DummyBW);
 	SetDispatchTableEntry(PVRSRV_BRIDGE_SGX_READREGISTRYDWORD, DummyBW);
 
 	SetDispatchTableEntry(PVRSRV_BRIDGE_SGX_2DQUERYBLTSCOMPLETE, SGX2DQueryBlitsCompleteBW);
+	SetDispatchTableBufferSizes(PVRSRV_BRIDGE_SGX_2DQUERYBLTSCOMPLETE,
+								sizeof(PVRSRV_BRIDGE_IN_2DQUERYBLTSCOMPLETE),
+								sizeof(PVRSRV_BRIDGE_RETURN));
+#if !defined(PDUMP)
+	/* Only reads the sync object, but may poll it for a long time */
+	SetDispatchTableConcurrent(PVRSRV_BRIDGE_SGX_2DQUERYBLTSCOMPLETE);
+#endif
 
 #if defined(TRANSFER_QUEUE)
 	SetDispatchTableEntry(PVRSRV_BRIDGE_SGX_SUBMITTRANSFER, SGXSubmitTransferBW);
+	SetDispatchTableBufferSizes(PVRSRV_BRIDGE_SGX_SUBMITTRANSFER,
+								sizeof(PVRSRV_BRIDGE_IN_SUBMITTRANSFER),
+								sizeof(PVRSRV_BRIDGE_RETURN));
 #endif
 	SetDispatchTableEntry(PVRSRV_BRIDGE_SGX_GETMISCINFO, SGXGetMiscInfoBW);
+	SetDispatchTableBufferSizes(PVRSRV_BRIDGE_SGX_GETMISCINFO,
+								sizeof(PVRSRV_BRIDGE_IN_SGXGETMISCINFO),
+								sizeof(PVRSRV_BRIDGE_RETURN));
 	SetDispatchTableEntry(PVRSRV_BRIDGE_SGXINFO_FOR_SRVINIT	, SGXGetInfoForSrvinitBW);
 	SetDispatchTableEntry(PVRSRV_BRIDGE_SGX_DEVINITPART2, SGXDevInitPart2BW);
 
@@ -3028,6 +2932,9 @@ IMG_VOID SetSGXDispatchTableEntry(IMG_VOID)
 	SetDispatchTableEntry(PVRSRV_BRIDGE_SGX_UNREGISTER_HW_RENDER_CONTEXT, SGXUnregisterHWRenderContextBW);
 #if defined(SGX_FEATURE_2D_HARDWARE)
 	SetDispatchTableEntry(PVRSRV_BRIDGE_SGX_SUBMIT2D, SGXSubmit2DBW);
+	SetDispatchTableBufferSizes(PVRSRV_BRIDGE_SGX_SUBMIT2D,
+								sizeof(PVRSRV_BRIDGE_IN_SUBMIT2D),
+								sizeof(PVRSRV_BRIDGE_RETURN));
 	SetDispatchTableEntry(PVRSRV_BRIDGE_SGX_REGISTER_HW_2D_CONTEXT, SGXRegisterHW2DContextBW);
 	SetDispatchTableEntry(PVRSRV_BRIDGE_SGX_UNREGISTER_HW_2D_CONTEXT, SGXUnregisterHW2DContextBW);
 #endif
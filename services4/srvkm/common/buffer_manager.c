@@ -48,6 +48,24 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "ra.h"
 #include "pdump_km.h"
 #include "lists.h"
+#include "alloc_trace.h"
+
+/* Largest allocation, in pages, served from the import arena quantum
+   caches. 0 disables quantum caching. */
+#if !defined(BM_QCACHE_PAGES)
+#define BM_QCACHE_PAGES		16
+#endif
+
+/* Completely free imports are kept in the import arena, up to
+   BM_RETAIN_SPAN_BYTES per heap for at most BM_RETAIN_SPAN_MS, so that
+   memory freed and allocated again on the next frame is not unmapped and
+   mapped again. 0 bytes disables retention. */
+#if !defined(BM_RETAIN_SPAN_BYTES)
+#define BM_RETAIN_SPAN_BYTES	(4 * 1024 * 1024)
+#endif
+#if !defined(BM_RETAIN_SPAN_MS)
+#define BM_RETAIN_SPAN_MS		1000
+#endif
 
 static IMG_BOOL
 ZeroBuf(BM_BUF *pBuf, BM_MAPPING *pMapping, IMG_SIZE_T uBytes, IMG_UINT32 ui32Flags);
@@ -1207,7 +1225,7 @@ BM_CreateContext(PVRSRV_DEVICE_NODE			*psDeviceNode,
 
 	/* This hash table is used to store BM_Wraps in a global way */
 	/* INTEGRATION_POINT: 32 is an abitrary limit on the number of hashed BM_wraps */
-	pBMContext->pBufferHash = HASH_Create(32);
+	pBMContext->pBufferHash = HASH_Create("BM buffers", 32);
 	if (pBMContext->pBufferHash==IMG_NULL)
 	{
 		PVR_DPF ((PVR_DBG_ERROR, "BM_CreateContext: HASH_Create failed"));
@@ -1405,6 +1423,7 @@ BM_CreateHeap (IMG_HANDLE hBMContext,
 	psBMHeap->pImportArena = RA_Create (psDevMemHeapInfo->pszBSName,
 										0, 0, IMG_NULL,
 										MIN(HOST_PAGESIZE(), psBMHeap->sDevArena.ui32DataPageSize),
+										BM_QCACHE_PAGES * MIN(HOST_PAGESIZE(), psBMHeap->sDevArena.ui32DataPageSize),
 										&BM_ImportMemory,
 										&BM_FreeMemory,
 										IMG_NULL,
@@ -1415,6 +1434,8 @@ BM_CreateHeap (IMG_HANDLE hBMContext,
 		goto ErrorExit;
 	}
 
+	RA_SetSpanRetention (psBMHeap->pImportArena, BM_RETAIN_SPAN_BYTES, BM_RETAIN_SPAN_MS);
+
 	if(psBMHeap->ui32Attribs & PVRSRV_BACKINGSTORE_LOCALMEM_CONTIG)
 	{
 		/*
@@ -1635,6 +1656,8 @@ BM_Alloc (  IMG_HANDLE			hDevMemHeap,
 		OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof (BM_BUF), pBuf, IMG_NULL);
 		/* not nulling pointer, out of scope */
 		PVR_DPF((PVR_DBG_ERROR, "BM_Alloc: AllocMemory FAILED"));
+		PVR_ALLOC_TRACE(BM_ALLOC, psBMHeap->sDevArena.ui32HeapID, 0, uSize,
+						uDevVAddrAlignment, ui32Flags, IMG_FALSE);
 		return IMG_FALSE;
 	}
 
@@ -1642,6 +1665,9 @@ BM_Alloc (  IMG_HANDLE			hDevMemHeap,
 		  "BM_Alloc (uSize=0x%" SIZE_T_FMT_LEN "x, ui32Flags=0x%x)",
 		  uSize, ui32Flags));
 
+	PVR_ALLOC_TRACE(BM_ALLOC, psBMHeap->sDevArena.ui32HeapID, pBuf->DevVAddr.uiAddr, uSize,
+					uDevVAddrAlignment, ui32Flags, IMG_TRUE);
+
 	/*
 	 * Assign the handle and return.
 	 */
@@ -2029,6 +2055,8 @@ BM_Free (BM_HANDLE hBuf,
 
 			HASH_Remove (pBuf->pMapping->pBMHeap->pBMContext->pBufferHash,	(IMG_UINTPTR_T)sHashAddr.uiAddr);
 		}
+		PVR_ALLOC_TRACE(BM_FREE, pBuf->pMapping->pBMHeap->sDevArena.ui32HeapID,
+						pBuf->DevVAddr.uiAddr, 0, 0, ui32Flags, IMG_TRUE);
 		FreeBuf (pBuf, ui32Flags, IMG_TRUE
 					#if defined(PVRSRV_DEVMEM_TIME_STATS)
 					,pui32TimeToDevUnmap
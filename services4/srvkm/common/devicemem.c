@@ -3285,7 +3285,7 @@ PVRSRV_ERROR IMG_CALLCONV PVRSRVInitDeviceMem(IMG_VOID)
 		For Ion buffers we need to store which ones we know about so
 		we don't give the same buffer a different sync
 	*/
-	g_psIonSyncHash = HASH_Create(ION_SYNC_HASH_SIZE);
+	g_psIonSyncHash = HASH_Create("ION syncs", ION_SYNC_HASH_SIZE);
 	if (!g_psIonSyncHash)
 	{
 		eError = PVRSRV_ERROR_OUT_OF_MEMORY;
@@ -3293,7 +3293,7 @@ PVRSRV_ERROR IMG_CALLCONV PVRSRVInitDeviceMem(IMG_VOID)
 	}
 #endif
 #if defined(SUPPORT_DMABUF)
-	g_psDmaBufSyncHash = HASH_Create(DMABUF_SYNC_HASH_SIZE);
+	g_psDmaBufSyncHash = HASH_Create("dma-buf syncs", DMABUF_SYNC_HASH_SIZE);
 	if (!g_psDmaBufSyncHash)
 	{
 		eError = PVRSRV_ERROR_OUT_OF_MEMORY;
@@ -44,21 +44,26 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 /* See handle.h for a description of the handle API. */
 
 /*
- * There is no locking here.  It is assumed the code is used in a single
- * threaded environment.  In particular, it is assumed that the code will
- * never be called from an interrupt handler.
+ * There is no locking here.  It is assumed the code that changes a handle
+ * base is used in a single threaded environment.  In particular, it is
+ * assumed that the code will never be called from an interrupt handler.
+ * The exception is PVRSRVLookupHandle and PVRSRVLookupHandleAnyType,
+ * which take no lock and may run alongside allocation and release of
+ * handles in other threads (see LookupHandleData).
  *
- * The implementation supports movable handle structures, allowing the address
- * of a handle structure to change without having to fix up pointers in
- * any of the handle structures.  For example, the linked list mechanism
- * used to link subhandles together uses handle array indices rather than
- * pointers to the structures themselves.
+ * Handle structures are allocated a block at a time, and never move once
+ * allocated.  The blocks are reached through a two level index (see
+ * HANDLE_INDEX_CHUNK_SHIFT), so growing the handle array copies nothing.
+ * Even so, the linked list mechanism used to link subhandles together
+ * uses handle array indices rather than pointers to the structures
+ * themselves.
  */
 
 #include "img_defs.h"
 
 #include "services_headers.h"
 #include "handle.h"
+#include "bridge_capture.h"
 
 #ifdef	DEBUG
 #define	HANDLE_BLOCK_SHIFT	2
@@ -77,26 +82,52 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #define	INDEX_IS_VALID(psBase, i) ((i) < (psBase)->ui32TotalHandCount)
 
-/* Valid handles are never NULL, but handle array indices are based from 0 */
-#define	INDEX_TO_HANDLE(i) ((IMG_HANDLE)((IMG_UINTPTR_T)(i) + 1))
-#define	HANDLE_TO_INDEX(h) ((IMG_UINT32)(IMG_UINTPTR_T)(h) - 1)
+/*
+ * A handle carries the generation of its handle structure above the
+ * array index.  The generation is advanced each time the structure is
+ * freed, so a stale handle stops matching once the slot is reused.
+ * Valid handles are never NULL, but handle array indices are based from 0.
+ */
+#define	INDEX_TO_HANDLE(psBase, i, g) ((IMG_HANDLE)((IMG_UINTPTR_T)((((g) & (psBase)->ui32GenerationMask) << (psBase)->ui32IndexBits) | (i)) + 1))
+#define	HANDLE_TO_INDEX(psBase, h) (((IMG_UINT32)(IMG_UINTPTR_T)(h) - 1) & (psBase)->ui32IndexMask)
+#define	HANDLE_TO_GENERATION(psBase, h) (((IMG_UINT32)(IMG_UINTPTR_T)(h) - 1) >> (psBase)->ui32IndexBits)
+
+/*
+ * Number of handle bits given over to the generation, unless that would
+ * leave fewer than HANDLE_MIN_INDEX_BITS for the index.
+ */
+#define	HANDLE_GENERATION_BITS	10
+#define	HANDLE_MIN_INDEX_BITS	17
 
 
 #define	INDEX_TO_BLOCK_INDEX(i)		DIVIDE_BY_BLOCK_SIZE(i)
 #define BLOCK_INDEX_TO_INDEX(i)		MULTIPLY_BY_BLOCK_SIZE(i)
 #define INDEX_TO_SUB_BLOCK_INDEX(i)	((i) & HANDLE_SUB_BLOCK_MASK)
 
-#define INDEX_TO_INDEX_STRUCT_PTR(psArray, i) (&((psArray)[INDEX_TO_BLOCK_INDEX(i)]))
-#define	BASE_AND_INDEX_TO_INDEX_STRUCT_PTR(psBase, i) INDEX_TO_INDEX_STRUCT_PTR((psBase)->psHandleArray, i)
+/*
+ * The index structures, one per block of handles, are held in chunks of
+ * HANDLE_INDEX_CHUNK_SIZE.  The chunks are found through a directory
+ * sized for the handle limit of the base when the first handles are
+ * allocated.
+ */
+#define	HANDLE_INDEX_CHUNK_SHIFT	6
+#define	HANDLE_INDEX_CHUNK_SIZE		(1U << HANDLE_INDEX_CHUNK_SHIFT)
+#define	HANDLE_INDEX_CHUNK_MASK		(HANDLE_INDEX_CHUNK_SIZE - 1)
+
+#define	BLOCK_INDEX_TO_CHUNK_INDEX(b)		((b) >> HANDLE_INDEX_CHUNK_SHIFT)
+#define	BLOCK_INDEX_TO_SUB_CHUNK_INDEX(b)	((b) & HANDLE_INDEX_CHUNK_MASK)
+
+#define INDEX_TO_INDEX_STRUCT_PTR(ppsChunk, i) (&(ppsChunk)[BLOCK_INDEX_TO_CHUNK_INDEX(INDEX_TO_BLOCK_INDEX(i))]->asIndex[BLOCK_INDEX_TO_SUB_CHUNK_INDEX(INDEX_TO_BLOCK_INDEX(i))])
+#define	BASE_AND_INDEX_TO_INDEX_STRUCT_PTR(psBase, i) INDEX_TO_INDEX_STRUCT_PTR((psBase)->ppsIndexChunk, i)
 
 #define	INDEX_TO_FREE_HAND_BLOCK_COUNT(psBase, i) (BASE_AND_INDEX_TO_INDEX_STRUCT_PTR(psBase, i)->ui32FreeHandBlockCount)
 
-#define INDEX_TO_HANDLE_STRUCT_PTR(psBase, i) (BASE_AND_INDEX_TO_INDEX_STRUCT_PTR(psBase, i)->psHandle + INDEX_TO_SUB_BLOCK_INDEX(i))
+#define INDEX_TO_HANDLE_STRUCT_PTR(psBase, i) (&BASE_AND_INDEX_TO_INDEX_STRUCT_PTR(psBase, i)->psBlock->asHandle[INDEX_TO_SUB_BLOCK_INDEX(i)])
 
-#define	HANDLE_TO_HANDLE_STRUCT_PTR(psBase, h) (INDEX_TO_HANDLE_STRUCT_PTR(psBase, HANDLE_TO_INDEX(h)))
+#define	HANDLE_TO_HANDLE_STRUCT_PTR(psBase, h) (INDEX_TO_HANDLE_STRUCT_PTR(psBase, HANDLE_TO_INDEX(psBase, h)))
 
 #define	HANDLE_PTR_TO_INDEX(psHandle) ((psHandle)->ui32Index)
-#define	HANDLE_PTR_TO_HANDLE(psHandle) INDEX_TO_HANDLE(HANDLE_PTR_TO_INDEX(psHandle))
+#define	HANDLE_PTR_TO_HANDLE(psBase, psHandle) INDEX_TO_HANDLE(psBase, HANDLE_PTR_TO_INDEX(psHandle), (psHandle)->ui32Generation)
 
 #define	ROUND_DOWN_TO_MULTIPLE_OF_BLOCK_SIZE(a) (HANDLE_BLOCK_MASK & (a))
 #define	ROUND_UP_TO_MULTIPLE_OF_BLOCK_SIZE(a) ROUND_DOWN_TO_MULTIPLE_OF_BLOCK_SIZE((a) + HANDLE_BLOCK_SIZE - 1)
@@ -186,6 +217,13 @@ struct sHandle
 	/* Index of this handle in the handle array */
 	IMG_UINT32 ui32Index;
 
+	/*
+	 * Generation of the handle, advanced each time the handle is
+	 * freed.  It is checked against the generation bits of the
+	 * handle value on lookup.
+	 */
+	IMG_UINT32 ui32Generation;
+
 	/* List head for subhandles of this handle */
 	struct sHandleList sChildren;
 
@@ -193,33 +231,87 @@ struct sHandle
 	struct sHandleList sSiblings;
 };
 
-/* Handle array index structure.
- * The handle array is an array of index structures, reallocated as the number of
- * handles increases.
- * NOTE: There is one index structure per block of handles.
+/*
+ * A handle being looked up by PVRSRVLookupHandles.  The handles are
+ * checked HANDLE_LOOKUP_CHUNK_SIZE at a time.
  */
-struct sHandleIndex
+#define	HANDLE_LOOKUP_CHUNK_SIZE	8
+
+struct sHandleLookup
 {
-	/* Pointer to first handle structure in the block */
+	/* Handle, replaced by the data pointer once looked up */
+	IMG_HANDLE *phHandle;
+
+	/* Handle structure for the handle index */
 	struct sHandle *psHandle;
 
-	/* Block allocation cookie returned from OSAllocMem for the block of handles */
+	/* Data pointer read from the handle structure */
+	IMG_PVOID pvData;
+
+	/* Generation from the handle */
+	IMG_UINT32 ui32Generation;
+
+	/* Type required, and type read from the handle structure */
+	PVRSRV_HANDLE_TYPE eType;
+	PVRSRV_HANDLE_TYPE eHandleType;
+};
+
+/*
+ * Block of handle structures.  Blocks dropped from the handle array are
+ * freed after an RCU grace period, as lockless lookups may still be
+ * reading them.
+ */
+struct sHandleBlock
+{
+	OS_RCU_HEAD sRCUHead;
+
+	/* Block allocation cookie returned from OSAllocMem for the block */
 	IMG_HANDLE hBlockAlloc;
 
+	struct sHandle asHandle[HANDLE_BLOCK_SIZE];
+};
+
+/* Handle array index structure.
+ * NOTE: There is one index structure per block of handles.
+ */
+struct sHandleIndex
+{
+	/* The block of handle structures */
+	struct sHandleBlock *psBlock;
+
 	/* Number of free handles in block */
 	IMG_UINT32 ui32FreeHandBlockCount;
 };
 
+/* Chunk of index structures */
+struct sHandleIndexChunk
+{
+	/* Block allocation cookie returned from OSAllocMem for the chunk */
+	IMG_HANDLE hBlockAlloc;
+
+	struct sHandleIndex asIndex[HANDLE_INDEX_CHUNK_SIZE];
+};
+
 struct _PVRSRV_HANDLE_BASE_
 {
 	/*  Handle returned from OSAllocMem for handle base allocation */
 	IMG_HANDLE hBaseBlockAlloc;
 
-	/* Handle returned from OSAllocMem for handle array allocation */
-	IMG_HANDLE hArrayBlockAlloc;
+	/*
+	 * Directory of chunks of index structures, or IMG_NULL if no
+	 * handles have been allocated yet.  Chunks are never freed
+	 * before the handle base.
+	 */
+	struct sHandleIndexChunk **ppsIndexChunk;
+
+	/* Handle returned from OSAllocMem for the directory allocation */
+	IMG_HANDLE hDirBlockAlloc;
+
+	/* Number of entries in the directory */
+	IMG_UINT32 ui32IndexChunkMax;
 
-	/* Pointer to array of pointers to handle structures */
-	struct sHandleIndex *psHandleArray;
+	/* Number of chunks allocated */
+	IMG_UINT32 ui32IndexChunkCount;
 
 	/*
 	 * Pointer to handle hash table.
@@ -232,8 +324,9 @@ struct _PVRSRV_HANDLE_BASE_
 	IMG_UINT32 ui32FreeHandCount;
 
 	/*
-	 * If purging is not enabled, this is the array index of first free
-	 * handle.
+	 * If purging is not enabled, this is the array index of the handle
+	 * at the front of the free handle list, which is the most recently
+	 * freed.
 	 * If purging is enabled, this is the index to start searching for
 	 * a free handle from.  In this case it is usually zero, unless
 	 * the handle array size has been increased due to lack of
@@ -244,14 +337,25 @@ struct _PVRSRV_HANDLE_BASE_
 	/* Maximum handle index, plus one */
 	IMG_UINT32 ui32MaxIndexPlusOne;
 
-	/* Total number of handles, free and allocated */
-	IMG_UINT32 ui32TotalHandCount;
+	/* Number of index bits in a handle, and the matching mask */
+	IMG_UINT32 ui32IndexBits;
+	IMG_UINT32 ui32IndexMask;
+
+	/* Mask for the generation bits above the index */
+	IMG_UINT32 ui32GenerationMask;
+
+	/*
+	 * Generation given to handle structures in newly allocated blocks.
+	 * Advanced whenever blocks are purged, so that handles into a
+	 * purged block are unlikely to match when the block is reallocated.
+	 */
+	IMG_UINT32 ui32NewBlockGeneration;
 
 	/*
-	 * Index of the last free index, plus one. Not used if purging
-	 * is enabled.
+	 * Total number of handles, free and allocated.  Read by lockless
+	 * lookups; the blocks are in place before it is raised.
 	 */
-	IMG_UINT32 ui32LastFreeIndexPlusOne;
+	IMG_UINT32 ui32TotalHandCount;
 
 	/* Size of current handle batch, or zero if batching not enabled */
 	IMG_UINT32 ui32HandBatchSize;
@@ -330,18 +434,19 @@ IMG_VOID HandleListInit(IMG_UINT32 ui32Index, struct sHandleList *psList, IMG_HA
  @Description	Initialise the children list head in a handle structure.
 		The children are the subhandles of this handle.
 
- @Input		psHandle - pointer to handle structure
+ @Input		psBase - pointer to handle base structure
+		psHandle - pointer to handle structure
 
 ******************************************************************************/
 #ifdef INLINE_IS_PRAGMA
 #pragma inline(InitParentList)
 #endif
 static INLINE
-IMG_VOID InitParentList(struct sHandle *psHandle)
+IMG_VOID InitParentList(PVRSRV_HANDLE_BASE *psBase, struct sHandle *psHandle)
 {
 	IMG_UINT32 ui32Parent = HANDLE_PTR_TO_INDEX(psHandle);
 
-	HandleListInit(ui32Parent, &psHandle->sChildren, INDEX_TO_HANDLE(ui32Parent));
+	HandleListInit(ui32Parent, &psHandle->sChildren, HANDLE_PTR_TO_HANDLE(psBase, psHandle));
 }
 
 /*!
@@ -408,7 +513,8 @@ IMG_BOOL HandleListIsEmpty(IMG_UINT32 ui32Index, struct sHandleList *psList)
 
  @Description	Determine whether a handle has any subhandles
 
- @Input		psHandle - pointer to handle structure
+ @Input		psBase - pointer to handle base structure
+		psHandle - pointer to handle structure
 
  @Return	IMG_TRUE if the handle has no subhandles, IMG_FALSE if it does.
 
@@ -417,9 +523,9 @@ IMG_BOOL HandleListIsEmpty(IMG_UINT32 ui32Index, struct sHandleList *psList)
 #pragma inline(NoChildren)
 #endif
 static INLINE
-IMG_BOOL NoChildren(struct sHandle *psHandle)
+IMG_BOOL NoChildren(PVRSRV_HANDLE_BASE *psBase, struct sHandle *psHandle)
 {
-	PVR_ASSERT(psHandle->sChildren.hParent == HANDLE_PTR_TO_HANDLE(psHandle));
+	PVR_ASSERT(psHandle->sChildren.hParent == HANDLE_PTR_TO_HANDLE(psBase, psHandle));
 
 	return HandleListIsEmpty(HANDLE_PTR_TO_INDEX(psHandle), &psHandle->sChildren);
 }
@@ -515,17 +621,18 @@ IMG_VOID HandleListInsertBefore(PVRSRV_HANDLE_BASE *psBase, IMG_UINT32 ui32InsIn
 {
 	/* PRQA S 3305 7 */ /*override stricter alignment warning */
 	struct sHandleList *psPrevIns = LIST_PTR_FROM_INDEX_AND_OFFSET(psBase, psIns->ui32Prev, ui32ParentIndex, uiParentOffset, uiEntryOffset);
+	IMG_HANDLE hParent = HANDLE_PTR_TO_HANDLE(psBase, INDEX_TO_HANDLE_STRUCT_PTR(psBase, ui32ParentIndex));
 
 	PVR_ASSERT(psEntry->hParent == IMG_NULL);
 	PVR_ASSERT(ui32InsIndex == psPrevIns->ui32Next);
-	PVR_ASSERT(LIST_PTR_FROM_INDEX_AND_OFFSET(psBase, ui32ParentIndex, ui32ParentIndex, uiParentOffset, uiParentOffset)->hParent == INDEX_TO_HANDLE(ui32ParentIndex));
+	PVR_ASSERT(LIST_PTR_FROM_INDEX_AND_OFFSET(psBase, ui32ParentIndex, ui32ParentIndex, uiParentOffset, uiParentOffset)->hParent == hParent);
 
 	psEntry->ui32Prev = psIns->ui32Prev;
 	psIns->ui32Prev = ui32EntryIndex;
 	psEntry->ui32Next = ui32InsIndex;
 	psPrevIns->ui32Next = ui32EntryIndex;
 
-	psEntry->hParent = INDEX_TO_HANDLE(ui32ParentIndex);
+	psEntry->hParent = hParent;
 }
 
 /*!
@@ -545,7 +652,7 @@ IMG_VOID HandleListInsertBefore(PVRSRV_HANDLE_BASE *psBase, IMG_UINT32 ui32InsIn
 static INLINE
 IMG_VOID AdoptChild(PVRSRV_HANDLE_BASE *psBase, struct sHandle *psParent, struct sHandle *psChild)
 {
-	IMG_UINT32 ui32Parent = HANDLE_TO_INDEX(psParent->sChildren.hParent);
+	IMG_UINT32 ui32Parent = HANDLE_TO_INDEX(psBase, psParent->sChildren.hParent);
 
 	PVR_ASSERT(ui32Parent == HANDLE_PTR_TO_INDEX(psParent));
 
@@ -575,8 +682,8 @@ IMG_VOID HandleListRemove(PVRSRV_HANDLE_BASE *psBase, IMG_UINT32 ui32EntryIndex,
 	if (!HandleListIsEmpty(ui32EntryIndex, psEntry))
 	{
 		/* PRQA S 3305 3 */ /*override stricter alignment warning */
-		struct sHandleList *psPrev = LIST_PTR_FROM_INDEX_AND_OFFSET(psBase, psEntry->ui32Prev, HANDLE_TO_INDEX(psEntry->hParent), uiParentOffset, uiEntryOffset);
-		struct sHandleList *psNext = LIST_PTR_FROM_INDEX_AND_OFFSET(psBase, psEntry->ui32Next, HANDLE_TO_INDEX(psEntry->hParent), uiParentOffset, uiEntryOffset);
+		struct sHandleList *psPrev = LIST_PTR_FROM_INDEX_AND_OFFSET(psBase, psEntry->ui32Prev, HANDLE_TO_INDEX(psBase, psEntry->hParent), uiParentOffset, uiEntryOffset);
+		struct sHandleList *psNext = LIST_PTR_FROM_INDEX_AND_OFFSET(psBase, psEntry->ui32Next, HANDLE_TO_INDEX(psBase, psEntry->hParent), uiParentOffset, uiEntryOffset);
 
 		/*
 		 * The list head is on the list, and we don't want to
@@ -630,7 +737,7 @@ static INLINE
 PVRSRV_ERROR HandleListIterate(PVRSRV_HANDLE_BASE *psBase, struct sHandleList *psHead, IMG_SIZE_T uiParentOffset, IMG_SIZE_T uiEntryOffset, PVRSRV_ERROR (*pfnIterFunc)(PVRSRV_HANDLE_BASE *, struct sHandle *))
 {
 	IMG_UINT32 ui32Index;
-	IMG_UINT32 ui32Parent = HANDLE_TO_INDEX(psHead->hParent);
+	IMG_UINT32 ui32Parent = HANDLE_TO_INDEX(psBase, psHead->hParent);
 
 	PVR_ASSERT(psHead->hParent != IMG_NULL);
 
@@ -706,7 +813,7 @@ PVRSRV_ERROR IterateOverChildren(PVRSRV_HANDLE_BASE *psBase, struct sHandle *psP
 static INLINE
 PVRSRV_ERROR GetHandleStructure(PVRSRV_HANDLE_BASE *psBase, struct sHandle **ppsHandle, IMG_HANDLE hHandle, PVRSRV_HANDLE_TYPE eType)
 {
-	IMG_UINT32 ui32Index = HANDLE_TO_INDEX(hHandle);
+	IMG_UINT32 ui32Index = HANDLE_TO_INDEX(psBase, hHandle);
 	struct sHandle *psHandle;
 
 	/* Check handle index is in range */
@@ -723,6 +830,13 @@ PVRSRV_ERROR GetHandleStructure(PVRSRV_HANDLE_BASE *psBase, struct sHandle **pps
 		return PVRSRV_ERROR_HANDLE_NOT_ALLOCATED;
 	}
 
+	/* Check the handle hasn't been freed and its slot reused */
+	if (HANDLE_TO_GENERATION(psBase, hHandle) != psHandle->ui32Generation)
+	{
+		PVR_DPF((PVR_DBG_ERROR, "GetHandleStructure: Stale handle (index: %u, generation: %u != %u)", ui32Index, HANDLE_TO_GENERATION(psBase, hHandle), psHandle->ui32Generation));
+		return PVRSRV_ERROR_HANDLE_NOT_ALLOCATED;
+	}
+
 	/*
 	 * Unless PVRSRV_HANDLE_TYPE_NONE was passed in to this function,
 	 * check handle is of the correct type.
@@ -739,6 +853,103 @@ PVRSRV_ERROR GetHandleStructure(PVRSRV_HANDLE_BASE *psBase, struct sHandle **pps
 	return PVRSRV_OK;
 }
 
+/*!
+******************************************************************************
+
+ @Function	LookupHandleData
+
+ @Description	Get the data pointer and type for a given handle, without
+		holding any lock against allocation and release of handles.
+
+		The handle count is read before the index, and blocks
+		dropped from the handle array are freed under RCU, so the
+		block cannot be freed from under the lookup.  The handle
+		structure is read between
+		two reads of its generation; FreeHandle advances the
+		generation before clearing the type, so if the handle is
+		freed during the lookup the two reads differ, or differ from
+		the generation in the handle, and the lookup fails as it
+		would have done had the free come first.
+
+ @Input		psBase - pointer to handle base structure
+		hHandle - handle from client
+		eType - handle type or PVRSRV_HANDLE_TYPE_NONE if the
+			handle type is not to be checked.
+		ppvData - location to return data pointer
+		peType - location to return handle type
+
+ @Output	ppvData - points to the data pointer
+		peType - points to handle type
+
+ @Return	Error code or PVRSRV_OK
+
+******************************************************************************/
+#ifdef INLINE_IS_PRAGMA
+#pragma inline(LookupHandleData)
+#endif
+static INLINE
+PVRSRV_ERROR LookupHandleData(PVRSRV_HANDLE_BASE *psBase, IMG_HANDLE hHandle, PVRSRV_HANDLE_TYPE eType, IMG_PVOID *ppvData, PVRSRV_HANDLE_TYPE *peType)
+{
+	IMG_UINT32 ui32Index = HANDLE_TO_INDEX(psBase, hHandle);
+	IMG_UINT32 ui32Generation = HANDLE_TO_GENERATION(psBase, hHandle);
+	IMG_UINT32 ui32TotalHandCount;
+	struct sHandle *psHandle;
+	PVRSRV_HANDLE_TYPE eHandleType;
+	IMG_PVOID pvData;
+	IMG_UINT32 ui32Before;
+	IMG_UINT32 ui32After;
+
+	OSRCUReadLock();
+
+	/* Pairs with the OSWriteMemoryBarrier in ReallocHandleArray */
+	ui32TotalHandCount = *(volatile IMG_UINT32 *)&psBase->ui32TotalHandCount;
+	OSReadMemoryBarrier();
+
+	/* Check handle index is in range */
+	if (ui32Index >= ui32TotalHandCount)
+	{
+		OSRCUReadUnlock();
+
+		PVR_DPF((PVR_DBG_ERROR, "LookupHandleData: Handle index out of range (%u)", ui32Index));
+		return PVRSRV_ERROR_HANDLE_INDEX_OUT_OF_RANGE;
+	}
+
+	psHandle = INDEX_TO_HANDLE_STRUCT_PTR(psBase, ui32Index);
+
+	ui32Before = psHandle->ui32Generation;
+	OSReadMemoryBarrier();
+	eHandleType = psHandle->eType;
+	pvData = psHandle->pvData;
+	OSReadMemoryBarrier();
+	ui32After = psHandle->ui32Generation;
+
+	OSRCUReadUnlock();
+
+	if (ui32Before != ui32Generation || ui32After != ui32Generation || eHandleType == PVRSRV_HANDLE_TYPE_NONE)
+	{
+		PVR_DPF((PVR_DBG_ERROR, "LookupHandleData: Handle not allocated (index: %u, generation: %u)", ui32Index, ui32Generation));
+		return PVRSRV_ERROR_HANDLE_NOT_ALLOCATED;
+	}
+
+	/*
+	 * Unless PVRSRV_HANDLE_TYPE_NONE was passed in to this function,
+	 * check handle is of the correct type.
+	 */
+	if (eType != PVRSRV_HANDLE_TYPE_NONE && eType != eHandleType)
+	{
+		PVR_DPF((PVR_DBG_ERROR, "LookupHandleData: Handle type mismatch (%d != %d)", eType, eHandleType));
+		return PVRSRV_ERROR_HANDLE_TYPE_MISMATCH;
+	}
+
+	*ppvData = pvData;
+	if (peType != IMG_NULL)
+	{
+		*peType = eHandleType;
+	}
+
+	return PVRSRV_OK;
+}
+
 /*!
 ******************************************************************************
 
@@ -789,17 +1000,44 @@ IMG_VOID InitKey(HAND_KEY aKey, PVRSRV_HANDLE_BASE *psBase, IMG_VOID *pvData, PV
 	aKey[HAND_KEY_PARENT] = (IMG_UINTPTR_T)hParent;
 }
 
+/*!
+******************************************************************************
+
+ @Function	FreeHandleBlock
+
+ @Description	Free a block of handle structures.
+
+ @Input		psHead - RCU head of the block
+
+******************************************************************************/
+static IMG_VOID FreeHandleBlock(OS_RCU_HEAD *psHead)
+{
+	struct sHandleBlock *psBlock = (struct sHandleBlock *)psHead;
+	PVRSRV_ERROR eError;
+
+	eError = OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP,
+			sizeof(*psBlock),
+			psBlock,
+			psBlock->hBlockAlloc);
+	if (eError != PVRSRV_OK)
+	{
+		PVR_DPF((PVR_DBG_ERROR, "FreeHandleBlock: Couldn't free handle structures (%d)", eError));
+	}
+}
+
 /*!
 ******************************************************************************
 
  @Function	ReallocHandleArray
 
- @Description	Reallocate the handle array
+ @Description	Change the number of handles in the handle array.
+		Growing the array allocates new blocks of handle
+		structures, and chunks of index structures as needed;
+		nothing already allocated is moved.  Shrinking the
+		array frees blocks, but keeps the index chunks.
 
  @Input		psBase - handle base.
-		phBlockAlloc - pointer to block allocation handle.
 		ui32NewCount - new handle count
-		ui32OldCount - old handle count
 
  @Return	Error code or PVRSRV_OK
 
@@ -807,13 +1045,8 @@ IMG_VOID InitKey(HAND_KEY aKey, PVRSRV_HANDLE_BASE *psBase, IMG_VOID *pvData, PV
 static
 PVRSRV_ERROR ReallocHandleArray(PVRSRV_HANDLE_BASE *psBase, IMG_UINT32 ui32NewCount)
 {
-	struct sHandleIndex *psOldArray = psBase->psHandleArray;
-	IMG_HANDLE hOldArrayBlockAlloc = psBase->hArrayBlockAlloc;
 	IMG_UINT32 ui32OldCount = psBase->ui32TotalHandCount;
-	struct sHandleIndex *psNewArray = IMG_NULL;
-	IMG_HANDLE hNewArrayBlockAlloc = IMG_NULL;
 	PVRSRV_ERROR eError;
-	PVRSRV_ERROR eReturn = PVRSRV_OK;
 	IMG_UINT32 ui32Index;
 
 	if (ui32NewCount == ui32OldCount)
@@ -836,123 +1069,151 @@ PVRSRV_ERROR ReallocHandleArray(PVRSRV_HANDLE_BASE *psBase, IMG_UINT32 ui32NewCo
 		return PVRSRV_ERROR_INVALID_PARAMS;
 	}
 
-	if (ui32NewCount != 0)
+	if (ui32NewCount < ui32OldCount)
 	{
-		/* Allocate new handle array */
-		eError = OSAllocMem(PVRSRV_OS_NON_PAGEABLE_HEAP,
-			HANDLE_ARRAY_SIZE(ui32NewCount) * sizeof(struct sHandleIndex),
-			(IMG_VOID **)&psNewArray,
-			&hNewArrayBlockAlloc,
-			"Memory Area");
-		if (eError != PVRSRV_OK)
+		PVR_ASSERT(ui32NewCount == 0 || psBase->ui32FirstFreeIndex <= ui32NewCount);
+		PVR_ASSERT(psBase->ui32FreeHandCount - (ui32OldCount - ui32NewCount) < psBase->ui32FreeHandCount);
+
+		/*
+		 * Drop the blocks beyond the new count.  Lockless lookups
+		 * that read the old count may still be using them, so they
+		 * are freed after a grace period.
+		 */
+		psBase->ui32TotalHandCount = ui32NewCount;
+
+		for(ui32Index = ui32NewCount; ui32Index < ui32OldCount; ui32Index += HANDLE_BLOCK_SIZE)
 		{
-			PVR_DPF((PVR_DBG_ERROR, "ReallocHandleArray: Couldn't allocate new handle array (%d)", eError));
-			eReturn = eError;
-			goto error;
+			struct sHandleIndex *psIndex = BASE_AND_INDEX_TO_INDEX_STRUCT_PTR(psBase, ui32Index);
+
+			OSCallRCU(&psIndex->psBlock->sRCUHead, FreeHandleBlock);
 		}
 
-		if (ui32OldCount != 0)
+		/* PRQA S 3382 1 */ /* ui32OldCount always >= ui32NewCount */
+		psBase->ui32FreeHandCount -= (ui32OldCount - ui32NewCount);
+
+		/* Handles into the dropped blocks must not match if they come back */
+		psBase->ui32NewBlockGeneration++;
+
+		if (ui32NewCount == 0)
 		{
-			OSMemCopy(psNewArray, psOldArray, HANDLE_ARRAY_SIZE(MIN(ui32NewCount, ui32OldCount)) * sizeof(struct sHandleIndex));
+			psBase->ui32FirstFreeIndex = 0;
 		}
+
+		return PVRSRV_OK;
 	}
 
-	/*
-	 * If the new handle array is smaller than the old one, free
-	 * unused handle structures
-	 */
-	for(ui32Index = ui32NewCount; ui32Index < ui32OldCount; ui32Index += HANDLE_BLOCK_SIZE)
+#ifdef	DEBUG_MAX_HANDLE_COUNT
+	/* Force handle failure to test error exit code */
+	if (ui32NewCount > DEBUG_MAX_HANDLE_COUNT)
 	{
-		struct sHandleIndex *psIndex = INDEX_TO_INDEX_STRUCT_PTR(psOldArray, ui32Index);
+		PVR_DPF((PVR_DBG_ERROR, "ReallocHandleArray: Max handle count (%u) reached", DEBUG_MAX_HANDLE_COUNT));
+		return PVRSRV_ERROR_OUT_OF_MEMORY;
+	}
+#endif
 
-		eError = OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP,
-				sizeof(struct sHandle) * HANDLE_BLOCK_SIZE,
-				psIndex->psHandle,
-				psIndex->hBlockAlloc);
+	if (psBase->ppsIndexChunk == IMG_NULL)
+	{
+		IMG_UINT32 ui32ChunkMax = BLOCK_INDEX_TO_CHUNK_INDEX(HANDLE_ARRAY_SIZE(psBase->ui32MaxIndexPlusOne) + HANDLE_INDEX_CHUNK_MASK);
+
+		/* Allocate the directory for the largest handle array allowed */
+		eError = OSAllocMem(PVRSRV_OS_NON_PAGEABLE_HEAP,
+			ui32ChunkMax * sizeof(*psBase->ppsIndexChunk),
+			(IMG_VOID **)&psBase->ppsIndexChunk,
+			&psBase->hDirBlockAlloc,
+			"Memory Area");
 		if (eError != PVRSRV_OK)
 		{
-			PVR_DPF((PVR_DBG_ERROR, "ReallocHandleArray: Couldn't free handle structures (%d)", eError));
+			psBase->ppsIndexChunk = IMG_NULL;
+			PVR_DPF((PVR_DBG_ERROR, "ReallocHandleArray: Couldn't allocate handle index directory (%d)", eError));
+			return eError;
 		}
+		OSMemSet(psBase->ppsIndexChunk, 0, ui32ChunkMax * sizeof(*psBase->ppsIndexChunk));
+
+		psBase->ui32IndexChunkMax = ui32ChunkMax;
 	}
 
-	/*
-	 * If the new handle array is bigger than the old one, allocate
-	 * new handle structures
-	 */
+	/* Allocate new handle structures */
 	for(ui32Index = ui32OldCount; ui32Index < ui32NewCount; ui32Index += HANDLE_BLOCK_SIZE)
 	{
-		/* PRQA S 0505 1 */ /* psNewArray is never NULL, see assert earlier */
-		struct sHandleIndex *psIndex = INDEX_TO_INDEX_STRUCT_PTR(psNewArray, ui32Index);
+		IMG_UINT32 ui32Chunk = BLOCK_INDEX_TO_CHUNK_INDEX(INDEX_TO_BLOCK_INDEX(ui32Index));
+		struct sHandleIndex *psIndex;
+		struct sHandleBlock *psBlock;
+		IMG_HANDLE hBlockAlloc;
+		IMG_UINT32 ui32SubIndex;
+
+		PVR_ASSERT(ui32Chunk <= psBase->ui32IndexChunkCount);
+
+		if (ui32Chunk == psBase->ui32IndexChunkCount)
+		{
+			struct sHandleIndexChunk *psChunk;
+
+			PVR_ASSERT(ui32Chunk < psBase->ui32IndexChunkMax);
+
+			eError = OSAllocMem(PVRSRV_OS_NON_PAGEABLE_HEAP,
+					sizeof(*psChunk),
+					(IMG_VOID **)&psChunk,
+					&hBlockAlloc,
+					"Memory Area");
+			if (eError != PVRSRV_OK)
+			{
+				PVR_DPF((PVR_DBG_ERROR, "ReallocHandleArray: Couldn't allocate handle index chunk (%d)", eError));
+				goto error;
+			}
+
+			psChunk->hBlockAlloc = hBlockAlloc;
+			OSMemSet(psChunk->asIndex, 0, sizeof(psChunk->asIndex));
+
+			/* Initialise the chunk before lockless lookups can reach it */
+			OSWriteMemoryBarrier();
+			psBase->ppsIndexChunk[ui32Chunk] = psChunk;
+			psBase->ui32IndexChunkCount++;
+		}
 
 		eError = OSAllocMem(PVRSRV_OS_NON_PAGEABLE_HEAP,
-				sizeof(struct sHandle) * HANDLE_BLOCK_SIZE,
-				(IMG_VOID **)&psIndex->psHandle,
-				&psIndex->hBlockAlloc,
+				sizeof(*psBlock),
+				(IMG_VOID **)&psBlock,
+				&hBlockAlloc,
 				"Memory Area");
 		if (eError != PVRSRV_OK)
 		{
-			psIndex->psHandle = IMG_NULL;
 			PVR_DPF((PVR_DBG_ERROR, "ReallocHandleArray: Couldn't allocate handle structures (%d)", eError));
-			eReturn = eError;
+			goto error;
 		}
-		else
-		{
-			IMG_UINT32 ui32SubIndex;
-
-			psIndex->ui32FreeHandBlockCount = HANDLE_BLOCK_SIZE;
 
-			for(ui32SubIndex = 0; ui32SubIndex < HANDLE_BLOCK_SIZE; ui32SubIndex++)
-			{
-				struct sHandle *psHandle = psIndex->psHandle + ui32SubIndex;
+		psBlock->hBlockAlloc = hBlockAlloc;
 
+		for(ui32SubIndex = 0; ui32SubIndex < HANDLE_BLOCK_SIZE; ui32SubIndex++)
+		{
+			struct sHandle *psHandle = &psBlock->asHandle[ui32SubIndex];
 
-				psHandle->ui32Index = ui32SubIndex + ui32Index;
-				psHandle->eType = PVRSRV_HANDLE_TYPE_NONE;
-				psHandle->eInternalFlag = INTERNAL_HANDLE_FLAG_NONE;
-				psHandle->ui32NextIndexPlusOne  = 0;
-			}
+			psHandle->ui32Index = ui32SubIndex + ui32Index;
+			psHandle->ui32Generation = psBase->ui32NewBlockGeneration & psBase->ui32GenerationMask;
+			psHandle->eType = PVRSRV_HANDLE_TYPE_NONE;
+			psHandle->eInternalFlag = INTERNAL_HANDLE_FLAG_NONE;
+			psHandle->ui32NextIndexPlusOne  = 0;
 		}
-	}
-	if (eReturn != PVRSRV_OK)
-	{
-		goto error;
-	}
 
-#ifdef	DEBUG_MAX_HANDLE_COUNT
-	/* Force handle failure to test error exit code */
-	if (ui32NewCount > DEBUG_MAX_HANDLE_COUNT)
-	{
-		PVR_DPF((PVR_DBG_ERROR, "ReallocHandleArray: Max handle count (%u) reached", DEBUG_MAX_HANDLE_COUNT));
-		eReturn = PVRSRV_ERROR_OUT_OF_MEMORY;
-		goto error;
-	}
-#endif
+		psIndex = BASE_AND_INDEX_TO_INDEX_STRUCT_PTR(psBase, ui32Index);
+		psIndex->ui32FreeHandBlockCount = HANDLE_BLOCK_SIZE;
 
-	if (psOldArray != IMG_NULL)
-	{
-		/* Free old handle array */
-		eError = OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP,
-			HANDLE_ARRAY_SIZE(ui32OldCount) * sizeof(struct sHandleIndex),
-			psOldArray,
-			hOldArrayBlockAlloc);
-		if (eError != PVRSRV_OK)
-		{
-			PVR_DPF((PVR_DBG_ERROR, "ReallocHandleArray: Couldn't free old handle array (%d)", eError));
-		}
+		/*
+		 * A lockless lookup that read the count from before a purge
+		 * may still index this block, so it must be initialised
+		 * before it is published.
+		 */
+		OSWriteMemoryBarrier();
+		psIndex->psBlock = psBlock;
 	}
 
-	psBase->psHandleArray = psNewArray;
-	psBase->hArrayBlockAlloc = hNewArrayBlockAlloc;
+	/* Make the new blocks visible to lockless lookups */
+	OSWriteMemoryBarrier();
 	psBase->ui32TotalHandCount = ui32NewCount;
 
-	if (ui32NewCount > ui32OldCount)
-	{
-		/* Check for wraparound */
-		PVR_ASSERT(psBase->ui32FreeHandCount + (ui32NewCount - ui32OldCount) > psBase->ui32FreeHandCount);
-
-		/* PRQA S 3382 1 */ /* ui32NewCount always > ui32OldCount */
-		psBase->ui32FreeHandCount += (ui32NewCount - ui32OldCount);
+	/* Check for wraparound */
+	PVR_ASSERT(psBase->ui32FreeHandCount + (ui32NewCount - ui32OldCount) > psBase->ui32FreeHandCount);
 
+	if (psBase->bPurgingEnabled)
+	{
 		/*
 		 * If purging is enabled, there is no free handle list
 		 * management, but as an optimization, when allocating
@@ -961,80 +1222,46 @@ PVRSRV_ERROR ReallocHandleArray(PVRSRV_HANDLE_BASE *psBase, IMG_UINT32 ui32NewCo
 		 */
 		if (psBase->ui32FirstFreeIndex == 0)
 		{
-			PVR_ASSERT(psBase->ui32LastFreeIndexPlusOne == 0);
-
 			psBase->ui32FirstFreeIndex = ui32OldCount;
 		}
-		else
-		{
-			if (!psBase->bPurgingEnabled)
-			{
-				PVR_ASSERT(psBase->ui32LastFreeIndexPlusOne != 0);
-				PVR_ASSERT(INDEX_TO_HANDLE_STRUCT_PTR(psBase, psBase->ui32LastFreeIndexPlusOne - 1)->ui32NextIndexPlusOne == 0);
-
-				INDEX_TO_HANDLE_STRUCT_PTR(psBase, psBase->ui32LastFreeIndexPlusOne - 1)->ui32NextIndexPlusOne = ui32OldCount + 1;
-			}
-		}
-
-		if (!psBase->bPurgingEnabled)
-		{
-			psBase->ui32LastFreeIndexPlusOne = ui32NewCount;
-		}
 	}
 	else
 	{
-		PVR_ASSERT(ui32NewCount == 0 || psBase->bPurgingEnabled);
-		PVR_ASSERT(ui32NewCount == 0 || psBase->ui32FirstFreeIndex <= ui32NewCount);
-		PVR_ASSERT(psBase->ui32FreeHandCount - (ui32OldCount - ui32NewCount) < psBase->ui32FreeHandCount);
-
-		/* PRQA S 3382 1 */ /* ui32OldCount always >= ui32NewCount */
-		psBase->ui32FreeHandCount -= (ui32OldCount - ui32NewCount);
-
-		if (ui32NewCount == 0)
+		/*
+		 * Put the new handles on the front of the free handle
+		 * list.  They are linked in index order by the zero
+		 * "next index plus one" fields; the last of them is
+		 * linked to the old front of the list.
+		 */
+		if (psBase->ui32FreeHandCount != 0)
 		{
-			psBase->ui32FirstFreeIndex = 0;
-			psBase->ui32LastFreeIndexPlusOne = 0;
+			INDEX_TO_HANDLE_STRUCT_PTR(psBase, ui32NewCount - 1)->ui32NextIndexPlusOne = psBase->ui32FirstFreeIndex + 1;
 		}
+
+		psBase->ui32FirstFreeIndex = ui32OldCount;
 	}
 
+	/* PRQA S 3382 1 */ /* ui32NewCount always > ui32OldCount */
+	psBase->ui32FreeHandCount += (ui32NewCount - ui32OldCount);
+
 	PVR_ASSERT(psBase->ui32FirstFreeIndex <= psBase->ui32TotalHandCount);
 
 	return PVRSRV_OK;
 
 error:
-	PVR_ASSERT(eReturn != PVRSRV_OK);
-
-	if (psNewArray != IMG_NULL)
+	/*
+	 * Free the handle structures allocated so far; the chunks are kept.
+	 * Stale lockless lookups may already see the blocks, so they are
+	 * freed after a grace period.
+	 */
+	while (ui32Index > ui32OldCount)
 	{
-		/* Free any new handle structures that were allocated */
-		for(ui32Index = ui32OldCount; ui32Index < ui32NewCount; ui32Index += HANDLE_BLOCK_SIZE)
-		{
-			struct sHandleIndex *psIndex = INDEX_TO_INDEX_STRUCT_PTR(psNewArray, ui32Index);
-			if (psIndex->psHandle != IMG_NULL)
-			{
-				eError = OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP,
-						sizeof(struct sHandle) * HANDLE_BLOCK_SIZE,
-						psIndex->psHandle,
-						psIndex->hBlockAlloc);
-				if (eError != PVRSRV_OK)
-				{
-					PVR_DPF((PVR_DBG_ERROR, "ReallocHandleArray: Couldn't free handle structures (%d)", eError));
-				}
-			}
-		}
+		ui32Index -= HANDLE_BLOCK_SIZE;
 
-		/* Free new handle array */
-		eError = OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP,
-			HANDLE_ARRAY_SIZE(ui32NewCount) * sizeof(struct sHandleIndex),
-			psNewArray,
-			hNewArrayBlockAlloc);
-		if (eError != PVRSRV_OK)
-		{
-			PVR_DPF((PVR_DBG_ERROR, "ReallocHandleArray: Couldn't free new handle array (%d)", eError));
-		}
+		OSCallRCU(&BASE_AND_INDEX_TO_INDEX_STRUCT_PTR(psBase, ui32Index)->psBlock->sRCUHead, FreeHandleBlock);
 	}
 
-	return eReturn;
+	return eError;
 }
 
 /*!
@@ -1043,8 +1270,8 @@ error:
  @Function	FreeHandleArray
 
  @Description	Frees the handle array.
-		The memory containing the array of handle structure
-		pointers is deallocated.
+		The memory containing the handle structures and the index
+		structures is deallocated.
 
  @Input		psBase - pointer to handle base structure
 
@@ -1053,7 +1280,45 @@ error:
 ******************************************************************************/
 static PVRSRV_ERROR FreeHandleArray(PVRSRV_HANDLE_BASE *psBase)
 {
-	return ReallocHandleArray(psBase, 0);
+	PVRSRV_ERROR eError;
+	IMG_UINT32 ui32Chunk;
+
+	eError = ReallocHandleArray(psBase, 0);
+	if (eError != PVRSRV_OK)
+	{
+		return eError;
+	}
+
+	for (ui32Chunk = 0; ui32Chunk < psBase->ui32IndexChunkCount; ui32Chunk++)
+	{
+		struct sHandleIndexChunk *psChunk = psBase->ppsIndexChunk[ui32Chunk];
+
+		eError = OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP,
+				sizeof(*psChunk),
+				psChunk,
+				psChunk->hBlockAlloc);
+		if (eError != PVRSRV_OK)
+		{
+			PVR_DPF((PVR_DBG_ERROR, "FreeHandleArray: Couldn't free handle index chunk (%d)", eError));
+		}
+	}
+	psBase->ui32IndexChunkCount = 0;
+
+	if (psBase->ppsIndexChunk != IMG_NULL)
+	{
+		eError = OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP,
+				psBase->ui32IndexChunkMax * sizeof(*psBase->ppsIndexChunk),
+				psBase->ppsIndexChunk,
+				psBase->hDirBlockAlloc);
+		if (eError != PVRSRV_OK)
+		{
+			PVR_DPF((PVR_DBG_ERROR, "FreeHandleArray: Couldn't free handle index directory (%d)", eError));
+		}
+		psBase->ppsIndexChunk = IMG_NULL;
+		psBase->ui32IndexChunkMax = 0;
+	}
+
+	return PVRSRV_OK;
 }
 
 /*!
@@ -1092,7 +1357,7 @@ static PVRSRV_ERROR FreeHandle(PVRSRV_HANDLE_BASE *psBase, struct sHandle *psHan
 
 
 		PVR_ASSERT(hHandle != IMG_NULL);
-		PVR_ASSERT(hHandle == INDEX_TO_HANDLE(ui32Index));
+		PVR_ASSERT(hHandle == HANDLE_PTR_TO_HANDLE(psBase, psHandle));
 		PVR_UNREFERENCED_PARAMETER(hHandle);
 	}
 
@@ -1109,9 +1374,17 @@ static PVRSRV_ERROR FreeHandle(PVRSRV_HANDLE_BASE *psBase, struct sHandle *psHan
 
 	/*
 	 * Clear the type here, so that a handle can no longer be looked
-	 * up if it is only partially freed.
+	 * up if it is only partially freed.  The generation is advanced
+	 * first, so that a lockless lookup that saw the old type also
+	 * sees the generation change (see LookupHandleData).  A handle
+	 * completing a partial free already has its new generation.
 	 */
-	psHandle->eType = PVRSRV_HANDLE_TYPE_NONE;
+	if (psHandle->eType != PVRSRV_HANDLE_TYPE_NONE)
+	{
+		psHandle->ui32Generation = (psHandle->ui32Generation + 1) & psBase->ui32GenerationMask;
+		OSWriteMemoryBarrier();
+		psHandle->eType = PVRSRV_HANDLE_TYPE_NONE;
+	}
 
 	if (BATCHED_HANDLE(psHandle) && !BATCHED_HANDLE_PARTIALLY_FREE(psHandle))
 	{
@@ -1127,28 +1400,23 @@ static PVRSRV_ERROR FreeHandle(PVRSRV_HANDLE_BASE *psBase, struct sHandle *psHan
 	/* No free list management if purging is enabled */
 	if (!psBase->bPurgingEnabled)
 	{
+		PVR_ASSERT(psHandle->ui32NextIndexPlusOne == 0);
+
+		/*
+		 * Put the handle on the front of the free handle list, so
+		 * that the next allocation reuses it while its handle
+		 * structure is still in the cache.
+		 */
 		if (psBase->ui32FreeHandCount == 0)
 		{
 			PVR_ASSERT(psBase->ui32FirstFreeIndex == 0);
-			PVR_ASSERT(psBase->ui32LastFreeIndexPlusOne == 0);
-
-			psBase->ui32FirstFreeIndex =  ui32Index;
 		}
 		else
 		{
-			/*
-			 * Put the handle pointer on the end of the free
-			 * handle pointer linked list.
-			 */
-			PVR_ASSERT(psBase->ui32LastFreeIndexPlusOne != 0);
-			PVR_ASSERT(INDEX_TO_HANDLE_STRUCT_PTR(psBase, psBase->ui32LastFreeIndexPlusOne - 1)->ui32NextIndexPlusOne == 0);
-			INDEX_TO_HANDLE_STRUCT_PTR(psBase, psBase->ui32LastFreeIndexPlusOne - 1)->ui32NextIndexPlusOne =  ui32Index + 1;
+			psHandle->ui32NextIndexPlusOne = psBase->ui32FirstFreeIndex + 1;
 		}
 
-		PVR_ASSERT(psHandle->ui32NextIndexPlusOne == 0);
-
-		/* Update the end of the free handle linked list */
-		psBase->ui32LastFreeIndexPlusOne = ui32Index + 1;
+		psBase->ui32FirstFreeIndex = ui32Index;
 	}
 
 	psBase->ui32FreeHandCount++;
@@ -1173,54 +1441,6 @@ static PVRSRV_ERROR FreeHandle(PVRSRV_HANDLE_BASE *psBase, struct sHandle *psHan
 	return PVRSRV_OK;
 }
 
-/*!
-******************************************************************************
-
- @Function	FreeAllHandles
-
- @Description	Free all handles for a given handle base
-
- @Input		psBase - pointer to handle base structure
-
- @Return	PVRSRV_OK or PVRSRV_ERROR
-
-******************************************************************************/
-static PVRSRV_ERROR FreeAllHandles(PVRSRV_HANDLE_BASE *psBase)
-{
-	IMG_UINT32 i;
-	PVRSRV_ERROR eError = PVRSRV_OK;
-
-	if (psBase->ui32FreeHandCount == psBase->ui32TotalHandCount)
-	{
-		return eError;
-	}
-
-	for (i = 0; i < psBase->ui32TotalHandCount; i++)
-	{
-		struct sHandle *psHandle;
-
-		psHandle = INDEX_TO_HANDLE_STRUCT_PTR(psBase, i);
-
-		if (psHandle->eType != PVRSRV_HANDLE_TYPE_NONE)
-		{
-			eError = FreeHandle(psBase, psHandle);
-			if (eError != PVRSRV_OK)
-			{
-				PVR_DPF((PVR_DBG_ERROR, "FreeAllHandles: FreeHandle failed (%d)", eError));
-				break;
-			}
-
-			/* Break out of loop if all the handles free */
-			if (psBase->ui32FreeHandCount == psBase->ui32TotalHandCount)
-			{
-				break;
-			}
-		}
-	}
-
-	return eError;
-}
-
 /*!
 ******************************************************************************
 
@@ -1243,12 +1463,18 @@ static PVRSRV_ERROR FreeHandleBase(PVRSRV_HANDLE_BASE *psBase)
 		PVRSRVReleaseHandleBatch(psBase);
 	}
 
-	/* Free the handle array */
-	eError = FreeAllHandles(psBase);
-	if (eError != PVRSRV_OK)
+	/*
+	 * The handles still allocated are not freed one at a time.  The
+	 * resources behind them have already been released through the
+	 * resource manager, and their parent/child and free lists are
+	 * held in the handle structures, which are freed a block at a
+	 * time along with the hash table and its entries.
+	 */
+	if (psBase->ui32FreeHandCount != psBase->ui32TotalHandCount)
 	{
-		PVR_DPF((PVR_DBG_ERROR, "FreeHandleBase: Couldn't free handles (%d)", eError));
-		return eError;
+		PVR_DPF((PVR_DBG_MESSAGE, "FreeHandleBase: Discarding %u handles", psBase->ui32TotalHandCount - psBase->ui32FreeHandCount));
+
+		psBase->ui32FreeHandCount = psBase->ui32TotalHandCount;
 	}
 
 	/* Free the handle array */
@@ -1261,8 +1487,8 @@ static PVRSRV_ERROR FreeHandleBase(PVRSRV_HANDLE_BASE *psBase)
 
 	if (psBase->psHashTab != IMG_NULL)
 	{
-		/* Free the hash table */
-		HASH_Delete(psBase->psHashTab);
+		/* Free the hash table, and the entries of the discarded handles */
+		HASH_Discard(psBase->psHashTab);
 	}
 
 	eError = OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP,
@@ -1490,7 +1716,7 @@ static PVRSRV_ERROR AllocHandle(PVRSRV_HANDLE_BASE *psBase, IMG_HANDLE *phHandle
 	PVR_ASSERT(psNewHandle != IMG_NULL);
 
 	/* Handle to be returned to client */
-	hHandle = INDEX_TO_HANDLE(ui32NewIndex);
+	hHandle = HANDLE_PTR_TO_HANDLE(psBase, psNewHandle);
 
 	/*
 	 * If a data pointer can be associated with multiple handles, we
@@ -1525,9 +1751,7 @@ static PVRSRV_ERROR AllocHandle(PVRSRV_HANDLE_BASE *psBase, IMG_HANDLE *phHandle
 		if (psBase->ui32FreeHandCount == 0)
 		{
 			PVR_ASSERT(psBase->ui32FirstFreeIndex == ui32NewIndex);
-			PVR_ASSERT(psBase->ui32LastFreeIndexPlusOne == (ui32NewIndex + 1));
 
-			psBase->ui32LastFreeIndexPlusOne = 0;
 			psBase->ui32FirstFreeIndex = 0;
 		}
 		else
@@ -1556,9 +1780,9 @@ static PVRSRV_ERROR AllocHandle(PVRSRV_HANDLE_BASE *psBase, IMG_HANDLE *phHandle
 	psNewHandle->eInternalFlag = INTERNAL_HANDLE_FLAG_NONE;
 	psNewHandle->eFlag = eFlag;
 
-	InitParentList(psNewHandle);
+	InitParentList(psBase, psNewHandle);
 #if defined(DEBUG)
-	PVR_ASSERT(NoChildren(psNewHandle));
+	PVR_ASSERT(NoChildren(psBase, psNewHandle));
 #endif
 
 	InitChildEntry(psNewHandle);
@@ -1645,6 +1869,7 @@ PVRSRV_ERROR PVRSRVAllocHandle(PVRSRV_HANDLE_BASE *psBase, IMG_HANDLE *phHandle,
 			if (TEST_FLAG(psHandle->eFlag & eFlag, PVRSRV_HANDLE_ALLOC_FLAG_SHARED))
 			{
 				*phHandle = hHandle;
+				PVR_BRIDGE_CAPTURE_HANDLE(psBase, hHandle, phHandle, FOUND);
 				eError = PVRSRV_OK;
 				goto exit_ok;
 			}
@@ -1654,6 +1879,10 @@ PVRSRV_ERROR PVRSRVAllocHandle(PVRSRV_HANDLE_BASE *psBase, IMG_HANDLE *phHandle,
 	}
 
 	eError = AllocHandle(psBase, phHandle, pvData, eType, eFlag, IMG_NULL);
+	if (eError == PVRSRV_OK)
+	{
+		PVR_BRIDGE_CAPTURE_HANDLE(psBase, *phHandle, phHandle, NEW);
+	}
 	
 exit_ok:
 	if (HANDLES_BATCHED(psBase) && (eError == PVRSRV_OK))
@@ -1712,6 +1941,7 @@ PVRSRV_ERROR PVRSRVAllocSubHandle(PVRSRV_HANDLE_BASE *psBase, IMG_HANDLE *phHand
 	{
 		return eError;
 	}
+	PVR_BRIDGE_CAPTURE_HANDLE(psBase, hParent, IMG_NULL, IN);
 
 	if (!TEST_FLAG(eFlag, PVRSRV_HANDLE_ALLOC_FLAG_MULTI))
 	{
@@ -1740,6 +1970,7 @@ PVRSRV_ERROR PVRSRVAllocSubHandle(PVRSRV_HANDLE_BASE *psBase, IMG_HANDLE *phHand
 			if (TEST_FLAG(psCHandle->eFlag & eFlag, PVRSRV_HANDLE_ALLOC_FLAG_SHARED) && ParentHandle(HANDLE_TO_HANDLE_STRUCT_PTR(psBase, hHandle)) == hParent)
 			{
 				*phHandle = hHandle;
+				PVR_BRIDGE_CAPTURE_HANDLE(psBase, hHandle, phHandle, FOUND);
 				goto exit_ok;
 			}
 			return PVRSRV_ERROR_HANDLE_NOT_SHAREABLE;
@@ -1764,6 +1995,7 @@ PVRSRV_ERROR PVRSRVAllocSubHandle(PVRSRV_HANDLE_BASE *psBase, IMG_HANDLE *phHand
 	AdoptChild(psBase, psPHand, psCHand);
 
 	*phHandle = hHandle;
+	PVR_BRIDGE_CAPTURE_HANDLE(psBase, hHandle, phHandle, NEW);
 
 exit_ok:
 	if (HANDLES_BATCHED(psBase))
@@ -1804,6 +2036,7 @@ PVRSRV_ERROR PVRSRVFindHandle(PVRSRV_HANDLE_BASE *psBase, IMG_HANDLE *phHandle,
 	}
 
 	*phHandle = hHandle;
+	PVR_BRIDGE_CAPTURE_HANDLE(psBase, hHandle, phHandle, FOUND);
 
 	return PVRSRV_OK;
 }
@@ -1827,19 +2060,16 @@ PVRSRV_ERROR PVRSRVFindHandle(PVRSRV_HANDLE_BASE *psBase, IMG_HANDLE *phHandle,
 ******************************************************************************/
 PVRSRV_ERROR PVRSRVLookupHandleAnyType(PVRSRV_HANDLE_BASE *psBase, IMG_PVOID *ppvData, PVRSRV_HANDLE_TYPE *peType, IMG_HANDLE hHandle)
 {
-	struct sHandle *psHandle;
 	PVRSRV_ERROR eError;
 
-	eError = GetHandleStructure(psBase, &psHandle, hHandle, PVRSRV_HANDLE_TYPE_NONE);
+	eError = LookupHandleData(psBase, hHandle, PVRSRV_HANDLE_TYPE_NONE, ppvData, peType);
 	if (eError != PVRSRV_OK)
 	{
 		PVR_DPF((PVR_DBG_ERROR, "PVRSRVLookupHandleAnyType: Error looking up handle (%d)", eError));
 		OSDumpStack();
 		return eError;
 	}
-
-	*ppvData = psHandle->pvData;
-	*peType = psHandle->eType;
+	PVR_BRIDGE_CAPTURE_HANDLE(psBase, hHandle, IMG_NULL, IN);
 
 	return PVRSRV_OK;
 }
@@ -1862,24 +2092,187 @@ PVRSRV_ERROR PVRSRVLookupHandleAnyType(PVRSRV_HANDLE_BASE *psBase, IMG_PVOID *pp
 ******************************************************************************/
 PVRSRV_ERROR PVRSRVLookupHandle(PVRSRV_HANDLE_BASE *psBase, IMG_PVOID *ppvData, IMG_HANDLE hHandle, PVRSRV_HANDLE_TYPE eType)
 {
-	struct sHandle *psHandle;
 	PVRSRV_ERROR eError;
 
 	PVR_ASSERT(eType != PVRSRV_HANDLE_TYPE_NONE);
 
-	eError = GetHandleStructure(psBase, &psHandle, hHandle, eType);
+	eError = LookupHandleData(psBase, hHandle, eType, ppvData, IMG_NULL);
 	if (eError != PVRSRV_OK)
 	{
 		PVR_DPF((PVR_DBG_ERROR, "PVRSRVLookupHandle: Error looking up handle (%d)", eError));
 		OSDumpStack();
 		return eError;
 	}
+	PVR_BRIDGE_CAPTURE_HANDLE(psBase, hHandle, IMG_NULL, IN);
 
-	*ppvData = psHandle->pvData;
+	return PVRSRV_OK;
+}
+
+/*!
+******************************************************************************
+
+ @Function	LookupHandleChunkRCU
+
+ @Description	Get the data pointers for a number of handles, as
+		LookupHandleData does for one, sharing the memory
+		barriers between them.  The caller, under the RCU read
+		lock it holds, has filled in the handle structures and
+		checked their generations against the handles.
+
+ @Input		psChunk - the handles to look up
+		ui32Count - number of handles
+
+ @Output	psChunk - the handles have been replaced by their data
+			pointers, if they all looked up.
+
+ @Return	Error code or PVRSRV_OK
+
+******************************************************************************/
+static PVRSRV_ERROR LookupHandleChunkRCU(struct sHandleLookup *psChunk, IMG_UINT32 ui32Count)
+{
+	IMG_UINT32 i;
+
+	OSReadMemoryBarrier();
+
+	for (i = 0; i < ui32Count; i++)
+	{
+		psChunk[i].eHandleType = psChunk[i].psHandle->eType;
+		psChunk[i].pvData = psChunk[i].psHandle->pvData;
+	}
+
+	OSReadMemoryBarrier();
+
+	for (i = 0; i < ui32Count; i++)
+	{
+		if (psChunk[i].psHandle->ui32Generation != psChunk[i].ui32Generation || psChunk[i].eHandleType == PVRSRV_HANDLE_TYPE_NONE)
+		{
+			PVR_DPF((PVR_DBG_ERROR, "LookupHandleChunkRCU: Handle not allocated (index: %u, generation: %u)", HANDLE_PTR_TO_INDEX(psChunk[i].psHandle), psChunk[i].ui32Generation));
+			return PVRSRV_ERROR_HANDLE_NOT_ALLOCATED;
+		}
+
+		if (psChunk[i].eHandleType != psChunk[i].eType)
+		{
+			PVR_DPF((PVR_DBG_ERROR, "LookupHandleChunkRCU: Handle type mismatch (%d != %d)", psChunk[i].eType, psChunk[i].eHandleType));
+			return PVRSRV_ERROR_HANDLE_TYPE_MISMATCH;
+		}
+	}
+
+	for (i = 0; i < ui32Count; i++)
+	{
+		*psChunk[i].phHandle = psChunk[i].pvData;
+	}
 
 	return PVRSRV_OK;
 }
 
+/*!
+******************************************************************************
+
+ @Function	PVRSRVLookupHandles
+
+ @Description	Look up a number of handles in one pass.  Each entry
+		gives ui32Count handles of type eType, ui32Stride bytes
+		apart from phHandle onwards, and each handle is replaced
+		by its data pointer.  The handles are checked
+		HANDLE_LOOKUP_CHUNK_SIZE at a time, with one set of
+		memory barriers for each chunk rather than each handle.
+
+ @Input		psBase - pointer to handle base structure
+		psLookup - the handles to look up
+		ui32NumLookups - number of entries at psLookup
+
+ @Output	psLookup - the handles have been replaced by their data
+			pointers.  On failure, some of them may have
+			been replaced.
+
+ @Return	Error code or PVRSRV_OK
+
+******************************************************************************/
+PVRSRV_ERROR PVRSRVLookupHandles(PVRSRV_HANDLE_BASE *psBase, PVRSRV_HANDLE_LOOKUP *psLookup, IMG_UINT32 ui32NumLookups)
+{
+	struct sHandleLookup asChunk[HANDLE_LOOKUP_CHUNK_SIZE];
+	IMG_UINT32 ui32ChunkCount = 0;
+	PVRSRV_ERROR eError = PVRSRV_OK;
+	IMG_UINT32 ui32TotalHandCount;
+	IMG_UINT32 i;
+	IMG_UINT32 j;
+
+	OSRCUReadLock();
+
+	/* Pairs with the OSWriteMemoryBarrier in ReallocHandleArray */
+	ui32TotalHandCount = *(volatile IMG_UINT32 *)&psBase->ui32TotalHandCount;
+	OSReadMemoryBarrier();
+
+	for (i = 0; i < ui32NumLookups; i++)
+	{
+		IMG_UINT8 *pui8Handle = (IMG_UINT8 *)psLookup[i].phHandle;
+
+		PVR_ASSERT(psLookup[i].eType != PVRSRV_HANDLE_TYPE_NONE);
+
+		for (j = 0; j < psLookup[i].ui32Count; j++)
+		{
+			IMG_HANDLE *phHandle = (IMG_HANDLE *)pui8Handle;
+			IMG_UINT32 ui32Index = HANDLE_TO_INDEX(psBase, *phHandle);
+			IMG_UINT32 ui32Generation;
+			struct sHandle *psHandle;
+
+			/* Check handle index is in range */
+			if (ui32Index >= ui32TotalHandCount)
+			{
+				PVR_DPF((PVR_DBG_ERROR, "PVRSRVLookupHandles: Handle index out of range (%u)", ui32Index));
+				eError = PVRSRV_ERROR_HANDLE_INDEX_OUT_OF_RANGE;
+				goto exit;
+			}
+
+			psHandle = INDEX_TO_HANDLE_STRUCT_PTR(psBase, ui32Index);
+			ui32Generation = HANDLE_TO_GENERATION(psBase, *phHandle);
+
+			/* First read of the generation, see LookupHandleData */
+			if (psHandle->ui32Generation != ui32Generation)
+			{
+				PVR_DPF((PVR_DBG_ERROR, "PVRSRVLookupHandles: Handle not allocated (index: %u, generation: %u)", ui32Index, ui32Generation));
+				eError = PVRSRV_ERROR_HANDLE_NOT_ALLOCATED;
+				goto exit;
+			}
+
+			PVR_BRIDGE_CAPTURE_HANDLE(psBase, *phHandle, phHandle, IN);
+
+			asChunk[ui32ChunkCount].phHandle = phHandle;
+			asChunk[ui32ChunkCount].psHandle = psHandle;
+			asChunk[ui32ChunkCount].ui32Generation = ui32Generation;
+			asChunk[ui32ChunkCount].eType = psLookup[i].eType;
+
+			if (++ui32ChunkCount == HANDLE_LOOKUP_CHUNK_SIZE)
+			{
+				eError = LookupHandleChunkRCU(asChunk, ui32ChunkCount);
+				if (eError != PVRSRV_OK)
+				{
+					goto exit;
+				}
+				ui32ChunkCount = 0;
+			}
+
+			pui8Handle += psLookup[i].ui32Stride;
+		}
+	}
+
+	if (ui32ChunkCount != 0)
+	{
+		eError = LookupHandleChunkRCU(asChunk, ui32ChunkCount);
+	}
+
+exit:
+	OSRCUReadUnlock();
+
+	if (eError != PVRSRV_OK)
+	{
+		PVR_DPF((PVR_DBG_ERROR, "PVRSRVLookupHandles: Error looking up handles (%d)", eError));
+		OSDumpStack();
+	}
+
+	return eError;
+}
+
 /*!
 ******************************************************************************
 
@@ -1924,6 +2317,9 @@ PVRSRV_ERROR PVRSRVLookupSubHandle(PVRSRV_HANDLE_BASE *psBase, IMG_PVOID *ppvDat
 		}
 	}
 
+	PVR_BRIDGE_CAPTURE_HANDLE(psBase, hHandle, IMG_NULL, IN);
+	PVR_BRIDGE_CAPTURE_HANDLE(psBase, hAncestor, IMG_NULL, IN);
+
 	*ppvData = psCHand->pvData;
 
 	return PVRSRV_OK;
@@ -1963,6 +2359,11 @@ PVRSRV_ERROR PVRSRVGetParentHandle(PVRSRV_HANDLE_BASE *psBase, IMG_PVOID *phPare
 	}
 
 	*phParent = ParentHandle(psHandle);
+	PVR_BRIDGE_CAPTURE_HANDLE(psBase, hHandle, IMG_NULL, IN);
+	if (*phParent != IMG_NULL)
+	{
+		PVR_BRIDGE_CAPTURE_HANDLE(psBase, *phParent, phParent, FOUND);
+	}
 
 	return PVRSRV_OK;
 }
@@ -2000,6 +2401,7 @@ PVRSRV_ERROR PVRSRVLookupAndReleaseHandle(PVRSRV_HANDLE_BASE *psBase, IMG_PVOID
 	}
 
 	*ppvData = psHandle->pvData;
+	PVR_BRIDGE_CAPTURE_HANDLE(psBase, hHandle, IMG_NULL, RELEASE);
 
 	eError = FreeHandle(psBase, psHandle);
 
@@ -2033,6 +2435,7 @@ PVRSRV_ERROR PVRSRVReleaseHandle(PVRSRV_HANDLE_BASE *psBase, IMG_HANDLE hHandle,
 		OSDumpStack();
 		return eError;
 	}
+	PVR_BRIDGE_CAPTURE_HANDLE(psBase, hHandle, IMG_NULL, RELEASE);
 
 	eError = FreeHandle(psBase, psHandle);
 
@@ -2230,6 +2633,54 @@ IMG_VOID PVRSRVReleaseHandleBatch(PVRSRV_HANDLE_BASE *psBase)
 	(IMG_VOID) PVRSRVHandleBatchCommitOrRelease(psBase, IMG_FALSE);
 }
 
+/*!
+******************************************************************************
+
+ @Function	SetHandleLimit
+
+ @Description	Split the handle bits for a given handle base between the
+		array index and the generation, such that no handle value
+		exceeds the given limit.
+
+ @Input 	psBase - pointer to handle base structure
+		ui32MaxHandle - Maximum handle number
+
+ @Return	IMG_TRUE if the limit was applied, IMG_FALSE if it would
+		leave no room for a block of handles.
+
+******************************************************************************/
+static IMG_BOOL SetHandleLimit(PVRSRV_HANDLE_BASE *psBase, IMG_UINT32 ui32MaxHandle)
+{
+	IMG_UINT32 ui32HandleBits = 0;
+	IMG_UINT32 ui32IndexBits;
+	IMG_UINT32 ui32MaxIndexPlusOne;
+
+	/* Handle values run from 1 to (1 << ui32HandleBits) */
+	while (ui32HandleBits < 30 && (2U << ui32HandleBits) <= ui32MaxHandle)
+	{
+		ui32HandleBits++;
+	}
+
+	ui32IndexBits = MIN(ui32HandleBits, HANDLE_MIN_INDEX_BITS);
+	if (ui32HandleBits > ui32IndexBits + HANDLE_GENERATION_BITS)
+	{
+		ui32IndexBits = ui32HandleBits - HANDLE_GENERATION_BITS;
+	}
+
+	ui32MaxIndexPlusOne = ROUND_DOWN_TO_MULTIPLE_OF_BLOCK_SIZE(1U << ui32IndexBits);
+	if (ui32MaxIndexPlusOne == 0)
+	{
+		return IMG_FALSE;
+	}
+
+	psBase->ui32MaxIndexPlusOne = ui32MaxIndexPlusOne;
+	psBase->ui32IndexBits = ui32IndexBits;
+	psBase->ui32IndexMask = (1U << ui32IndexBits) - 1;
+	psBase->ui32GenerationMask = (1U << (ui32HandleBits - ui32IndexBits)) - 1;
+
+	return IMG_TRUE;
+}
+
 /*!
 ******************************************************************************
 
@@ -2245,8 +2696,6 @@ IMG_VOID PVRSRVReleaseHandleBatch(PVRSRV_HANDLE_BASE *psBase)
 ******************************************************************************/
 PVRSRV_ERROR PVRSRVSetMaxHandle(PVRSRV_HANDLE_BASE *psBase, IMG_UINT32 ui32MaxHandle)
 {
-	IMG_UINT32 ui32MaxHandleRounded;
-
 	if (HANDLES_BATCHED(psBase))
 	{
 		PVR_DPF((PVR_DBG_ERROR, "PVRSRVSetMaxHandle: Limit cannot be set whilst in batch mode"));
@@ -2269,15 +2718,13 @@ PVRSRV_ERROR PVRSRVSetMaxHandle(PVRSRV_HANDLE_BASE *psBase, IMG_UINT32 ui32MaxHa
 		return PVRSRV_ERROR_INVALID_PARAMS;
 	}
 
-	ui32MaxHandleRounded = ROUND_DOWN_TO_MULTIPLE_OF_BLOCK_SIZE(ui32MaxHandle);
-
 	/*
 	 * Allow the maximum number of handles to be reduced, but never to
 	 * zero.
 	 */
-	if (ui32MaxHandleRounded != 0 && ui32MaxHandleRounded < psBase->ui32MaxIndexPlusOne)
+	if (ui32MaxHandle < PVRSRVGetMaxHandle(psBase))
 	{
-		psBase->ui32MaxIndexPlusOne = ui32MaxHandleRounded;
+		(IMG_VOID)SetHandleLimit(psBase, ui32MaxHandle);
 	}
 
 	PVR_ASSERT(psBase->ui32MaxIndexPlusOne != 0);
@@ -2304,7 +2751,7 @@ PVRSRV_ERROR PVRSRVSetMaxHandle(PVRSRV_HANDLE_BASE *psBase, IMG_UINT32 ui32MaxHa
 ******************************************************************************/
 IMG_UINT32 PVRSRVGetMaxHandle(PVRSRV_HANDLE_BASE *psBase)
 {
-	return psBase->ui32MaxIndexPlusOne;
+	return ((psBase->ui32GenerationMask << psBase->ui32IndexBits) | (psBase->ui32MaxIndexPlusOne - 1)) + 1;
 }
 
 /*!
@@ -2372,7 +2819,7 @@ PVRSRV_ERROR PVRSRVPurgeHandles(PVRSRV_HANDLE_BASE *psBase)
 
 	for (ui32BlockIndex = INDEX_TO_BLOCK_INDEX(psBase->ui32TotalHandCount); ui32BlockIndex != 0; ui32BlockIndex--)
 	{
-		if (psBase->psHandleArray[ui32BlockIndex - 1].ui32FreeHandBlockCount != HANDLE_BLOCK_SIZE)
+		if (INDEX_TO_FREE_HAND_BLOCK_COUNT(psBase, BLOCK_INDEX_TO_INDEX(ui32BlockIndex - 1)) != HANDLE_BLOCK_SIZE)
 		{
 			break;
 		}
@@ -2430,8 +2877,11 @@ PVRSRV_ERROR PVRSRVAllocHandleBase(PVRSRV_HANDLE_BASE **ppsBase)
 	}
 	OSMemSet(psBase, 0, sizeof(*psBase));
 
-	/* Create hash table */
-	psBase->psHashTab = HASH_Create_Extended(HANDLE_HASH_TAB_INIT_SIZE, sizeof(HAND_KEY), HASH_Func_Default, HASH_Key_Comp_Default);
+	/*
+	 * Create hash table. Keys are unique, and the table is looked up far
+	 * more often than it is changed, so store the entries inline.
+	 */
+	psBase->psHashTab = HASH_Create_Extended("handles", HANDLE_HASH_TAB_INIT_SIZE, sizeof(HAND_KEY), HASH_Func_Default, HASH_Key_Comp_Default, HASH_CREATE_OPEN_ADDRESSING);
 	if (psBase->psHashTab == IMG_NULL)
 	{
 		PVR_DPF((PVR_DBG_ERROR, "PVRSRVAllocHandleBase: Couldn't create data pointer hash table\n"));
@@ -2441,7 +2891,7 @@ PVRSRV_ERROR PVRSRVAllocHandleBase(PVRSRV_HANDLE_BASE **ppsBase)
 
 	psBase->hBaseBlockAlloc = hBlockAlloc;
 
-	psBase->ui32MaxIndexPlusOne = DEFAULT_MAX_INDEX_PLUS_ONE;
+	(IMG_VOID)SetHandleLimit(psBase, DEFAULT_MAX_HANDLE);
 
 	*ppsBase = psBase;
 
@@ -51,14 +51,31 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "servicesint.h"
 #include "hash.h"
 #include "osfunc.h"
+#include "lists.h"
 
 #define PRIVATE_MAX(a,b) ((a)>(b)?(a):(b))
 
+/* Tables using the default hash and key comparison functions have their
+   keys handled inline rather than through the function pointers */
+#define HASH_KEY_CUSTOM		0	/* caller supplied functions */
+#define HASH_KEY_WORD		1	/* a single IMG_UINTPTR_T, power of two sizes */
+#define HASH_KEY_WORDS		2	/* an array of IMG_UINTPTR_Ts */
+
+#define	KEY_HASH(pHash, key, uSize) \
+	(((pHash)->uKeyType == HASH_KEY_WORD) ? _HashWord(*(IMG_UINTPTR_T *)(key)) : \
+	 ((pHash)->uKeyType == HASH_KEY_WORDS) ? HASH_Func_Default((pHash)->uKeySize, (key), (uSize)) : \
+	 (pHash)->pfnHashFunc((pHash)->uKeySize, (key), (uSize)))
+
+#define	HASH_TO_INDEX(pHash, uHash, uSize) \
+	(((pHash)->uKeyType == HASH_KEY_WORD) ? ((uHash) & ((uSize) - 1)) : ((uHash) % (uSize)))
+
 #define	KEY_TO_INDEX(pHash, key, uSize) \
-	((pHash)->pfnHashFunc((pHash)->uKeySize, (key), (uSize)) % (uSize))
+	HASH_TO_INDEX(pHash, KEY_HASH(pHash, key, uSize), uSize)
 
 #define	KEY_COMPARE(pHash, pKey1, pKey2) \
-	((pHash)->pfnKeyComp((pHash)->uKeySize, (pKey1), (pKey2)))
+	(((pHash)->uKeyType == HASH_KEY_WORD) ? (*(IMG_UINTPTR_T *)(pKey1) == *(IMG_UINTPTR_T *)(pKey2)) : \
+	 ((pHash)->uKeyType == HASH_KEY_WORDS) ? _KeyCompareWords((pHash)->uKeySize, (pKey1), (pKey2)) : \
+	 (pHash)->pfnKeyComp((pHash)->uKeySize, (pKey1), (pKey2)))
 
 /* Each entry in a hash table is placed into a bucket */
 struct _BUCKET_
@@ -74,10 +91,114 @@ struct _BUCKET_
 };
 typedef struct _BUCKET_ BUCKET;
 
+/* Memory that lockless readers of a HASH_CREATE_RCU table may still be
+   looking at starts with this, so it can be freed after a grace period */
+typedef struct _HASH_RCU_FREE_
+{
+	OS_RCU_HEAD sRCUHead;
+
+	/* size of the whole allocation in bytes */
+	IMG_SIZE_T uAllocSize;
+} HASH_RCU_FREE;
+
+/* The bucket chains of a chained table */
+struct _BUCKET_TABLE_
+{
+	HASH_RCU_FREE sFree;
+
+	/* while a resize is in progress, the table being drained into this
+	   one. Hanging it off the new table lets a lockless reader pick up
+	   a consistent pair with one pointer. */
+	struct _BUCKET_TABLE_ *psPrevious;
+
+	/* number of chains, kept here so lockless readers index the array
+	   they actually loaded */
+	IMG_UINT32 uSize;
+
+	BUCKET *apsBucket[];		/* PRQA S 0642 */ /* override dynamic array declaration warning */
+};
+typedef struct _BUCKET_TABLE_ BUCKET_TABLE;
+
+/* store a chain link, publishing it to lockless readers of RCU tables */
+#define	CHAIN_SET_LINK(pHash, ppLink, pBucket) \
+	do \
+	{ \
+		if ((pHash)->ui32Flags & HASH_CREATE_RCU) \
+		{ \
+			OSRCUAssignPointer(*(ppLink), (pBucket)); \
+		} \
+		else \
+		{ \
+			*(ppLink) = (pBucket); \
+		} \
+	} while (0)
+
+/* Each entry in an open addressing hash table occupies one slot */
+struct _HASH_SLOT_
+{
+	/* one more than the distance from the slot the key hashes to,
+	   0 if the slot is empty */
+	IMG_UINT32 uDistance;
+
+	/* full hash of the key, which saves rehashing on resize and most
+	   key comparisons on lookup */
+	IMG_UINT32 uHash;
+
+	/* entry value */
+	IMG_UINTPTR_T v;
+
+	/* entry key */
+	IMG_UINTPTR_T k[];		/* PRQA S 0642 */ /* override dynamic array declaration warning */
+};
+typedef struct _HASH_SLOT_ HASH_SLOT;
+
+#define	OA_SLOT(pHash, pui8Slots, uIndex) \
+	((HASH_SLOT *)((pui8Slots) + (IMG_SIZE_T)(uIndex) * (pHash)->uSlotSize))
+
+/* smallest open addressing table, in slots */
+#define OA_MINIMUM_SIZE		8
+
+/* Old bucket chains (or open addressing slots) moved to the new table by
+   each insert, remove or lookup while a resize is in progress */
+#if !defined(HASH_MIGRATE_STEP)
+#define HASH_MIGRATE_STEP	32
+#endif
+
 struct _HASH_TABLE_
 {
+	/* lets RCU tables outlive HASH_Delete until readers are done */
+	HASH_RCU_FREE sFree;
+
+	/* HASH_CREATE_* flags the table was created with */
+	IMG_UINT32 ui32Flags;
+
 	/* the hash table array */
-	BUCKET **ppBucketTable;
+	BUCKET_TABLE *psBucketTable;
+
+	/* open addressing slot array, uSize slots of uSlotSize bytes */
+	IMG_UINT8 *pui8Slots;
+
+	/* size of an open addressing slot including the key, in bytes */
+	IMG_UINT32 uSlotSize;
+
+	/* one slot of working space for insertion */
+	IMG_UINT8 *pui8Scratch;
+
+	/* while a resize is in progress, the slot array being drained into
+	   pui8Slots; chained tables use psBucketTable->psPrevious */
+	IMG_UINT8 *pui8OldSlots;
+
+	/* size of the old table, 0 when no resize is in progress */
+	IMG_UINT32 uOldSize;
+
+	/* next old chain or slot to move to the new table */
+	IMG_UINT32 uMigrateIndex;
+
+	/* old slots still to be visited (open addressing only) */
+	IMG_UINT32 uMigrateLeft;
+
+	/* HASH_Iterate nesting depth; resizing is held off while non zero */
+	IMG_UINT32 uIterateDepth;
 
 	/* current size of the hash table */
 	IMG_UINT32 uSize;
@@ -91,13 +212,37 @@ struct _HASH_TABLE_
 	/* size of key in bytes */
 	IMG_UINT32 uKeySize;
 
+	/* HASH_KEY_* inline key handling */
+	IMG_UINT32 uKeyType;
+
 	/* hash function */
 	HASH_FUNC *pfnHashFunc;
 
 	/* key comparison function */
 	HASH_KEY_COMP *pfnKeyComp;
+
+	/* name given at creation, for the statistics */
+	const IMG_CHAR *pszName;
+
+	/* counters reported by HASH_IterateTables; the size and count
+	   fields are filled in when they are read */
+	HASH_TABLE_STATS sStats;
+
+	/* links on the list of live tables */
+	struct _HASH_TABLE_ *psNext;
+	struct _HASH_TABLE_ **ppsThis;
 };
 
+/* resize latency over all tables, see HASH_GetLatencyStats */
+static HASH_LATENCY_STATS gsHashLatency;
+
+/* every live table, for HASH_IterateTables */
+static HASH_TABLE *gpsHashTableList = IMG_NULL;
+static OS_DEFINE_MUTEX(gsHashTableListLock);
+
+static IMPLEMENT_LIST_INSERT(HASH_TABLE)
+static IMPLEMENT_LIST_REMOVE(HASH_TABLE)
+
 /*!
 ******************************************************************************
 	@Function   	HASH_Func_Default
@@ -173,6 +318,76 @@ HASH_Key_Comp_Default (IMG_SIZE_T uKeySize, IMG_VOID *pKey1, IMG_VOID *pKey2)
 	return IMG_TRUE;
 }
 
+/*!
+******************************************************************************
+	@Function   	_HashWord
+
+	@Description    Multiplicative hash of a single word key. The top half
+                    of the key is folded in first, and the result is the
+                    middle of the product, whose low bits depend on every
+                    bit of the key and can simply be masked.
+
+	@Input          k - the key
+
+	@Return         the hash value.
+******************************************************************************/
+static INLINE IMG_UINT32
+_HashWord (IMG_UINTPTR_T k)
+{
+	IMG_UINT64 ui64Key = (IMG_UINT64)k;
+
+	ui64Key ^= ui64Key >> 32;
+
+	return (IMG_UINT32)((ui64Key * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+/*!
+******************************************************************************
+	@Function   	_KeyCompareWords
+
+	@Description    Inline equivalent of HASH_Key_Comp_Default. The words
+                    are compared together, ORing their differences and
+                    testing once, so a mismatch costs no more than a match
+                    and there is no branch per word.
+
+	@Input          uKeySize - the size of the hash key, in bytes.
+	@Input          pKey1 - pointer to first hash key to compare.
+	@Input          pKey2 - pointer to second hash key to compare.
+	@Return         IMG_TRUE  - the keys match.
+                    IMG_FALSE - the keys don't match.
+******************************************************************************/
+static INLINE IMG_BOOL
+_KeyCompareWords (IMG_SIZE_T uKeySize, IMG_VOID *pKey1, IMG_VOID *pKey2)
+{
+	IMG_UINTPTR_T *p1 = (IMG_UINTPTR_T *)pKey1;
+	IMG_UINTPTR_T *p2 = (IMG_UINTPTR_T *)pKey2;
+	IMG_UINTPTR_T uDiff;
+	IMG_UINT32 ui;
+
+	switch (uKeySize / sizeof(IMG_UINTPTR_T))
+	{
+		case 2:
+			uDiff = (p1[0] ^ p2[0]) | (p1[1] ^ p2[1]);
+			break;
+		case 3:
+			uDiff = (p1[0] ^ p2[0]) | (p1[1] ^ p2[1]) | (p1[2] ^ p2[2]);
+			break;
+		case 4:
+			uDiff = (p1[0] ^ p2[0]) | (p1[1] ^ p2[1]) |
+					(p1[2] ^ p2[2]) | (p1[3] ^ p2[3]);
+			break;
+		default:
+			uDiff = 0;
+			for (ui = 0; ui < uKeySize / sizeof(IMG_UINTPTR_T); ui++)
+			{
+				uDiff |= p1[ui] ^ p2[ui];
+			}
+			break;
+	}
+
+	return (uDiff == 0) ? IMG_TRUE : IMG_FALSE;
+}
+
 /*!
 ******************************************************************************
 	@Function   	_ChainInsert
@@ -180,121 +395,930 @@ HASH_Key_Comp_Default (IMG_SIZE_T uKeySize, IMG_VOID *pKey1, IMG_VOID *pKey2)
 	@Description    Insert a bucket into the appropriate hash table chain.
 
 	@Input          pBucket - the bucket
-	@Input          ppBucketTable - the hash table
-	@Input          uSize - the size of the hash table
+	@Input          psBucketTable - the hash table
     
 	@Return         PVRSRV_ERROR
 ******************************************************************************/
-static PVRSRV_ERROR
-_ChainInsert (HASH_TABLE *pHash, BUCKET *pBucket, BUCKET **ppBucketTable, IMG_UINT32 uSize)
+static PVRSRV_ERROR
+_ChainInsert (HASH_TABLE *pHash, BUCKET *pBucket, BUCKET_TABLE *psBucketTable)
+{
+	IMG_UINT32 uIndex;
+
+	PVR_ASSERT (pBucket != IMG_NULL);
+	PVR_ASSERT (psBucketTable != IMG_NULL);
+
+	if ((pBucket == IMG_NULL) || (psBucketTable == IMG_NULL))
+	{
+		PVR_DPF((PVR_DBG_ERROR, "_ChainInsert: invalid parameter"));
+		return PVRSRV_ERROR_INVALID_PARAMS;
+	}
+
+	uIndex = KEY_TO_INDEX(pHash, pBucket->k, psBucketTable->uSize);	/* PRQA S 0432,0541 */ /* ignore dynamic array warning */
+	pBucket->pNext = psBucketTable->apsBucket[uIndex];
+	CHAIN_SET_LINK(pHash, &psBucketTable->apsBucket[uIndex], pBucket);
+
+	return PVRSRV_OK;
+}
+
+/*!
+******************************************************************************
+	@Function   	_RCUFree
+
+	@Description    Free memory retired from an RCU table once its grace
+                    period has ended.
+
+	@Input          psHead - the RCU head at the start of the memory
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_RCUFree (OS_RCU_HEAD *psHead)
+{
+	HASH_RCU_FREE *psFree = (HASH_RCU_FREE *)psHead;
+
+	OSFreeMem(PVRSRV_PAGEABLE_SELECT, psFree->uAllocSize, psFree, IMG_NULL);
+}
+
+/*!
+******************************************************************************
+	@Function   	_Retire
+
+	@Description    Free memory no longer reachable from a table, after a
+                    grace period if the table has lockless readers.
+
+	@Input          pHash - the hash table
+	@Input          psFree - the memory to free
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_Retire (HASH_TABLE *pHash, HASH_RCU_FREE *psFree)
+{
+	if (pHash->ui32Flags & HASH_CREATE_RCU)
+	{
+		OSCallRCU(&psFree->sRCUHead, _RCUFree);
+	}
+	else
+	{
+		OSFreeMem(PVRSRV_PAGEABLE_SELECT, psFree->uAllocSize, psFree, IMG_NULL);
+	}
+}
+
+/*!
+******************************************************************************
+	@Function   	_AllocBucketTable
+
+	@Description    Allocate an array of empty bucket chains.
+
+	@Input          uSize - the number of chains
+
+	@Return         the table, or IMG_NULL
+******************************************************************************/
+static BUCKET_TABLE *
+_AllocBucketTable (IMG_UINT32 uSize)
+{
+	BUCKET_TABLE *psBucketTable;
+	IMG_SIZE_T uAllocSize = sizeof(BUCKET_TABLE) + sizeof(BUCKET *) * uSize;
+	IMG_UINT32 uIndex;
+
+	if (OSAllocMem(PVRSRV_PAGEABLE_SELECT,
+				   uAllocSize,
+				   (IMG_PVOID *)&psBucketTable, IMG_NULL,
+				   "Hash Table Buckets") != PVRSRV_OK)
+	{
+		return IMG_NULL;
+	}
+
+	psBucketTable->sFree.uAllocSize = uAllocSize;
+	psBucketTable->psPrevious = IMG_NULL;
+	psBucketTable->uSize = uSize;
+	for (uIndex = 0; uIndex < uSize; uIndex++)
+	{
+		psBucketTable->apsBucket[uIndex] = IMG_NULL;
+	}
+
+	return psBucketTable;
+}
+
+/*!
+******************************************************************************
+	@Function   	_AllocBucket
+
+	@Description    Allocate a bucket with room for a key. Buckets of RCU
+                    tables are preceded by a HASH_RCU_FREE.
+
+	@Input          pHash - the hash table
+
+	@Return         the bucket, or IMG_NULL
+******************************************************************************/
+static BUCKET *
+_AllocBucket (HASH_TABLE *pHash)
+{
+	HASH_RCU_FREE *psFree;
+	IMG_SIZE_T uAllocSize = sizeof(BUCKET) + pHash->uKeySize;
+
+	if (!(pHash->ui32Flags & HASH_CREATE_RCU))
+	{
+		BUCKET *pBucket;
+
+		if (OSAllocMem(PVRSRV_PAGEABLE_SELECT,
+					   uAllocSize,
+					   (IMG_VOID **)&pBucket, IMG_NULL,
+					   "Hash Table entry") != PVRSRV_OK)
+		{
+			return IMG_NULL;
+		}
+		return pBucket;
+	}
+
+	uAllocSize += sizeof(HASH_RCU_FREE);
+	if (OSAllocMem(PVRSRV_PAGEABLE_SELECT,
+				   uAllocSize,
+				   (IMG_VOID **)&psFree, IMG_NULL,
+				   "Hash Table entry") != PVRSRV_OK)
+	{
+		return IMG_NULL;
+	}
+	psFree->uAllocSize = uAllocSize;
+
+	return (BUCKET *)(psFree + 1);
+}
+
+/*!
+******************************************************************************
+	@Function   	_FreeBucket
+
+	@Description    Free a bucket allocated by _AllocBucket that is no
+                    longer on any chain.
+
+	@Input          pHash - the hash table
+	@Input          pBucket - the bucket
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_FreeBucket (HASH_TABLE *pHash, BUCKET *pBucket)
+{
+	if (pHash->ui32Flags & HASH_CREATE_RCU)
+	{
+		_Retire (pHash, (HASH_RCU_FREE *)pBucket - 1);
+	}
+	else
+	{
+		OSFreeMem(PVRSRV_PAGEABLE_SELECT, sizeof(BUCKET) + pHash->uKeySize, pBucket, IMG_NULL);
+	}
+}
+
+/*!
+******************************************************************************
+	@Function   	_RecordLatency
+
+	@Description    Add the time since ui64Startns to the resize latency
+                    histogram and to the resize time of the table.
+
+	@Input          pHash - the hash table
+	@Input          ui64Startns - OSClockns64 when the work started
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_RecordLatency (HASH_TABLE *pHash, IMG_UINT64 ui64Startns)
+{
+	IMG_UINT64 ui64Elapsedns = OSClockns64() - ui64Startns;
+	IMG_UINT64 ui64Units = ui64Elapsedns >> 10;
+	IMG_UINT32 uBucket = 0;
+
+	pHash->sStats.ui64Resizens += ui64Elapsedns;
+
+	while (ui64Units != 0 && uBucket < HASH_LATENCY_BUCKETS - 1)
+	{
+		ui64Units >>= 1;
+		uBucket++;
+	}
+
+	gsHashLatency.aui32Histogram[uBucket]++;
+	if (ui64Elapsedns > gsHashLatency.ui64Worstns)
+	{
+		gsHashLatency.ui64Worstns = ui64Elapsedns;
+	}
+}
+
+/*!
+******************************************************************************
+	@Function   	_RecordLookup
+
+	@Description    Count a lookup in the table statistics.
+
+	@Input          pHash - the hash table
+	@Input          uProbes - the number of keys compared
+	@Input          bFound - whether the key was found
+
+	@Return         None
+******************************************************************************/
+static INLINE IMG_VOID
+_RecordLookup (HASH_TABLE *pHash, IMG_UINT32 uProbes, IMG_BOOL bFound)
+{
+	if (bFound)
+	{
+		pHash->sStats.ui64Hits++;
+	}
+	else
+	{
+		pHash->sStats.ui64Misses++;
+	}
+	pHash->sStats.ui64Probes += uProbes;
+	if (uProbes > pHash->sStats.ui32MaxProbes)
+	{
+		pHash->sStats.ui32MaxProbes = uProbes;
+	}
+}
+
+/*!
+******************************************************************************
+	@Function   	_ChainMigrateRCU
+
+	@Description    Move one old chain of an RCU table to the new table,
+                    last bucket first. Each bucket is linked onto the end
+                    of its new chain before it is unlinked from the end of
+                    the old one, so a lockless reader that searches the
+                    old table and then the new one always finds it.
+
+	@Input          pHash - the hash table
+	@Input          ppChain - head of the old chain
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_ChainMigrateRCU (HASH_TABLE *pHash, BUCKET **ppChain)
+{
+	BUCKET_TABLE *psBucketTable = pHash->psBucketTable;
+
+	while (*ppChain != IMG_NULL)
+	{
+		BUCKET **ppLast = ppChain;
+		BUCKET **ppTail;
+		IMG_UINT32 uIndex;
+
+		while ((*ppLast)->pNext != IMG_NULL)
+		{
+			ppLast = &((*ppLast)->pNext);
+		}
+
+		uIndex = KEY_TO_INDEX(pHash, (*ppLast)->k, psBucketTable->uSize);	/* PRQA S 0432,0541 */ /* ignore dynamic array warning */
+		for (ppTail = &psBucketTable->apsBucket[uIndex]; *ppTail != IMG_NULL; ppTail = &((*ppTail)->pNext))
+		{
+		}
+
+		OSRCUAssignPointer(*ppTail, *ppLast);
+		OSRCUAssignPointer(*ppLast, IMG_NULL);
+	}
+}
+
+/*!
+******************************************************************************
+	@Function   	_ChainMigrate
+
+	@Description    Move bucket chains from the old table of a resize in
+                    progress to the new one, and free the old table once
+                    it is empty. Buckets are appended to their new chain,
+                    which keeps each chain in newest first order.
+
+	@Input          pHash - the hash table
+	@Input          uChains - the number of old chains to move
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_ChainMigrate (HASH_TABLE *pHash, IMG_UINT32 uChains)
+{
+	BUCKET_TABLE *psBucketTable = pHash->psBucketTable;
+	BUCKET_TABLE *psPrevious = psBucketTable->psPrevious;
+
+	while (uChains-- > 0 && pHash->uMigrateIndex < pHash->uOldSize)
+	{
+		BUCKET **ppChain = &psPrevious->apsBucket[pHash->uMigrateIndex++];
+		BUCKET *pBucket;
+
+		if (pHash->ui32Flags & HASH_CREATE_RCU)
+		{
+			_ChainMigrateRCU (pHash, ppChain);
+			continue;
+		}
+
+		pBucket = *ppChain;
+		*ppChain = IMG_NULL;
+
+		while (pBucket != IMG_NULL)
+		{
+			BUCKET *pNextBucket = pBucket->pNext;
+			BUCKET **ppTail;
+			IMG_UINT32 uIndex;
+
+			uIndex = KEY_TO_INDEX(pHash, pBucket->k, psBucketTable->uSize);	/* PRQA S 0432,0541 */ /* ignore dynamic array warning */
+			for (ppTail = &psBucketTable->apsBucket[uIndex]; *ppTail != IMG_NULL; ppTail = &((*ppTail)->pNext))
+			{
+			}
+			pBucket->pNext = IMG_NULL;
+			*ppTail = pBucket;
+
+			pBucket = pNextBucket;
+		}
+	}
+
+	if (pHash->uMigrateIndex == pHash->uOldSize)
+	{
+		OSRCUAssignPointer(psBucketTable->psPrevious, IMG_NULL);
+		_Retire (pHash, &psPrevious->sFree);
+		pHash->uOldSize = 0;
+	}
+}
+
+/*!
+******************************************************************************
+	@Function   	_ChainFind
+
+	@Description    Find the link to the bucket holding a key, looking in
+                    the old table too if a resize is in progress.
+
+	@Input          pHash - the hash table
+	@Input          pKey - pointer to the key
+
+	@Return         the link to the bucket, or IMG_NULL if the key is
+                    missing
+******************************************************************************/
+static BUCKET **
+_ChainFind (HASH_TABLE *pHash, IMG_VOID *pKey)
+{
+	IMG_UINT32 uHash = KEY_HASH(pHash, pKey, pHash->uSize);
+	BUCKET_TABLE *psBucketTable = pHash->psBucketTable;
+	BUCKET **ppBucket;
+	IMG_UINT32 uProbes = 0;
+
+	for (ppBucket = &(psBucketTable->apsBucket[HASH_TO_INDEX(pHash, uHash, psBucketTable->uSize)]); *ppBucket != IMG_NULL; ppBucket = &((*ppBucket)->pNext))
+	{
+		uProbes++;
+		/* PRQA S 0432,0541 1 */ /* ignore warning about dynamic array k */
+		if (KEY_COMPARE(pHash, (*ppBucket)->k, pKey))
+		{
+			_RecordLookup (pHash, uProbes, IMG_TRUE);
+			return ppBucket;
+		}
+	}
+
+	psBucketTable = psBucketTable->psPrevious;
+	if (psBucketTable != IMG_NULL)
+	{
+		for (ppBucket = &(psBucketTable->apsBucket[HASH_TO_INDEX(pHash, uHash, psBucketTable->uSize)]); *ppBucket != IMG_NULL; ppBucket = &((*ppBucket)->pNext))
+		{
+			uProbes++;
+			/* PRQA S 0432,0541 1 */ /* ignore warning about dynamic array k */
+			if (KEY_COMPARE(pHash, (*ppBucket)->k, pKey))
+			{
+				_RecordLookup (pHash, uProbes, IMG_TRUE);
+				return ppBucket;
+			}
+		}
+	}
+
+	_RecordLookup (pHash, uProbes, IMG_FALSE);
+	return IMG_NULL;
+}
+
+/*!
+******************************************************************************
+	@Function   	_ChainSearchRCU
+
+	@Description    Look for a key on one chain without holding the
+                    writers' lock.
+
+	@Input          pHash - the hash table
+	@Input          psBucketTable - the table to search
+	@Input          pKey - pointer to the key
+	@Input          uHash - hash of the key
+	@Output         pv - the value, if the key was found
+
+	@Return         IMG_TRUE if the key was found
+******************************************************************************/
+static IMG_BOOL
+_ChainSearchRCU (HASH_TABLE *pHash, BUCKET_TABLE *psBucketTable,
+				 IMG_VOID *pKey, IMG_UINT32 uHash, IMG_UINTPTR_T *pv)
+{
+	BUCKET *pBucket;
+
+	for (pBucket = OSRCUDereference(psBucketTable->apsBucket[HASH_TO_INDEX(pHash, uHash, psBucketTable->uSize)]);
+		 pBucket != IMG_NULL;
+		 pBucket = OSRCUDereference(pBucket->pNext))
+	{
+		/* PRQA S 0432,0541 1 */ /* ignore warning about dynamic array k */
+		if (KEY_COMPARE(pHash, pBucket->k, pKey))
+		{
+			*pv = pBucket->v;
+			return IMG_TRUE;
+		}
+	}
+
+	return IMG_FALSE;
+}
+
+/*!
+******************************************************************************
+	@Function   	_ChainRetrieveRCU
+
+	@Description    Lockless lookup in an RCU table.
+
+	@Input          pHash - the hash table
+	@Input          pKey - pointer to the key
+
+	@Return         0 if the key is missing, or the value associated
+                    with the key.
+******************************************************************************/
+static IMG_UINTPTR_T
+_ChainRetrieveRCU (HASH_TABLE *pHash, IMG_VOID *pKey)
+{
+	BUCKET_TABLE *psBucketTable;
+	BUCKET_TABLE *psPrevious;
+	IMG_UINTPTR_T v = 0;
+	IMG_UINT32 uHash;
+
+	OSRCUReadLock();
+
+	for (;;)
+	{
+		psBucketTable = OSRCUDereference(pHash->psBucketTable);
+		psPrevious = OSRCUDereference(psBucketTable->psPrevious);
+		uHash = KEY_HASH(pHash, pKey, psBucketTable->uSize);
+
+		/* search the old table first, and only then the new one that
+		   migration links entries into before unlinking them */
+		if (psPrevious != IMG_NULL)
+		{
+			if (_ChainSearchRCU (pHash, psPrevious, pKey, uHash, &v))
+			{
+				break;
+			}
+			OSMemoryBarrier();
+		}
+
+		if (_ChainSearchRCU (pHash, psBucketTable, pKey, uHash, &v))
+		{
+			break;
+		}
+
+		/* a resize started meanwhile may have moved the key out of the
+		   tables searched, in which case go round again */
+		OSMemoryBarrier();
+		if (psBucketTable == OSRCUDereference(pHash->psBucketTable))
+		{
+			break;
+		}
+	}
+
+	OSRCUReadUnlock();
+
+	/* not counted in the table statistics: readers run concurrently, and
+	   the shared counters would both race and bounce between CPUs */
+
+	return v;
+}
+
+/*!
+******************************************************************************
+	@Function   	_Resize
+
+	@Description    Start resizing a hash table. The new table takes all
+                    inserts from now on, and the entries of the old one
+                    are moved across a few chains at a time by later
+                    operations rather than all at once. Failure to
+                    allocate the new table is not considered a hard
+                    failure. We simply continue and allow the table to
+                    fill up, the effect is to allow hash chains to become
+                    longer.
+
+	@Input          pHash - Hash table to resize.
+    @Input          uNewSize - Required table size.
+	@Return         IMG_TRUE Success
+	            	IMG_FALSE Failed
+******************************************************************************/
+static IMG_BOOL
+_Resize (HASH_TABLE *pHash, IMG_UINT32 uNewSize)
+{
+	BUCKET_TABLE *psNewTable;
+	IMG_UINT64 ui64Startns;
+
+	if (uNewSize == pHash->uSize || pHash->uIterateDepth != 0)
+	{
+		return IMG_FALSE;
+	}
+
+	PVR_DPF ((PVR_DBG_MESSAGE,
+              "HASH_Resize: oldsize=0x%x  newsize=0x%x  count=0x%x",
+			pHash->uSize, uNewSize, pHash->uCount));
+
+	ui64Startns = OSClockns64();
+
+	/* only two tables can be live, so finish off the last resize */
+	if (pHash->uOldSize != 0)
+	{
+		_ChainMigrate (pHash, pHash->uOldSize);
+	}
+
+	psNewTable = _AllocBucketTable (uNewSize);
+	if (psNewTable == IMG_NULL)
+	{
+		_RecordLatency (pHash, ui64Startns);
+		return IMG_FALSE;
+	}
+
+	psNewTable->psPrevious = pHash->psBucketTable;
+	pHash->uOldSize = pHash->uSize;
+	pHash->uMigrateIndex = 0;
+	OSRCUAssignPointer(pHash->psBucketTable, psNewTable);
+	pHash->uSize = uNewSize;
+
+	_ChainMigrate (pHash, HASH_MIGRATE_STEP);
+
+	gsHashLatency.ui32Resizes++;
+	pHash->sStats.ui32Resizes++;
+	_RecordLatency (pHash, ui64Startns);
+
+	return IMG_TRUE;
+}
+
+/*!
+******************************************************************************
+	@Function   	_OAInsertSlot
+
+	@Description    Robin Hood insertion of an entry into an open addressing
+                    slot array. The entry goes in front of the first entry
+                    nearer to its home slot than the new one would be, and
+                    the rest of that run moves up a slot. Entries stay
+                    ordered by home slot, which keeps probes short and lets
+                    lookups stop early.
+
+	@Input          pHash - the hash table
+	@Input          pui8Slots - the slot array
+	@Input          uSize - the number of slots, a power of two
+	@Input          psEntry - the entry to insert, uHash, v and k set
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_OAInsertSlot (HASH_TABLE *pHash, IMG_UINT8 *pui8Slots, IMG_UINT32 uSize, HASH_SLOT *psEntry)
+{
+	IMG_UINT32 uMask = uSize - 1;
+	IMG_UINT32 uIndex = psEntry->uHash & uMask;
+	IMG_UINT32 uDistance = 1;
+	HASH_SLOT *psSlot;
+
+	for (;;)
+	{
+		psSlot = OA_SLOT(pHash, pui8Slots, uIndex);
+
+		/* empty slots have a distance of 0 so stop here too */
+		if (psSlot->uDistance < uDistance)
+		{
+			break;
+		}
+
+		uIndex = (uIndex + 1) & uMask;
+		uDistance++;
+	}
+
+	if (psSlot->uDistance != 0)
+	{
+		IMG_UINT32 uEnd = uIndex;
+
+		do
+		{
+			uEnd = (uEnd + 1) & uMask;
+		} while (OA_SLOT(pHash, pui8Slots, uEnd)->uDistance != 0);
+
+		while (uEnd != uIndex)
+		{
+			IMG_UINT32 uPrev = (uEnd - 1) & uMask;
+			HASH_SLOT *psEnd = OA_SLOT(pHash, pui8Slots, uEnd);
+
+			OSMemCopy(psEnd, OA_SLOT(pHash, pui8Slots, uPrev), pHash->uSlotSize);
+			psEnd->uDistance++;
+			uEnd = uPrev;
+		}
+	}
+
+	OSMemCopy(psSlot, psEntry, pHash->uSlotSize);
+	psSlot->uDistance = uDistance;
+}
+
+/*!
+******************************************************************************
+	@Function   	_OAFind
+
+	@Description    Find the slot holding a key in an open addressing slot
+                    array. The probe stops at the first slot whose entry
+                    is closer to its home than the key would be.
+
+	@Input          pHash - the hash table
+	@Input          pui8Slots - the slot array
+	@Input          uSize - the number of slots, a power of two
+	@Input          pKey - pointer to the key
+	@Input          uHash - hash of the key
+	@Output         puIndex - index of the slot found
+	@Modified       puProbes - incremented for each slot examined
+
+	@Return         the slot, or IMG_NULL if the key is missing
+******************************************************************************/
+static HASH_SLOT *
+_OAFind (HASH_TABLE *pHash, IMG_UINT8 *pui8Slots, IMG_UINT32 uSize,
+		 IMG_VOID *pKey, IMG_UINT32 uHash, IMG_UINT32 *puIndex,
+		 IMG_UINT32 *puProbes)
+{
+	IMG_UINT32 uMask = uSize - 1;
+	IMG_UINT32 uIndex = uHash & uMask;
+	IMG_UINT32 uDistance;
+
+	for (uDistance = 1; ; uDistance++)
+	{
+		HASH_SLOT *psSlot = OA_SLOT(pHash, pui8Slots, uIndex);
+
+		/* empty slots have a distance of 0 so end the probe here too */
+		if (psSlot->uDistance < uDistance)
+		{
+			return IMG_NULL;
+		}
+
+		(*puProbes)++;
+		/* PRQA S 0432,0541 1 */ /* ignore warning about dynamic array k */
+		if (psSlot->uHash == uHash && KEY_COMPARE(pHash, psSlot->k, pKey))
+		{
+			*puIndex = uIndex;
+			return psSlot;
+		}
+
+		uIndex = (uIndex + 1) & uMask;
+	}
+}
+
+/*!
+******************************************************************************
+	@Function   	_OALookup
+
+	@Description    Find a key in an open addressing table, looking in the
+                    old slot array too if a resize is in progress.
+
+	@Input          pHash - the hash table
+	@Input          pKey - pointer to the key
+	@Output         ppui8Slots - the slot array holding the key
+	@Output         puSize - the size of that slot array
+	@Output         puIndex - index of the slot found
+
+	@Return         the slot, or IMG_NULL if the key is missing
+******************************************************************************/
+static HASH_SLOT *
+_OALookup (HASH_TABLE *pHash, IMG_VOID *pKey, IMG_UINT8 **ppui8Slots,
+		   IMG_UINT32 *puSize, IMG_UINT32 *puIndex)
+{
+	IMG_UINT32 uHash = KEY_HASH(pHash, pKey, pHash->uSize);
+	IMG_UINT32 uProbes = 0;
+	HASH_SLOT *psSlot;
+
+	psSlot = _OAFind (pHash, pHash->pui8Slots, pHash->uSize, pKey, uHash, puIndex, &uProbes);
+	if (psSlot != IMG_NULL)
+	{
+		*ppui8Slots = pHash->pui8Slots;
+		*puSize = pHash->uSize;
+		_RecordLookup (pHash, uProbes, IMG_TRUE);
+		return psSlot;
+	}
+
+	if (pHash->uOldSize != 0)
+	{
+		psSlot = _OAFind (pHash, pHash->pui8OldSlots, pHash->uOldSize, pKey, uHash, puIndex, &uProbes);
+		*ppui8Slots = pHash->pui8OldSlots;
+		*puSize = pHash->uOldSize;
+	}
+	_RecordLookup (pHash, uProbes, (psSlot != IMG_NULL) ? IMG_TRUE : IMG_FALSE);
+	return psSlot;
+}
+
+/*!
+******************************************************************************
+	@Function   	_OAMigrate
+
+	@Description    Move entries from the old slot array of a resize in
+                    progress to the new one, and free the old array once
+                    every slot has been visited. The walk started at an
+                    empty slot and only pauses at one, so a run of
+                    entries is never left half moved and probes of the
+                    old array still end correctly.
+
+	@Input          pHash - the hash table
+	@Input          uSlots - the number of old slots to visit at least
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_OAMigrate (HASH_TABLE *pHash, IMG_UINT32 uSlots)
+{
+	IMG_UINT32 uMask = pHash->uOldSize - 1;
+
+	while (pHash->uMigrateLeft != 0)
+	{
+		HASH_SLOT *psSlot = OA_SLOT(pHash, pHash->pui8OldSlots, pHash->uMigrateIndex);
+
+		if (psSlot->uDistance == 0)
+		{
+			if (uSlots == 0)
+			{
+				break;
+			}
+		}
+		else
+		{
+			_OAInsertSlot (pHash, pHash->pui8Slots, pHash->uSize, psSlot);
+			psSlot->uDistance = 0;
+		}
+
+		pHash->uMigrateIndex = (pHash->uMigrateIndex + 1) & uMask;
+		pHash->uMigrateLeft--;
+		if (uSlots != 0)
+		{
+			uSlots--;
+		}
+	}
+
+	if (pHash->uMigrateLeft == 0)
+	{
+		OSFreeMem(PVRSRV_PAGEABLE_SELECT, (IMG_SIZE_T)pHash->uSlotSize * pHash->uOldSize,
+				  pHash->pui8OldSlots, IMG_NULL);
+		pHash->pui8OldSlots = IMG_NULL;
+		pHash->uOldSize = 0;
+	}
+}
+
+/*!
+******************************************************************************
+	@Function   	_OAResize
+
+	@Description    Start resizing an open addressing table. As with
+                    _Resize the entries move across incrementally, and
+                    failure leaves the table valid at its old size.
+
+	@Input          pHash - Hash table to resize.
+	@Input          uNewSize - Required table size, a power of two.
+	@Return         IMG_TRUE Success
+	            	IMG_FALSE Failed
+******************************************************************************/
+static IMG_BOOL
+_OAResize (HASH_TABLE *pHash, IMG_UINT32 uNewSize)
+{
+	IMG_UINT8 *pui8NewSlots;
+	IMG_UINT32 uIndex;
+	IMG_UINT64 ui64Startns;
+
+	if (uNewSize == pHash->uSize || pHash->uIterateDepth != 0)
+	{
+		return IMG_FALSE;
+	}
+
+	PVR_DPF ((PVR_DBG_MESSAGE,
+			  "HASH_Resize: oldsize=0x%x  newsize=0x%x  count=0x%x",
+			  pHash->uSize, uNewSize, pHash->uCount));
+
+	ui64Startns = OSClockns64();
+
+	if (pHash->uOldSize != 0)
+	{
+		_OAMigrate (pHash, pHash->uMigrateLeft);
+	}
+
+	if (OSAllocMem(PVRSRV_PAGEABLE_SELECT,
+				   (IMG_SIZE_T)pHash->uSlotSize * uNewSize,
+				   (IMG_PVOID *)&pui8NewSlots, IMG_NULL,
+				   "Hash Table Slots") != PVRSRV_OK)
+	{
+		_RecordLatency (pHash, ui64Startns);
+		return IMG_FALSE;
+	}
+	OSMemSet(pui8NewSlots, 0, (IMG_SIZE_T)pHash->uSlotSize * uNewSize);
+
+	/* the table is never full, so there is an empty slot to start at */
+	for (uIndex = 0; OA_SLOT(pHash, pHash->pui8Slots, uIndex)->uDistance != 0; uIndex++)
+	{
+	}
+
+	pHash->pui8OldSlots = pHash->pui8Slots;
+	pHash->uOldSize = pHash->uSize;
+	pHash->uMigrateIndex = uIndex;
+	pHash->uMigrateLeft = pHash->uSize;
+	pHash->pui8Slots = pui8NewSlots;
+	pHash->uSize = uNewSize;
+
+	_OAMigrate (pHash, HASH_MIGRATE_STEP);
+
+	gsHashLatency.ui32Resizes++;
+	pHash->sStats.ui32Resizes++;
+	_RecordLatency (pHash, ui64Startns);
+
+	return IMG_TRUE;
+}
+
+/*!
+******************************************************************************
+	@Function   	_MigrateStep
+
+	@Description    Do a bounded amount of the work of a resize in
+                    progress, if any.
+
+	@Input          pHash - the hash table
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_MigrateStep (HASH_TABLE *pHash)
 {
-	IMG_UINT32 uIndex;
-
-	PVR_ASSERT (pBucket != IMG_NULL);
-	PVR_ASSERT (ppBucketTable != IMG_NULL);
-	PVR_ASSERT (uSize != 0);
+	IMG_UINT64 ui64Startns;
 
-	if ((pBucket == IMG_NULL) || (ppBucketTable == IMG_NULL) || (uSize == 0))
+	if (pHash->uOldSize == 0 || pHash->uIterateDepth != 0)
 	{
-		PVR_DPF((PVR_DBG_ERROR, "_ChainInsert: invalid parameter"));
-		return PVRSRV_ERROR_INVALID_PARAMS;
+		return;
 	}
 
-	uIndex = KEY_TO_INDEX(pHash, pBucket->k, uSize);	/* PRQA S 0432,0541 */ /* ignore dynamic array warning */
-	pBucket->pNext = ppBucketTable[uIndex];
-	ppBucketTable[uIndex] = pBucket;
+	ui64Startns = OSClockns64();
 
-	return PVRSRV_OK;
+	if (pHash->ui32Flags & HASH_CREATE_OPEN_ADDRESSING)
+	{
+		_OAMigrate (pHash, HASH_MIGRATE_STEP);
+	}
+	else
+	{
+		_ChainMigrate (pHash, HASH_MIGRATE_STEP);
+	}
+
+	_RecordLatency (pHash, ui64Startns);
 }
 
 /*!
 ******************************************************************************
-	@Function   	_Rehash
+	@Function   	_AddToTableList
 
-	@Description   	Iterate over every entry in an old hash table and
-                    rehash into the new table.
+	@Description    Make a new table visible to HASH_IterateTables.
+
+	@Input          pHash - the hash table
 
-	@Input          ppOldTable - the old hash table
-	@Input          uOldSize - the size of the old hash table
-	@Input          ppNewTable - the new hash table
-	@Input          uNewSize - the size of the new hash table
-    
 	@Return         None
 ******************************************************************************/
-static PVRSRV_ERROR
-_Rehash (HASH_TABLE *pHash,
-	 BUCKET **ppOldTable, IMG_UINT32 uOldSize,
-         BUCKET **ppNewTable, IMG_UINT32 uNewSize)
+static IMG_VOID
+_AddToTableList (HASH_TABLE *pHash)
 {
-	IMG_UINT32 uIndex;
-	for (uIndex=0; uIndex< uOldSize; uIndex++)
-    {
-		BUCKET *pBucket;
-		pBucket = ppOldTable[uIndex];
-		while (pBucket != IMG_NULL)
-		{
-			PVRSRV_ERROR eError;
-			BUCKET *pNextBucket = pBucket->pNext;
-			eError = _ChainInsert (pHash, pBucket, ppNewTable, uNewSize);
-			if (eError != PVRSRV_OK)
-			{
-				PVR_DPF((PVR_DBG_ERROR, "_Rehash: call to _ChainInsert failed"));
-				return eError;
-			}
-			pBucket = pNextBucket;
-		}
-    }
-	return PVRSRV_OK;
+	OSMutexLock(&gsHashTableListLock);
+	List_HASH_TABLE_Insert(&gpsHashTableList, pHash);
+	OSMutexUnlock(&gsHashTableListLock);
 }
 
 /*!
 ******************************************************************************
-	@Function   	_Resize
+	@Function   	_OACreate
 
-	@Description    Attempt to resize a hash table, failure to allocate a
-                    new larger hash table is not considered a hard failure.
-                    We simply continue and allow the table to fill up, the
-	            	effect is to allow hash chains to become longer.
+	@Description    Allocate the slot array of a new open addressing table.
+
+	@Input          pHash - the hash table, with uSize and uKeySize set.
 
-	@Input          pHash - Hash table to resize.
-    @Input          uNewSize - Required table size.
 	@Return         IMG_TRUE Success
 	            	IMG_FALSE Failed
 ******************************************************************************/
 static IMG_BOOL
-_Resize (HASH_TABLE *pHash, IMG_UINT32 uNewSize)
+_OACreate (HASH_TABLE *pHash)
 {
-	if (uNewSize != pHash->uSize)
-    {
-		BUCKET **ppNewTable;
-        IMG_UINT32 uIndex;
-
-		PVR_DPF ((PVR_DBG_MESSAGE,
-                  "HASH_Resize: oldsize=0x%x  newsize=0x%x  count=0x%x",
-				pHash->uSize, uNewSize, pHash->uCount));
-
-		OSAllocMem(PVRSRV_PAGEABLE_SELECT,
-                      sizeof (BUCKET *) * uNewSize,
-                      (IMG_PVOID*)&ppNewTable, IMG_NULL,
-					  "Hash Table Buckets");
-		if (ppNewTable == IMG_NULL)
-            return IMG_FALSE;
+	IMG_UINT32 uSize = OA_MINIMUM_SIZE;
 
-        for (uIndex=0; uIndex<uNewSize; uIndex++)
-            ppNewTable[uIndex] = IMG_NULL;
+	/* power of two sizes let the slot index be a mask of the hash */
+	while (uSize < pHash->uSize)
+	{
+		uSize <<= 1;
+	}
+	pHash->uSize = uSize;
+	pHash->uMinimumSize = uSize;
+	pHash->uSlotSize = (IMG_UINT32)(sizeof(HASH_SLOT) + pHash->uKeySize);
+
+	if (OSAllocMem(PVRSRV_PAGEABLE_SELECT,
+				   pHash->uSlotSize,
+				   (IMG_PVOID *)&pHash->pui8Scratch, IMG_NULL,
+				   "Hash Table Scratch") != PVRSRV_OK)
+	{
+		return IMG_FALSE;
+	}
 
-        if (_Rehash (pHash, pHash->ppBucketTable, pHash->uSize, ppNewTable, uNewSize) != PVRSRV_OK)
-		{
-			OSFreeMem (PVRSRV_PAGEABLE_SELECT, sizeof(BUCKET *) * uNewSize, ppNewTable, IMG_NULL);
-			return IMG_FALSE;
-		}
+	if (OSAllocMem(PVRSRV_PAGEABLE_SELECT,
+				   (IMG_SIZE_T)pHash->uSlotSize * uSize,
+				   (IMG_PVOID *)&pHash->pui8Slots, IMG_NULL,
+				   "Hash Table Slots") != PVRSRV_OK)
+	{
+		OSFreeMem(PVRSRV_PAGEABLE_SELECT, pHash->uSlotSize,
+				  pHash->pui8Scratch, IMG_NULL);
+		return IMG_FALSE;
+	}
+	OSMemSet(pHash->pui8Slots, 0, (IMG_SIZE_T)pHash->uSlotSize * uSize);
 
-        OSFreeMem (PVRSRV_PAGEABLE_SELECT, sizeof(BUCKET *)*pHash->uSize, pHash->ppBucketTable, IMG_NULL);
-        /*not nulling pointer, being reassigned just below*/
-        pHash->ppBucketTable = ppNewTable;
-        pHash->uSize = uNewSize;
-    }
-    return IMG_TRUE;
+	return IMG_TRUE;
 }
 
 
@@ -306,6 +1330,7 @@ _Resize (HASH_TABLE *pHash, IMG_UINT32 uNewSize)
                     key size, and the supplied hash and key comparsion
                     functions.
 
+	@Input          pszName - name of the table in the statistics.
 	@Input          uInitialLen - initial and minimum length of the
                     hash table, where the length refers to the number
                     of entries in the hash table, not its size in
@@ -313,14 +1338,15 @@ _Resize (HASH_TABLE *pHash, IMG_UINT32 uNewSize)
 	@Input          uKeySize - the size of the key, in bytes.
 	@Input          pfnHashFunc - pointer to hash function.
     @Input          pfnKeyComp - pointer to key comparsion function.
+	@Input          ui32Flags - HASH_CREATE_* flags selecting the table
+                    implementation.
 	@Return         IMG_NULL or hash table handle.
 ******************************************************************************/
-HASH_TABLE * HASH_Create_Extended (IMG_UINT32 uInitialLen, IMG_SIZE_T uKeySize, HASH_FUNC *pfnHashFunc, HASH_KEY_COMP *pfnKeyComp)
+HASH_TABLE * HASH_Create_Extended (const IMG_CHAR *pszName, IMG_UINT32 uInitialLen, IMG_SIZE_T uKeySize, HASH_FUNC *pfnHashFunc, HASH_KEY_COMP *pfnKeyComp, IMG_UINT32 ui32Flags)
 {
 	HASH_TABLE *pHash;
-	IMG_UINT32 uIndex;
 
-	PVR_DPF ((PVR_DBG_MESSAGE, "HASH_Create_Extended: InitialSize=0x%x", uInitialLen));
+	PVR_DPF ((PVR_DBG_MESSAGE, "HASH_Create_Extended: %s InitialSize=0x%x", pszName, uInitialLen));
 
 	if(OSAllocMem(PVRSRV_PAGEABLE_SELECT,
 					sizeof(HASH_TABLE),
@@ -336,21 +1362,65 @@ HASH_TABLE * HASH_Create_Extended (IMG_UINT32 uInitialLen, IMG_SIZE_T uKeySize,
 	pHash->uKeySize = (IMG_UINT32)uKeySize;
 	pHash->pfnHashFunc = pfnHashFunc;
 	pHash->pfnKeyComp = pfnKeyComp;
+	pHash->uKeyType = HASH_KEY_CUSTOM;
+	if (pfnHashFunc == &HASH_Func_Default && pfnKeyComp == &HASH_Key_Comp_Default)
+	{
+		pHash->uKeyType = (uKeySize == sizeof(IMG_UINTPTR_T)) ? HASH_KEY_WORD : HASH_KEY_WORDS;
+	}
+	pHash->ui32Flags = ui32Flags;
+	pHash->sFree.uAllocSize = sizeof(HASH_TABLE);
+	pHash->psBucketTable = IMG_NULL;
+	pHash->pui8Slots = IMG_NULL;
+	pHash->pui8Scratch = IMG_NULL;
+	pHash->pui8OldSlots = IMG_NULL;
+	pHash->uOldSize = 0;
+	pHash->uMigrateIndex = 0;
+	pHash->uMigrateLeft = 0;
+	pHash->uIterateDepth = 0;
+	pHash->pszName = pszName;
+	OSMemSet(&pHash->sStats, 0, sizeof(pHash->sStats));
+	pHash->sStats.ui32Flags = ui32Flags;
+
+	/* lockless readers are only supported on chains */
+	PVR_ASSERT ((ui32Flags & (HASH_CREATE_OPEN_ADDRESSING | HASH_CREATE_RCU)) !=
+				(HASH_CREATE_OPEN_ADDRESSING | HASH_CREATE_RCU));
+
+	if (ui32Flags & HASH_CREATE_OPEN_ADDRESSING)
+	{
+		if ((ui32Flags & HASH_CREATE_RCU) || !_OACreate (pHash))
+		{
+			OSFreeMem(PVRSRV_PAGEABLE_SELECT, sizeof(HASH_TABLE), pHash, IMG_NULL);
+			/*not nulling pointer, out of scope*/
+			return IMG_NULL;
+		}
+		_AddToTableList (pHash);
+		return pHash;
+	}
+
+	if (pHash->uKeyType == HASH_KEY_WORD)
+	{
+		/* word key tables mask rather than divide, so need power of two
+		   sizes; doubling and halving keeps them that way */
+		IMG_UINT32 uSize = 1;
+
+		while (uSize < pHash->uSize)
+		{
+			uSize <<= 1;
+		}
+		pHash->uSize = uSize;
+		pHash->uMinimumSize = uSize;
+	}
 
-	OSAllocMem(PVRSRV_PAGEABLE_SELECT,
-                  sizeof (BUCKET *) * pHash->uSize,
-                  (IMG_PVOID*)&pHash->ppBucketTable, IMG_NULL,
-				  "Hash Table Buckets");
+	pHash->psBucketTable = _AllocBucketTable (pHash->uSize);
 
-	if (pHash->ppBucketTable == IMG_NULL)
+	if (pHash->psBucketTable == IMG_NULL)
     {
 		OSFreeMem(PVRSRV_PAGEABLE_SELECT, sizeof(HASH_TABLE), pHash, IMG_NULL);
 		/*not nulling pointer, out of scope*/
 		return IMG_NULL;
     }
 
-	for (uIndex=0; uIndex<pHash->uSize; uIndex++)
-		pHash->ppBucketTable[uIndex] = IMG_NULL;
+	_AddToTableList (pHash);
 	return pHash;
 }
 
@@ -362,16 +1432,17 @@ HASH_TABLE * HASH_Create_Extended (IMG_UINT32 uInitialLen, IMG_SIZE_T uKeySize,
                     consisting of a single IMG_UINTPTR_T, and using
                     the default hash and key comparison functions.
 
+	@Input          pszName - name of the table in the statistics.
 	@Input          uInitialLen - initial and minimum length of the
                     hash table, where the length refers to the
                     number of entries in the hash table, not its size
                     in bytes.
 	@Return 	    IMG_NULL or hash table handle.
 ******************************************************************************/
-HASH_TABLE * HASH_Create (IMG_UINT32 uInitialLen)
+HASH_TABLE * HASH_Create (const IMG_CHAR *pszName, IMG_UINT32 uInitialLen)
 {
-	return HASH_Create_Extended(uInitialLen, sizeof(IMG_UINTPTR_T),
-		&HASH_Func_Default, &HASH_Key_Comp_Default);
+	return HASH_Create_Extended(pszName, uInitialLen, sizeof(IMG_UINTPTR_T),
+		&HASH_Func_Default, &HASH_Key_Comp_Default, HASH_CREATE_CHAINED);
 }
 
 /*!
@@ -399,13 +1470,89 @@ HASH_Delete (HASH_TABLE *pHash)
 			PVR_DPF ((PVR_DBG_ERROR, "HASH_Delete: leak detected in hash table!"));
 			PVR_DPF ((PVR_DBG_ERROR, "Likely Cause: client drivers not freeing allocations before destroying devmemcontext"));
 		}
-		OSFreeMem(PVRSRV_PAGEABLE_SELECT, sizeof(BUCKET *)*pHash->uSize, pHash->ppBucketTable, IMG_NULL);
-		pHash->ppBucketTable = IMG_NULL;
-		OSFreeMem(PVRSRV_PAGEABLE_SELECT, sizeof(HASH_TABLE), pHash, IMG_NULL);
+
+		OSMutexLock(&gsHashTableListLock);
+		List_HASH_TABLE_Remove(pHash);
+		OSMutexUnlock(&gsHashTableListLock);
+
+		if (pHash->ui32Flags & HASH_CREATE_OPEN_ADDRESSING)
+		{
+			if (pHash->uOldSize != 0)
+			{
+				OSFreeMem(PVRSRV_PAGEABLE_SELECT, (IMG_SIZE_T)pHash->uSlotSize * pHash->uOldSize, pHash->pui8OldSlots, IMG_NULL);
+				pHash->pui8OldSlots = IMG_NULL;
+			}
+			OSFreeMem(PVRSRV_PAGEABLE_SELECT, (IMG_SIZE_T)pHash->uSlotSize * pHash->uSize, pHash->pui8Slots, IMG_NULL);
+			pHash->pui8Slots = IMG_NULL;
+			OSFreeMem(PVRSRV_PAGEABLE_SELECT, pHash->uSlotSize, pHash->pui8Scratch, IMG_NULL);
+			pHash->pui8Scratch = IMG_NULL;
+		}
+		else
+		{
+			if (pHash->psBucketTable->psPrevious != IMG_NULL)
+			{
+				_Retire (pHash, &pHash->psBucketTable->psPrevious->sFree);
+			}
+			_Retire (pHash, &pHash->psBucketTable->sFree);
+		}
+		/* readers of an RCU table may still be inside it */
+		_Retire (pHash, &pHash->sFree);
 		/*not nulling pointer, copy on stack*/
     }
 }
 
+/*!
+******************************************************************************
+	@Function       HASH_Discard
+
+	@Description    Delete a hash table together with any entries still in
+                    it.  For tables whose owner is being torn down and has
+                    no further use for the entries, so they need not be
+                    removed one at a time.
+
+	@Input          pHash - hash table
+
+	@Return 	    None
+******************************************************************************/
+IMG_VOID
+HASH_Discard (HASH_TABLE *pHash)
+{
+	if (pHash == IMG_NULL)
+	{
+		return;
+	}
+
+	if (!(pHash->ui32Flags & HASH_CREATE_OPEN_ADDRESSING))
+	{
+		IMG_UINT32 uIndex;
+
+		/* finish any resize so every bucket is on one table */
+		if (pHash->uOldSize != 0)
+		{
+			_ChainMigrate (pHash, pHash->uOldSize);
+		}
+
+		for (uIndex=0; uIndex < pHash->psBucketTable->uSize; uIndex++)
+		{
+			BUCKET *pBucket = pHash->psBucketTable->apsBucket[uIndex];
+
+			while (pBucket != IMG_NULL)
+			{
+				BUCKET *pNextBucket = pBucket->pNext;
+
+				_FreeBucket (pHash, pBucket);
+				pBucket = pNextBucket;
+			}
+			pHash->psBucketTable->apsBucket[uIndex] = IMG_NULL;
+		}
+	}
+
+	/* open addressing entries live in the slot arrays */
+	pHash->uCount = 0;
+
+	HASH_Delete (pHash);
+}
+
 /*!
 ******************************************************************************
 	@Function   	HASH_Insert_Extended
@@ -437,10 +1584,37 @@ HASH_Insert_Extended (HASH_TABLE *pHash, IMG_VOID *pKey, IMG_UINTPTR_T v)
 		return IMG_FALSE;
 	}
 
-	if(OSAllocMem(PVRSRV_PAGEABLE_SELECT,
-					sizeof(BUCKET) + pHash->uKeySize,
-					(IMG_VOID **)&pBucket, IMG_NULL,
-					"Hash Table entry") != PVRSRV_OK)
+	if (pHash->ui32Flags & HASH_CREATE_OPEN_ADDRESSING)
+	{
+		HASH_SLOT *psEntry;
+
+		/* grow at three quarters full; if that fails carry on until a
+		   single empty slot is left to end probes */
+		if ((pHash->uCount + 1) << 2 > pHash->uSize * 3)
+		{
+			if (!_OAResize (pHash, pHash->uSize << 1) && pHash->uCount + 1 >= pHash->uSize)
+			{
+				return IMG_FALSE;
+			}
+		}
+		else
+		{
+			_MigrateStep (pHash);
+		}
+
+		psEntry = (HASH_SLOT *)pHash->pui8Scratch;
+		psEntry->uHash = KEY_HASH(pHash, pKey, pHash->uSize);
+		psEntry->v = v;
+		/* PRQA S 0432,0541 1 */ /* ignore warning about dynamic array k */
+		OSMemCopy(psEntry->k, pKey, pHash->uKeySize);
+		_OAInsertSlot (pHash, pHash->pui8Slots, pHash->uSize, psEntry);
+
+		pHash->uCount++;
+		return IMG_TRUE;
+	}
+
+	pBucket = _AllocBucket (pHash);
+	if (pBucket == IMG_NULL)
 	{
 		return IMG_FALSE;
 	}
@@ -448,11 +1622,9 @@ HASH_Insert_Extended (HASH_TABLE *pHash, IMG_VOID *pKey, IMG_UINTPTR_T v)
 	pBucket->v = v;
 	/* PRQA S 0432,0541 1 */ /* ignore warning about dynamic array k (linux)*/
 	OSMemCopy(pBucket->k, pKey, pHash->uKeySize);
-	if (_ChainInsert (pHash, pBucket, pHash->ppBucketTable, pHash->uSize) != PVRSRV_OK)
+	if (_ChainInsert (pHash, pBucket, pHash->psBucketTable) != PVRSRV_OK)
 	{
-		OSFreeMem(PVRSRV_PAGEABLE_SELECT,
-				  sizeof(BUCKET) + pHash->uKeySize,
-				  pBucket, IMG_NULL);
+		_FreeBucket (pHash, pBucket);
 		return IMG_FALSE;
 	}
 
@@ -466,6 +1638,10 @@ HASH_Insert_Extended (HASH_TABLE *pHash, IMG_VOID *pKey, IMG_UINTPTR_T v)
            functional */
         _Resize (pHash, pHash->uSize << 1);
     }
+	else
+	{
+		_MigrateStep (pHash);
+	}
 
 
 	return IMG_TRUE;
@@ -512,7 +1688,8 @@ IMG_UINTPTR_T
 HASH_Remove_Extended(HASH_TABLE *pHash, IMG_VOID *pKey)
 {
 	BUCKET **ppBucket;
-	IMG_UINT32 uIndex;
+	BUCKET *pBucket;
+	IMG_UINTPTR_T v;
 
 	PVR_DPF ((PVR_DBG_MESSAGE, "HASH_Remove_Extended: Hash=0x%p, pKey=0x%p",
 			pHash, pKey));
@@ -525,44 +1702,97 @@ HASH_Remove_Extended(HASH_TABLE *pHash, IMG_VOID *pKey)
 		return 0;
 	}
 
-	uIndex = KEY_TO_INDEX(pHash, pKey, pHash->uSize);
-
-	for (ppBucket = &(pHash->ppBucketTable[uIndex]); *ppBucket != IMG_NULL; ppBucket = &((*ppBucket)->pNext))
+	if (pHash->ui32Flags & HASH_CREATE_OPEN_ADDRESSING)
 	{
-		/* PRQA S 0432,0541 1 */ /* ignore warning about dynamic array k */
-		if (KEY_COMPARE(pHash, (*ppBucket)->k, pKey))
+		IMG_UINT8 *pui8Slots;
+		IMG_UINT32 uSize;
+		IMG_UINT32 uIndex;
+		IMG_UINT32 uMask;
+		HASH_SLOT *psSlot = _OALookup (pHash, pKey, &pui8Slots, &uSize, &uIndex);
+
+		if (psSlot == IMG_NULL)
 		{
-			BUCKET *pBucket = *ppBucket;
-			IMG_UINTPTR_T v = pBucket->v;
-			(*ppBucket) = pBucket->pNext;
+			_MigrateStep (pHash);
+			return 0;
+		}
+		v = psSlot->v;
+		uMask = uSize - 1;
 
-			OSFreeMem(PVRSRV_PAGEABLE_SELECT, sizeof(BUCKET) + pHash->uKeySize, pBucket, IMG_NULL);
-			/*not nulling original pointer, already overwritten*/
+		/* shift the rest of the probe sequence back a slot rather than
+		   leaving a tombstone */
+		for (;;)
+		{
+			HASH_SLOT *psNext;
 
-			pHash->uCount--;
+			uIndex = (uIndex + 1) & uMask;
+			psNext = OA_SLOT(pHash, pui8Slots, uIndex);
+			if (psNext->uDistance <= 1)
+			{
+				break;
+			}
+			OSMemCopy(psSlot, psNext, pHash->uSlotSize);
+			psSlot->uDistance--;
+			psSlot = psNext;
+		}
+		psSlot->uDistance = 0;
 
-			/* check if we need to think about re-balencing */
-			if (pHash->uSize > (pHash->uCount << 2) &&
-                pHash->uSize > pHash->uMinimumSize)
-            {
-                /* Ignore the return code from _Resize because the
-                   hash table is still in a valid state and although
-                   not ideally sized, it is still functional */
-				_Resize (pHash,
-                         PRIVATE_MAX (pHash->uSize >> 1,
-                                      pHash->uMinimumSize));
-            }
+		pHash->uCount--;
 
-			PVR_DPF ((PVR_DBG_MESSAGE,
-                      "HASH_Remove_Extended: Hash=0x%p, pKey=0x%p = 0x" UINTPTR_FMT,
-                      pHash, pKey, v));
-			return v;
+		if (pHash->uSize > (pHash->uCount << 3) &&
+			pHash->uSize > pHash->uMinimumSize)
+		{
+			/* as for chained tables, failure to shrink is harmless */
+			_OAResize (pHash, PRIVATE_MAX (pHash->uSize >> 1, pHash->uMinimumSize));
+		}
+		else
+		{
+			_MigrateStep (pHash);
 		}
+
+		return v;
 	}
-	PVR_DPF ((PVR_DBG_MESSAGE,
+
+	ppBucket = _ChainFind (pHash, pKey);
+	if (ppBucket == IMG_NULL)
+	{
+		_MigrateStep (pHash);
+		PVR_DPF ((PVR_DBG_MESSAGE,
               "HASH_Remove_Extended: Hash=0x%p, pKey=0x%p = 0x0 !!!!",
               pHash, pKey));
-	return 0;
+		return 0;
+	}
+
+	pBucket = *ppBucket;
+	v = pBucket->v;
+	CHAIN_SET_LINK(pHash, ppBucket, pBucket->pNext);
+
+	_FreeBucket (pHash, pBucket);
+	/*not nulling original pointer, already overwritten*/
+
+	pHash->uCount--;
+
+	/* check if we need to think about re-balencing; shrinking only at
+	   an eighth full leaves a margin below the grow threshold of a half,
+	   so a table hovering around one size does not flip back and forth */
+	if (pHash->uSize > (pHash->uCount << 3) &&
+        pHash->uSize > pHash->uMinimumSize)
+    {
+        /* Ignore the return code from _Resize because the
+           hash table is still in a valid state and although
+           not ideally sized, it is still functional */
+		_Resize (pHash,
+                 PRIVATE_MAX (pHash->uSize >> 1,
+                              pHash->uMinimumSize));
+    }
+	else
+	{
+		_MigrateStep (pHash);
+	}
+
+	PVR_DPF ((PVR_DBG_MESSAGE,
+              "HASH_Remove_Extended: Hash=0x%p, pKey=0x%p = 0x" UINTPTR_FMT,
+              pHash, pKey, v));
+	return v;
 }
 
 /*!
@@ -604,7 +1834,7 @@ IMG_UINTPTR_T
 HASH_Retrieve_Extended (HASH_TABLE *pHash, IMG_VOID *pKey)
 {
 	BUCKET **ppBucket;
-	IMG_UINT32 uIndex;
+	IMG_UINTPTR_T v = 0;
 
 	PVR_DPF ((PVR_DBG_MESSAGE, "HASH_Retrieve_Extended: Hash=0x%p, pKey=0x%p",
 			pHash, pKey));
@@ -617,26 +1847,38 @@ HASH_Retrieve_Extended (HASH_TABLE *pHash, IMG_VOID *pKey)
 		return 0;
 	}
 
-	uIndex = KEY_TO_INDEX(pHash, pKey, pHash->uSize);
-
-	for (ppBucket = &(pHash->ppBucketTable[uIndex]); *ppBucket != IMG_NULL; ppBucket = &((*ppBucket)->pNext))
+	if (pHash->ui32Flags & HASH_CREATE_OPEN_ADDRESSING)
 	{
-		/* PRQA S 0432,0541 1 */ /* ignore warning about dynamic array k */
-		if (KEY_COMPARE(pHash, (*ppBucket)->k, pKey))
-		{
-			BUCKET *pBucket = *ppBucket;
-			IMG_UINTPTR_T v = pBucket->v;
+		IMG_UINT8 *pui8Slots;
+		IMG_UINT32 uSize;
+		IMG_UINT32 uIndex;
+		HASH_SLOT *psSlot = _OALookup (pHash, pKey, &pui8Slots, &uSize, &uIndex);
 
-			PVR_DPF ((PVR_DBG_MESSAGE,
-                      "HASH_Retrieve: Hash=0x%p, pKey=0x%p = 0x" UINTPTR_FMT,
-                      pHash, pKey, v));
-			return v;
+		if (psSlot != IMG_NULL)
+		{
+			v = psSlot->v;
 		}
+		_MigrateStep (pHash);
+		return v;
+	}
+
+	/* readers of RCU tables leave resizing to the writers */
+	if (pHash->ui32Flags & HASH_CREATE_RCU)
+	{
+		return _ChainRetrieveRCU (pHash, pKey);
+	}
+
+	ppBucket = _ChainFind (pHash, pKey);
+	if (ppBucket != IMG_NULL)
+	{
+		v = (*ppBucket)->v;
 	}
+	_MigrateStep (pHash);
+
 	PVR_DPF ((PVR_DBG_MESSAGE,
-              "HASH_Retrieve: Hash=0x%p, pKey=0x%p = 0x0 !!!!",
-              pHash, pKey));
-	return 0;
+              "HASH_Retrieve: Hash=0x%p, pKey=0x%p = 0x" UINTPTR_FMT,
+              pHash, pKey, v));
+	return v;
 }
 
 /*!
@@ -673,26 +1915,140 @@ HASH_Retrieve (HASH_TABLE *pHash, IMG_UINTPTR_T k)
 PVRSRV_ERROR
 HASH_Iterate(HASH_TABLE *pHash, HASH_pfnCallback pfnCallback)
 {
+	PVRSRV_ERROR eError = PVRSRV_OK;
 	IMG_UINT32 uIndex;
-	for (uIndex=0; uIndex < pHash->uSize; uIndex++)
+
+	/* finish any resize so there is a single table to walk, then hold
+	   off resizing so callbacks can remove entries as they go */
+	if (pHash->uOldSize != 0)
 	{
-		BUCKET *pBucket;
-		pBucket = pHash->ppBucketTable[uIndex];
-		while (pBucket != IMG_NULL)
+		IMG_UINT64 ui64Startns = OSClockns64();
+
+		if (pHash->ui32Flags & HASH_CREATE_OPEN_ADDRESSING)
 		{
-			PVRSRV_ERROR eError;
-			BUCKET *pNextBucket = pBucket->pNext;
-			
-			eError = pfnCallback((IMG_UINTPTR_T) ((IMG_VOID *) *(pBucket->k)), (IMG_UINTPTR_T) pBucket->v);
+			_OAMigrate (pHash, pHash->uMigrateLeft);
+		}
+		else
+		{
+			_ChainMigrate (pHash, pHash->uOldSize);
+		}
+		_RecordLatency (pHash, ui64Startns);
+	}
+	pHash->uIterateDepth++;
 
-			/* The callback might want us to break out early */
-			if (eError != PVRSRV_OK)
-				return eError;
+	if (pHash->ui32Flags & HASH_CREATE_OPEN_ADDRESSING)
+	{
+		for (uIndex=0; uIndex < pHash->uSize && eError == PVRSRV_OK; uIndex++)
+		{
+			HASH_SLOT *psSlot = OA_SLOT(pHash, pHash->pui8Slots, uIndex);
 
-			pBucket = pNextBucket;
+			if (psSlot->uDistance != 0)
+			{
+				/* The callback might want us to break out early */
+				eError = pfnCallback(psSlot->k[0], psSlot->v);
+			}
 		}
 	}
-	return PVRSRV_OK;
+	else
+	{
+		for (uIndex=0; uIndex < pHash->uSize && eError == PVRSRV_OK; uIndex++)
+		{
+			BUCKET *pBucket;
+			pBucket = pHash->psBucketTable->apsBucket[uIndex];
+			while (pBucket != IMG_NULL)
+			{
+				BUCKET *pNextBucket = pBucket->pNext;
+
+				eError = pfnCallback((IMG_UINTPTR_T) ((IMG_VOID *) *(pBucket->k)), (IMG_UINTPTR_T) pBucket->v);
+
+				/* The callback might want us to break out early */
+				if (eError != PVRSRV_OK)
+					break;
+
+				pBucket = pNextBucket;
+			}
+		}
+	}
+
+	pHash->uIterateDepth--;
+	return eError;
+}
+
+/*!
+******************************************************************************
+	@Function   	HASH_GetLatencyStats
+
+	@Description    Read the resize latency histogram.
+
+	@Output         psStats - receives the histogram
+
+	@Return         None
+******************************************************************************/
+IMG_VOID
+HASH_GetLatencyStats (HASH_LATENCY_STATS *psStats)
+{
+	*psStats = gsHashLatency;
+}
+
+/*!
+******************************************************************************
+	@Function   	HASH_IterateTables
+
+	@Description    Call a function with the statistics of every live hash
+                    table.
+
+	@Input          pfnCallback - called once per table
+	@Input          pvData - passed to the callback
+
+	@Return         None
+******************************************************************************/
+IMG_VOID
+HASH_IterateTables (HASH_pfnTableCallback pfnCallback, IMG_VOID *pvData)
+{
+	HASH_TABLE *pHash;
+
+	OSMutexLock(&gsHashTableListLock);
+
+	for (pHash = gpsHashTableList; pHash != IMG_NULL; pHash = pHash->psNext)
+	{
+		HASH_TABLE_STATS sStats = pHash->sStats;
+
+		sStats.ui32Size = pHash->uSize;
+		sStats.ui32Count = pHash->uCount;
+
+		pfnCallback(pHash->pszName, &sStats, pvData);
+	}
+
+	OSMutexUnlock(&gsHashTableListLock);
+}
+
+/*!
+******************************************************************************
+	@Function   	HASH_ResetStats
+
+	@Description    Clear the resize latency histogram and the counters of
+                    every live hash table.
+
+	@Return         None
+******************************************************************************/
+IMG_VOID
+HASH_ResetStats (IMG_VOID)
+{
+	HASH_TABLE *pHash;
+
+	OSMutexLock(&gsHashTableListLock);
+
+	OSMemSet(&gsHashLatency, 0, sizeof(gsHashLatency));
+
+	for (pHash = gpsHashTableList; pHash != IMG_NULL; pHash = pHash->psNext)
+	{
+		IMG_UINT32 ui32Flags = pHash->sStats.ui32Flags;
+
+		OSMemSet(&pHash->sStats, 0, sizeof(pHash->sStats));
+		pHash->sStats.ui32Flags = ui32Flags;
+	}
+
+	OSMutexUnlock(&gsHashTableListLock);
 }
 
 #ifdef HASH_TRACE
@@ -715,15 +2071,35 @@ HASH_Dump (HASH_TABLE *pHash)
 	IMG_UINT32 uEmptyCount=0;
 
 	PVR_ASSERT (pHash != IMG_NULL);
+
+	if (pHash->ui32Flags & HASH_CREATE_OPEN_ADDRESSING)
+	{
+		for (uIndex=0; uIndex<pHash->uSize; uIndex++)
+		{
+			HASH_SLOT *psSlot = OA_SLOT(pHash, pHash->pui8Slots, uIndex);
+
+			if (psSlot->uDistance == 0)
+			{
+				uEmptyCount++;
+			}
+			uMaxLength = PRIVATE_MAX (uMaxLength, psSlot->uDistance);
+		}
+
+		PVR_TRACE(("open addressing hash table: uMinimumSize=%d  size=%d  count=%d  resizing from=%d",
+				pHash->uMinimumSize, pHash->uSize, pHash->uCount, pHash->uOldSize));
+		PVR_TRACE(("  empty=%d  max probe=%d", uEmptyCount, uMaxLength));
+		return;
+	}
+
 	for (uIndex=0; uIndex<pHash->uSize; uIndex++)
 	{
 		BUCKET *pBucket;
 		IMG_UINT32 uLength = 0;
-		if (pHash->ppBucketTable[uIndex] == IMG_NULL)
+		if (pHash->psBucketTable->apsBucket[uIndex] == IMG_NULL)
 		{
 			uEmptyCount++;
 		}
-		for (pBucket=pHash->ppBucketTable[uIndex];
+		for (pBucket=pHash->psBucketTable->apsBucket[uIndex];
 				pBucket != IMG_NULL;
 				pBucket = pBucket->pNext)
 		{
@@ -732,8 +2108,8 @@ HASH_Dump (HASH_TABLE *pHash)
 		uMaxLength = PRIVATE_MAX (uMaxLength, uLength);
 	}
 
-	PVR_TRACE(("hash table: uMinimumSize=%d  size=%d  count=%d",
-			pHash->uMinimumSize, pHash->uSize, pHash->uCount));
+	PVR_TRACE(("hash table: uMinimumSize=%d  size=%d  count=%d  resizing from=%d",
+			pHash->uMinimumSize, pHash->uSize, pHash->uCount, pHash->uOldSize));
 	PVR_TRACE(("  empty=%d  max=%d", uEmptyCount, uMaxLength));
 }
 #endif
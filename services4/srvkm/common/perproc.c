@@ -52,6 +52,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define	HASH_TAB_INIT_SIZE 32
 
 static HASH_TABLE *psHashTab = IMG_NULL;
+static IMG_UINT32 ui32NextGeneration = 1;
 
 /*!
 ******************************************************************************
@@ -217,6 +218,7 @@ PVRSRV_ERROR PVRSRVPerProcessDataConnect(IMG_UINT32	ui32PID, IMG_UINT32 ui32Flag
 
 		psPerProc->ui32PID = ui32PID;
 		psPerProc->ui32RefCount = 0;
+		psPerProc->ui32Generation = ui32NextGeneration++;
 
 #if defined(SUPPORT_PDUMP_MULTI_PROCESS)
 		if (ui32Flags == SRV_FLAGS_PDUMP_ACTIVE)
@@ -359,8 +361,11 @@ PVRSRV_ERROR PVRSRVPerProcessDataInit(IMG_VOID)
 {
 	PVR_ASSERT(psHashTab == IMG_NULL);
 
-	/* Create hash table */
-	psHashTab = HASH_Create(HASH_TAB_INIT_SIZE);
+	/* Create hash table. PIDs are unique, so it can take lockless
+	   lookups from PVRSRVPerProcessData */
+	psHashTab = HASH_Create_Extended("per-process data", HASH_TAB_INIT_SIZE, sizeof(IMG_UINTPTR_T),
+									 &HASH_Func_Default, &HASH_Key_Comp_Default,
+									 HASH_CREATE_RCU);
 	if (psHashTab == IMG_NULL)
 	{
 		PVR_DPF((PVR_DBG_ERROR, "PVRSRVPerProcessDataInit: Couldn't create per-process data hash table"));
@@ -17,15 +17,24 @@
   of resources which are either 'free', available for allocation, or
   'busy' currently allocated. Adjacent 'free' segments are always
   coallesced to avoid fragmentation.
+
+  Alongside the ordered list each arena keeps an address index, a
+  randomised balanced binary tree (treap) over the same boundary tags
+  whose in-order traversal matches the segment list. The index lets new
+  spans find their insertion point in O(log n) rather than by walking
+  the segment list.
  
   For allocation, all 'free' segments are kept on lists of 'free'
   segments in a table index by pvr_log2(segment size). ie Each table index
-  n holds 'free' segments in the size range 2**(n-1) -> 2**n.
+  n holds 'free' segments in the size range 2**(n-1) -> 2**n. Each power
+  of two is further divided into FREE_SUBCLASSES equal sub-ranges
+  (segregated fit), and a bitmap of non-empty table entries lets the
+  allocator skip straight to the first usable list.
  
   Allocation policy is based on an *almost* best fit
   stratedy. Choosing any segment from the appropriate table entry
-  guarantees that we choose a segment which is with a power of 2 of
-  the size we are allocating.
+  guarantees that we choose a segment which is within a fraction
+  1/FREE_SUBCLASSES of a power of 2 of the size we are allocating.
  
   Allocated segments are inserted into a self scaling hash table which
   maps the base resource of the span to the relevant boundary
@@ -35,12 +44,28 @@
   Each arena has an associated quantum size, all allocations from the
   arena are made in multiples of the basic quantum.
  
+  Arenas may be created with quantum caches for small allocations. A
+  quantum cache holds recently freed segments of one size class (a small
+  multiple of the quantum) in magazines, so that the next allocation of
+  that class is served without splitting, coalescing or rehashing. Cached
+  segments remain live in the arena until the cache is purged.
+ 
+  Boundary tags for all arenas are allocated from one object cache. Each
+  arena holds back a few free tags, topped up on entry to RA_Alloc, so an
+  allocation does not have to allocate tags part way through changing
+  the arena.
+ 
   On resource exhaustion in an arena, a callback if provided will be
   used to request further resources. Resouces spans allocated by the
   callback mechanism are delimited by special boundary tag markers of
   zero span, 'span' markers. Span markers are never coallesced. Span
   markers are used to detect when an imported span is completely free
   and can be deallocated by the callback mechanism.
+ 
+  Arenas may retain completely free imported spans for a limited time
+  and total size, so that an import which is freed and allocated again
+  shortly after does not go back to the callback. RA_Reclaim releases
+  retained spans early under memory pressure.
 @License        Dual MIT/GPLv2
 
 The contents of this file are subject to the MIT license as set out below.
@@ -90,6 +115,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "ra.h"
 #include "buffer_manager.h"
 #include "osfunc.h"
+#include "alloc_trace.h"
 
 #if defined(__linux__) && defined(__KERNEL__)
 #include <linux/kernel.h>
@@ -156,9 +182,25 @@ struct _BT_
 	/* doubly linked un-ordered list of free segments. */
 	struct _BT_ *pNextFree;
 	struct _BT_ *pPrevFree;
+	/* address index (treap) links, in-order matches the segment list */
+	struct _BT_ *pIndexParent;
+	struct _BT_ *pIndexLeft;
+	struct _BT_ *pIndexRight;
+	IMG_UINT32 ui32IndexPriority;
 	/* a user reference associated with this span, user references are
 	 * currently only provided in the callback mechanism */
 	BM_MAPPING *psMapping;
+	/* live segment is held in a quantum cache rather than by a user */
+	IMG_BOOL bQCached;
+	/* bFreeBackingStore passed to RA_Free when the segment was cached */
+	IMG_BOOL bQCacheFreeBackingStore;
+
+	/* free segment covering a whole import span which is being kept
+	   back from export, linked on the arena retained span list */
+	IMG_BOOL bRetained;
+	IMG_UINT32 ui32RetainTime;
+	struct _BT_ *pNextRetained;
+	struct _BT_ *pPrevRetained;
 
 #if defined(VALIDATE_ARENA_TEST)
 	RESOURCE_DESCRIPTOR eResourceSpan;
@@ -172,6 +214,31 @@ struct _BT_
 };
 typedef struct _BT_ BT;
 
+/* quantum cache limits: the number of size classes, the number of segments
+   in a magazine and the number of full magazines kept in a depot */
+#define RA_QCACHE_MAX_CLASSES		16
+#define RA_QCACHE_MAGAZINE_SIZE		4
+#define RA_QCACHE_DEPOT_LIMIT		2
+
+/* a magazine of cached live segments */
+typedef struct _RA_MAGAZINE_
+{
+	struct _RA_MAGAZINE_ *psNext;
+	IMG_UINT32 ui32Rounds;
+	BT *apsRound[RA_QCACHE_MAGAZINE_SIZE];
+} RA_MAGAZINE;
+
+/* quantum cache for one size class: a loaded and previous magazine in
+   front of a depot of full and empty magazines */
+typedef struct _RA_QCACHE_
+{
+	RA_MAGAZINE *psLoaded;
+	RA_MAGAZINE *psPrevious;
+	RA_MAGAZINE *psFull;
+	RA_MAGAZINE *psEmpty;
+	IMG_UINT32 ui32FullCount;
+} RA_QCACHE;
+
 
 /* resource allocation arena */
 struct _RA_ARENA_
@@ -202,20 +269,74 @@ struct _RA_ARENA_
 
 	/* head of list of free boundary tags for indexed by pvr_log2 of the
 	   boundary tag size */
-#define FREE_TABLE_LIMIT 32
+#define FREE_TABLE_LIMIT RA_FREE_EXTENT_CLASSES
+
+	/* each power of two is split into 2**FREE_SUBCLASS_SHIFT sub-ranges,
+	   a shift of 0 gives a plain power-of-two table */
+#define FREE_SUBCLASS_SHIFT 2
+#define FREE_SUBCLASSES (1 << FREE_SUBCLASS_SHIFT)
+#define FREE_TABLE_SIZE (FREE_TABLE_LIMIT * FREE_SUBCLASSES)
+#define FREE_BITMAP_WORDS ((FREE_TABLE_SIZE + 31) / 32)
 
-	/* power-of-two table of free lists */
-	BT *aHeadFree [FREE_TABLE_LIMIT];
+	/* segregated power-of-two table of free lists */
+	BT *aHeadFree [FREE_TABLE_SIZE];
+
+	/* one bit per free table entry, set when the list is not empty */
+	IMG_UINT32 aui32FreeBitmap [FREE_BITMAP_WORDS];
 
 	/* resource ordered segment list */
 	BT *pHeadSegment;
 	BT *pTailSegment;
 
+	/* root of the address index over the segment list */
+	BT *pIndexRoot;
+
+	/* state of the priority generator for the address index */
+	IMG_UINT32 ui32IndexSeed;
+
 	/* segment address to boundary tag hash table */
 	HASH_TABLE *pSegmentHash;
 
+	/* number of quantum cache size classes in use, 0 if disabled */
+	IMG_UINT32 ui32QCacheClasses;
+
+	/* quantum caches, indexed by (size / uQuantum) - 1 */
+	RA_QCACHE asQCache[RA_QCACHE_MAX_CLASSES];
+
+	/* boundary tags held back so that RA_Alloc does not need to allocate
+	   any once it has started changing the arena, linked by pNextFree */
+	BT *pBTReserve;
+	IMG_UINT32 ui32BTReserveCount;
+
+	/* completely free import spans kept back from export, oldest first */
+	BT *pRetainedHead;
+	BT *pRetainedTail;
+	IMG_SIZE_T uRetainedBytes;
+
+	/* span retention limits, a uRetainMaxBytes of 0 disables retention */
+	IMG_SIZE_T uRetainMaxBytes;
+	IMG_UINT32 ui32RetainMaxAgeus;
+
+	/* next arena on the list of all arenas */
+	struct _RA_ARENA_ *pNextArena;
+
+#if defined(PVRSRV_ALLOC_TRACE)
+	/* identifies the arena in the allocation trace */
+	IMG_UINT32 ui32TraceID;
+#endif
+
 #ifdef RA_STATS
 	RA_STATISTICS sStatistics;
+
+	/* start of the current import/export rate window (OSClockus), and
+	   the import and export counts when it started */
+	IMG_UINT32 ui32ChurnWindowStart;
+	IMG_SIZE_T uChurnWindowImports;
+	IMG_SIZE_T uChurnWindowExports;
+
+	/* import and export rates over the last completed window, per minute */
+	IMG_SIZE_T uImportRate;
+	IMG_SIZE_T uExportRate;
 #endif
 
 #if defined(CONFIG_PROC_FS) && defined(DEBUG)
@@ -227,6 +348,29 @@ struct _RA_ARENA_
 	IMG_BOOL bInitProcEntry;
 #endif
 };
+
+/* enough boundary tags for an import span plus an aligned allocation
+   carved out of the middle of it */
+#define RA_BT_RESERVE			8
+
+/* length of the window over which import and export rates are measured */
+#define RA_CHURN_WINDOW_US		(10 * 1000 * 1000)
+
+/* boundary tags for every arena come from one object cache, which lives
+   from the first RA_Create to the last RA_Delete */
+static IMG_HANDLE ghBTCache = IMG_NULL;
+static IMG_UINT32 gui32ArenaCount = 0;
+
+/* every arena, for RA_Reclaim */
+static RA_ARENA *gpsArenaList = IMG_NULL;
+
+#if defined(PVRSRV_ALLOC_TRACE)
+/* trace ID for the next arena created, never reused */
+static IMG_UINT32 gui32NextArenaTraceID = 0;
+#endif
+
+/* total size of the spans retained by all arenas */
+static IMG_SIZE_T guRetainedBytes = 0;
 /* #define ENABLE_RA_DUMP	1 */
 #if defined(ENABLE_RA_DUMP)
 IMG_VOID RA_Dump (RA_ARENA *pArena);
@@ -315,6 +459,13 @@ _RequestAllocFail (IMG_VOID *_h,
 static IMG_UINT32
 pvr_log2 (IMG_SIZE_T n)
 {
+#if defined(__GNUC__)
+	if (n == 0)
+	{
+		return 0;
+	}
+	return (IMG_UINT32)(sizeof(unsigned long long) * 8 - 1 - __builtin_clzll((unsigned long long)n));
+#else
 	IMG_UINT32 l = 0;
 	n>>=1;
 	while (n>0)
@@ -323,6 +474,455 @@ pvr_log2 (IMG_SIZE_T n)
 		l++;
 	}
 	return l;
+#endif
+}
+
+/*!
+******************************************************************************
+	@Function       pvr_ffs32
+
+	@Description    Finds the index of the least significant set bit of a
+                    non-zero 32 bit value.
+
+	@Input          ui32Value - non-zero value
+
+	@Return         Index of the lowest set bit
+******************************************************************************/
+static IMG_UINT32
+pvr_ffs32 (IMG_UINT32 ui32Value)
+{
+#if defined(__GNUC__)
+	return (IMG_UINT32)__builtin_ctz(ui32Value);
+#else
+	IMG_UINT32 l = 0;
+	while ((ui32Value & 1) == 0)
+	{
+		ui32Value >>= 1;
+		l++;
+	}
+	return l;
+#endif
+}
+
+/*!
+******************************************************************************
+	@Function       _FreeTableIndex
+
+	@Description    Computes the free table entry for a segment size. The
+                    power-of-two class is taken from pvr_log2 and the
+                    sub-class from the FREE_SUBCLASS_SHIFT bits below the
+                    most significant bit.
+
+	@Input          uSize - segment size
+
+	@Return         Free table index
+******************************************************************************/
+static IMG_UINT32
+_FreeTableIndex (IMG_SIZE_T uSize)
+{
+	IMG_UINT32 uLog2 = pvr_log2 (uSize);
+	IMG_UINT32 uSub;
+
+	if (uLog2 >= FREE_TABLE_LIMIT)
+	{
+		/* anything larger shares the last list */
+		return FREE_TABLE_SIZE - 1;
+	}
+
+	if (uLog2 >= FREE_SUBCLASS_SHIFT)
+	{
+		uSub = (IMG_UINT32)(uSize >> (uLog2 - FREE_SUBCLASS_SHIFT));
+	}
+	else
+	{
+		uSub = (IMG_UINT32)(uSize << (FREE_SUBCLASS_SHIFT - uLog2));
+	}
+
+	return (uLog2 << FREE_SUBCLASS_SHIFT) + (uSub & (FREE_SUBCLASSES - 1));
+}
+
+/*!
+******************************************************************************
+	@Function       _FreeTableNext
+
+	@Description    Finds the first non-empty free table entry at or above a
+                    given index using the arena free bitmap.
+
+	@Input          pArena - the arena.
+	@Input          uIndex - the first free table index to consider.
+
+	@Return         Free table index, or FREE_TABLE_SIZE if there is none.
+******************************************************************************/
+static IMG_UINT32
+_FreeTableNext (RA_ARENA *pArena, IMG_UINT32 uIndex)
+{
+	IMG_UINT32 uWord;
+	IMG_UINT32 ui32Bits;
+
+	if (uIndex >= FREE_TABLE_SIZE)
+	{
+		return FREE_TABLE_SIZE;
+	}
+
+	uWord = uIndex >> 5;
+	ui32Bits = pArena->aui32FreeBitmap[uWord] & (0xFFFFFFFFU << (uIndex & 31));
+
+	while (ui32Bits == 0)
+	{
+		if (++uWord >= FREE_BITMAP_WORDS)
+		{
+			return FREE_TABLE_SIZE;
+		}
+		ui32Bits = pArena->aui32FreeBitmap[uWord];
+	}
+
+	return (uWord << 5) + pvr_ffs32 (ui32Bits);
+}
+
+#ifdef RA_STATS
+/*!
+******************************************************************************
+	@Function       _ChurnRate
+
+	@Description    Computes a per minute rate from a count over an interval.
+
+	@Input          uCount - the number of events.
+	@Input          ui32Elapsedus - the interval in microseconds.
+
+	@Return         events per minute
+******************************************************************************/
+static IMG_SIZE_T
+_ChurnRate (IMG_SIZE_T uCount, IMG_UINT32 ui32Elapsedus)
+{
+	if (ui32Elapsedus == 0)
+	{
+		return 0;
+	}
+	return (IMG_SIZE_T)(((IMG_UINT64)uCount * 60 * 1000 * 1000) / ui32Elapsedus);
+}
+
+/*!
+******************************************************************************
+	@Function       _ChurnUpdate
+
+	@Description    Closes the import/export rate window once it has run for
+                    RA_CHURN_WINDOW_US. Called after each import and export.
+
+	@Input          pArena - the arena.
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_ChurnUpdate (RA_ARENA *pArena)
+{
+	IMG_UINT32 ui32Now = OSClockus();
+	IMG_UINT32 ui32Elapsed = ui32Now - pArena->ui32ChurnWindowStart;
+
+	if (ui32Elapsed >= RA_CHURN_WINDOW_US)
+	{
+		pArena->uImportRate = _ChurnRate (pArena->sStatistics.uImportCount - pArena->uChurnWindowImports, ui32Elapsed);
+		pArena->uExportRate = _ChurnRate (pArena->sStatistics.uExportCount - pArena->uChurnWindowExports, ui32Elapsed);
+		pArena->uChurnWindowImports = pArena->sStatistics.uImportCount;
+		pArena->uChurnWindowExports = pArena->sStatistics.uExportCount;
+		pArena->ui32ChurnWindowStart = ui32Now;
+	}
+}
+
+/*!
+******************************************************************************
+	@Function       _ChurnGet
+
+	@Description    Gets the current import and export rates. If the window
+                    has run past RA_CHURN_WINDOW_US without being closed there
+                    has been no churn since it started, so the rate over the
+                    open window is the more recent figure.
+
+	@Input          pArena - the arena.
+	@Output         puImportRate - imports per minute.
+	@Output         puExportRate - exports per minute.
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_ChurnGet (RA_ARENA *pArena, IMG_SIZE_T *puImportRate, IMG_SIZE_T *puExportRate)
+{
+	IMG_UINT32 ui32Elapsed = OSClockus() - pArena->ui32ChurnWindowStart;
+
+	if (ui32Elapsed >= RA_CHURN_WINDOW_US)
+	{
+		*puImportRate = _ChurnRate (pArena->sStatistics.uImportCount - pArena->uChurnWindowImports, ui32Elapsed);
+		*puExportRate = _ChurnRate (pArena->sStatistics.uExportCount - pArena->uChurnWindowExports, ui32Elapsed);
+	}
+	else
+	{
+		*puImportRate = pArena->uImportRate;
+		*puExportRate = pArena->uExportRate;
+	}
+}
+
+/*!
+******************************************************************************
+	@Function       _LargestFreeExtent
+
+	@Description    Finds the largest free segment in an arena. Only the
+                    highest non-empty free table list is searched.
+
+	@Input          pArena - the arena.
+
+	@Return         size of the largest free segment, 0 if there is none.
+******************************************************************************/
+static IMG_SIZE_T
+_LargestFreeExtent (RA_ARENA *pArena)
+{
+	IMG_INT32 i32Word;
+	IMG_SIZE_T uLargest = 0;
+	BT *pBT;
+
+	for (i32Word = FREE_BITMAP_WORDS - 1; i32Word >= 0; i32Word--)
+	{
+		if (pArena->aui32FreeBitmap[i32Word] != 0)
+		{
+			break;
+		}
+	}
+	if (i32Word < 0)
+	{
+		return 0;
+	}
+
+	pBT = pArena->aHeadFree[((IMG_UINT32)i32Word << 5) + pvr_log2 (pArena->aui32FreeBitmap[i32Word])];
+	for (; pBT != IMG_NULL; pBT = pBT->pNextFree)
+	{
+		if (pBT->uSize > uLargest)
+		{
+			uLargest = pBT->uSize;
+		}
+	}
+
+	return uLargest;
+}
+
+/*!
+******************************************************************************
+	@Function       _FragmentationPercent
+
+	@Description    External fragmentation of the arena free space: the
+                    percentage of free resource which is not in the largest
+                    free segment.
+
+	@Input          pArena - the arena.
+	@Input          uLargest - size of the largest free segment.
+
+	@Return         0 (no fragmentation) to 100
+******************************************************************************/
+static IMG_UINT32
+_FragmentationPercent (RA_ARENA *pArena, IMG_SIZE_T uLargest)
+{
+	IMG_SIZE_T uFree = pArena->sStatistics.uFreeResourceCount;
+
+	if (uFree == 0 || uLargest >= uFree)
+	{
+		return 0;
+	}
+	return (IMG_UINT32)(((IMG_UINT64)(uFree - uLargest) * 100) / uFree);
+}
+#endif
+
+/*!
+******************************************************************************
+	@Function       _IndexPriority
+
+	@Description    Generate a pseudo random priority for a new address index
+                    node (xorshift32).
+
+	@Input          pArena - the arena.
+
+	@Return         The priority.
+******************************************************************************/
+static IMG_UINT32
+_IndexPriority (RA_ARENA *pArena)
+{
+	IMG_UINT32 x = pArena->ui32IndexSeed;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	pArena->ui32IndexSeed = x;
+
+	return x;
+}
+
+/*!
+******************************************************************************
+	@Function       _IndexRotateUp
+
+	@Description    Rotate an address index node above its parent, preserving
+                    the in-order sequence of the index.
+
+	@Input          pArena - the arena.
+	@Input          pBT - the boundary tag to rotate up, must have a parent.
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_IndexRotateUp (RA_ARENA *pArena, BT *pBT)
+{
+	BT *pParent = pBT->pIndexParent;
+	BT *pGrandParent = pParent->pIndexParent;
+
+	if (pParent->pIndexLeft == pBT)
+	{
+		pParent->pIndexLeft = pBT->pIndexRight;
+		if (pBT->pIndexRight != IMG_NULL)
+			pBT->pIndexRight->pIndexParent = pParent;
+		pBT->pIndexRight = pParent;
+	}
+	else
+	{
+		pParent->pIndexRight = pBT->pIndexLeft;
+		if (pBT->pIndexLeft != IMG_NULL)
+			pBT->pIndexLeft->pIndexParent = pParent;
+		pBT->pIndexLeft = pParent;
+	}
+
+	pParent->pIndexParent = pBT;
+	pBT->pIndexParent = pGrandParent;
+
+	if (pGrandParent == IMG_NULL)
+		pArena->pIndexRoot = pBT;
+	else if (pGrandParent->pIndexLeft == pParent)
+		pGrandParent->pIndexLeft = pBT;
+	else
+		pGrandParent->pIndexRight = pBT;
+}
+
+/*!
+******************************************************************************
+	@Function       _IndexInsertAfter
+
+	@Description    Insert a boundary tag into the arena address index so
+                    that it immediately follows another boundary tag in the
+                    in-order sequence. This mirrors the segment list exactly,
+                    including for span markers which share a base.
+
+	@Input          pArena - the arena.
+	@Input          pInsertionPoint - the preceding boundary tag, or IMG_NULL
+                     to insert at the head.
+	@Input          pBT - the boundary tag to insert.
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_IndexInsertAfter (RA_ARENA *pArena, BT *pInsertionPoint, BT *pBT)
+{
+	BT *pScan;
+
+	pBT->pIndexLeft = IMG_NULL;
+	pBT->pIndexRight = IMG_NULL;
+	pBT->ui32IndexPriority = _IndexPriority (pArena);
+
+	if (pArena->pIndexRoot == IMG_NULL)
+	{
+		pBT->pIndexParent = IMG_NULL;
+		pArena->pIndexRoot = pBT;
+		return;
+	}
+
+	if (pInsertionPoint != IMG_NULL && pInsertionPoint->pIndexRight == IMG_NULL)
+	{
+		pInsertionPoint->pIndexRight = pBT;
+		pBT->pIndexParent = pInsertionPoint;
+	}
+	else
+	{
+		/* become the left child of the leftmost node following the
+		   insertion point */
+		pScan = (pInsertionPoint != IMG_NULL) ? pInsertionPoint->pIndexRight : pArena->pIndexRoot;
+		while (pScan->pIndexLeft != IMG_NULL)
+			pScan = pScan->pIndexLeft;
+		pScan->pIndexLeft = pBT;
+		pBT->pIndexParent = pScan;
+	}
+
+	while (pBT->pIndexParent != IMG_NULL
+		   && pBT->pIndexParent->ui32IndexPriority < pBT->ui32IndexPriority)
+	{
+		_IndexRotateUp (pArena, pBT);
+	}
+}
+
+/*!
+******************************************************************************
+	@Function       _IndexRemove
+
+	@Description    Remove a boundary tag from the arena address index.
+
+	@Input          pArena - the arena.
+	@Input          pBT - the boundary tag to remove.
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_IndexRemove (RA_ARENA *pArena, BT *pBT)
+{
+	BT *pChild;
+
+	/* rotate the boundary tag down until it has at most one child */
+	while (pBT->pIndexLeft != IMG_NULL && pBT->pIndexRight != IMG_NULL)
+	{
+		if (pBT->pIndexLeft->ui32IndexPriority > pBT->pIndexRight->ui32IndexPriority)
+			_IndexRotateUp (pArena, pBT->pIndexLeft);
+		else
+			_IndexRotateUp (pArena, pBT->pIndexRight);
+	}
+
+	pChild = (pBT->pIndexLeft != IMG_NULL) ? pBT->pIndexLeft : pBT->pIndexRight;
+	if (pChild != IMG_NULL)
+		pChild->pIndexParent = pBT->pIndexParent;
+
+	if (pBT->pIndexParent == IMG_NULL)
+		pArena->pIndexRoot = pChild;
+	else if (pBT->pIndexParent->pIndexLeft == pBT)
+		pBT->pIndexParent->pIndexLeft = pChild;
+	else
+		pBT->pIndexParent->pIndexRight = pChild;
+
+	pBT->pIndexParent = pBT->pIndexLeft = pBT->pIndexRight = IMG_NULL;
+}
+
+/*!
+******************************************************************************
+	@Function       _IndexFindFloor
+
+	@Description    Find the last boundary tag in the segment list whose base
+                    is less than or equal to a given base.
+
+	@Input          pArena - the arena.
+	@Input          base - the base to search for.
+
+	@Return         The boundary tag, or IMG_NULL if every segment in the
+                    arena starts above base.
+******************************************************************************/
+static BT *
+_IndexFindFloor (RA_ARENA *pArena, IMG_UINTPTR_T base)
+{
+	BT *pScan = pArena->pIndexRoot;
+	BT *pFloor = IMG_NULL;
+
+	while (pScan != IMG_NULL)
+	{
+		if (pScan->base <= base)
+		{
+			pFloor = pScan;
+			pScan = pScan->pIndexRight;
+		}
+		else
+		{
+			pScan = pScan->pIndexLeft;
+		}
+	}
+
+	return pFloor;
 }
 
 /*!
@@ -360,6 +960,8 @@ _SegmentListInsertAfter (RA_ARENA *pArena,
 		pInsertionPoint->pNextSegment->pPrevSegment = pBT;
 	pInsertionPoint->pNextSegment = pBT;
 
+	_IndexInsertAfter (pArena, pInsertionPoint, pBT);
+
 	return PVRSRV_OK;
 }
 
@@ -385,12 +987,19 @@ _SegmentListInsert (RA_ARENA *pArena, BT *pBT)
 	{
 		pArena->pHeadSegment = pArena->pTailSegment = pBT;
 		pBT->pNextSegment = pBT->pPrevSegment = IMG_NULL;
+		_IndexInsertAfter (pArena, IMG_NULL, pBT);
 	}
 	else
 	{
 		BT *pBTScan;
 
-		if (pBT->base < pArena->pHeadSegment->base)
+		/* pBT must be inserted before the first boundary tag with a
+		greater base value - or at the end of the list. The address index
+		gives us the last boundary tag with a base less than or equal to
+		that of pBT. */
+		pBTScan = _IndexFindFloor (pArena, pBT->base);
+
+		if (pBTScan == IMG_NULL)
 		{
 			/* The base address of pBT is less than the base address of the boundary tag
 			at the head of the list - so insert this boundary tag at the head. */
@@ -398,21 +1007,10 @@ _SegmentListInsert (RA_ARENA *pArena, BT *pBT)
 			pArena->pHeadSegment->pPrevSegment = pBT;
 			pArena->pHeadSegment = pBT;
 			pBT->pPrevSegment = IMG_NULL;
+			_IndexInsertAfter (pArena, IMG_NULL, pBT);
 		}
 		else
 		{
-
-			/* The base address of pBT is greater than or equal to that of the boundary tag
-			at the head of the list. Search for the insertion point: pBT must be inserted
-			before the first boundary tag with a greater base value - or at the end of the list.
-			*/
-			pBTScan = pArena->pHeadSegment;
-
-			while ((pBTScan->pNextSegment != IMG_NULL)  && (pBT->base >= pBTScan->pNextSegment->base))
-			{
-				pBTScan = pBTScan->pNextSegment;
-			}
-
 			eError = _SegmentListInsertAfter (pArena, pBTScan, pBT);
 			if (eError != PVRSRV_OK)
 			{
@@ -446,6 +1044,133 @@ _SegmentListRemove (RA_ARENA *pArena, BT *pBT)
 		pArena->pTailSegment = pBT->pPrevSegment;
 	else
 		pBT->pNextSegment->pPrevSegment = pBT->pPrevSegment;
+
+	_IndexRemove (pArena, pBT);
+}
+
+/*!
+******************************************************************************
+	@Function       _AllocBT
+
+	@Description    Get a zeroed boundary tag for an arena, from the arena
+                    reserve if possible.
+
+	@Input          pArena - the arena.
+
+	@Return         boundary tag, or IMG_NULL on failure.
+******************************************************************************/
+static BT *
+_AllocBT (RA_ARENA *pArena)
+{
+	BT *pBT = pArena->pBTReserve;
+
+	if (pBT != IMG_NULL)
+	{
+		pArena->pBTReserve = pBT->pNextFree;
+		pArena->ui32BTReserveCount--;
+	}
+	else
+	{
+		if (OSAllocObject(ghBTCache, (IMG_VOID **)&pBT) != PVRSRV_OK)
+		{
+			return IMG_NULL;
+		}
+#ifdef RA_STATS
+		pArena->sStatistics.uBTCacheAllocCount++;
+#endif
+	}
+#ifdef RA_STATS
+	pArena->sStatistics.uBTAllocCount++;
+#endif
+
+	OSMemSet(pBT, 0, sizeof(BT));
+
+#if defined(VALIDATE_ARENA_TEST)
+	pBT->ui32BoundaryTagID = ++ui32BoundaryTagID;
+#endif
+
+	return pBT;
+}
+
+/*!
+******************************************************************************
+	@Function       _ReleaseBT
+
+	@Description    Give back a boundary tag which is no longer in use,
+                    refilling the arena reserve first.
+
+	@Input          pArena - the arena.
+	@Input          pBT - the boundary tag.
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_ReleaseBT (RA_ARENA *pArena, BT *pBT)
+{
+	if (pArena->ui32BTReserveCount < RA_BT_RESERVE)
+	{
+		pBT->pNextFree = pArena->pBTReserve;
+		pArena->pBTReserve = pBT;
+		pArena->ui32BTReserveCount++;
+	}
+	else
+	{
+		OSFreeObject(ghBTCache, pBT);
+	}
+}
+
+/*!
+******************************************************************************
+	@Function       _FillBTReserve
+
+	@Description    Top up the arena boundary tag reserve. Failure is not
+                    fatal, the tags are then allocated as they are needed.
+
+	@Input          pArena - the arena.
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_FillBTReserve (RA_ARENA *pArena)
+{
+	while (pArena->ui32BTReserveCount < RA_BT_RESERVE)
+	{
+		BT *pBT;
+
+		if (OSAllocObject(ghBTCache, (IMG_VOID **)&pBT) != PVRSRV_OK)
+		{
+			return;
+		}
+#ifdef RA_STATS
+		pArena->sStatistics.uBTCacheAllocCount++;
+#endif
+		pBT->pNextFree = pArena->pBTReserve;
+		pArena->pBTReserve = pBT;
+		pArena->ui32BTReserveCount++;
+	}
+}
+
+/*!
+******************************************************************************
+	@Function       _DrainBTReserve
+
+	@Description    Free every boundary tag in the arena reserve.
+
+	@Input          pArena - the arena.
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_DrainBTReserve (RA_ARENA *pArena)
+{
+	while (pArena->pBTReserve != IMG_NULL)
+	{
+		BT *pBT = pArena->pBTReserve;
+
+		pArena->pBTReserve = pBT->pNextFree;
+		OSFreeObject(ghBTCache, pBT);
+	}
+	pArena->ui32BTReserveCount = 0;
 }
 
 /*!
@@ -478,20 +1203,12 @@ _SegmentSplit (RA_ARENA *pArena, BT *pBT, IMG_SIZE_T uSize)
 		return IMG_NULL;
 	}
 
-	if(OSAllocMem(PVRSRV_OS_PAGEABLE_HEAP,
-					sizeof(BT),
-					(IMG_VOID **)&pNeighbour, IMG_NULL,
-					"Boundary Tag") != PVRSRV_OK)
+	pNeighbour = _AllocBT (pArena);
+	if (pNeighbour == IMG_NULL)
 	{
 		return IMG_NULL;
 	}
 
-	OSMemSet(pNeighbour, 0, sizeof(BT));
-
-#if defined(VALIDATE_ARENA_TEST)
-	pNeighbour->ui32BoundaryTagID = ++ui32BoundaryTagID;
-#endif
-
 	pNeighbour->pPrevSegment = pBT;
 	pNeighbour->pNextSegment = pBT->pNextSegment;
 	if (pBT->pNextSegment == IMG_NULL)
@@ -506,6 +1223,8 @@ _SegmentSplit (RA_ARENA *pArena, BT *pBT, IMG_SIZE_T uSize)
 	pNeighbour->psMapping = pBT->psMapping;
 	pBT->uSize = uSize;
 
+	_IndexInsertAfter (pArena, pBT, pNeighbour);
+
 #if defined(VALIDATE_ARENA_TEST)
 	if (pNeighbour->pPrevSegment->eResourceType == IMPORTED_RESOURCE_TYPE)
 	{
@@ -543,13 +1262,18 @@ static IMG_VOID
 _FreeListInsert (RA_ARENA *pArena, BT *pBT)
 {
 	IMG_UINT32 uIndex;
-	uIndex = pvr_log2 (pBT->uSize);
+	uIndex = _FreeTableIndex (pBT->uSize);
 	pBT->type = btt_free;
 	pBT->pNextFree = pArena->aHeadFree [uIndex];
 	pBT->pPrevFree = IMG_NULL;
 	if (pArena->aHeadFree[uIndex] != IMG_NULL)
 		pArena->aHeadFree[uIndex]->pPrevFree = pBT;
+	else
+		pArena->aui32FreeBitmap[uIndex >> 5] |= 1U << (uIndex & 31);
 	pArena->aHeadFree [uIndex] = pBT;
+#ifdef RA_STATS
+	pArena->sStatistics.auFreeExtentCount[uIndex >> FREE_SUBCLASS_SHIFT]++;
+#endif
 }
 
 /*!
@@ -568,13 +1292,20 @@ static IMG_VOID
 _FreeListRemove (RA_ARENA *pArena, BT *pBT)
 {
 	IMG_UINT32 uIndex;
-	uIndex = pvr_log2 (pBT->uSize);
+	uIndex = _FreeTableIndex (pBT->uSize);
 	if (pBT->pNextFree != IMG_NULL)
 		pBT->pNextFree->pPrevFree = pBT->pPrevFree;
 	if (pBT->pPrevFree == IMG_NULL)
+	{
 		pArena->aHeadFree[uIndex] = pBT->pNextFree;
+		if (pBT->pNextFree == IMG_NULL)
+			pArena->aui32FreeBitmap[uIndex >> 5] &= ~(1U << (uIndex & 31));
+	}
 	else
 		pBT->pPrevFree->pNextFree = pBT->pNextFree;
+#ifdef RA_STATS
+	pArena->sStatistics.auFreeExtentCount[uIndex >> FREE_SUBCLASS_SHIFT]--;
+#endif
 }
 
 /*!
@@ -585,29 +1316,22 @@ _FreeListRemove (RA_ARENA *pArena, BT *pBT)
 
 	@Input          pArena - arena to contain span marker
 	@Input          base - the base of the bounary tag.
+	@Input          uSize - the extent of the span, 0 for an end marker.
 
 	@Return         span marker boundary tag
 
 ******************************************************************************/
 static BT *
-_BuildSpanMarker (IMG_UINTPTR_T base, IMG_SIZE_T uSize)
+_BuildSpanMarker (RA_ARENA *pArena, IMG_UINTPTR_T base, IMG_SIZE_T uSize)
 {
 	BT *pBT;
 
-	if(OSAllocMem(PVRSRV_OS_PAGEABLE_HEAP,
-					sizeof(BT),
-					(IMG_VOID **)&pBT, IMG_NULL,
-					"Boundary Tag") != PVRSRV_OK)
+	pBT = _AllocBT (pArena);
+	if (pBT == IMG_NULL)
 	{
 		return IMG_NULL;
 	}
 
-	OSMemSet(pBT, 0, sizeof(BT));
-
-#if defined(VALIDATE_ARENA_TEST)
-	pBT->ui32BoundaryTagID = ++ui32BoundaryTagID;
-#endif
-
 	pBT->type = btt_span;
 	pBT->base = base;
 	pBT->uSize = uSize;
@@ -622,6 +1346,7 @@ _BuildSpanMarker (IMG_UINTPTR_T base, IMG_SIZE_T uSize)
 
 	@Description    Construct a boundary tag for a free segment.
 
+	@Input          pArena - arena to contain the boundary tag.
 	@Input          base - the base of the resource segment.
 	@Input          uSize - the extent of the resouce segment.
 
@@ -629,24 +1354,16 @@ _BuildSpanMarker (IMG_UINTPTR_T base, IMG_SIZE_T uSize)
 
 ******************************************************************************/
 static BT *
-_BuildBT (IMG_UINTPTR_T base, IMG_SIZE_T uSize)
+_BuildBT (RA_ARENA *pArena, IMG_UINTPTR_T base, IMG_SIZE_T uSize)
 {
 	BT *pBT;
 
-	if(OSAllocMem(PVRSRV_OS_PAGEABLE_HEAP,
-					sizeof(BT),
-					(IMG_VOID **)&pBT, IMG_NULL,
-					"Boundary Tag") != PVRSRV_OK)
+	pBT = _AllocBT (pArena);
+	if (pBT == IMG_NULL)
 	{
 		return IMG_NULL;
 	}
 
-	OSMemSet(pBT, 0, sizeof(BT));
-
-#if defined(VALIDATE_ARENA_TEST)
-	pBT->ui32BoundaryTagID = ++ui32BoundaryTagID;
-#endif
-
 	pBT->type = btt_free;
 	pBT->base = base;
 	pBT->uSize = uSize;
@@ -679,7 +1396,7 @@ _InsertResource (RA_ARENA *pArena, IMG_UINTPTR_T base, IMG_SIZE_T uSize)
 		return IMG_NULL;
 	}
 
-	pBT = _BuildBT (base, uSize);
+	pBT = _BuildBT (pArena, base, uSize);
 	if (pBT != IMG_NULL)
 	{
 
@@ -697,6 +1414,7 @@ _InsertResource (RA_ARENA *pArena, IMG_UINTPTR_T base, IMG_SIZE_T uSize)
 #ifdef RA_STATS
 		pArena->sStatistics.uTotalResourceCount+=uSize;
 		pArena->sStatistics.uFreeResourceCount+=uSize;
+		pArena->sStatistics.uFreeSegmentCount++;
 		pArena->sStatistics.uSpanCount++;
 #endif
 	}
@@ -735,7 +1453,7 @@ _InsertResourceSpan (RA_ARENA *pArena, IMG_UINTPTR_T base, IMG_SIZE_T uSize)
 			  "RA_InsertResourceSpan: arena='%s', base=0x" UINTPTR_FMT ", size=0x%" SIZE_T_FMT_LEN "x",
 			  pArena->name, base, uSize));
 
-	pSpanStart = _BuildSpanMarker (base, uSize);
+	pSpanStart = _BuildSpanMarker (pArena, base, uSize);
 	if (pSpanStart == IMG_NULL)
 	{
 		goto fail_start;
@@ -746,7 +1464,7 @@ _InsertResourceSpan (RA_ARENA *pArena, IMG_UINTPTR_T base, IMG_SIZE_T uSize)
 	pSpanStart->eResourceType = IMPORTED_RESOURCE_TYPE;
 #endif
 
-	pSpanEnd = _BuildSpanMarker (base + uSize, 0);
+	pSpanEnd = _BuildSpanMarker (pArena, base + uSize, 0);
 	if (pSpanEnd == IMG_NULL)
 	{
 		goto fail_end;
@@ -757,7 +1475,7 @@ _InsertResourceSpan (RA_ARENA *pArena, IMG_UINTPTR_T base, IMG_SIZE_T uSize)
 	pSpanEnd->eResourceType = IMPORTED_RESOURCE_TYPE;
 #endif
 
-	pBT = _BuildBT (base, uSize);
+	pBT = _BuildBT (pArena, base, uSize);
 	if (pBT == IMG_NULL)
 	{
 		goto fail_bt;
@@ -799,18 +1517,161 @@ _InsertResourceSpan (RA_ARENA *pArena, IMG_UINTPTR_T base, IMG_SIZE_T uSize)
 	return pBT;
 
   fail_SegListInsert:
-	OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(BT), pBT, IMG_NULL);
+	_ReleaseBT (pArena, pBT);
 	/*not nulling pointer, out of scope*/
   fail_bt:
-	OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(BT), pSpanEnd, IMG_NULL);
+	_ReleaseBT (pArena, pSpanEnd);
 	/*not nulling pointer, out of scope*/
   fail_end:
-	OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(BT), pSpanStart, IMG_NULL);
+	_ReleaseBT (pArena, pSpanStart);
 	/*not nulling pointer, out of scope*/
   fail_start:
 	return IMG_NULL;
 }
 
+/*!
+******************************************************************************
+	@Function       _RetainedInsert
+
+	@Description    Add the free segment covering a whole import span to the
+                    tail of the arena retained span list.
+
+	@Input          pArena - the arena.
+	@Input          pBT - the free boundary tag.
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_RetainedInsert (RA_ARENA *pArena, BT *pBT)
+{
+	pBT->bRetained = IMG_TRUE;
+	pBT->ui32RetainTime = OSClockus();
+	pBT->pNextRetained = IMG_NULL;
+	pBT->pPrevRetained = pArena->pRetainedTail;
+	if (pArena->pRetainedTail == IMG_NULL)
+		pArena->pRetainedHead = pBT;
+	else
+		pArena->pRetainedTail->pNextRetained = pBT;
+	pArena->pRetainedTail = pBT;
+
+	pArena->uRetainedBytes += pBT->uSize;
+	guRetainedBytes += pBT->uSize;
+#ifdef RA_STATS
+	pArena->sStatistics.uRetainedSpanCount++;
+#endif
+}
+
+/*!
+******************************************************************************
+	@Function       _RetainedRemove
+
+	@Description    Remove a boundary tag from the arena retained span list.
+
+	@Input          pArena - the arena.
+	@Input          pBT - the retained boundary tag.
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_RetainedRemove (RA_ARENA *pArena, BT *pBT)
+{
+	PVR_ASSERT (pBT->bRetained);
+
+	if (pBT->pPrevRetained == IMG_NULL)
+		pArena->pRetainedHead = pBT->pNextRetained;
+	else
+		pBT->pPrevRetained->pNextRetained = pBT->pNextRetained;
+	if (pBT->pNextRetained == IMG_NULL)
+		pArena->pRetainedTail = pBT->pPrevRetained;
+	else
+		pBT->pNextRetained->pPrevRetained = pBT->pPrevRetained;
+	pBT->bRetained = IMG_FALSE;
+
+	pArena->uRetainedBytes -= pBT->uSize;
+	guRetainedBytes -= pBT->uSize;
+#ifdef RA_STATS
+	pArena->sStatistics.uRetainedSpanCount--;
+#endif
+}
+
+/*!
+******************************************************************************
+	@Function       _ExportSpan
+
+	@Description    Return a completely free import span to the import
+                    source. The free boundary tag must not be in the free
+                    table.
+
+	@Input          pArena - the arena.
+	@Input          pBT - the free boundary tag covering the span.
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_ExportSpan (RA_ARENA *pArena, BT *pBT)
+{
+	BT *next = pBT->pNextSegment;
+	BT *prev = pBT->pPrevSegment;
+
+	_SegmentListRemove (pArena, next);
+	_SegmentListRemove (pArena, prev);
+	_SegmentListRemove (pArena, pBT);
+	pArena->pImportFree (pArena->pImportHandle, pBT->base, pBT->psMapping);
+#ifdef RA_STATS
+	pArena->sStatistics.uSpanCount--;
+	pArena->sStatistics.uExportCount++;
+	_ChurnUpdate (pArena);
+	pArena->sStatistics.uFreeSegmentCount--;
+	pArena->sStatistics.uFreeResourceCount-=pBT->uSize;
+	pArena->sStatistics.uTotalResourceCount-=pBT->uSize;
+#endif
+	_ReleaseBT (pArena, next);
+	/*not nulling original pointer, already overwritten*/
+	_ReleaseBT (pArena, prev);
+	/*not nulling original pointer, already overwritten*/
+	_ReleaseBT (pArena, pBT);
+	/*not nulling pointer, copy on stack*/
+}
+
+/*!
+******************************************************************************
+	@Function       _RetainedRelease
+
+	@Description    Export retained spans, oldest first, until the arena is
+                    within its retention limits and at least uReclaim bytes
+                    have been released.
+
+	@Input          pArena - the arena.
+	@Input          uReclaim - minimum number of bytes to release.
+
+	@Return         number of bytes released
+******************************************************************************/
+static IMG_SIZE_T
+_RetainedRelease (RA_ARENA *pArena, IMG_SIZE_T uReclaim)
+{
+	IMG_UINT32 ui32Now = OSClockus();
+	IMG_SIZE_T uReleased = 0;
+
+	while (pArena->pRetainedHead != IMG_NULL)
+	{
+		BT *pBT = pArena->pRetainedHead;
+
+		if (uReleased >= uReclaim
+			&& pArena->uRetainedBytes <= pArena->uRetainMaxBytes
+			&& ui32Now - pBT->ui32RetainTime < pArena->ui32RetainMaxAgeus)
+		{
+			break;
+		}
+
+		uReleased += pBT->uSize;
+		_RetainedRemove (pArena, pBT);
+		_FreeListRemove (pArena, pBT);
+		_ExportSpan (pArena, pBT);
+	}
+
+	return uReleased;
+}
+
 /*!
 ******************************************************************************
 	@Function       _FreeBT
@@ -859,7 +1720,7 @@ _FreeBT (RA_ARENA *pArena, BT *pBT, IMG_BOOL bFreeBackingStore)
 		_SegmentListRemove (pArena, pNeighbour);
 		pBT->base = pNeighbour->base;
 		pBT->uSize += pNeighbour->uSize;
-		OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(BT), pNeighbour, IMG_NULL);
+		_ReleaseBT (pArena, pNeighbour);
 		/*not nulling original pointer, already overwritten*/
 #ifdef RA_STATS
 		pArena->sStatistics.uFreeSegmentCount--;
@@ -875,7 +1736,7 @@ _FreeBT (RA_ARENA *pArena, BT *pBT, IMG_BOOL bFreeBackingStore)
 		_FreeListRemove (pArena, pNeighbour);
 		_SegmentListRemove (pArena, pNeighbour);
 		pBT->uSize += pNeighbour->uSize;
-		OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(BT), pNeighbour, IMG_NULL);
+		_ReleaseBT (pArena, pNeighbour);
 		/*not nulling original pointer, already overwritten*/
 #ifdef RA_STATS
 		pArena->sStatistics.uFreeSegmentCount--;
@@ -912,25 +1773,18 @@ _FreeBT (RA_ARENA *pArena, BT *pBT, IMG_BOOL bFreeBackingStore)
 	if (pBT->pNextSegment!=IMG_NULL && pBT->pNextSegment->type == btt_span
 		&& pBT->pPrevSegment!=IMG_NULL && pBT->pPrevSegment->type == btt_span)
 	{
-		BT *next = pBT->pNextSegment;
-		BT *prev = pBT->pPrevSegment;
-		_SegmentListRemove (pArena, next);
-		_SegmentListRemove (pArena, prev);
-		_SegmentListRemove (pArena, pBT);
-		pArena->pImportFree (pArena->pImportHandle, pBT->base, pBT->psMapping);
-#ifdef RA_STATS
-		pArena->sStatistics.uSpanCount--;
-		pArena->sStatistics.uExportCount++;
-		pArena->sStatistics.uFreeSegmentCount--;
-		pArena->sStatistics.uFreeResourceCount-=pBT->uSize;
-		pArena->sStatistics.uTotalResourceCount-=pBT->uSize;
-#endif
-		OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(BT), next, IMG_NULL);
-		/*not nulling original pointer, already overwritten*/
-		OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(BT), prev, IMG_NULL);
-		/*not nulling original pointer, already overwritten*/
-		OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(BT), pBT, IMG_NULL);
-		/*not nulling pointer, copy on stack*/
+		if (pBT->uSize <= pArena->uRetainMaxBytes)
+		{
+			/* keep the span for a while in case the same size is
+			   imported again shortly */
+			_FreeListInsert (pArena, pBT);
+			_RetainedInsert (pArena, pBT);
+			_RetainedRelease (pArena, 0);
+		}
+		else
+		{
+			_ExportSpan (pArena, pBT);
+		}
 	}
 	else
 		_FreeListInsert (pArena, pBT);
@@ -976,14 +1830,11 @@ _AttemptAllocAligned (RA_ARENA *pArena,
 		uAlignmentOffset %= uAlignment;
 
 	/* search for a near fit free boundary tag, start looking at the
-	   pvr_log2 free table for our required size and work on up the
-	   table. */
-	uIndex = pvr_log2 (uSize);
+	   free table entry for our required size and work on up the
+	   table, skipping empty entries using the free bitmap. */
+	uIndex = _FreeTableNext (pArena, _FreeTableIndex (uSize));
 
-	while (uIndex < FREE_TABLE_LIMIT && pArena->aHeadFree[uIndex]==IMG_NULL)
-		uIndex++;
-
-	while (uIndex < FREE_TABLE_LIMIT)
+	while (uIndex < FREE_TABLE_SIZE)
 	{
 		if (pArena->aHeadFree[uIndex]!=IMG_NULL)
 		{
@@ -1012,6 +1863,14 @@ _AttemptAllocAligned (RA_ARENA *pArena,
 				{
 					if(!pBT->psMapping || pBT->psMapping->ui32Flags == uFlags)
 					{
+						if (pBT->bRetained)
+						{
+							_RetainedRemove (pArena, pBT);
+#ifdef RA_STATS
+							pArena->sStatistics.uImportsAvoided++;
+#endif
+						}
+
 						_FreeListRemove (pArena, pBT);
 
 						PVR_ASSERT (pBT->type == btt_free);
@@ -1058,62 +1917,317 @@ _AttemptAllocAligned (RA_ARENA *pArena,
 								return IMG_FALSE;
 							}
 
-							_FreeListInsert (pArena, pNeighbour);
-	#ifdef RA_STATS
-							pArena->sStatistics.uFreeSegmentCount++;
-							pArena->sStatistics.uFreeResourceCount+=pNeighbour->uSize;
-	#endif
-						}
+							_FreeListInsert (pArena, pNeighbour);
+	#ifdef RA_STATS
+							pArena->sStatistics.uFreeSegmentCount++;
+							pArena->sStatistics.uFreeResourceCount+=pNeighbour->uSize;
+	#endif
+						}
+
+						pBT->type = btt_live;
+
+#if defined(VALIDATE_ARENA_TEST)
+						if (pBT->eResourceType == IMPORTED_RESOURCE_TYPE)
+						{
+							pBT->eResourceSpan = IMPORTED_RESOURCE_SPAN_LIVE;
+						}
+						else if (pBT->eResourceType == NON_IMPORTED_RESOURCE_TYPE)
+						{
+							pBT->eResourceSpan = RESOURCE_SPAN_LIVE;
+						}
+						else
+						{
+							PVR_DPF ((PVR_DBG_ERROR,"_AttemptAllocAligned ERROR: pBT->eResourceType unrecognized"));
+							PVR_DBG_BREAK;
+						}
+#endif
+						if (!HASH_Insert (pArena->pSegmentHash, pBT->base, (IMG_UINTPTR_T) pBT))
+						{
+							_FreeBT (pArena, pBT, IMG_FALSE);
+							return IMG_FALSE;
+						}
+
+						if (ppsMapping!=IMG_NULL)
+							*ppsMapping = pBT->psMapping;
+
+						*base = pBT->base;
+
+						return IMG_TRUE;
+					}
+					else
+					{
+						PVR_DPF ((PVR_DBG_MESSAGE,
+								"AttemptAllocAligned: mismatch in flags. Import has %x, request was %x", pBT->psMapping->ui32Flags, uFlags));
+
+					}
+				}
+				pBT = pBT->pNextFree;
+			}
+
+		}
+		uIndex = _FreeTableNext (pArena, uIndex + 1);
+	}
+
+	return IMG_FALSE;
+}
+
+
+
+/*!
+******************************************************************************
+	@Function       _QCacheNewMagazine
+
+	@Description    Get an empty magazine for a quantum cache, reusing one
+                    from the depot if possible.
+
+	@Input          psCache - the quantum cache.
+
+	@Return         An empty magazine, or IMG_NULL on failure.
+******************************************************************************/
+static RA_MAGAZINE *
+_QCacheNewMagazine (RA_QCACHE *psCache)
+{
+	RA_MAGAZINE *psMag = psCache->psEmpty;
+
+	if (psMag != IMG_NULL)
+	{
+		psCache->psEmpty = psMag->psNext;
+	}
+	else if (OSAllocMem(PVRSRV_OS_PAGEABLE_HEAP,
+						sizeof(RA_MAGAZINE),
+						(IMG_VOID **)&psMag, IMG_NULL,
+						"RA Quantum Cache Magazine") != PVRSRV_OK)
+	{
+		return IMG_NULL;
+	}
+
+	psMag->psNext = IMG_NULL;
+	psMag->ui32Rounds = 0;
+
+	return psMag;
+}
+
+/*!
+******************************************************************************
+	@Function       _QCacheAlloc
+
+	@Description    Attempt to allocate a live segment from a quantum cache.
+
+	@Input          psCache - the quantum cache.
+	@Input          uFlags - allocation flags, which must match the mapping.
+	@Input          uAlignment - required alignment, or 0.
+	@Output         ppsMapping - the user reference of the segment.
+	@Output         base - the base of the segment.
+
+	@Return         IMG_TRUE on a cache hit, IMG_FALSE otherwise.
+******************************************************************************/
+static IMG_BOOL
+_QCacheAlloc (RA_QCACHE *psCache,
+			  IMG_UINT32 uFlags,
+			  IMG_UINT32 uAlignment,
+			  BM_MAPPING **ppsMapping,
+			  IMG_UINTPTR_T *base)
+{
+	RA_MAGAZINE *psMag;
+	BT *pBT;
+
+	if (psCache->psLoaded == IMG_NULL || psCache->psLoaded->ui32Rounds == 0)
+	{
+		if (psCache->psPrevious != IMG_NULL && psCache->psPrevious->ui32Rounds != 0)
+		{
+			/* exchange the empty loaded magazine with the previous one */
+			psMag = psCache->psLoaded;
+			psCache->psLoaded = psCache->psPrevious;
+			psCache->psPrevious = psMag;
+		}
+		else if (psCache->psFull != IMG_NULL)
+		{
+			/* return the empty previous magazine to the depot and load
+			   a full one from it */
+			if (psCache->psPrevious != IMG_NULL)
+			{
+				psCache->psPrevious->psNext = psCache->psEmpty;
+				psCache->psEmpty = psCache->psPrevious;
+			}
+			psCache->psPrevious = psCache->psLoaded;
+			psCache->psLoaded = psCache->psFull;
+			psCache->psFull = psCache->psLoaded->psNext;
+			psCache->psLoaded->psNext = IMG_NULL;
+			psCache->ui32FullCount--;
+		}
+		else
+		{
+			return IMG_FALSE;
+		}
+	}
+
+	psMag = psCache->psLoaded;
+	pBT = psMag->apsRound[psMag->ui32Rounds - 1];
+
+	if ((pBT->psMapping != IMG_NULL && pBT->psMapping->ui32Flags != uFlags)
+		|| (uAlignment > 1 && (pBT->base % uAlignment) != 0))
+	{
+		return IMG_FALSE;
+	}
+
+	psMag->ui32Rounds--;
+	pBT->bQCached = IMG_FALSE;
+
+	if (ppsMapping != IMG_NULL)
+		*ppsMapping = pBT->psMapping;
+
+	*base = pBT->base;
+
+	return IMG_TRUE;
+}
+
+/*!
+******************************************************************************
+	@Function       _QCacheFree
+
+	@Description    Attempt to place a live segment in a quantum cache.
+
+	@Input          psCache - the quantum cache.
+	@Input          pBT - the boundary tag of the segment.
+	@Input          bFreeBackingStore - passed on when the segment is
+                     eventually returned to the arena.
+
+	@Return         IMG_TRUE if the segment was cached, IMG_FALSE if it must
+                    be freed to the arena.
+******************************************************************************/
+static IMG_BOOL
+_QCacheFree (RA_QCACHE *psCache, BT *pBT, IMG_BOOL bFreeBackingStore)
+{
+	RA_MAGAZINE *psMag;
+
+	if (psCache->psLoaded == IMG_NULL)
+	{
+		psCache->psLoaded = _QCacheNewMagazine (psCache);
+		if (psCache->psLoaded == IMG_NULL)
+		{
+			return IMG_FALSE;
+		}
+	}
+
+	if (psCache->psLoaded->ui32Rounds == RA_QCACHE_MAGAZINE_SIZE)
+	{
+		if (psCache->psPrevious != IMG_NULL && psCache->psPrevious->ui32Rounds == 0)
+		{
+			/* exchange the full loaded magazine with the previous one */
+			psMag = psCache->psLoaded;
+			psCache->psLoaded = psCache->psPrevious;
+			psCache->psPrevious = psMag;
+		}
+		else
+		{
+			/* the depot bounds how much the cache holds on to */
+			if (psCache->psPrevious != IMG_NULL
+				&& psCache->ui32FullCount >= RA_QCACHE_DEPOT_LIMIT)
+			{
+				return IMG_FALSE;
+			}
+
+			psMag = _QCacheNewMagazine (psCache);
+			if (psMag == IMG_NULL)
+			{
+				return IMG_FALSE;
+			}
+
+			if (psCache->psPrevious != IMG_NULL)
+			{
+				psCache->psPrevious->psNext = psCache->psFull;
+				psCache->psFull = psCache->psPrevious;
+				psCache->ui32FullCount++;
+			}
+			psCache->psPrevious = psCache->psLoaded;
+			psCache->psLoaded = psMag;
+		}
+	}
+
+	psMag = psCache->psLoaded;
+	psMag->apsRound[psMag->ui32Rounds++] = pBT;
+	pBT->bQCached = IMG_TRUE;
+	pBT->bQCacheFreeBackingStore = bFreeBackingStore;
+
+	return IMG_TRUE;
+}
+
+/*!
+******************************************************************************
+	@Function       _QCacheFreeMagazine
+
+	@Description    Return every segment in a magazine to the arena and free
+                    the magazine.
+
+	@Input          pArena - the arena.
+	@Input          psMag - the magazine, or IMG_NULL.
+
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_QCacheFreeMagazine (RA_ARENA *pArena, RA_MAGAZINE *psMag)
+{
+	if (psMag == IMG_NULL)
+	{
+		return;
+	}
+
+	while (psMag->ui32Rounds != 0)
+	{
+		BT *pBT = psMag->apsRound[--psMag->ui32Rounds];
 
-						pBT->type = btt_live;
+		pBT->bQCached = IMG_FALSE;
+		HASH_Remove (pArena->pSegmentHash, pBT->base);
+		_FreeBT (pArena, pBT, pBT->bQCacheFreeBackingStore);
+	}
 
-#if defined(VALIDATE_ARENA_TEST)
-						if (pBT->eResourceType == IMPORTED_RESOURCE_TYPE)
-						{
-							pBT->eResourceSpan = IMPORTED_RESOURCE_SPAN_LIVE;
-						}
-						else if (pBT->eResourceType == NON_IMPORTED_RESOURCE_TYPE)
-						{
-							pBT->eResourceSpan = RESOURCE_SPAN_LIVE;
-						}
-						else
-						{
-							PVR_DPF ((PVR_DBG_ERROR,"_AttemptAllocAligned ERROR: pBT->eResourceType unrecognized"));
-							PVR_DBG_BREAK;
-						}
-#endif
-						if (!HASH_Insert (pArena->pSegmentHash, pBT->base, (IMG_UINTPTR_T) pBT))
-						{
-							_FreeBT (pArena, pBT, IMG_FALSE);
-							return IMG_FALSE;
-						}
+	OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(RA_MAGAZINE), psMag, IMG_NULL);
+}
 
-						if (ppsMapping!=IMG_NULL)
-							*ppsMapping = pBT->psMapping;
+/*!
+******************************************************************************
+	@Function       _QCachePurge
 
-						*base = pBT->base;
+	@Description    Return every segment held in the arena quantum caches to
+                    the arena, and free the magazines.
 
-						return IMG_TRUE;
-					}
-					else
-					{
-						PVR_DPF ((PVR_DBG_MESSAGE,
-								"AttemptAllocAligned: mismatch in flags. Import has %x, request was %x", pBT->psMapping->ui32Flags, uFlags));
+	@Input          pArena - the arena.
 
-					}
-				}
-				pBT = pBT->pNextFree;
-			}
+	@Return         None
+******************************************************************************/
+static IMG_VOID
+_QCachePurge (RA_ARENA *pArena)
+{
+	IMG_UINT32 ui32Class;
+
+	for (ui32Class = 0; ui32Class < pArena->ui32QCacheClasses; ui32Class++)
+	{
+		RA_QCACHE *psCache = &pArena->asQCache[ui32Class];
+		RA_MAGAZINE *psMag;
+
+		_QCacheFreeMagazine (pArena, psCache->psLoaded);
+		_QCacheFreeMagazine (pArena, psCache->psPrevious);
+		psCache->psLoaded = IMG_NULL;
+		psCache->psPrevious = IMG_NULL;
 
+		while (psCache->psFull != IMG_NULL)
+		{
+			psMag = psCache->psFull;
+			psCache->psFull = psMag->psNext;
+			_QCacheFreeMagazine (pArena, psMag);
 		}
-		uIndex++;
-	}
+		psCache->ui32FullCount = 0;
 
-	return IMG_FALSE;
+		while (psCache->psEmpty != IMG_NULL)
+		{
+			psMag = psCache->psEmpty;
+			psCache->psEmpty = psMag->psNext;
+			_QCacheFreeMagazine (pArena, psMag);
+		}
+	}
 }
 
 
-
 /*!
 ******************************************************************************
 	@Function       RA_Create
@@ -1124,6 +2238,8 @@ _AttemptAllocAligned (RA_ARENA *pArena,
 	@Input          base - the base of an initial resource span or 0.
 	@Input          uSize - the size of an initial resource span or 0.
 	@Input          uQuantum - the arena allocation quantum.
+	@Input          uQCacheMax - the largest allocation served from the
+                     quantum caches, or 0 for no quantum caching.
 	@Input          alloc - a resource allocation callback or 0.
 	@Input          free - a resource de-allocation callback or 0.
 	@Input          backingstore_free - a callback to free resources for spans or 0.
@@ -1137,6 +2253,7 @@ RA_Create (IMG_CHAR *name,
 		   IMG_SIZE_T uSize,
 		   BM_MAPPING *psMapping,
 		   IMG_SIZE_T uQuantum,
+		   IMG_SIZE_T uQCacheMax,
 		   IMG_BOOL (*imp_alloc)(IMG_VOID *, IMG_SIZE_T uSize, IMG_SIZE_T *pActualSize,
 								 BM_MAPPING **ppsMapping, IMG_UINT32 _flags,
 								 IMG_PVOID pvPrivData, IMG_UINT32 ui32PrivDataLength,
@@ -1153,6 +2270,16 @@ RA_Create (IMG_CHAR *name,
 			  "RA_Create: name='%s', base=0x" UINTPTR_FMT ", uSize=0x%" SIZE_T_FMT_LEN "x, alloc=0x%p, free=0x%p",
 			  name, base, uSize, imp_alloc, imp_free));
 
+	if (gui32ArenaCount == 0)
+	{
+		ghBTCache = OSCreateObjectCache("img-ra-bt", sizeof(BT));
+		if (ghBTCache == IMG_NULL)
+		{
+			PVR_DPF ((PVR_DBG_ERROR, "RA_Create: couldn't create boundary tag cache"));
+			goto cache_fail;
+		}
+	}
+	gui32ArenaCount++;
 
 	if (OSAllocMem(PVRSRV_OS_PAGEABLE_HEAP,
 					 sizeof (*pArena),
@@ -1167,11 +2294,32 @@ RA_Create (IMG_CHAR *name,
 	pArena->pImportFree = imp_free;
 	pArena->pBackingStoreFree = backingstore_free;
 	pArena->pImportHandle = pImportHandle;
-	for (i=0; i<FREE_TABLE_LIMIT; i++)
+	for (i=0; i<FREE_TABLE_SIZE; i++)
 		pArena->aHeadFree[i] = IMG_NULL;
+	for (i=0; i<FREE_BITMAP_WORDS; i++)
+		pArena->aui32FreeBitmap[i] = 0;
 	pArena->pHeadSegment = IMG_NULL;
 	pArena->pTailSegment = IMG_NULL;
+	pArena->pIndexRoot = IMG_NULL;
+	pArena->ui32IndexSeed = 0x2545F491;
 	pArena->uQuantum = uQuantum;
+	pArena->pBTReserve = IMG_NULL;
+	pArena->ui32BTReserveCount = 0;
+	pArena->pRetainedHead = IMG_NULL;
+	pArena->pRetainedTail = IMG_NULL;
+	pArena->uRetainedBytes = 0;
+	pArena->uRetainMaxBytes = 0;
+	pArena->ui32RetainMaxAgeus = 0;
+
+	pArena->ui32QCacheClasses = (uQuantum != 0) ? (IMG_UINT32)MIN(uQCacheMax / uQuantum, RA_QCACHE_MAX_CLASSES) : 0;
+	for (i=0; i<RA_QCACHE_MAX_CLASSES; i++)
+	{
+		pArena->asQCache[i].psLoaded = IMG_NULL;
+		pArena->asQCache[i].psPrevious = IMG_NULL;
+		pArena->asQCache[i].psFull = IMG_NULL;
+		pArena->asQCache[i].psEmpty = IMG_NULL;
+		pArena->asQCache[i].ui32FullCount = 0;
+	}
 
 #ifdef RA_STATS
 	pArena->sStatistics.uSpanCount = 0;
@@ -1183,6 +2331,19 @@ RA_Create (IMG_CHAR *name,
 	pArena->sStatistics.uCumulativeFrees = 0;
 	pArena->sStatistics.uImportCount = 0;
 	pArena->sStatistics.uExportCount = 0;
+	pArena->sStatistics.uQCacheHits = 0;
+	pArena->sStatistics.uQCacheMisses = 0;
+	pArena->sStatistics.uBTAllocCount = 0;
+	pArena->sStatistics.uBTCacheAllocCount = 0;
+	pArena->sStatistics.uRetainedSpanCount = 0;
+	pArena->sStatistics.uImportsAvoided = 0;
+	for (i=0; i<RA_FREE_EXTENT_CLASSES; i++)
+		pArena->sStatistics.auFreeExtentCount[i] = 0;
+	pArena->ui32ChurnWindowStart = OSClockus();
+	pArena->uChurnWindowImports = 0;
+	pArena->uChurnWindowExports = 0;
+	pArena->uImportRate = 0;
+	pArena->uExportRate = 0;
 #endif
 
 #if defined(CONFIG_PROC_FS) && defined(DEBUG)
@@ -1230,7 +2391,7 @@ RA_Create (IMG_CHAR *name,
 	}
 #endif /* defined(CONFIG_PROC_FS) && defined(DEBUG) */
 
-	pArena->pSegmentHash = HASH_Create (MINIMUM_HASH_SIZE);
+	pArena->pSegmentHash = HASH_Create (pArena->name, MINIMUM_HASH_SIZE);
 	if (pArena->pSegmentHash==IMG_NULL)
 	{
 		goto hash_fail;
@@ -1246,14 +2407,31 @@ RA_Create (IMG_CHAR *name,
 		pBT->psMapping = psMapping;
 
 	}
+
+	pArena->pNextArena = gpsArenaList;
+	gpsArenaList = pArena;
+
+#if defined(PVRSRV_ALLOC_TRACE)
+	pArena->ui32TraceID = gui32NextArenaTraceID++;
+#endif
+	PVR_ALLOC_TRACE(RA_CREATE, pArena->ui32TraceID, base, uSize, (IMG_UINT32)uQuantum,
+					(imp_alloc != IMG_NULL) ? RA_TRACE_FLAG_IMPORT : 0, IMG_TRUE);
+
 	return pArena;
 
 insert_fail:
+	_DrainBTReserve (pArena);
 	HASH_Delete (pArena->pSegmentHash);
 hash_fail:
 	OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(RA_ARENA), pArena, IMG_NULL);
 	/*not nulling pointer, out of scope*/
 arena_fail:
+	if (--gui32ArenaCount == 0)
+	{
+		OSDestroyObjectCache(ghBTCache);
+		ghBTCache = IMG_NULL;
+	}
+cache_fail:
 	return IMG_NULL;
 }
 
@@ -1272,6 +2450,7 @@ IMG_VOID
 RA_Delete (RA_ARENA *pArena)
 {
 	IMG_UINT32 uIndex;
+	RA_ARENA **ppArena;
 
 	PVR_ASSERT(pArena != IMG_NULL);
 
@@ -1284,8 +2463,24 @@ RA_Delete (RA_ARENA *pArena)
 	PVR_DPF ((PVR_DBG_MESSAGE,
 			  "RA_Delete: name='%s'", pArena->name));
 
-	for (uIndex=0; uIndex<FREE_TABLE_LIMIT; uIndex++)
+	PVR_ALLOC_TRACE(RA_DELETE, pArena->ui32TraceID, 0, 0, 0, 0, IMG_TRUE);
+
+	for (ppArena = &gpsArenaList; *ppArena != IMG_NULL; ppArena = &(*ppArena)->pNextArena)
+	{
+		if (*ppArena == pArena)
+		{
+			*ppArena = pArena->pNextArena;
+			break;
+		}
+	}
+
+	_QCachePurge (pArena);
+	_RetainedRelease (pArena, ~(IMG_SIZE_T)0);
+
+	for (uIndex=0; uIndex<FREE_TABLE_SIZE; uIndex++)
 		pArena->aHeadFree[uIndex] = IMG_NULL;
+	for (uIndex=0; uIndex<FREE_BITMAP_WORDS; uIndex++)
+		pArena->aui32FreeBitmap[uIndex] = 0;
 
 	while (pArena->pHeadSegment != IMG_NULL)
 	{
@@ -1299,7 +2494,7 @@ RA_Delete (RA_ARENA *pArena)
 		}
 
 		_SegmentListRemove (pArena, pBT);
-		OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(BT), pBT, IMG_NULL);
+		_ReleaseBT (pArena, pBT);
 		/*not nulling original pointer, it has changed*/
 #ifdef RA_STATS
 		pArena->sStatistics.uSpanCount--;
@@ -1323,8 +2518,15 @@ RA_Delete (RA_ARENA *pArena)
 	}
 #endif
 	HASH_Delete (pArena->pSegmentHash);
+	_DrainBTReserve (pArena);
 	OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(RA_ARENA), pArena, IMG_NULL);
 	/*not nulling pointer, copy on stack*/
+
+	if (--gui32ArenaCount == 0)
+	{
+		OSDestroyObjectCache(ghBTCache);
+		ghBTCache = IMG_NULL;
+	}
 }
 
 /*!
@@ -1345,6 +2547,11 @@ RA_TestDelete (RA_ARENA *pArena)
 
 	if (pArena != IMG_NULL)
 	{
+		/* segments held by the quantum caches and retained spans are
+		   not leaks */
+		_QCachePurge (pArena);
+		_RetainedRelease (pArena, ~(IMG_SIZE_T)0);
+
 		while (pArena->pHeadSegment != IMG_NULL)
 		{
 			BT *pBT = pArena->pHeadSegment;
@@ -1377,6 +2584,8 @@ RA_TestDelete (RA_ARENA *pArena)
 IMG_BOOL
 RA_Add (RA_ARENA *pArena, IMG_UINTPTR_T base, IMG_SIZE_T uSize)
 {
+	IMG_BOOL bResult;
+
 	PVR_ASSERT (pArena != IMG_NULL);
 
 	if (pArena == IMG_NULL)
@@ -1389,7 +2598,11 @@ RA_Add (RA_ARENA *pArena, IMG_UINTPTR_T base, IMG_SIZE_T uSize)
 			  "RA_Add: name='%s', base=0x" UINTPTR_FMT ", size=0x%" SIZE_T_FMT_LEN "x", pArena->name, base, uSize));
 
 	uSize = (uSize + pArena->uQuantum - 1) / pArena->uQuantum * pArena->uQuantum;
-	return ((IMG_BOOL)(_InsertResource (pArena, base, uSize) != IMG_NULL));
+	bResult = (IMG_BOOL)(_InsertResource (pArena, base, uSize) != IMG_NULL);
+
+	PVR_ALLOC_TRACE(RA_ADD, pArena->ui32TraceID, base, uSize, 0, 0, bResult);
+
+	return bResult;
 }
 
 /*!
@@ -1446,11 +2659,55 @@ RA_Alloc (RA_ARENA *pArena,
 	CheckBMFreespace();
 #endif
 
+	/* small allocations without special placement are rounded up to
+	   their quantum cache size class and served from the cache if
+	   possible */
+	if (uSize != 0
+		&& uSize <= pArena->ui32QCacheClasses * pArena->uQuantum
+		&& uAlignment <= pArena->uQuantum
+		&& uAlignmentOffset == 0
+		&& pvPrivData == IMG_NULL)
+	{
+		IMG_SIZE_T uClass = (uSize + pArena->uQuantum - 1) / pArena->uQuantum;
+
+		uSize = uClass * pArena->uQuantum;
+
+		if (_QCacheAlloc (&pArena->asQCache[uClass - 1], uFlags, uAlignment, ppsMapping, base))
+		{
+			if (pActualSize != IMG_NULL)
+			{
+				*pActualSize = uSize;
+			}
+#if defined PVRSRV_DEVMEM_TIME_STATS
+			if (ppsMapping)
+			{
+				(*ppsMapping)->ui32TimeToDevMap = 0;
+			}
+#endif
+#ifdef RA_STATS
+			pArena->sStatistics.uQCacheHits++;
+			pArena->sStatistics.uCumulativeAllocs++;
+#endif
+			PVR_ALLOC_TRACE(RA_ALLOC, pArena->ui32TraceID, *base, uRequestSize,
+							uAlignment, uFlags, IMG_TRUE);
+			return IMG_TRUE;
+		}
+#ifdef RA_STATS
+		pArena->sStatistics.uQCacheMisses++;
+#endif
+	}
+
 	if (pActualSize != IMG_NULL)
 	{
 		*pActualSize = uSize;
 	}
 
+	/* allocate any boundary tags the splits below may need up front */
+	_FillBTReserve (pArena);
+
+	/* let spans retained for too long go */
+	_RetainedRelease (pArena, 0);
+
 	PVR_DPF ((PVR_DBG_MESSAGE,
 			  "RA_Alloc: arena='%s', size=0x%" SIZE_T_FMT_LEN "x(0x%" SIZE_T_FMT_LEN "x), alignment=0x%x, offset=0x%x",
 		   pArena->name, uSize, uRequestSize, uAlignment, uAlignmentOffset));
@@ -1498,6 +2755,8 @@ RA_Alloc (RA_ARENA *pArena,
 						  "RA_Alloc: name='%s', size=0x%" SIZE_T_FMT_LEN "x failed!",
 						  pArena->name, uSize));
 				/* RA_Dump (arena); */
+				PVR_ALLOC_TRACE(RA_ALLOC, pArena->ui32TraceID, 0, uRequestSize,
+								uAlignment, uFlags, IMG_FALSE);
 				return IMG_FALSE;
 			}
 			pBT->psMapping = psImportMapping;
@@ -1505,6 +2764,7 @@ RA_Alloc (RA_ARENA *pArena,
 			pArena->sStatistics.uFreeSegmentCount++;
 			pArena->sStatistics.uFreeResourceCount += uImportSize;
 			pArena->sStatistics.uImportCount++;
+			_ChurnUpdate (pArena);
 			pArena->sStatistics.uSpanCount++;
 #endif
 			bResult = _AttemptAllocAligned(pArena, uSize, ppsMapping, uFlags,
@@ -1517,6 +2777,15 @@ RA_Alloc (RA_ARENA *pArena,
 						  pArena->name));
 			}
 		}
+
+		if (!bResult && pArena->ui32QCacheClasses != 0)
+		{
+			/* give the segments held by the quantum caches back to the
+			   arena and try once more */
+			_QCachePurge (pArena);
+			bResult = _AttemptAllocAligned (pArena, uSize, ppsMapping, uFlags,
+											uAlignment, uAlignmentOffset, base);
+		}
 	}
 #if defined PVRSRV_DEVMEM_TIME_STATS
 	else
@@ -1540,6 +2809,9 @@ RA_Alloc (RA_ARENA *pArena,
 			  "RA_Alloc: name='%s', size=0x%" SIZE_T_FMT_LEN "x, *base=0x" UINTPTR_FMT " = %d",
 			  pArena->name, uSize, *base, bResult));
 
+	PVR_ALLOC_TRACE(RA_ALLOC, pArena->ui32TraceID, bResult ? *base : 0, uRequestSize,
+					uAlignment, uFlags, bResult);
+
 	/*  RA_Dump (pArena);
 		ra_stats (pArena);
 	*/
@@ -1570,8 +2842,53 @@ RA_Alloc (RA_ARENA *pArena,
 IMG_UINT32 ValidateArena(RA_ARENA *pArena)
 {
 	BT* pSegment;
+	BT* pIndex;
 	RESOURCE_DESCRIPTOR eNextSpan;
 
+	/* The in-order walk of the address index must visit the boundary tags
+	in segment list order, and every node must satisfy the heap property. */
+	pIndex = pArena->pIndexRoot;
+	while (pIndex != IMG_NULL && pIndex->pIndexLeft != IMG_NULL)
+	{
+		pIndex = pIndex->pIndexLeft;
+	}
+
+	for (pSegment = pArena->pHeadSegment; pSegment != IMG_NULL; pSegment = pSegment->pNextSegment)
+	{
+		if (pIndex != pSegment
+			|| (pIndex->pIndexParent != IMG_NULL
+				&& pIndex->pIndexParent->ui32IndexPriority < pIndex->ui32IndexPriority))
+		{
+			PVR_DPF((PVR_DBG_ERROR,
+					"ValidateArena ERROR: address index inconsistent at boundary tag %d (base=0x" UINTPTR_FMT
+					") (arena: %s)",
+					pSegment->ui32BoundaryTagID,
+					pSegment->base,
+					pArena->name));
+
+			PVR_DBG_BREAK;
+			break;
+		}
+
+		/* step to the in-order successor */
+		if (pIndex->pIndexRight != IMG_NULL)
+		{
+			pIndex = pIndex->pIndexRight;
+			while (pIndex->pIndexLeft != IMG_NULL)
+			{
+				pIndex = pIndex->pIndexLeft;
+			}
+		}
+		else
+		{
+			while (pIndex->pIndexParent != IMG_NULL && pIndex->pIndexParent->pIndexRight == pIndex)
+			{
+				pIndex = pIndex->pIndexParent;
+			}
+			pIndex = pIndex->pIndexParent;
+		}
+	}
+
 	pSegment = pArena->pHeadSegment;
 
 	if (pSegment == IMG_NULL)
@@ -1794,6 +3111,42 @@ RA_Free (RA_ARENA *pArena, IMG_UINTPTR_T base, IMG_BOOL bFreeBackingStore)
 	PVR_DPF ((PVR_DBG_MESSAGE,
 			  "RA_Free: name='%s', base=0x" UINTPTR_FMT, pArena->name, base));
 
+	PVR_ALLOC_TRACE(RA_FREE, pArena->ui32TraceID, base, 0, 0, bFreeBackingStore, IMG_TRUE);
+
+	if (pArena->ui32QCacheClasses != 0)
+	{
+		pBT = (BT *) HASH_Retrieve (pArena->pSegmentHash, base);
+
+		if (pBT != IMG_NULL && pBT->bQCached)
+		{
+			PVR_DPF ((PVR_DBG_ERROR, "RA_Free: segment base=0x" UINTPTR_FMT " freed twice", base));
+			PVR_ASSERT (!pBT->bQCached);
+			return;
+		}
+
+		/* segments which would coalesce with a free neighbour are
+		   returned to the arena, so the caches never pin fragments */
+		if (pBT != IMG_NULL
+			&& pBT->uSize != 0
+			&& (pBT->uSize % pArena->uQuantum) == 0
+			&& pBT->uSize <= pArena->ui32QCacheClasses * pArena->uQuantum
+			&& (pBT->pPrevSegment == IMG_NULL || pBT->pPrevSegment->type != btt_free)
+			&& (pBT->pNextSegment == IMG_NULL || pBT->pNextSegment->type != btt_free))
+		{
+			if (_QCacheFree (&pArena->asQCache[(pBT->uSize / pArena->uQuantum) - 1], pBT, bFreeBackingStore))
+			{
+#ifdef RA_STATS
+				pArena->sStatistics.uCumulativeFrees++;
+				pArena->sStatistics.uQCacheHits++;
+#endif
+				return;
+			}
+#ifdef RA_STATS
+			pArena->sStatistics.uQCacheMisses++;
+#endif
+		}
+	}
+
 	pBT = (BT *) HASH_Remove (pArena->pSegmentHash, base);
 	PVR_ASSERT (pBT != IMG_NULL);
 
@@ -1836,6 +3189,80 @@ RA_Free (RA_ARENA *pArena, IMG_UINTPTR_T base, IMG_BOOL bFreeBackingStore)
 	}
 }
 
+/*!
+******************************************************************************
+	@Function       RA_SetSpanRetention
+
+	@Description    Keep completely free import spans in the arena for a
+                    while instead of returning them to the import source
+                    immediately.
+
+	@Input          pArena - the arena.
+	@Input          uMaxBytes - most bytes of spans to retain, 0 disables
+                     retention.
+	@Input          ui32MaxAgems - longest time in ms a span may be retained.
+
+	@Return         None
+******************************************************************************/
+IMG_VOID
+RA_SetSpanRetention (RA_ARENA *pArena, IMG_SIZE_T uMaxBytes, IMG_UINT32 ui32MaxAgems)
+{
+	PVR_ASSERT (pArena != IMG_NULL);
+
+	if (pArena == IMG_NULL)
+	{
+		PVR_DPF ((PVR_DBG_ERROR,"RA_SetSpanRetention: invalid parameter - pArena"));
+		return;
+	}
+
+	pArena->uRetainMaxBytes = uMaxBytes;
+	pArena->ui32RetainMaxAgeus = ui32MaxAgems * 1000;
+
+	_RetainedRelease (pArena, 0);
+}
+
+/*!
+******************************************************************************
+	@Function       RA_GetRetainedBytes
+
+	@Description    Total size of the spans retained by all arenas. May be
+                    called without the arenas being locked, in which case
+                    the result is approximate.
+
+	@Return         Number of bytes
+******************************************************************************/
+IMG_SIZE_T
+RA_GetRetainedBytes (IMG_VOID)
+{
+	return guRetainedBytes;
+}
+
+/*!
+******************************************************************************
+	@Function       RA_Reclaim
+
+	@Description    Return retained spans, oldest first, and the contents of
+                    the quantum caches of all arenas to their import sources.
+
+	@Input          uBytes - number of bytes of retained spans to release.
+
+	@Return         Number of bytes of retained spans released
+******************************************************************************/
+IMG_SIZE_T
+RA_Reclaim (IMG_SIZE_T uBytes)
+{
+	RA_ARENA *pArena;
+	IMG_SIZE_T uReleased = 0;
+
+	for (pArena = gpsArenaList; pArena != IMG_NULL && uReleased < uBytes; pArena = pArena->pNextArena)
+	{
+		_QCachePurge (pArena);
+		uReleased += _RetainedRelease (pArena, uBytes - uReleased);
+	}
+
+	return uReleased;
+}
+
 
 /*!
 ******************************************************************************
@@ -2026,6 +3453,57 @@ static void RA_ProcSeqShowInfo(struct seq_file *sfile, void* el)
 	case 10:
 		seq_printf(sfile, "export count\t\t%" SIZE_T_FMT_LEN "u\n", pArena->sStatistics.uExportCount);
 		break;
+	case 11:
+		seq_printf(sfile, "qcache hits\t\t%" SIZE_T_FMT_LEN "u\n", pArena->sStatistics.uQCacheHits);
+		break;
+	case 12:
+		seq_printf(sfile, "qcache misses\t\t%" SIZE_T_FMT_LEN "u\n", pArena->sStatistics.uQCacheMisses);
+		break;
+	case 13:
+		seq_printf(sfile, "bt requests\t\t%" SIZE_T_FMT_LEN "u\n", pArena->sStatistics.uBTAllocCount);
+		break;
+	case 14:
+		seq_printf(sfile, "bt cache allocs\t\t%" SIZE_T_FMT_LEN "u\n", pArena->sStatistics.uBTCacheAllocCount);
+		break;
+	case 15:
+	{
+		IMG_SIZE_T uLargest = _LargestFreeExtent (pArena);
+
+		seq_printf(sfile, "largest free extent\t%" SIZE_T_FMT_LEN "u (0x%" SIZE_T_FMT_LEN "x)\n", uLargest, uLargest);
+		seq_printf(sfile, "fragmentation\t\t%u%%\n", _FragmentationPercent (pArena, uLargest));
+		break;
+	}
+	case 16:
+	{
+		IMG_SIZE_T uImportRate, uExportRate;
+
+		_ChurnGet (pArena, &uImportRate, &uExportRate);
+		seq_printf(sfile, "imports per minute\t%" SIZE_T_FMT_LEN "u\n", uImportRate);
+		seq_printf(sfile, "exports per minute\t%" SIZE_T_FMT_LEN "u\n", uExportRate);
+		break;
+	}
+	case 17:
+	{
+		IMG_UINT32 i;
+
+		seq_printf(sfile, "free extents by size:\n");
+		for (i = 0; i < RA_FREE_EXTENT_CLASSES; i++)
+		{
+			if (pArena->sStatistics.auFreeExtentCount[i] != 0)
+			{
+				seq_printf(sfile, "  >= 2^%u\t\t%" SIZE_T_FMT_LEN "u\n", i, pArena->sStatistics.auFreeExtentCount[i]);
+			}
+		}
+		break;
+	}
+	case 18:
+		seq_printf(sfile, "retained spans\t\t%" SIZE_T_FMT_LEN "u (0x%" SIZE_T_FMT_LEN "x)\n",
+							pArena->sStatistics.uRetainedSpanCount,
+							pArena->uRetainedBytes);
+		break;
+	case 19:
+		seq_printf(sfile, "imports avoided\t\t%" SIZE_T_FMT_LEN "u\n", pArena->sStatistics.uImportsAvoided);
+		break;
 #endif
 	}
 
@@ -2034,7 +3512,7 @@ static void RA_ProcSeqShowInfo(struct seq_file *sfile, void* el)
 static void* RA_ProcSeqOff2ElementInfo(struct seq_file * sfile, loff_t off)
 {
 #ifdef RA_STATS
-	if(off <= 9)
+	if(off <= 18)
 #else
 	if(off <= 1)
 #endif
@@ -2097,6 +3575,9 @@ PVRSRV_ERROR RA_GetStats(RA_ARENA *pArena,
 	IMG_UINT32 	ui32StrLen = *pui32StrLen;
 	IMG_INT32	i32Count;
 	BT 			*pBT;
+	IMG_SIZE_T	uLargest;
+	IMG_SIZE_T	uImportRate, uExportRate;
+	IMG_UINT32	i;
 
 	CHECK_SPACE(ui32StrLen);
 	i32Count = OSSNPrintf(pszStr, 100, "\nArena '%s':\n", pArena->name);
@@ -2152,6 +3633,72 @@ PVRSRV_ERROR RA_GetStats(RA_ARENA *pArena,
                             pArena->sStatistics.uExportCount);
 	UPDATE_SPACE(pszStr, i32Count, ui32StrLen);
 
+	CHECK_SPACE(ui32StrLen);
+	i32Count = OSSNPrintf(pszStr, 100, "qcache hits\t\t%" SIZE_T_FMT_LEN "u\n",
+                            pArena->sStatistics.uQCacheHits);
+	UPDATE_SPACE(pszStr, i32Count, ui32StrLen);
+
+	CHECK_SPACE(ui32StrLen);
+	i32Count = OSSNPrintf(pszStr, 100, "qcache misses\t\t%" SIZE_T_FMT_LEN "u\n",
+                            pArena->sStatistics.uQCacheMisses);
+	UPDATE_SPACE(pszStr, i32Count, ui32StrLen);
+
+	CHECK_SPACE(ui32StrLen);
+	i32Count = OSSNPrintf(pszStr, 100, "bt requests\t\t%" SIZE_T_FMT_LEN "u\n",
+                            pArena->sStatistics.uBTAllocCount);
+	UPDATE_SPACE(pszStr, i32Count, ui32StrLen);
+
+	CHECK_SPACE(ui32StrLen);
+	i32Count = OSSNPrintf(pszStr, 100, "bt cache allocs\t\t%" SIZE_T_FMT_LEN "u\n",
+                            pArena->sStatistics.uBTCacheAllocCount);
+	UPDATE_SPACE(pszStr, i32Count, ui32StrLen);
+
+	uLargest = _LargestFreeExtent (pArena);
+
+	CHECK_SPACE(ui32StrLen);
+	i32Count = OSSNPrintf(pszStr, 100, "largest free extent\t%" SIZE_T_FMT_LEN "u\n", uLargest);
+	UPDATE_SPACE(pszStr, i32Count, ui32StrLen);
+
+	CHECK_SPACE(ui32StrLen);
+	i32Count = OSSNPrintf(pszStr, 100, "fragmentation\t\t%u%%\n",
+                            _FragmentationPercent (pArena, uLargest));
+	UPDATE_SPACE(pszStr, i32Count, ui32StrLen);
+
+	_ChurnGet (pArena, &uImportRate, &uExportRate);
+
+	CHECK_SPACE(ui32StrLen);
+	i32Count = OSSNPrintf(pszStr, 100, "imports per minute\t%" SIZE_T_FMT_LEN "u\n", uImportRate);
+	UPDATE_SPACE(pszStr, i32Count, ui32StrLen);
+
+	CHECK_SPACE(ui32StrLen);
+	i32Count = OSSNPrintf(pszStr, 100, "exports per minute\t%" SIZE_T_FMT_LEN "u\n", uExportRate);
+	UPDATE_SPACE(pszStr, i32Count, ui32StrLen);
+
+	CHECK_SPACE(ui32StrLen);
+	i32Count = OSSNPrintf(pszStr, 100, "retained spans\t\t%" SIZE_T_FMT_LEN "u (0x%" SIZE_T_FMT_LEN "x)\n",
+                            pArena->sStatistics.uRetainedSpanCount, pArena->uRetainedBytes);
+	UPDATE_SPACE(pszStr, i32Count, ui32StrLen);
+
+	CHECK_SPACE(ui32StrLen);
+	i32Count = OSSNPrintf(pszStr, 100, "imports avoided\t\t%" SIZE_T_FMT_LEN "u\n",
+                            pArena->sStatistics.uImportsAvoided);
+	UPDATE_SPACE(pszStr, i32Count, ui32StrLen);
+
+	CHECK_SPACE(ui32StrLen);
+	i32Count = OSSNPrintf(pszStr, 100, "  free extents by size:\n");
+	UPDATE_SPACE(pszStr, i32Count, ui32StrLen);
+
+	for (i = 0; i < RA_FREE_EXTENT_CLASSES; i++)
+	{
+		if (pArena->sStatistics.auFreeExtentCount[i] != 0)
+		{
+			CHECK_SPACE(ui32StrLen);
+			i32Count = OSSNPrintf(pszStr, 100, "\t>= 2^%u\t%" SIZE_T_FMT_LEN "u\n",
+                                    i, pArena->sStatistics.auFreeExtentCount[i]);
+			UPDATE_SPACE(pszStr, i32Count, ui32StrLen);
+		}
+	}
+
 	CHECK_SPACE(ui32StrLen);
 	i32Count = OSSNPrintf(pszStr, 100, "  segment Chain:\n");
 	UPDATE_SPACE(pszStr, i32Count, ui32StrLen);
@@ -284,7 +284,7 @@ PVRSRV_ERROR PVRSRVTimeTraceBufferDestroy(IMG_UINT32 ui32PID)
 ******************************************************************************/
 PVRSRV_ERROR PVRSRVTimeTraceInit(IMG_VOID)
 {
-	g_psBufferTable = HASH_Create(TIME_TRACE_HASH_TABLE_SIZE);
+	g_psBufferTable = HASH_Create("time trace buffers", TIME_TRACE_HASH_TABLE_SIZE);
 
 	/* Create hash table to store the per process buffers in */
 	if (!g_psBufferTable)
@@ -3046,6 +3046,7 @@ MMU_Create (MMU_CONTEXT *psMMUContext,
 									psDevArena->ui32Size,
 									IMG_NULL,
 									MIN(HOST_PAGESIZE(), pMMUHeap->ui32DataPageSize),
+									0,
 									IMG_NULL,
 									IMG_NULL,
 									&MMU_FreePageTables,
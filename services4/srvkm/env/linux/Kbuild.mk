@@ -113,6 +113,16 @@ p$(PVRSRV_MODNAME)-y += \
 	services4/srvkm/common/ttrace.o
 endif
 
+ifeq ($(PVRSRV_ALLOC_TRACE),1)
+$(PVRSRV_MODNAME)-y += \
+	services4/srvkm/env/linux/alloc_trace.o
+endif
+
+ifeq ($(PVRSRV_BRIDGE_CAPTURE),1)
+$(PVRSRV_MODNAME)-y += \
+	services4/srvkm/env/linux/bridge_capture.o
+endif
+
 ifeq ($(SUPPORT_PVRSRV_ANDROID_SYSTRACE),1)
 p$(PVRSRV_MODNAME)-y += \
 	services4/srvkm/env/linux/systrace.o
@@ -131,6 +141,8 @@ CFLAGS_mm.o := -Werror
 CFLAGS_mutex.o := -Werror
 CFLAGS_event.o := -Werror
 CFLAGS_osperproc.o := -Werror
+CFLAGS_alloc_trace.o := -Werror
+CFLAGS_bridge_capture.o := -Werror
 CFLAGS_buffer_manager.o := -Werror
 CFLAGS_devicemem.o := -Werror
 CFLAGS_deviceclass.o := -Werror
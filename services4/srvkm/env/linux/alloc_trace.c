@@ -0,0 +1,322 @@
+/*************************************************************************/ /*!
+@Title          Linux allocator trace recorder
+@Copyright      Copyright (c) Imagination Technologies Ltd. All Rights Reserved
+@Description    Ring buffer backing the RA/BM allocation trace, drained as
+                binary records through debugfs.
+@License        Dual MIT/GPLv2
+
+The contents of this file are subject to the MIT license as set out below.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public License Version 2 ("GPL") in which case the provisions
+of GPL are applicable instead of those above.
+
+If you wish to allow use of your version of this file only under the terms of
+GPL, and not to allow others to use your version of this file under the terms
+of the MIT license, indicate your decision by deleting the provisions above
+and replace them with the notice and other provisions required by GPL as set
+out in the file called "GPL-COPYING" included in this distribution. If you do
+not delete the provisions above, a recipient may use your version of this file
+under the terms of either the MIT license or GPL.
+
+This License is also included in this distribution in the file called
+"MIT-COPYING".
+
+EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/ /**************************************************************************/
+
+#include <linux/version.h>
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/debugfs.h>
+#include <linux/spinlock.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+
+#include "services_headers.h"
+#include "alloc_trace.h"
+#include "pvr_uaccess.h"
+
+/* Number of records held by the ring; must be a power of 2 */
+#if !defined(PVRSRV_ALLOC_TRACE_RECORDS)
+#define PVRSRV_ALLOC_TRACE_RECORDS	65536
+#endif
+
+/* Records copied out per spinlock hold when draining */
+#define ALLOC_TRACE_READ_CHUNK		8
+
+/*
+	PVRSRVAllocTraceInit starts recording at load so the arenas created
+	during device initialisation are part of the capture. Once the ring fills new
+	records are dropped (and counted) rather than overwriting old ones,
+	since a replay cannot cope with losing an arena's creation.
+*/
+IMG_BOOL gbPVRSRVAllocTraceEnabled = IMG_FALSE;
+
+static DEFINE_SPINLOCK(gsAllocTraceLock);
+static PVRSRV_ALLOC_TRACE_RECORD *gpsAllocTraceRing;
+static IMG_UINT32 gui32AllocTraceHead;
+static IMG_UINT32 gui32AllocTraceTail;
+static IMG_UINT32 gui32AllocTraceLost;
+
+static struct dentry *gpsAllocTraceDir;
+
+#define ALLOC_TRACE_COUNT()	(gui32AllocTraceHead - gui32AllocTraceTail)
+#define ALLOC_TRACE_SLOT(i)	(&gpsAllocTraceRing[(i) & (PVRSRV_ALLOC_TRACE_RECORDS - 1)])
+
+/*!
+******************************************************************************
+ @Function	PVRSRVAllocTraceRecord
+
+ @Description	Append one record to the trace ring. Called through
+				PVR_ALLOC_TRACE() only once the recorder is enabled.
+
+ @Input		ui16Type - PVRSRV_ALLOC_TRACE_* record type
+ @Input		ui32ID - arena trace ID or BM heap ID
+ @Input		ui64Base - base of the allocation
+ @Input		ui64Size - size of the allocation
+ @Input		ui32Alignment - requested alignment
+ @Input		ui32Flags - allocation flags
+ @Input		bResult - whether the operation succeeded
+
+ @Return	None
+******************************************************************************/
+IMG_VOID PVRSRVAllocTraceRecord(IMG_UINT16 ui16Type,
+								IMG_UINT32 ui32ID,
+								IMG_UINT64 ui64Base,
+								IMG_UINT64 ui64Size,
+								IMG_UINT32 ui32Alignment,
+								IMG_UINT32 ui32Flags,
+								IMG_BOOL bResult)
+{
+	PVRSRV_ALLOC_TRACE_RECORD *psRecord;
+	IMG_UINT64 ui64Timens = (IMG_UINT64)ktime_to_ns(ktime_get());
+	unsigned long ulFlags;
+
+	spin_lock_irqsave(&gsAllocTraceLock, ulFlags);
+
+	if (gpsAllocTraceRing == IMG_NULL)
+	{
+		goto exit_unlock;
+	}
+
+	/* Keep one slot back for the marker telling the reader about the gap */
+	if (gui32AllocTraceLost != 0)
+	{
+		if (ALLOC_TRACE_COUNT() >= PVRSRV_ALLOC_TRACE_RECORDS - 1)
+		{
+			gui32AllocTraceLost++;
+			goto exit_unlock;
+		}
+
+		psRecord = ALLOC_TRACE_SLOT(gui32AllocTraceHead++);
+		OSMemSet(psRecord, 0, sizeof(*psRecord));
+		psRecord->ui64Timens = ui64Timens;
+		psRecord->ui64Size = gui32AllocTraceLost;
+		psRecord->ui16Type = PVRSRV_ALLOC_TRACE_LOST;
+		gui32AllocTraceLost = 0;
+	}
+	else if (ALLOC_TRACE_COUNT() >= PVRSRV_ALLOC_TRACE_RECORDS - 1)
+	{
+		gui32AllocTraceLost++;
+		goto exit_unlock;
+	}
+
+	psRecord = ALLOC_TRACE_SLOT(gui32AllocTraceHead++);
+	psRecord->ui64Timens = ui64Timens;
+	psRecord->ui64Base = ui64Base;
+	psRecord->ui64Size = ui64Size;
+	psRecord->ui32ID = ui32ID;
+	psRecord->ui32Flags = ui32Flags;
+	psRecord->ui32Alignment = ui32Alignment;
+	psRecord->ui16Type = ui16Type;
+	psRecord->ui16Result = bResult ? 1 : 0;
+
+exit_unlock:
+	spin_unlock_irqrestore(&gsAllocTraceLock, ulFlags);
+}
+
+/*
+	Reads consume whole records from the ring; a short buffer returns
+	as many whole records as fit.
+*/
+static ssize_t AllocTraceRead(struct file *psFile, char __user *pszBuffer,
+							  size_t uCount, loff_t *puiPos)
+{
+	PVRSRV_ALLOC_TRACE_RECORD asChunk[ALLOC_TRACE_READ_CHUNK];
+	size_t uCopied = 0;
+
+	PVR_UNREFERENCED_PARAMETER(psFile);
+	PVR_UNREFERENCED_PARAMETER(puiPos);
+
+	while (uCount - uCopied >= sizeof(PVRSRV_ALLOC_TRACE_RECORD))
+	{
+		IMG_UINT32 ui32Wanted = (IMG_UINT32)((uCount - uCopied) / sizeof(PVRSRV_ALLOC_TRACE_RECORD));
+		IMG_UINT32 ui32Taken = 0;
+		unsigned long ulFlags;
+
+		if (ui32Wanted > ALLOC_TRACE_READ_CHUNK)
+		{
+			ui32Wanted = ALLOC_TRACE_READ_CHUNK;
+		}
+
+		spin_lock_irqsave(&gsAllocTraceLock, ulFlags);
+		while (ui32Taken < ui32Wanted && ALLOC_TRACE_COUNT() != 0)
+		{
+			asChunk[ui32Taken++] = *ALLOC_TRACE_SLOT(gui32AllocTraceTail++);
+		}
+		spin_unlock_irqrestore(&gsAllocTraceLock, ulFlags);
+
+		if (ui32Taken == 0)
+		{
+			break;
+		}
+
+		/*
+			A fault here loses the records taken in this chunk; the
+			capture is already unusable at that point.
+		*/
+		if (pvr_copy_to_user(pszBuffer + uCopied, asChunk,
+							 ui32Taken * sizeof(PVRSRV_ALLOC_TRACE_RECORD)) != 0)
+		{
+			return uCopied ? (ssize_t)uCopied : -EFAULT;
+		}
+		uCopied += ui32Taken * sizeof(PVRSRV_ALLOC_TRACE_RECORD);
+	}
+
+	return (ssize_t)uCopied;
+}
+
+/*
+	"1" enables recording, "0" disables it. Records already in the ring
+	are kept either way.
+*/
+static ssize_t AllocTraceWrite(struct file *psFile, const char __user *pszBuffer,
+							   size_t uCount, loff_t *puiPos)
+{
+	IMG_CHAR cValue;
+
+	PVR_UNREFERENCED_PARAMETER(psFile);
+	PVR_UNREFERENCED_PARAMETER(puiPos);
+
+	if (uCount == 0)
+	{
+		return 0;
+	}
+
+	if (pvr_copy_from_user(&cValue, pszBuffer, 1) != 0)
+	{
+		return -EFAULT;
+	}
+
+	switch (cValue)
+	{
+		case '0':
+			gbPVRSRVAllocTraceEnabled = IMG_FALSE;
+			break;
+		case '1':
+			gbPVRSRVAllocTraceEnabled = IMG_TRUE;
+			break;
+		default:
+			return -EINVAL;
+	}
+
+	return (ssize_t)uCount;
+}
+
+static const struct file_operations gsAllocTraceFops =
+{
+	.owner	= THIS_MODULE,
+	.open	= nonseekable_open,
+	.read	= AllocTraceRead,
+	.write	= AllocTraceWrite,
+};
+
+/*!
+******************************************************************************
+ @Function	PVRSRVAllocTraceInit
+
+ @Description	Allocate the trace ring, create
+				<debugfs>/PVRSRV_MODNAME/alloc_trace and start recording.
+
+ @Return	PVRSRV_ERROR
+******************************************************************************/
+PVRSRV_ERROR PVRSRVAllocTraceInit(IMG_VOID)
+{
+	PVRSRV_ALLOC_TRACE_RECORD *psRing;
+	unsigned long ulFlags;
+
+	psRing = vmalloc(PVRSRV_ALLOC_TRACE_RECORDS * sizeof(PVRSRV_ALLOC_TRACE_RECORD));
+	if (psRing == IMG_NULL)
+	{
+		PVR_DPF((PVR_DBG_ERROR, "PVRSRVAllocTraceInit: failed to allocate trace ring"));
+		return PVRSRV_ERROR_OUT_OF_MEMORY;
+	}
+
+	spin_lock_irqsave(&gsAllocTraceLock, ulFlags);
+	gpsAllocTraceRing = psRing;
+	gui32AllocTraceHead = 0;
+	gui32AllocTraceTail = 0;
+	gui32AllocTraceLost = 0;
+	spin_unlock_irqrestore(&gsAllocTraceLock, ulFlags);
+
+	/* Without debugfs the ring can still be inspected from a crash dump */
+	gpsAllocTraceDir = debugfs_create_dir(PVRSRV_MODNAME, IMG_NULL);
+	if (!IS_ERR_OR_NULL(gpsAllocTraceDir))
+	{
+		debugfs_create_file("alloc_trace", S_IRUSR | S_IWUSR,
+							gpsAllocTraceDir, IMG_NULL, &gsAllocTraceFops);
+	}
+
+	gbPVRSRVAllocTraceEnabled = IMG_TRUE;
+
+	return PVRSRV_OK;
+}
+
+/*!
+******************************************************************************
+ @Function	PVRSRVAllocTraceDeInit
+
+ @Description	Stop recording, remove the debugfs file and free the ring.
+
+ @Return	None
+******************************************************************************/
+IMG_VOID PVRSRVAllocTraceDeInit(IMG_VOID)
+{
+	PVRSRV_ALLOC_TRACE_RECORD *psRing;
+	unsigned long ulFlags;
+
+	gbPVRSRVAllocTraceEnabled = IMG_FALSE;
+
+	if (!IS_ERR_OR_NULL(gpsAllocTraceDir))
+	{
+		debugfs_remove_recursive(gpsAllocTraceDir);
+	}
+	gpsAllocTraceDir = IMG_NULL;
+
+	spin_lock_irqsave(&gsAllocTraceLock, ulFlags);
+	psRing = gpsAllocTraceRing;
+	gpsAllocTraceRing = IMG_NULL;
+	spin_unlock_irqrestore(&gsAllocTraceLock, ulFlags);
+
+	if (psRing != IMG_NULL)
+	{
+		vfree(psRing);
+	}
+}
@@ -0,0 +1,760 @@
+/*************************************************************************/ /*!
+@Title          Linux bridge call capture
+@Copyright      Copyright (c) Imagination Technologies Ltd. All Rights Reserved
+@Description    Records every bridge call, with its handles renamed to
+                symbols, into a ring drained as binary records through
+                debugfs.
+@License        Dual MIT/GPLv2
+
+The contents of this file are subject to the MIT license as set out below.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public License Version 2 ("GPL") in which case the provisions
+of GPL are applicable instead of those above.
+
+If you wish to allow use of your version of this file only under the terms of
+GPL, and not to allow others to use your version of this file under the terms
+of the MIT license, indicate your decision by deleting the provisions above
+and replace them with the notice and other provisions required by GPL as set
+out in the file called "GPL-COPYING" included in this distribution. If you do
+not delete the provisions above, a recipient may use your version of this file
+under the terms of either the MIT license or GPL.
+
+This License is also included in this distribution in the file called
+"MIT-COPYING".
+
+EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/ /**************************************************************************/
+
+#include <linux/version.h>
+#include <linux/module.h>
+#include <linux/fs.h>
+#include <linux/debugfs.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/list.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+
+#include "services_headers.h"
+#include "pvr_bridge.h"
+#if defined(SUPPORT_VGX)
+#include "vgx_bridge.h"
+#endif
+#if defined(SUPPORT_SGX)
+#include "sgx_bridge.h"
+#endif
+#include "bridged_pvr_bridge.h"
+#include "env_data.h"
+#include "hash.h"
+#include "bridge_capture.h"
+#include "pvr_uaccess.h"
+
+/* Bytes held by the ring; must be a power of 2 */
+#if !defined(PVRSRV_BRIDGE_CAPTURE_BYTES)
+#define PVRSRV_BRIDGE_CAPTURE_BYTES		(8 * 1024 * 1024)
+#endif
+
+/* Records are padded to a multiple of this */
+#define BRIDGE_CAPTURE_ALIGN			8
+#define BRIDGE_CAPTURE_ROUND(x)			(((x) + BRIDGE_CAPTURE_ALIGN - 1) & ~(BRIDGE_CAPTURE_ALIGN - 1))
+
+/* A handle reported by the handle manager during a call */
+typedef struct _BRIDGE_CAPTURE_USE_
+{
+	IMG_VOID	*psBase;
+	IMG_HANDLE	hHandle;
+	IMG_HANDLE	*phHandle;
+	IMG_UINT32	ui32Use;
+} BRIDGE_CAPTURE_USE;
+
+/* A call being captured */
+typedef struct _BRIDGE_CAPTURE_CALL_
+{
+	struct list_head	sNode;				/* on gsBridgeCaptureCalls */
+	struct task_struct	*psTask;			/* thread making the call */
+	IMG_UINT8			*pui8BridgeIn;
+	IMG_UINT8			*pui8BridgeOut;
+	IMG_UINT32			ui32NumUses;
+	IMG_BOOL			bUsesLost;
+	BRIDGE_CAPTURE_USE	asUses[PVRSRV_BRIDGE_CAPTURE_MAX_HANDLES];
+
+	PVRSRV_BRIDGE_CAPTURE_RECORD	sRecord;
+	PVRSRV_BRIDGE_CAPTURE_HANDLE	asHandles[PVRSRV_BRIDGE_CAPTURE_MAX_HANDLES];
+	IMG_UINT8			aui8In[PVRSRV_BRIDGE_CAPTURE_MAX_IN];
+} BRIDGE_CAPTURE_CALL;
+
+/* A handle is only unique within its base */
+typedef struct _BRIDGE_CAPTURE_KEY_
+{
+	IMG_UINTPTR_T	uiBase;
+	IMG_UINTPTR_T	uiHandle;
+} BRIDGE_CAPTURE_KEY;
+
+/*
+	Nothing is recorded until "1" is written to the capture file: a
+	capture is of one application's run, and has to start before the
+	application connects so that the calls giving it its handles are
+	part of it.
+*/
+IMG_BOOL gbPVRSRVBridgeCaptureEnabled = IMG_FALSE;
+
+/* Calls being captured, for PVRSRVBridgeCaptureHandle to find its caller's */
+static DEFINE_SPINLOCK(gsBridgeCaptureCallsLock);
+static LIST_HEAD(gsBridgeCaptureCalls);
+
+/*
+	Held while a finished call's handles are given symbols and its
+	record is written, so records reach the ring in the order their
+	symbols were bound.
+*/
+static DEFINE_MUTEX(gsBridgeCaptureLock);
+static HASH_TABLE *gpsBridgeCaptureSymbols;
+static IMG_UINT32 gui32BridgeCaptureNextSymbol;
+
+static DEFINE_SPINLOCK(gsBridgeCaptureRingLock);
+static IMG_UINT8 *gpui8BridgeCaptureRing;
+static IMG_UINT32 gui32BridgeCaptureHead;
+static IMG_UINT32 gui32BridgeCaptureTail;
+static IMG_UINT32 gui32BridgeCaptureLost;
+
+/* Readers take a record out of the ring into here before copying it out */
+static DEFINE_MUTEX(gsBridgeCaptureReadLock);
+static IMG_UINT64 gaui64BridgeCaptureReadBuffer[PVRSRV_BRIDGE_CAPTURE_MAX_RECORD / sizeof(IMG_UINT64)];
+
+static struct dentry *gpsBridgeCaptureFile;
+
+#define BRIDGE_CAPTURE_USED()	(gui32BridgeCaptureHead - gui32BridgeCaptureTail)
+#define BRIDGE_CAPTURE_FREE()	(PVRSRV_BRIDGE_CAPTURE_BYTES - BRIDGE_CAPTURE_USED())
+
+static IMG_VOID BridgeCaptureRingWrite(IMG_UINT32 ui32Pos, const IMG_VOID *pvData, IMG_UINT32 ui32Bytes)
+{
+	IMG_UINT32 ui32Offset = ui32Pos & (PVRSRV_BRIDGE_CAPTURE_BYTES - 1);
+	IMG_UINT32 ui32First = MIN(ui32Bytes, PVRSRV_BRIDGE_CAPTURE_BYTES - ui32Offset);
+
+	if (ui32Bytes == 0)
+	{
+		return;
+	}
+
+	OSMemCopy(gpui8BridgeCaptureRing + ui32Offset, (IMG_VOID *)pvData, ui32First);
+	if (ui32First != ui32Bytes)
+	{
+		OSMemCopy(gpui8BridgeCaptureRing, (IMG_UINT8 *)pvData + ui32First, ui32Bytes - ui32First);
+	}
+}
+
+static IMG_VOID BridgeCaptureRingRead(IMG_UINT32 ui32Pos, IMG_VOID *pvData, IMG_UINT32 ui32Bytes)
+{
+	IMG_UINT32 ui32Offset = ui32Pos & (PVRSRV_BRIDGE_CAPTURE_BYTES - 1);
+	IMG_UINT32 ui32First = MIN(ui32Bytes, PVRSRV_BRIDGE_CAPTURE_BYTES - ui32Offset);
+
+	OSMemCopy(pvData, gpui8BridgeCaptureRing + ui32Offset, ui32First);
+	if (ui32First != ui32Bytes)
+	{
+		OSMemCopy((IMG_UINT8 *)pvData + ui32First, gpui8BridgeCaptureRing, ui32Bytes - ui32First);
+	}
+}
+
+/*
+	Write a record, followed by its handle entries and input, to the
+	ring. Once the ring fills records are dropped (and counted) rather
+	than overwriting old ones, since a replay can't do without the call
+	that bound a symbol.
+*/
+static IMG_VOID BridgeCaptureAppend(PVRSRV_BRIDGE_CAPTURE_RECORD *psRecord,
+									const PVRSRV_BRIDGE_CAPTURE_HANDLE *psHandles,
+									const IMG_UINT8 *pui8In)
+{
+	static const IMG_UINT8 aui8Pad[BRIDGE_CAPTURE_ALIGN];
+	IMG_UINT32 ui32Needed = psRecord->ui32Size;
+	IMG_UINT32 ui32Pos;
+
+	spin_lock(&gsBridgeCaptureRingLock);
+
+	if (gpui8BridgeCaptureRing == IMG_NULL)
+	{
+		goto exit_unlock;
+	}
+
+	/* Room is needed for the marker telling the reader about the gap too */
+	if (gui32BridgeCaptureLost != 0)
+	{
+		ui32Needed += sizeof(PVRSRV_BRIDGE_CAPTURE_RECORD);
+	}
+
+	if (BRIDGE_CAPTURE_FREE() < ui32Needed)
+	{
+		gui32BridgeCaptureLost++;
+		goto exit_unlock;
+	}
+
+	if (gui32BridgeCaptureLost != 0)
+	{
+		PVRSRV_BRIDGE_CAPTURE_RECORD sLost;
+
+		OSMemSet(&sLost, 0, sizeof(sLost));
+		sLost.ui64Timens = psRecord->ui64Timens;
+		sLost.ui32Size = sizeof(sLost);
+		sLost.ui16Type = PVRSRV_BRIDGE_CAPTURE_LOST;
+		sLost.ui32BridgeID = gui32BridgeCaptureLost;
+
+		BridgeCaptureRingWrite(gui32BridgeCaptureHead, &sLost, sizeof(sLost));
+		gui32BridgeCaptureHead += sizeof(sLost);
+		gui32BridgeCaptureLost = 0;
+	}
+
+	ui32Pos = gui32BridgeCaptureHead;
+	BridgeCaptureRingWrite(ui32Pos, psRecord, sizeof(*psRecord));
+	ui32Pos += sizeof(*psRecord);
+	BridgeCaptureRingWrite(ui32Pos, psHandles, psRecord->ui32NumHandles * sizeof(*psHandles));
+	ui32Pos += psRecord->ui32NumHandles * sizeof(*psHandles);
+	BridgeCaptureRingWrite(ui32Pos, pui8In, psRecord->ui32InBufferSize);
+	ui32Pos += psRecord->ui32InBufferSize;
+	BridgeCaptureRingWrite(ui32Pos, aui8Pad, gui32BridgeCaptureHead + psRecord->ui32Size - ui32Pos);
+
+	gui32BridgeCaptureHead += psRecord->ui32Size;
+
+exit_unlock:
+	spin_unlock(&gsBridgeCaptureRingLock);
+}
+
+/*
+	The symbol naming a handle. A newly allocated handle always gets a
+	new symbol, as its value may have been used before; a released one
+	loses its symbol once this call has been recorded.
+*/
+static IMG_UINT32 BridgeCaptureSymbol(BRIDGE_CAPTURE_USE *psUse)
+{
+	BRIDGE_CAPTURE_KEY sKey;
+	IMG_UINT32 ui32Symbol;
+
+	sKey.uiBase = (IMG_UINTPTR_T)psUse->psBase;
+	sKey.uiHandle = (IMG_UINTPTR_T)psUse->hHandle;
+
+	ui32Symbol = (IMG_UINT32)HASH_Retrieve_Extended(gpsBridgeCaptureSymbols, &sKey);
+
+	if (ui32Symbol != 0 && psUse->ui32Use == BRIDGE_CAPTURE_HANDLE_NEW)
+	{
+		HASH_Remove_Extended(gpsBridgeCaptureSymbols, &sKey);
+		ui32Symbol = 0;
+	}
+
+	if (ui32Symbol == 0)
+	{
+		ui32Symbol = gui32BridgeCaptureNextSymbol++;
+
+		if (psUse->ui32Use != BRIDGE_CAPTURE_HANDLE_RELEASE &&
+			!HASH_Insert_Extended(gpsBridgeCaptureSymbols, &sKey, ui32Symbol))
+		{
+			/* Later calls will see the handle as one they never got */
+			PVR_DPF((PVR_DBG_WARNING, "BridgeCaptureSymbol: Couldn't remember symbol %u", ui32Symbol));
+		}
+	}
+	else if (psUse->ui32Use == BRIDGE_CAPTURE_HANDLE_RELEASE)
+	{
+		HASH_Remove_Extended(gpsBridgeCaptureSymbols, &sKey);
+	}
+
+	return ui32Symbol;
+}
+
+static IMG_VOID BridgeCaptureAddHandle(BRIDGE_CAPTURE_CALL *psCall,
+									   IMG_UINT32 ui32Symbol,
+									   IMG_UINT32 ui32Offset,
+									   IMG_UINT16 ui16Flags)
+{
+	PVRSRV_BRIDGE_CAPTURE_RECORD *psRecord = &psCall->sRecord;
+	PVRSRV_BRIDGE_CAPTURE_HANDLE *psHandle;
+	IMG_UINT32 i;
+
+	/* The same handle may be looked up more than once */
+	for (i = 0; i < psRecord->ui32NumHandles; i++)
+	{
+		if (psCall->asHandles[i].ui16Offset == ui32Offset &&
+			psCall->asHandles[i].ui16Flags == ui16Flags)
+		{
+			return;
+		}
+	}
+
+	if (psRecord->ui32NumHandles == PVRSRV_BRIDGE_CAPTURE_MAX_HANDLES)
+	{
+		psRecord->ui16Flags |= PVRSRV_BRIDGE_CAPTURE_FLAG_HANDLES_LOST;
+		return;
+	}
+
+	psHandle = &psCall->asHandles[psRecord->ui32NumHandles++];
+	psHandle->ui32Symbol = ui32Symbol;
+	psHandle->ui16Offset = (IMG_UINT16)ui32Offset;
+	psHandle->ui16Flags = ui16Flags;
+}
+
+/*
+	Find where a handle the call used is in its input or output. When
+	the handle manager was given its address that says; otherwise every
+	IMG_HANDLE aligned word holding its value is taken to be it. The
+	input searched is the copy taken before the call, as wrappers
+	replace input handles with what they look up.
+*/
+static IMG_VOID BridgeCaptureLocate(BRIDGE_CAPTURE_CALL *psCall, BRIDGE_CAPTURE_USE *psUse)
+{
+	IMG_BOOL bOut = (psUse->ui32Use == BRIDGE_CAPTURE_HANDLE_NEW ||
+					 psUse->ui32Use == BRIDGE_CAPTURE_HANDLE_FOUND);
+	IMG_UINT16 ui16Flags = bOut ? PVRSRV_BRIDGE_CAPTURE_HANDLE_OUT : 0;
+	IMG_UINT8 *pui8Live = bOut ? psCall->pui8BridgeOut : psCall->pui8BridgeIn;
+	IMG_UINT8 *pui8Search = bOut ? psCall->pui8BridgeOut : psCall->aui8In;
+	IMG_UINT32 ui32Size = bOut ? psCall->sRecord.ui32OutBufferSize : psCall->sRecord.ui32InBufferSize;
+	IMG_UINT32 ui32Symbol = BridgeCaptureSymbol(psUse);
+	IMG_UINT32 ui32Offset;
+
+	if (psUse->phHandle != IMG_NULL)
+	{
+		IMG_UINTPTR_T uiAddr = (IMG_UINTPTR_T)psUse->phHandle;
+
+		if (uiAddr >= (IMG_UINTPTR_T)pui8Live &&
+			uiAddr - (IMG_UINTPTR_T)pui8Live + sizeof(IMG_HANDLE) <= ui32Size)
+		{
+			BridgeCaptureAddHandle(psCall, ui32Symbol,
+								   (IMG_UINT32)(uiAddr - (IMG_UINTPTR_T)pui8Live), ui16Flags);
+			return;
+		}
+	}
+
+	for (ui32Offset = 0; ui32Offset + sizeof(IMG_HANDLE) <= ui32Size; ui32Offset += sizeof(IMG_HANDLE))
+	{
+		IMG_HANDLE hValue;
+
+		OSMemCopy(&hValue, pui8Search + ui32Offset, sizeof(hValue));
+		if (hValue == psUse->hHandle)
+		{
+			BridgeCaptureAddHandle(psCall, ui32Symbol, ui32Offset, ui16Flags);
+		}
+	}
+}
+
+/*!
+******************************************************************************
+ @Function	PVRSRVBridgeCaptureBegin
+
+ @Description	Start capturing a bridge call. Called by BridgedCallKM,
+				once the capture is enabled, before the call is made.
+
+ @Input		ui32PID - process the call is made for
+ @Input		ui32BridgeID - dispatch table index of the call
+ @Input		psBridgeIn - the call's input structure
+ @Input		ui32InBufferSize - bytes of input the caller gave
+ @Input		psBridgeOut - the call's output structure
+ @Input		ui32OutBufferSize - bytes of output the caller wants
+
+ @Return	Context to pass to PVRSRVBridgeCaptureEnd, or IMG_NULL
+******************************************************************************/
+IMG_VOID *PVRSRVBridgeCaptureBegin(IMG_UINT32 ui32PID,
+								   IMG_UINT32 ui32BridgeID,
+								   IMG_VOID *psBridgeIn,
+								   IMG_UINT32 ui32InBufferSize,
+								   IMG_VOID *psBridgeOut,
+								   IMG_UINT32 ui32OutBufferSize)
+{
+	BRIDGE_CAPTURE_CALL *psCall;
+
+	psCall = kmalloc(sizeof(*psCall), GFP_KERNEL);
+	if (psCall == IMG_NULL)
+	{
+		spin_lock(&gsBridgeCaptureRingLock);
+		gui32BridgeCaptureLost++;
+		spin_unlock(&gsBridgeCaptureRingLock);
+		return IMG_NULL;
+	}
+
+	OSMemSet(&psCall->sRecord, 0, sizeof(psCall->sRecord));
+	psCall->sRecord.ui16Type = PVRSRV_BRIDGE_CAPTURE_CALL;
+	psCall->sRecord.ui32PID = ui32PID;
+	psCall->sRecord.ui32BridgeID = ui32BridgeID;
+	psCall->sRecord.ui32InBufferSize = MIN(ui32InBufferSize, PVRSRV_BRIDGE_CAPTURE_MAX_IN);
+	psCall->sRecord.ui32OutBufferSize = MIN(ui32OutBufferSize, PVRSRV_MAX_BRIDGE_OUT_SIZE);
+
+	psCall->psTask = current;
+	psCall->pui8BridgeIn = psBridgeIn;
+	psCall->pui8BridgeOut = psBridgeOut;
+	psCall->ui32NumUses = 0;
+	psCall->bUsesLost = IMG_FALSE;
+
+	OSMemCopy(psCall->aui8In, psBridgeIn, psCall->sRecord.ui32InBufferSize);
+
+	spin_lock(&gsBridgeCaptureCallsLock);
+	list_add(&psCall->sNode, &gsBridgeCaptureCalls);
+	spin_unlock(&gsBridgeCaptureCallsLock);
+
+	psCall->sRecord.ui64Timens = (IMG_UINT64)ktime_to_ns(ktime_get());
+
+	return psCall;
+}
+
+/*!
+******************************************************************************
+ @Function	PVRSRVBridgeCaptureHandle
+
+ @Description	Note a handle used by the bridge call the current thread
+				is making, if it is being captured. Called through
+				PVR_BRIDGE_CAPTURE_HANDLE() by the handle manager.
+
+ @Input		psBase - handle base the handle belongs to
+ @Input		hHandle - the handle
+ @Input		phHandle - where the handle is held, or IMG_NULL
+ @Input		ui32Use - BRIDGE_CAPTURE_HANDLE_*
+
+ @Return	None
+******************************************************************************/
+IMG_VOID PVRSRVBridgeCaptureHandle(IMG_VOID *psBase,
+								   IMG_HANDLE hHandle,
+								   IMG_HANDLE *phHandle,
+								   IMG_UINT32 ui32Use)
+{
+	BRIDGE_CAPTURE_CALL *psCall;
+
+	spin_lock(&gsBridgeCaptureCallsLock);
+
+	list_for_each_entry(psCall, &gsBridgeCaptureCalls, sNode)
+	{
+		if (psCall->psTask == current)
+		{
+			if (psCall->ui32NumUses < PVRSRV_BRIDGE_CAPTURE_MAX_HANDLES)
+			{
+				BRIDGE_CAPTURE_USE *psUse = &psCall->asUses[psCall->ui32NumUses++];
+
+				psUse->psBase = psBase;
+				psUse->hHandle = hHandle;
+				psUse->phHandle = phHandle;
+				psUse->ui32Use = ui32Use;
+			}
+			else
+			{
+				psCall->bUsesLost = IMG_TRUE;
+			}
+			break;
+		}
+	}
+
+	spin_unlock(&gsBridgeCaptureCallsLock);
+}
+
+/*!
+******************************************************************************
+ @Function	PVRSRVBridgeCaptureEnd
+
+ @Description	Finish capturing a bridge call: rename the handles it used
+				to symbols and write its record to the ring.
+
+ @Input		pvCapture - context from PVRSRVBridgeCaptureBegin
+ @Input		iResult - what the call returned
+
+ @Return	None
+******************************************************************************/
+IMG_VOID PVRSRVBridgeCaptureEnd(IMG_VOID *pvCapture, IMG_INT iResult)
+{
+	BRIDGE_CAPTURE_CALL *psCall = (BRIDGE_CAPTURE_CALL *)pvCapture;
+	PVRSRV_BRIDGE_CAPTURE_RECORD *psRecord = &psCall->sRecord;
+	IMG_UINT32 i;
+
+	psRecord->ui64Durationns = (IMG_UINT64)ktime_to_ns(ktime_get()) - psRecord->ui64Timens;
+	psRecord->i32Result = iResult;
+	if (psRecord->ui32OutBufferSize >= sizeof(IMG_UINT32))
+	{
+		OSMemCopy(&psRecord->ui32Error, psCall->pui8BridgeOut, sizeof(IMG_UINT32));
+	}
+
+	spin_lock(&gsBridgeCaptureCallsLock);
+	list_del(&psCall->sNode);
+	spin_unlock(&gsBridgeCaptureCallsLock);
+
+	mutex_lock(&gsBridgeCaptureLock);
+
+	if (gpsBridgeCaptureSymbols != IMG_NULL)
+	{
+		if (psCall->bUsesLost)
+		{
+			psRecord->ui16Flags |= PVRSRV_BRIDGE_CAPTURE_FLAG_HANDLES_LOST;
+		}
+
+		for (i = 0; i < psCall->ui32NumUses; i++)
+		{
+			BridgeCaptureLocate(psCall, &psCall->asUses[i]);
+		}
+
+		/* Only now, so a symbol can't be mistaken for a handle's value */
+		for (i = 0; i < psRecord->ui32NumHandles; i++)
+		{
+			if ((psCall->asHandles[i].ui16Flags & PVRSRV_BRIDGE_CAPTURE_HANDLE_OUT) == 0)
+			{
+				IMG_HANDLE hSymbol = (IMG_HANDLE)(IMG_UINTPTR_T)psCall->asHandles[i].ui32Symbol;
+
+				OSMemCopy(psCall->aui8In + psCall->asHandles[i].ui16Offset, &hSymbol, sizeof(hSymbol));
+			}
+		}
+
+		psRecord->ui32Size = sizeof(*psRecord) +
+							 psRecord->ui32NumHandles * sizeof(PVRSRV_BRIDGE_CAPTURE_HANDLE) +
+							 BRIDGE_CAPTURE_ROUND(psRecord->ui32InBufferSize);
+
+		BridgeCaptureAppend(psRecord, psCall->asHandles, psCall->aui8In);
+	}
+
+	mutex_unlock(&gsBridgeCaptureLock);
+
+	kfree(psCall);
+}
+
+/* Forget what an earlier capture named, drop anything it left unread and start recording */
+static PVRSRV_ERROR BridgeCaptureStart(IMG_VOID)
+{
+	PVRSRV_BRIDGE_CAPTURE_RECORD sStart;
+	HASH_TABLE *psSymbols;
+
+	psSymbols = HASH_Create_Extended("bridge capture symbols", 256,
+									 sizeof(BRIDGE_CAPTURE_KEY),
+									 &HASH_Func_Default, &HASH_Key_Comp_Default,
+									 HASH_CREATE_CHAINED);
+	if (psSymbols == IMG_NULL)
+	{
+		return PVRSRV_ERROR_OUT_OF_MEMORY;
+	}
+
+	mutex_lock(&gsBridgeCaptureLock);
+
+	if (gpsBridgeCaptureSymbols != IMG_NULL)
+	{
+		HASH_Discard(gpsBridgeCaptureSymbols);
+	}
+	gpsBridgeCaptureSymbols = psSymbols;
+	gui32BridgeCaptureNextSymbol = 1;
+
+	spin_lock(&gsBridgeCaptureRingLock);
+	gui32BridgeCaptureHead = 0;
+	gui32BridgeCaptureTail = 0;
+	gui32BridgeCaptureLost = 0;
+	spin_unlock(&gsBridgeCaptureRingLock);
+
+	OSMemSet(&sStart, 0, sizeof(sStart));
+	sStart.ui64Timens = (IMG_UINT64)ktime_to_ns(ktime_get());
+	sStart.ui32Size = sizeof(sStart);
+	sStart.ui16Type = PVRSRV_BRIDGE_CAPTURE_START;
+	sStart.ui32BridgeID = PVRSRV_BRIDGE_CAPTURE_VERSION;
+	sStart.ui32OutBufferSize = BRIDGE_DISPATCH_TABLE_ENTRY_COUNT;
+	sStart.ui32Error = sizeof(IMG_HANDLE);
+	BridgeCaptureAppend(&sStart, IMG_NULL, IMG_NULL);
+
+	gbPVRSRVBridgeCaptureEnabled = IMG_TRUE;
+
+	mutex_unlock(&gsBridgeCaptureLock);
+
+	return PVRSRV_OK;
+}
+
+/*
+	Reads consume whole records from the ring, so must be given room
+	for the largest; a short buffer returns as many whole records as
+	fit.
+*/
+static ssize_t BridgeCaptureRead(struct file *psFile, char __user *pszBuffer,
+								 size_t uCount, loff_t *puiPos)
+{
+	PVRSRV_BRIDGE_CAPTURE_RECORD *psRecord = (PVRSRV_BRIDGE_CAPTURE_RECORD *)gaui64BridgeCaptureReadBuffer;
+	size_t uCopied = 0;
+
+	PVR_UNREFERENCED_PARAMETER(psFile);
+	PVR_UNREFERENCED_PARAMETER(puiPos);
+
+	if (uCount < PVRSRV_BRIDGE_CAPTURE_MAX_RECORD)
+	{
+		return -EINVAL;
+	}
+
+	mutex_lock(&gsBridgeCaptureReadLock);
+
+	for (;;)
+	{
+		IMG_UINT32 ui32Size;
+
+		spin_lock(&gsBridgeCaptureRingLock);
+
+		if (BRIDGE_CAPTURE_USED() == 0)
+		{
+			spin_unlock(&gsBridgeCaptureRingLock);
+			break;
+		}
+
+		BridgeCaptureRingRead(gui32BridgeCaptureTail, psRecord, sizeof(*psRecord));
+		ui32Size = psRecord->ui32Size;
+		if (ui32Size > uCount - uCopied)
+		{
+			spin_unlock(&gsBridgeCaptureRingLock);
+			break;
+		}
+
+		BridgeCaptureRingRead(gui32BridgeCaptureTail, psRecord, ui32Size);
+		gui32BridgeCaptureTail += ui32Size;
+
+		spin_unlock(&gsBridgeCaptureRingLock);
+
+		/*
+			A fault here loses the record; the capture is already
+			unusable at that point.
+		*/
+		if (pvr_copy_to_user(pszBuffer + uCopied, psRecord, ui32Size) != 0)
+		{
+			mutex_unlock(&gsBridgeCaptureReadLock);
+			return uCopied ? (ssize_t)uCopied : -EFAULT;
+		}
+		uCopied += ui32Size;
+	}
+
+	mutex_unlock(&gsBridgeCaptureReadLock);
+
+	return (ssize_t)uCopied;
+}
+
+/*
+	"1" starts a new capture, "0" stops recording. Records already in
+	the ring are kept until read or a new capture starts.
+*/
+static ssize_t BridgeCaptureWrite(struct file *psFile, const char __user *pszBuffer,
+								  size_t uCount, loff_t *puiPos)
+{
+	IMG_CHAR cValue;
+
+	PVR_UNREFERENCED_PARAMETER(psFile);
+	PVR_UNREFERENCED_PARAMETER(puiPos);
+
+	if (uCount == 0)
+	{
+		return 0;
+	}
+
+	if (pvr_copy_from_user(&cValue, pszBuffer, 1) != 0)
+	{
+		return -EFAULT;
+	}
+
+	switch (cValue)
+	{
+		case '0':
+			gbPVRSRVBridgeCaptureEnabled = IMG_FALSE;
+			break;
+		case '1':
+			if (BridgeCaptureStart() != PVRSRV_OK)
+			{
+				return -ENOMEM;
+			}
+			break;
+		default:
+			return -EINVAL;
+	}
+
+	return (ssize_t)uCount;
+}
+
+static const struct file_operations gsBridgeCaptureFops =
+{
+	.owner	= THIS_MODULE,
+	.open	= nonseekable_open,
+	.read	= BridgeCaptureRead,
+	.write	= BridgeCaptureWrite,
+};
+
+/*!
+******************************************************************************
+ @Function	PVRSRVBridgeCaptureInit
+
+ @Description	Allocate the capture ring and create
+				<debugfs>/PVRSRV_MODNAME_bridge_capture. Recording starts
+				when "1" is written to it.
+
+ @Return	PVRSRV_ERROR
+******************************************************************************/
+PVRSRV_ERROR PVRSRVBridgeCaptureInit(IMG_VOID)
+{
+	IMG_UINT8 *pui8Ring;
+
+	pui8Ring = vmalloc(PVRSRV_BRIDGE_CAPTURE_BYTES);
+	if (pui8Ring == IMG_NULL)
+	{
+		PVR_DPF((PVR_DBG_ERROR, "PVRSRVBridgeCaptureInit: failed to allocate capture ring"));
+		return PVRSRV_ERROR_OUT_OF_MEMORY;
+	}
+
+	spin_lock(&gsBridgeCaptureRingLock);
+	gpui8BridgeCaptureRing = pui8Ring;
+	gui32BridgeCaptureHead = 0;
+	gui32BridgeCaptureTail = 0;
+	gui32BridgeCaptureLost = 0;
+	spin_unlock(&gsBridgeCaptureRingLock);
+
+	/*
+		Not in <debugfs>/PVRSRV_MODNAME, which belongs to the allocation
+		trace and is removed with everything in it.
+	*/
+	gpsBridgeCaptureFile = debugfs_create_file(PVRSRV_MODNAME "_bridge_capture",
+											   S_IRUSR | S_IWUSR, IMG_NULL,
+											   IMG_NULL, &gsBridgeCaptureFops);
+
+	return PVRSRV_OK;
+}
+
+/*!
+******************************************************************************
+ @Function	PVRSRVBridgeCaptureDeInit
+
+ @Description	Stop recording, remove the debugfs file and free the ring
+				and symbols.
+
+ @Return	None
+******************************************************************************/
+IMG_VOID PVRSRVBridgeCaptureDeInit(IMG_VOID)
+{
+	IMG_UINT8 *pui8Ring;
+
+	gbPVRSRVBridgeCaptureEnabled = IMG_FALSE;
+
+	if (!IS_ERR_OR_NULL(gpsBridgeCaptureFile))
+	{
+		debugfs_remove(gpsBridgeCaptureFile);
+	}
+	gpsBridgeCaptureFile = IMG_NULL;
+
+	mutex_lock(&gsBridgeCaptureLock);
+	if (gpsBridgeCaptureSymbols != IMG_NULL)
+	{
+		HASH_Discard(gpsBridgeCaptureSymbols);
+		gpsBridgeCaptureSymbols = IMG_NULL;
+	}
+	mutex_unlock(&gsBridgeCaptureLock);
+
+	spin_lock(&gsBridgeCaptureRingLock);
+	pui8Ring = gpui8BridgeCaptureRing;
+	gpui8BridgeCaptureRing = IMG_NULL;
+	spin_unlock(&gsBridgeCaptureRingLock);
+
+	if (pui8Ring != IMG_NULL)
+	{
+		vfree(pui8Ring);
+	}
+}
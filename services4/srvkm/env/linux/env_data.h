@@ -44,6 +44,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <linux/interrupt.h>
 #include <linux/pci.h>
+#include <linux/spinlock.h>
 
 #if defined(PVR_LINUX_MISR_USING_WORKQUEUE) || defined(PVR_LINUX_MISR_USING_PRIVATE_WORKQUEUE)
 #include <linux/workqueue.h>
@@ -57,6 +58,16 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define PVRSRV_MAX_BRIDGE_IN_SIZE	0x1000
 #define PVRSRV_MAX_BRIDGE_OUT_SIZE	0x1000
 
+/*
+ * Each bridge call gets its own parameter buffers.  Calls whose
+ * structures are known to fit in PVRSRV_BRIDGE_STACK_BUFFER_SIZE bytes
+ * (in and out together) use a buffer on the stack; the rest take a
+ * PVRSRV_MAX_BRIDGE_IN_SIZE + PVRSRV_MAX_BRIDGE_OUT_SIZE buffer from a
+ * pool which keeps up to PVRSRV_BRIDGE_BUFFER_POOL_SIZE spare buffers.
+ */
+#define PVRSRV_BRIDGE_STACK_BUFFER_SIZE	0x100
+#define PVRSRV_BRIDGE_BUFFER_POOL_SIZE	4
+
 typedef	struct _PVR_PCI_DEV_TAG
 {
 	struct pci_dev		*psPCIDev;
@@ -66,7 +77,9 @@ typedef	struct _PVR_PCI_DEV_TAG
 
 typedef struct _ENV_DATA_TAG
 {
-	IMG_VOID		*pvBridgeData;
+	spinlock_t		sBridgeBufferPoolLock;
+	IMG_VOID		*apvBridgeBufferPool[PVRSRV_BRIDGE_BUFFER_POOL_SIZE];
+	IMG_UINT32		ui32BridgeBufferPoolCount;
 	struct pm_dev		*psPowerDevice;
 	IMG_BOOL		bLISRInstalled;
 	IMG_BOOL		bMISRInstalled;
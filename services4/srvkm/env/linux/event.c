@@ -366,11 +366,15 @@ PVRSRV_ERROR LinuxEventObjectSignal(IMG_HANDLE hOSEventObjectList)
 PVRSRV_ERROR LinuxEventObjectWait(IMG_HANDLE hOSEventObject, IMG_UINT32 ui32MSTimeout)
 {
 	IMG_UINT32 ui32TimeStamp;
+	IMG_BOOL bWriteLocked;
 	DEFINE_WAIT(sWait);
 
 	PVRSRV_LINUX_EVENT_OBJECT *psLinuxEventObject = (PVRSRV_LINUX_EVENT_OBJECT *) hOSEventObject;
 
 	IMG_UINT32 ui32TimeOutJiffies = msecs_to_jiffies(ui32MSTimeout);
+
+	/* Sleep without the bridge lock, retaking it in the mode it was held */
+	bWriteLocked = LinuxIsRWLockWriteLocked(&gPVRSRVLock);
 	
 	do	
 	{
@@ -382,11 +386,18 @@ PVRSRV_ERROR LinuxEventObjectWait(IMG_HANDLE hOSEventObject, IMG_UINT32 ui32MSTi
 			break;
 		}
 
-		LinuxUnLockMutex(&gPVRSRVLock);		
+		LinuxUnLockRWLock(&gPVRSRVLock);		
 
 		ui32TimeOutJiffies = (IMG_UINT32)schedule_timeout((IMG_INT32)ui32TimeOutJiffies);
 		
-		LinuxLockMutexNested(&gPVRSRVLock, PVRSRV_LOCK_CLASS_BRIDGE);
+		if (bWriteLocked)
+		{
+			LinuxLockRWLock(&gPVRSRVLock);
+		}
+		else
+		{
+			LinuxLockRWLockShared(&gPVRSRVLock);
+		}
 #if defined(DEBUG)
 		psLinuxEventObject->ui32Stats++;
 #endif			
@@ -44,11 +44,15 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define __LOCK_H__
 
 /*
- * Main driver lock, used to ensure driver code is single threaded.
- * There are some places where this lock must not be taken, such as
- * in the mmap related deriver entry points.
+ * Main driver lock.  Held for writing, it ensures driver code is single
+ * threaded.  Bridge calls marked concurrent in the dispatch table, which
+ * only look up handles and read state, hold it for reading instead, so
+ * they can run alongside each other while everything else stays
+ * serialised.  Any code that changes driver state must hold it for
+ * writing.  There are some places where this lock must not be taken,
+ * such as in the mmap related deriver entry points.
  */
-extern PVRSRV_LINUX_MUTEX gPVRSRVLock;
+extern PVRSRV_LINUX_RWLOCK gPVRSRVLock;
 
 #endif /* __LOCK_H__ */
 /*****************************************************************************
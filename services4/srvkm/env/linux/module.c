@@ -143,6 +143,14 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "pvr_linux_fence.h"
 #endif
 
+#if defined(PVRSRV_ALLOC_TRACE)
+#include "alloc_trace.h"
+#endif
+
+#if defined(PVRSRV_BRIDGE_CAPTURE)
+#include "bridge_capture.h"
+#endif
+
 /*
  * DRVNAME is the name we use to register our driver.
  * DEVNAME is the name we use to register actual device nodes.
@@ -169,6 +177,13 @@ module_param(gPVRDebugLevel, uint, 0644);
 MODULE_PARM_DESC(gPVRDebugLevel, "Sets the level of debug output (default 0x7)");
 #endif /* defined(PVRSRV_NEED_PVR_DPF) */
 
+#if defined(DEBUG_BRIDGE_KM)
+#include <linux/moduleparam.h>
+extern IMG_UINT32 gPVRBridgePerProcCache;
+module_param(gPVRBridgePerProcCache, uint, 0644);
+MODULE_PARM_DESC(gPVRBridgePerProcCache, "Use the per-process data cached at open for bridge calls (default 1)");
+#endif /* defined(DEBUG_BRIDGE_KM) */
+
 #if !defined(__devinitdata)
 #define __devinitdata
 #endif
@@ -224,7 +239,7 @@ static struct file_operations pvrsrv_fops =
 };
 #endif
 
-PVRSRV_LINUX_MUTEX gPVRSRVLock;
+PVRSRV_LINUX_RWLOCK gPVRSRVLock;
 
 /* PID of process being released */
 IMG_UINT32 gui32ReleasePID;
@@ -513,7 +528,7 @@ PVR_MOD_STATIC void PVRSRVDriverShutdown(LDM_DEV *pDevice)
 		 * processes trying to use the driver after it has been
 		 * shutdown.
 		 */
-		LinuxLockMutexNested(&gPVRSRVLock, PVRSRV_LOCK_CLASS_BRIDGE);
+		LinuxLockRWLock(&gPVRSRVLock);
 #endif
 		(void) PVRSRVSetPowerStateKM(PVRSRV_SYS_POWER_STATE_D3);
 	}
@@ -587,7 +602,7 @@ PVR_MOD_STATIC int PVRSRVDriverSuspend(LDM_DEV *pDevice, pm_message_t state)
 		 * locking order may have been bridge mutex first, followed
 		 * by the console lock.
 		 */
-		LinuxLockMutexNested(&gPVRSRVLock, PVRSRV_LOCK_CLASS_BRIDGE);
+		LinuxLockRWLock(&gPVRSRVLock);
 #endif
 		if (PVRSRVSetPowerStateKM(PVRSRV_SYS_POWER_STATE_D3) == PVRSRV_OK)
 		{
@@ -596,7 +611,7 @@ PVR_MOD_STATIC int PVRSRVDriverSuspend(LDM_DEV *pDevice, pm_message_t state)
 		else
 		{
 #if defined(ANDROID)
-			LinuxUnLockMutex(&gPVRSRVLock);
+			LinuxUnLockRWLock(&gPVRSRVLock);
 #endif
 			res = -EINVAL;
 		}
@@ -649,7 +664,7 @@ PVR_MOD_STATIC int PVRSRVDriverResume(LDM_DEV *pDevice)
 		{
 			bDriverIsSuspended = IMG_FALSE;
 #if defined(ANDROID)
-			LinuxUnLockMutex(&gPVRSRVLock);
+			LinuxUnLockRWLock(&gPVRSRVLock);
 #endif
 		}
 		else
@@ -775,6 +790,7 @@ static int PVRSRVOpen(struct inode unref__ * pInode, struct file *pFile)
 #endif
 {
 	PVRSRV_FILE_PRIVATE_DATA *psPrivateData;
+	PVRSRV_PER_PROCESS_DATA *psPerProc;
 	IMG_HANDLE hBlockAlloc;
 	int iRet = -ENOMEM;
 	PVRSRV_ERROR eError;
@@ -783,7 +799,7 @@ static int PVRSRVOpen(struct inode unref__ * pInode, struct file *pFile)
 	PVRSRV_ENV_PER_PROCESS_DATA *psEnvPerProc;
 #endif
 
-	LinuxLockMutexNested(&gPVRSRVLock, PVRSRV_LOCK_CLASS_BRIDGE);
+	LinuxLockRWLock(&gPVRSRVLock);
 
 #if !defined(SUPPORT_DRI_DRM)
 	pFile->f_mode |= FMODE_UNSIGNED_OFFSET;
@@ -794,6 +810,9 @@ static int PVRSRVOpen(struct inode unref__ * pInode, struct file *pFile)
 	if (PVRSRVProcessConnect(ui32PID, 0) != PVRSRV_OK)
 		goto err_unlock;
 
+	psPerProc = PVRSRVPerProcessData(ui32PID);
+	PVR_ASSERT(psPerProc != IMG_NULL);
+
 #if defined(SUPPORT_DRI_DRM) && defined(PVR_SECURE_DRM_AUTH_EXPORT)
 	psEnvPerProc = PVRSRVPerProcessPrivateData(ui32PID);
 	if (psEnvPerProc == IMG_NULL)
@@ -813,6 +832,11 @@ static int PVRSRVOpen(struct inode unref__ * pInode, struct file *pFile)
 		goto err_unlock;
 
 	psPrivateData->hKernelMemInfo = NULL;
+	psPrivateData->psPerProc = psPerProc;
+	psPrivateData->hKernelServices = psPerProc->hPerProcData;
+	psPrivateData->ui32PerProcGeneration = psPerProc->ui32Generation;
+	psPrivateData->psSubmitRing = IMG_NULL;
+	LinuxInitMutex(&psPrivateData->sSubmitRingMutex);
 #if defined(SUPPORT_DRI_DRM) && defined(PVR_SECURE_DRM_AUTH_EXPORT)
 	psPrivateData->psDRMFile = pFile;
 
@@ -823,7 +847,7 @@ static int PVRSRVOpen(struct inode unref__ * pInode, struct file *pFile)
 	PRIVATE_DATA(pFile) = psPrivateData;
 	iRet = 0;
 err_unlock:	
-	LinuxUnLockMutex(&gPVRSRVLock);
+	LinuxUnLockRWLock(&gPVRSRVLock);
 	return iRet;
 }
 
@@ -854,7 +878,7 @@ static int PVRSRVRelease(struct inode unref__ * pInode, struct file *pFile)
 	PVRSRV_FILE_PRIVATE_DATA *psPrivateData;
 	int err = 0;
 
-	LinuxLockMutexNested(&gPVRSRVLock, PVRSRV_LOCK_CLASS_BRIDGE);
+	LinuxLockRWLock(&gPVRSRVLock);
 
 #if defined(SUPPORT_DRI_DRM)
 	psPrivateData = (PVRSRV_FILE_PRIVATE_DATA *)pvPrivData;
@@ -898,6 +922,9 @@ static int PVRSRVRelease(struct inode unref__ * pInode, struct file *pFile)
 			}
 		}
 
+		/* Free the submission ring while the handle base it is in exists */
+		LinuxBridgeReleaseFile(psPrivateData);
+
 		/* Usually this is the same as OSGetCurrentProcessIDKM(),
 		 * but not necessarily (e.g. fork(), child closes last..)
 		 */
@@ -915,7 +942,7 @@ static int PVRSRVRelease(struct inode unref__ * pInode, struct file *pFile)
 	}
 
 err_unlock:
-	LinuxUnLockMutex(&gPVRSRVLock);
+	LinuxUnLockRWLock(&gPVRSRVLock);
 #if defined(SUPPORT_DRI_DRM)
 	return;
 #else
@@ -988,7 +1015,7 @@ static int __init PVRCore_Init(void)
 #if defined(PVR_LDM_MODULE) || defined(SUPPORT_DRI_DRM)
 	LinuxInitMutex(&gsPMMutex);
 #endif
-	LinuxInitMutex(&gPVRSRVLock);
+	LinuxInitRWLock(&gPVRSRVLock);
 
 	if (CreateProcEntries ())
 	{
@@ -1010,6 +1037,22 @@ static int __init PVRCore_Init(void)
 		goto init_failed;
 	}
 
+#if defined(PVRSRV_ALLOC_TRACE)
+	if (PVRSRVAllocTraceInit() != PVRSRV_OK)
+	{
+		error = -ENOMEM;
+		goto init_failed;
+	}
+#endif
+
+#if defined(PVRSRV_BRIDGE_CAPTURE)
+	if (PVRSRVBridgeCaptureInit() != PVRSRV_OK)
+	{
+		error = -ENOMEM;
+		goto init_failed;
+	}
+#endif
+
 #if defined(SUPPORT_DMABUF)
 	if (PVRLinuxFenceInit())
 	{
@@ -1018,8 +1061,12 @@ static int __init PVRCore_Init(void)
 	}
 #endif
 
-	LinuxBridgeInit();
-	
+	if (LinuxBridgeInit() != PVRSRV_OK)
+	{
+		error = -ENOMEM;
+		goto init_failed;
+	}
+
 	PVRMMapInit();
 
 #if defined(PVR_LDM_MODULE)
@@ -1157,6 +1204,14 @@ sys_deinit:
 #endif	/* defined(PVR_LDM_MODULE) */
 init_failed:
 	PVRMMapCleanup();
+#if defined(PVRSRV_ALLOC_TRACE)
+	PVRSRVAllocTraceDeInit();
+#endif
+#if defined(PVRSRV_BRIDGE_CAPTURE)
+	PVRSRVBridgeCaptureDeInit();
+#endif
+	/* let memory retired through OSCallRCU be freed before leak checks */
+	OSRCUBarrier();
 	LinuxMMCleanup();
 	LinuxBridgeDeInit();
 #if defined(SUPPORT_DMABUF)
@@ -1252,6 +1307,16 @@ static void __exit PVRCore_Cleanup(void)
 
 	PVRMMapCleanup();
 
+#if defined(PVRSRV_ALLOC_TRACE)
+	PVRSRVAllocTraceDeInit();
+#endif
+
+#if defined(PVRSRV_BRIDGE_CAPTURE)
+	PVRSRVBridgeCaptureDeInit();
+#endif
+
+	OSRCUBarrier();
+
 	LinuxMMCleanup();
 
 	LinuxBridgeDeInit();
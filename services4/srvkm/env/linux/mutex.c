@@ -42,6 +42,8 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <linux/version.h>
 #include <linux/errno.h>
 #include <linux/mutex.h>
+#include <linux/rwsem.h>
+#include <linux/lockdep.h>
 #include <linux/module.h>
 
 #include <img_defs.h>
@@ -49,6 +51,10 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "mutex.h"
 
+#if !defined(lockdep_assert_held)
+#define lockdep_assert_held(l)	do { (void)(l); } while (0)
+#endif
+
 IMG_VOID LinuxInitMutex(PVRSRV_LINUX_MUTEX *psPVRSRVMutex)
 {
     mutex_init(psPVRSRVMutex);
@@ -90,3 +96,52 @@ IMG_BOOL LinuxIsLockedMutex(PVRSRV_LINUX_MUTEX *psPVRSRVMutex)
 {
     return (mutex_is_locked(psPVRSRVMutex)) ? IMG_TRUE : IMG_FALSE;
 }
+
+IMG_VOID LinuxInitRWLock(PVRSRV_LINUX_RWLOCK *psPVRSRVRWLock)
+{
+	init_rwsem(&psPVRSRVRWLock->sSem);
+	psPVRSRVRWLock->bWriteLocked = IMG_FALSE;
+}
+
+IMG_VOID LinuxLockRWLock(PVRSRV_LINUX_RWLOCK *psPVRSRVRWLock)
+{
+	down_write(&psPVRSRVRWLock->sSem);
+	psPVRSRVRWLock->bWriteLocked = IMG_TRUE;
+}
+
+IMG_VOID LinuxLockRWLockShared(PVRSRV_LINUX_RWLOCK *psPVRSRVRWLock)
+{
+	down_read(&psPVRSRVRWLock->sSem);
+}
+
+IMG_INT32 LinuxTryLockRWLock(PVRSRV_LINUX_RWLOCK *psPVRSRVRWLock)
+{
+	if (!down_write_trylock(&psPVRSRVRWLock->sSem))
+	{
+		return 0;
+	}
+	psPVRSRVRWLock->bWriteLocked = IMG_TRUE;
+	return 1;
+}
+
+/* Release the lock in whichever mode the caller holds it */
+IMG_VOID LinuxUnLockRWLock(PVRSRV_LINUX_RWLOCK *psPVRSRVRWLock)
+{
+	if (psPVRSRVRWLock->bWriteLocked)
+	{
+		psPVRSRVRWLock->bWriteLocked = IMG_FALSE;
+		up_write(&psPVRSRVRWLock->sSem);
+	}
+	else
+	{
+		up_read(&psPVRSRVRWLock->sSem);
+	}
+}
+
+/* Only meaningful to a holder of the lock */
+IMG_BOOL LinuxIsRWLockWriteLocked(PVRSRV_LINUX_RWLOCK *psPVRSRVRWLock)
+{
+	lockdep_assert_held(&psPVRSRVRWLock->sSem);
+
+	return psPVRSRVRWLock->bWriteLocked;
+}
@@ -46,16 +46,29 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <linux/version.h>
 
 #include <linux/mutex.h>
+#include <linux/rwsem.h>
 
 typedef struct mutex PVRSRV_LINUX_MUTEX;
 
+/*
+ * Reader/writer lock.  Holders in either mode may sleep.  bWriteLocked
+ * is only set while the lock is held for writing, so any holder can
+ * tell which mode it holds the lock in, and the lock can be released
+ * by a task other than the one that took it.
+ */
+typedef struct _PVRSRV_LINUX_RWLOCK_
+{
+	struct rw_semaphore sSem;
+	IMG_BOOL bWriteLocked;
+} PVRSRV_LINUX_RWLOCK;
+
 enum PVRSRV_MUTEX_LOCK_CLASS
 {
 	PVRSRV_LOCK_CLASS_POWER,
-	PVRSRV_LOCK_CLASS_BRIDGE,
 	PVRSRV_LOCK_CLASS_MMAP,
 	PVRSRV_LOCK_CLASS_MM_DEBUG,
 	PVRSRV_LOCK_CLASS_PVR_DEBUG,
+	PVRSRV_LOCK_CLASS_SUBMIT_RING,
 };
 
 extern IMG_VOID LinuxInitMutex(PVRSRV_LINUX_MUTEX *psPVRSRVMutex);
@@ -72,6 +85,18 @@ extern IMG_VOID LinuxUnLockMutex(PVRSRV_LINUX_MUTEX *psPVRSRVMutex);
 
 extern IMG_BOOL LinuxIsLockedMutex(PVRSRV_LINUX_MUTEX *psPVRSRVMutex);
 
+extern IMG_VOID LinuxInitRWLock(PVRSRV_LINUX_RWLOCK *psPVRSRVRWLock);
+
+extern IMG_VOID LinuxLockRWLock(PVRSRV_LINUX_RWLOCK *psPVRSRVRWLock);
+
+extern IMG_VOID LinuxLockRWLockShared(PVRSRV_LINUX_RWLOCK *psPVRSRVRWLock);
+
+extern IMG_INT32 LinuxTryLockRWLock(PVRSRV_LINUX_RWLOCK *psPVRSRVRWLock);
+
+extern IMG_VOID LinuxUnLockRWLock(PVRSRV_LINUX_RWLOCK *psPVRSRVRWLock);
+
+extern IMG_BOOL LinuxIsRWLockWriteLocked(PVRSRV_LINUX_RWLOCK *psPVRSRVRWLock);
+
 
 #endif /* __INCLUDED_LINUX_MUTEX_H_ */
 
@@ -186,6 +186,88 @@ PVRSRV_ERROR OSFreeMem_Impl(IMG_UINT32 ui32Flags, IMG_SIZE_T uiSize, IMG_PVOID p
 }
 
 
+/*!
+******************************************************************************
+
+ @Function OSCreateObjectCache
+
+ @Description creates a cache of fixed size objects
+
+ @Input pszName - name of the cache
+ @Input uObjectSize - size of each object in bytes
+
+ @Return handle to the cache, or IMG_NULL on failure
+
+******************************************************************************/
+IMG_HANDLE OSCreateObjectCache(IMG_CHAR *pszName, IMG_SIZE_T uObjectSize)
+{
+    return (IMG_HANDLE)KMemCacheCreateWrapper(pszName, uObjectSize, 0, 0);
+}
+
+
+/*!
+******************************************************************************
+
+ @Function OSDestroyObjectCache
+
+ @Description destroys a cache created by OSCreateObjectCache. All objects
+              must have been freed.
+
+ @Input hCache - handle to the cache
+
+ @Return none
+
+******************************************************************************/
+IMG_VOID OSDestroyObjectCache(IMG_HANDLE hCache)
+{
+    KMemCacheDestroyWrapper((LinuxKMemCache *)hCache);
+}
+
+
+/*!
+******************************************************************************
+
+ @Function OSAllocObject
+
+ @Description allocates an object from a cache created by OSCreateObjectCache
+
+ @Input hCache - handle to the cache
+ @Output ppvObject - receives the object
+
+ @Return error status
+
+******************************************************************************/
+PVRSRV_ERROR OSAllocObject(IMG_HANDLE hCache, IMG_PVOID *ppvObject)
+{
+    *ppvObject = KMemCacheAllocWrapper((LinuxKMemCache *)hCache, GFP_KERNEL | __GFP_NOWARN);
+    if (*ppvObject == IMG_NULL)
+    {
+        return PVRSRV_ERROR_OUT_OF_MEMORY;
+    }
+
+    return PVRSRV_OK;
+}
+
+
+/*!
+******************************************************************************
+
+ @Function OSFreeObject
+
+ @Description returns an object to the cache it was allocated from
+
+ @Input hCache - handle to the cache
+ @Input pvObject - the object
+
+ @Return none
+
+******************************************************************************/
+IMG_VOID OSFreeObject(IMG_HANDLE hCache, IMG_PVOID pvObject)
+{
+    KMemCacheFreeWrapper((LinuxKMemCache *)hCache, pvObject);
+}
+
+
 PVRSRV_ERROR
 OSAllocPages_Impl(IMG_UINT32 ui32AllocFlags,
 				  IMG_SIZE_T uiSize,
@@ -644,8 +726,9 @@ PVRSRV_ERROR OSInitEnvData(IMG_PVOID *ppvEnvSpecificData)
         return eError;
     }
 
+    /* Start the pool with one buffer, so serialised calls never allocate */
     eError = OSAllocMem(PVRSRV_OS_PAGEABLE_HEAP, PVRSRV_MAX_BRIDGE_IN_SIZE + PVRSRV_MAX_BRIDGE_OUT_SIZE, 
-                    &psEnvData->pvBridgeData, IMG_NULL,
+                    &psEnvData->apvBridgeBufferPool[0], IMG_NULL,
                     "Bridge Data");
     if (eError != PVRSRV_OK)
     {
@@ -655,6 +738,9 @@ PVRSRV_ERROR OSInitEnvData(IMG_PVOID *ppvEnvSpecificData)
     }
 
 
+    psEnvData->ui32BridgeBufferPoolCount = 1;
+    spin_lock_init(&psEnvData->sBridgeBufferPoolLock);
+
     /* ISR installation flags */
     psEnvData->bMISRInstalled = IMG_FALSE;
     psEnvData->bLISRInstalled = IMG_FALSE;
@@ -685,8 +771,12 @@ PVRSRV_ERROR OSDeInitEnvData(IMG_PVOID pvEnvSpecificData)
     PVR_ASSERT(!psEnvData->bMISRInstalled);
     PVR_ASSERT(!psEnvData->bLISRInstalled);
 
-    OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, PVRSRV_MAX_BRIDGE_IN_SIZE + PVRSRV_MAX_BRIDGE_OUT_SIZE, psEnvData->pvBridgeData, IMG_NULL);
-    psEnvData->pvBridgeData = IMG_NULL;
+    while (psEnvData->ui32BridgeBufferPoolCount != 0)
+    {
+        psEnvData->ui32BridgeBufferPoolCount--;
+        OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, PVRSRV_MAX_BRIDGE_IN_SIZE + PVRSRV_MAX_BRIDGE_OUT_SIZE,
+                  psEnvData->apvBridgeBufferPool[psEnvData->ui32BridgeBufferPoolCount], IMG_NULL);
+    }
 
     OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(ENV_DATA), pvEnvSpecificData, IMG_NULL);
 	/*not nulling pointer, copy on stack*/
@@ -695,6 +785,83 @@ PVRSRV_ERROR OSDeInitEnvData(IMG_PVOID pvEnvSpecificData)
 }
 
 
+/*!
+******************************************************************************
+
+ @Function		OSAcquireBridgeBuffer
+
+ @Description	Gets a buffer for the parameters of one bridge call, big
+				enough for PVRSRV_MAX_BRIDGE_IN_SIZE bytes of input
+				followed by PVRSRV_MAX_BRIDGE_OUT_SIZE bytes of output.
+				A spare buffer is reused if there is one, otherwise a
+				new one is allocated.  The contents are undefined.
+
+ @Output		ppvBuffer - the buffer
+
+ @Return		PVRSRV_OK, or PVRSRV_ERROR_OUT_OF_MEMORY
+
+******************************************************************************/
+PVRSRV_ERROR OSAcquireBridgeBuffer(IMG_VOID **ppvBuffer)
+{
+	SYS_DATA *psSysData;
+	ENV_DATA *psEnvData;
+
+	SysAcquireData(&psSysData);
+	psEnvData = (ENV_DATA *)psSysData->pvEnvSpecificData;
+
+	spin_lock(&psEnvData->sBridgeBufferPoolLock);
+	if (psEnvData->ui32BridgeBufferPoolCount != 0)
+	{
+		psEnvData->ui32BridgeBufferPoolCount--;
+		*ppvBuffer = psEnvData->apvBridgeBufferPool[psEnvData->ui32BridgeBufferPoolCount];
+		spin_unlock(&psEnvData->sBridgeBufferPoolLock);
+		return PVRSRV_OK;
+	}
+	spin_unlock(&psEnvData->sBridgeBufferPoolLock);
+
+	return OSAllocMem(PVRSRV_OS_PAGEABLE_HEAP, PVRSRV_MAX_BRIDGE_IN_SIZE + PVRSRV_MAX_BRIDGE_OUT_SIZE,
+					  ppvBuffer, IMG_NULL,
+					  "Bridge Data");
+}
+
+
+/*!
+******************************************************************************
+
+ @Function		OSReleaseBridgeBuffer
+
+ @Description	Returns a buffer from OSAcquireBridgeBuffer.  It is kept
+				for reuse unless the pool already holds
+				PVRSRV_BRIDGE_BUFFER_POOL_SIZE spare buffers.
+
+ @Input			pvBuffer - the buffer
+
+ @Return		nothing
+
+******************************************************************************/
+IMG_VOID OSReleaseBridgeBuffer(IMG_VOID *pvBuffer)
+{
+	SYS_DATA *psSysData;
+	ENV_DATA *psEnvData;
+
+	SysAcquireData(&psSysData);
+	psEnvData = (ENV_DATA *)psSysData->pvEnvSpecificData;
+
+	spin_lock(&psEnvData->sBridgeBufferPoolLock);
+	if (psEnvData->ui32BridgeBufferPoolCount < PVRSRV_BRIDGE_BUFFER_POOL_SIZE)
+	{
+		psEnvData->apvBridgeBufferPool[psEnvData->ui32BridgeBufferPoolCount] = pvBuffer;
+		psEnvData->ui32BridgeBufferPoolCount++;
+		spin_unlock(&psEnvData->sBridgeBufferPoolLock);
+		return;
+	}
+	spin_unlock(&psEnvData->sBridgeBufferPoolLock);
+
+	OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, PVRSRV_MAX_BRIDGE_IN_SIZE + PVRSRV_MAX_BRIDGE_OUT_SIZE,
+			  pvBuffer, IMG_NULL);
+}
+
+
 /*!
 ******************************************************************************
 
@@ -759,6 +926,26 @@ IMG_UINT32 OSClockus(IMG_VOID)
 }
 
 
+/*!
+******************************************************************************
+
+ @Function OSClockns64
+ 
+ @Description 
+    This function returns the monotonic clock in nanoseconds, for timing
+    intervals too short for the jiffy resolution of OSClockus
+ 
+ @Input void
+
+ @Return - clock (ns)
+
+******************************************************************************/ 
+IMG_UINT64 OSClockns64(IMG_VOID)
+{
+	return (IMG_UINT64)ktime_to_ns(ktime_get());
+}
+
+
 IMG_VOID OSWaitus(IMG_UINT32 ui32Timeus)
 {
     udelay(ui32Timeus);
@@ -4672,6 +4859,76 @@ IMG_BOOL OSInvalidateCPUCacheRangeKM(IMG_HANDLE hOSMemHandle,
 
 #endif
 
+/* Memory retired with OSCallRCU whose grace period has ended. It is
+   freed from a work item, since the OSFreeMem debug tracking can sleep
+   and RCU callbacks run in softirq context. */
+static LLIST_HEAD(gsRCUFreeList);
+
+static void OSRCUFreeWorker(struct work_struct *psWork)
+{
+	struct llist_node *psNode = llist_del_all(&gsRCUFreeList);
+
+	PVR_UNREFERENCED_PARAMETER(psWork);
+
+	while (psNode != NULL)
+	{
+		OS_RCU_HEAD *psHead = llist_entry(psNode, OS_RCU_HEAD, sNode);
+
+		psNode = psNode->next;
+		psHead->pfnFree(psHead);
+	}
+}
+
+static DECLARE_WORK(gsRCUFreeWork, OSRCUFreeWorker);
+
+static void OSRCUCallback(struct rcu_head *psRCU)
+{
+	OS_RCU_HEAD *psHead = container_of(psRCU, OS_RCU_HEAD, sRCU);
+
+	if (llist_add(&psHead->sNode, &gsRCUFreeList))
+	{
+		schedule_work(&gsRCUFreeWork);
+	}
+}
+
+/*!
+******************************************************************************
+
+ @Function OSCallRCU
+
+ @Description
+    Free memory that lockless readers may still be looking at. pfnFree is
+    called from process context after an RCU grace period.
+
+ @Input psHead - RCU head embedded in the memory to free
+ @Input pfnFree - function freeing the memory
+
+ @Return None
+
+******************************************************************************/
+IMG_VOID OSCallRCU(OS_RCU_HEAD *psHead, PFN_OS_RCU_FREE pfnFree)
+{
+	psHead->pfnFree = pfnFree;
+	call_rcu(&psHead->sRCU, OSRCUCallback);
+}
+
+/*!
+******************************************************************************
+
+ @Function OSRCUBarrier
+
+ @Description
+    Wait until everything passed to OSCallRCU so far has been freed.
+
+ @Return None
+
+******************************************************************************/
+IMG_VOID OSRCUBarrier(IMG_VOID)
+{
+	rcu_barrier();
+	flush_work(&gsRCUFreeWork);
+}
+
 typedef struct _AtomicStruct
 {
 	atomic_t RefCount;
@@ -4723,12 +4980,15 @@ IMG_UINT32 OSAtomicRead(IMG_PVOID pvRefCount)
 
 IMG_VOID OSReleaseBridgeLock(IMG_VOID)
 {
-       LinuxUnLockMutex(&gPVRSRVLock);
+       /* OSReacquireBridgeLock takes the lock back for writing */
+       PVR_ASSERT(LinuxIsRWLockWriteLocked(&gPVRSRVLock));
+
+       LinuxUnLockRWLock(&gPVRSRVLock);
 }
 
 IMG_VOID OSReacquireBridgeLock(IMG_VOID)
 {
-       LinuxLockMutexNested(&gPVRSRVLock, PVRSRV_LOCK_CLASS_BRIDGE);
+       LinuxLockRWLock(&gPVRSRVLock);
 }
 
 typedef struct _OSTime
@@ -47,6 +47,8 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <drm/drmP.h>
 #endif
 
+#include "mutex.h"
+
 /* This structure is required in the rare case that a process creates
  * a connection to services, but before closing the file descriptor,
  * does a fork(). This fork() will duplicate the file descriptor in the
@@ -66,6 +68,18 @@ typedef struct
 	/* Global kernel MemInfo handle */
 	IMG_HANDLE hKernelMemInfo;
 
+	/* The opening process's per-process data, which this connection
+	 * holds a reference on, and the kernel services handle naming it.
+	 * Bridge calls that name it need not look the handle up. */
+	struct _PVRSRV_PER_PROCESS_DATA_ *psPerProc;
+	IMG_HANDLE hKernelServices;
+	IMG_UINT32 ui32PerProcGeneration;
+
+	/* The connection's submission ring, if it has one.  The mutex is
+	 * held while the ring is created, destroyed or drained. */
+	struct _PVRSRV_SUBMIT_RING_KM_ *psSubmitRing;
+	PVRSRV_LINUX_MUTEX sSubmitRingMutex;
+
 #if defined(SUPPORT_DRI_DRM) && defined(PVR_SECURE_DRM_AUTH_EXPORT)
 	/* The private data is on a list in the per-process data structure */
 	struct list_head sDRMAuthListItem;
@@ -49,6 +49,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <linux/fs.h>
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
+#include <linux/math64.h>
 
 #include "services_headers.h"
 
@@ -61,6 +62,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "perproc.h"
 #include "env_perproc.h"
 #include "linkage.h"
+#include "hash.h"
 
 #include "lists.h"
 
@@ -123,6 +125,7 @@ static struct pvr_proc_dir_entry* g_pProcQueue;
 #endif
 static struct pvr_proc_dir_entry* g_pProcVersion;
 static struct pvr_proc_dir_entry* g_pProcSysNodes;
+static struct pvr_proc_dir_entry* g_pProcHash;
 
 #ifdef DEBUG
 static struct pvr_proc_dir_entry* g_pProcDebugLevel;
@@ -138,6 +141,9 @@ static void ProcSeqShowVersion(struct seq_file *sfile,void* el);
 static void ProcSeqShowSysNodes(struct seq_file *sfile,void* el);
 static void* ProcSeqOff2ElementSysNodes(struct seq_file * sfile, loff_t off);
 
+static void ProcSeqShowHash(struct seq_file *sfile,void* el);
+static int ProcSetHash(struct file *file, const char __user *buffer, unsigned long count, void *data);
+
 
 #if (LINUX_VERSION_CODE < KERNEL_VERSION(5,16,0))
 // defined in proc_fs.h
@@ -673,8 +679,9 @@ IMG_INT CreateProcEntries(IMG_VOID)
 #endif
 	g_pProcVersion = CreateProcReadEntrySeq("version", NULL, NULL, ProcSeqShowVersion, ProcSeq1ElementHeaderOff2Element, NULL);
 	g_pProcSysNodes = CreateProcReadEntrySeq("nodes", NULL, NULL, ProcSeqShowSysNodes, ProcSeqOff2ElementSysNodes, NULL);
+	g_pProcHash = CreateProcEntrySeq("hash", NULL, NULL, ProcSeqShowHash, ProcSeq1ElementHeaderOff2Element, NULL, ProcSetHash);
 
-	if(!g_pProcVersion || !g_pProcSysNodes
+	if(!g_pProcVersion || !g_pProcSysNodes || !g_pProcHash
 #if defined(SUPPORT_PVRSRV_DEVICE_CLASS)
 		|| !g_pProcQueue
 #endif
@@ -811,6 +818,7 @@ IMG_VOID RemoveProcEntries(IMG_VOID)
 #endif
 	RemoveProcEntrySeq(g_pProcVersion);
 	RemoveProcEntrySeq(g_pProcSysNodes);
+	RemoveProcEntrySeq(g_pProcHash);
 
 	proc_remove(dir);
 }
@@ -982,6 +990,102 @@ static void* ProcSeqOff2ElementSysNodes(struct seq_file * sfile, loff_t off)
     return (void*)psDevNode;
 }
 
+/*****************************************************************************
+ FUNCTION	:	ProcSeqShowHashTable
+
+ PURPOSE	:	Print one line of hash table statistics. The average
+				probe count is shown to two decimal places.
+
+ PARAMETERS	:	pszName - name of the table
+				psStats - statistics of the table
+				pvData - /proc seq_file
+*****************************************************************************/
+static IMG_VOID ProcSeqShowHashTable(const IMG_CHAR *pszName,
+									 const HASH_TABLE_STATS *psStats,
+									 IMG_VOID *pvData)
+{
+	struct seq_file *sfile = (struct seq_file *)pvData;
+	IMG_UINT64 ui64Lookups = psStats->ui64Hits + psStats->ui64Misses;
+	IMG_UINT64 ui64AvgProbes = 0;
+
+	if (ui64Lookups != 0)
+	{
+		ui64AvgProbes = div64_u64(psStats->ui64Probes * 100, ui64Lookups);
+	}
+
+	seq_printf(sfile, "%-20s %-7s %8u %8u %12llu %12llu %5llu.%02llu %6u %7u %10llu\n",
+			   pszName,
+			   (psStats->ui32Flags & HASH_CREATE_OPEN_ADDRESSING) ? "open" :
+			   (psStats->ui32Flags & HASH_CREATE_RCU) ? "rcu" : "chained",
+			   psStats->ui32Size,
+			   psStats->ui32Count,
+			   (unsigned long long)psStats->ui64Hits,
+			   (unsigned long long)psStats->ui64Misses,
+			   (unsigned long long)div64_u64(ui64AvgProbes, 100),
+			   (unsigned long long)(ui64AvgProbes - div64_u64(ui64AvgProbes, 100) * 100),
+			   psStats->ui32MaxProbes,
+			   psStats->ui32Resizes,
+			   (unsigned long long)div64_u64(psStats->ui64Resizens, 1000));
+}
+
+/*****************************************************************************
+ FUNCTION	:	ProcSeqShowHash
+
+ PURPOSE	:	Print the hash table resize latency histogram, in which
+				bucket n counts operations that took under 1024ns << n,
+				followed by the statistics of every live table.
+
+ PARAMETERS	:	sfile - /proc seq_file
+				el - Element to print
+*****************************************************************************/
+static void ProcSeqShowHash(struct seq_file *sfile, void* el)
+{
+	HASH_LATENCY_STATS sStats;
+	IMG_UINT32 ui32Bucket;
+
+	if(el == PVR_PROC_SEQ_START_TOKEN)
+	{
+		seq_printf(sfile, "Hash table statistics (write to reset)\n");
+		return;
+	}
+
+	HASH_GetLatencyStats(&sStats);
+
+	seq_printf(sfile, "resizes\t\t%u\n", sStats.ui32Resizes);
+	seq_printf(sfile, "worst\t\t%lluns\n", (unsigned long long)sStats.ui64Worstns);
+	for (ui32Bucket = 0; ui32Bucket < HASH_LATENCY_BUCKETS; ui32Bucket++)
+	{
+		seq_printf(sfile, "%s%8uns\t%u\n",
+				   (ui32Bucket == HASH_LATENCY_BUCKETS - 1) ? ">=" : "< ",
+				   1024U << ((ui32Bucket == HASH_LATENCY_BUCKETS - 1) ? ui32Bucket - 1 : ui32Bucket),
+				   sStats.aui32Histogram[ui32Bucket]);
+	}
+
+	seq_printf(sfile, "\n%-20s %-7s %8s %8s %12s %12s %8s %6s %7s %10s\n",
+			   "name", "type", "size", "count", "hits", "misses",
+			   "avgprobe", "max", "resizes", "resize_us");
+	HASH_IterateTables(ProcSeqShowHashTable, sfile);
+}
+
+/*****************************************************************************
+ FUNCTION	:	ProcSetHash
+
+ PURPOSE	:	Reset the hash table resize latency histogram and the
+				counters of every table
+
+ PARAMETERS	:	standard /proc write handler
+*****************************************************************************/
+static int ProcSetHash(struct file *file, const char __user *buffer, unsigned long count, void *data)
+{
+	PVR_UNREFERENCED_PARAMETER(file);
+	PVR_UNREFERENCED_PARAMETER(buffer);
+	PVR_UNREFERENCED_PARAMETER(data);
+
+	HASH_ResetStats();
+
+	return (int)count;
+}
+
 /*****************************************************************************
  End of file (proc.c)
 *****************************************************************************/
@@ -42,6 +42,12 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 */ /**************************************************************************/
 
 #include <linux/fs.h>
+#include <linux/percpu.h>
+#include <linux/vmalloc.h>
+#include <linux/sched/clock.h>
+#if defined(CONFIG_COMPAT)
+#include <linux/compat.h>
+#endif
 
 #include "img_defs.h"
 #include "services.h"
@@ -57,6 +63,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "pvr_uaccess.h"
 #include "refcount.h"
 #include "buffer_manager.h"
+#include "env_data.h"
 
 #if defined(SUPPORT_DRI_DRM)
 #include <drm/drm_file.h>
@@ -82,8 +89,10 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #if defined(SUPPORT_DRI_DRM)
 #define	PRIVATE_DATA(pFile) ((pFile)->driver_priv)
+typedef struct drm_file PVRSRV_BRIDGE_FILE;
 #else
 #define	PRIVATE_DATA(pFile) ((pFile)->private_data)
+typedef struct file PVRSRV_BRIDGE_FILE;
 #endif
 
 #if defined(DEBUG_BRIDGE_KM)
@@ -96,15 +105,262 @@ static void ProcSeqStartstopBridgeStats(struct seq_file *sfile,IMG_BOOL start);
 
 #endif
 
-extern PVRSRV_LINUX_MUTEX gPVRSRVLock;
+/* Bridge call latency: log2 histograms of the time each call waited for
+ * gPVRSRVLock and the time it then took.  Bucket n counts times in
+ * [2^(n-1), 2^n) ns, the last bucket everything longer.  Each CPU has its
+ * own table, so recording a call touches no shared cache lines. */
+#define BRIDGE_LATENCY_BUCKETS	32
+
+typedef struct _BRIDGE_LATENCY_
+{
+	IMG_UINT32 aui32Wait[BRIDGE_LATENCY_BUCKETS];
+	IMG_UINT32 aui32Service[BRIDGE_LATENCY_BUCKETS];
+} BRIDGE_LATENCY;
+
+static DEFINE_PER_CPU(BRIDGE_LATENCY *, gpsBridgeLatency);
+
+/* A call posted to a submission ring, copied out of the client's reach */
+typedef struct _BRIDGE_SUBMIT_RING_CALL_
+{
+	IMG_UINT32 ui32BridgeID;
+	IMG_UINT32 ui32InBufferSize;
+	IMG_UINT32 ui32OutBufferSize;
+} BRIDGE_SUBMIT_RING_CALL;
+
+/* A connection's submission ring.  The ring is shared with the client, so
+ * nothing the kernel relies on is read from it more than once. */
+typedef struct _PVRSRV_SUBMIT_RING_KM_
+{
+	PVRSRV_SUBMIT_RING *psRing;
+	IMG_HANDLE hOSMemHandle;
+	IMG_SIZE_T uiBytes;
+
+	/* The handle the client maps the ring with, and its handle base */
+	IMG_HANDLE hRing;
+	PVRSRV_PER_PROCESS_DATA *psPerProc;
+
+	/* Frees the ring with the per-process data if its file can't */
+	PRESMAN_ITEM hResItem;
+
+	IMG_UINT32 ui32NumSlots;
+	IMG_UINT32 ui32ReadOffset;
+
+	BRIDGE_SUBMIT_RING_CALL asCalls[PVRSRV_SUBMIT_RING_MAX_SLOTS];
+} PVRSRV_SUBMIT_RING_KM;
+
+/* Cached, as the ring is only shared between CPUs */
+#define SUBMIT_RING_ALLOC_FLAGS	(PVRSRV_HAP_MULTI_PROCESS | PVRSRV_HAP_CACHED)
+
+static struct pvr_proc_dir_entry *g_ProcBridgeLatency;
+static void* ProcSeqNextBridgeLatency(struct seq_file *sfile,void* el,loff_t off);
+static void ProcSeqShowBridgeLatency(struct seq_file *sfile,void* el);
+static void* ProcSeqOff2ElementBridgeLatency(struct seq_file * sfile, loff_t off);
+static int ProcWriteBridgeLatency(struct file *file, const char __user *buffer,
+								  unsigned long count, void *data);
+
+extern PVRSRV_LINUX_RWLOCK gPVRSRVLock;
 
 #if defined(SUPPORT_MEMINFO_IDS)
 IMG_UINT64 g_ui64MemInfoID;
 #endif /* defined(SUPPORT_MEMINFO_IDS) */
 
+#if defined(DEBUG_BRIDGE_KM)
+/* Cleared to measure bridge calls with a handle lookup each */
+IMG_UINT32 gPVRBridgePerProcCache = 1;
+#endif
+
+static IMG_VOID BridgeLatencyFree(IMG_VOID)
+{
+	IMG_UINT32 ui32CPU;
+
+	for_each_possible_cpu(ui32CPU)
+	{
+		vfree(per_cpu(gpsBridgeLatency, ui32CPU));
+		per_cpu(gpsBridgeLatency, ui32CPU) = IMG_NULL;
+	}
+}
+
+#if defined(CONFIG_COMPAT)
+/*
+ * Input structures a 32-bit process lays out differently, because they
+ * carry user pointers.  Handles and sizes are 64-bit for 32-bit callers
+ * too; compat_u64 gives them the alignment the 32-bit ABI does.  Calls
+ * not converted here are laid out the same, and copied in as they are.
+ */
+typedef struct _BRIDGE_COMPAT_IN_WRAP_EXT_MEMORY_
+{
+	compat_u64		hDevCookie;
+	compat_u64		hDevMemContext;
+	compat_uptr_t	pvLinAddr;
+	compat_u64		uByteSize;
+	compat_u64		uPageOffset;
+	IMG_BOOL		bPhysContig;
+	IMG_UINT32		ui32NumPageTableEntries;
+	compat_uptr_t	psSysPAddr;
+	IMG_UINT32		ui32Flags;
+} BRIDGE_COMPAT_IN_WRAP_EXT_MEMORY;
+
+#if defined(SUPPORT_SGX)
+typedef struct _BRIDGE_COMPAT_IN_SGXADDSHAREDPBDESC_
+{
+	IMG_UINT32		ui32TotalPBSize;
+	compat_u64		hDevCookie;
+	compat_u64		hSharedPBDescKernelMemInfo;
+	compat_u64		hHWPBDescKernelMemInfo;
+	compat_u64		hBlockKernelMemInfo;
+	compat_u64		hHWBlockKernelMemInfo;
+	compat_uptr_t	phKernelMemInfoHandles;
+	IMG_UINT32		ui32KernelMemInfoHandlesCount;
+	IMG_DEV_VIRTADDR	sHWPBDescDevVAddr;
+} BRIDGE_COMPAT_IN_SGXADDSHAREDPBDESC;
+#endif
+
+#define BRIDGE_COMPAT_HANDLE(x)	((IMG_HANDLE)(IMG_UINTPTR_T)(x))
+
+/*
+ * Read a 32-bit caller's PVRSRV_BRIDGE_IN_WRAP_EXT_MEMORY.
+ *
+ * psBridgeIn : the PVRSRV_BRIDGE_IN_WRAP_EXT_MEMORY to fill in
+ * pvParamIn : the caller's input, in user memory
+ * ui32InBufferSize : the size of the caller's input
+ *
+ * returns PVRSRV_ERROR
+ */
+static PVRSRV_ERROR
+BridgeCompatCopyInWrapExtMemory(IMG_VOID *psBridgeIn,
+								IMG_VOID *pvParamIn,
+								IMG_UINT32 ui32InBufferSize)
+{
+	PVRSRV_BRIDGE_IN_WRAP_EXT_MEMORY *psWrapExtMemIN =
+		(PVRSRV_BRIDGE_IN_WRAP_EXT_MEMORY *)psBridgeIn;
+	BRIDGE_COMPAT_IN_WRAP_EXT_MEMORY sCompatIN;
+
+	if(ui32InBufferSize < sizeof(sCompatIN))
+	{
+		return PVRSRV_ERROR_INVALID_PARAMS;
+	}
+
+	if(OSCopyFromUser(IMG_NULL, &sCompatIN, pvParamIn, sizeof(sCompatIN)) != PVRSRV_OK)
+	{
+		return PVRSRV_ERROR_FAILED_TO_COPY_VIRT_MEMORY;
+	}
+
+	psWrapExtMemIN->hDevCookie = BRIDGE_COMPAT_HANDLE(sCompatIN.hDevCookie);
+	psWrapExtMemIN->hDevMemContext = BRIDGE_COMPAT_HANDLE(sCompatIN.hDevMemContext);
+	psWrapExtMemIN->pvLinAddr = (IMG_VOID *)compat_ptr(sCompatIN.pvLinAddr);
+	psWrapExtMemIN->uByteSize = (IMG_SIZE_T)sCompatIN.uByteSize;
+	psWrapExtMemIN->uPageOffset = (IMG_SIZE_T)sCompatIN.uPageOffset;
+	psWrapExtMemIN->bPhysContig = sCompatIN.bPhysContig;
+	psWrapExtMemIN->ui32NumPageTableEntries = sCompatIN.ui32NumPageTableEntries;
+	psWrapExtMemIN->psSysPAddr = (IMG_SYS_PHYADDR *)compat_ptr(sCompatIN.psSysPAddr);
+	psWrapExtMemIN->ui32Flags = sCompatIN.ui32Flags;
+
+	return PVRSRV_OK;
+}
+
+#if defined(SUPPORT_SGX)
+/*
+ * Read a 32-bit caller's PVRSRV_BRIDGE_IN_SGXADDSHAREDPBDESC.
+ *
+ * psBridgeIn : the PVRSRV_BRIDGE_IN_SGXADDSHAREDPBDESC to fill in
+ * pvParamIn : the caller's input, in user memory
+ * ui32InBufferSize : the size of the caller's input
+ *
+ * returns PVRSRV_ERROR
+ */
+static PVRSRV_ERROR
+BridgeCompatCopyInSGXAddSharedPBDesc(IMG_VOID *psBridgeIn,
+									 IMG_VOID *pvParamIn,
+									 IMG_UINT32 ui32InBufferSize)
+{
+	PVRSRV_BRIDGE_IN_SGXADDSHAREDPBDESC *psSGXAddSharedPBDescIN =
+		(PVRSRV_BRIDGE_IN_SGXADDSHAREDPBDESC *)psBridgeIn;
+	BRIDGE_COMPAT_IN_SGXADDSHAREDPBDESC sCompatIN;
+
+	if(ui32InBufferSize < sizeof(sCompatIN))
+	{
+		return PVRSRV_ERROR_INVALID_PARAMS;
+	}
+
+	if(OSCopyFromUser(IMG_NULL, &sCompatIN, pvParamIn, sizeof(sCompatIN)) != PVRSRV_OK)
+	{
+		return PVRSRV_ERROR_FAILED_TO_COPY_VIRT_MEMORY;
+	}
+
+	psSGXAddSharedPBDescIN->ui32TotalPBSize = sCompatIN.ui32TotalPBSize;
+	psSGXAddSharedPBDescIN->hDevCookie = BRIDGE_COMPAT_HANDLE(sCompatIN.hDevCookie);
+	psSGXAddSharedPBDescIN->hSharedPBDescKernelMemInfo =
+		BRIDGE_COMPAT_HANDLE(sCompatIN.hSharedPBDescKernelMemInfo);
+	psSGXAddSharedPBDescIN->hHWPBDescKernelMemInfo =
+		BRIDGE_COMPAT_HANDLE(sCompatIN.hHWPBDescKernelMemInfo);
+	psSGXAddSharedPBDescIN->hBlockKernelMemInfo =
+		BRIDGE_COMPAT_HANDLE(sCompatIN.hBlockKernelMemInfo);
+	psSGXAddSharedPBDescIN->hHWBlockKernelMemInfo =
+		BRIDGE_COMPAT_HANDLE(sCompatIN.hHWBlockKernelMemInfo);
+	/* An array of 64-bit handles, which the wrapper copies in itself */
+	psSGXAddSharedPBDescIN->phKernelMemInfoHandles =
+		(IMG_HANDLE *)compat_ptr(sCompatIN.phKernelMemInfoHandles);
+	psSGXAddSharedPBDescIN->ui32KernelMemInfoHandlesCount = sCompatIN.ui32KernelMemInfoHandlesCount;
+	psSGXAddSharedPBDescIN->sHWPBDescDevVAddr = sCompatIN.sHWPBDescDevVAddr;
+
+	return PVRSRV_OK;
+}
+#endif /* defined(SUPPORT_SGX) */
+
+/*
+ * Record, in the dispatch table, how to read the input of the calls whose
+ * layout differs for 32-bit callers.  Called once the table is set up.
+ */
+static IMG_VOID
+BridgeCompatInit(IMG_VOID)
+{
+	SetDispatchTableCompatCopyIn(PVRSRV_BRIDGE_WRAP_EXT_MEMORY,
+								 BridgeCompatCopyInWrapExtMemory);
+#if defined(SUPPORT_SGX)
+	SetDispatchTableCompatCopyIn(PVRSRV_BRIDGE_SGX_ADDSHAREDPBDESC,
+								 BridgeCompatCopyInSGXAddSharedPBDesc);
+#endif
+}
+#endif /* defined(CONFIG_COMPAT) */
+
 PVRSRV_ERROR
 LinuxBridgeInit(IMG_VOID)
 {
+	PVRSRV_ERROR eError;
+	IMG_UINT32 ui32CPU;
+
+	/* Device bridge IDs are user mode ABI; new calls go after them */
+#if defined(SUPPORT_SGX)
+	BUILD_BUG_ON(PVRSRV_BRIDGE_SGX_CMD_BASE != PVRSRV_BRIDGE_SYNC_OPS_CMD_LAST + 2);
+#endif
+
+	for_each_possible_cpu(ui32CPU)
+	{
+		BRIDGE_LATENCY *psLatency;
+
+		psLatency = vzalloc_node(sizeof(BRIDGE_LATENCY) * BRIDGE_DISPATCH_TABLE_ENTRY_COUNT,
+								 cpu_to_node(ui32CPU));
+		if(!psLatency)
+		{
+			BridgeLatencyFree();
+			return PVRSRV_ERROR_OUT_OF_MEMORY;
+		}
+		per_cpu(gpsBridgeLatency, ui32CPU) = psLatency;
+	}
+
+	g_ProcBridgeLatency = CreateProcEntrySeq("bridge_latency",
+											 NULL,
+											 ProcSeqNextBridgeLatency,
+											 ProcSeqShowBridgeLatency,
+											 ProcSeqOff2ElementBridgeLatency,
+											 NULL,
+											 ProcWriteBridgeLatency);
+	if(!g_ProcBridgeLatency)
+	{
+		/* The histograms are still kept, just not shown */
+		PVR_DPF((PVR_DBG_WARNING, "%s: Couldn't create bridge_latency", __FUNCTION__));
+	}
+
 #if defined(DEBUG_BRIDGE_KM)
 	{
 		g_ProcBridgeStats = CreateProcReadEntrySeq(
@@ -121,15 +377,191 @@ LinuxBridgeInit(IMG_VOID)
 		}
 	}
 #endif
-	return CommonBridgeInit();
+	eError = CommonBridgeInit();
+	if(eError != PVRSRV_OK)
+	{
+		return eError;
+	}
+
+#if defined(CONFIG_COMPAT)
+	BridgeCompatInit();
+#endif
+	return PVRSRV_OK;
 }
 
 IMG_VOID
 LinuxBridgeDeInit(IMG_VOID)
 {
 #if defined(DEBUG_BRIDGE_KM)
-    RemoveProcEntrySeq(g_ProcBridgeStats);
+	if(g_ProcBridgeStats)
+	{
+		RemoveProcEntrySeq(g_ProcBridgeStats);
+		g_ProcBridgeStats = IMG_NULL;
+	}
+#endif
+	if(g_ProcBridgeLatency)
+	{
+		RemoveProcEntrySeq(g_ProcBridgeLatency);
+		g_ProcBridgeLatency = IMG_NULL;
+	}
+
+	BridgeLatencyFree();
+}
+
+/*
+ * Time stamp for bridge latency accounting: cheap, and only ever compared
+ * with another taken by the same call.
+ */
+static INLINE IMG_UINT64 BridgeLatencyClock(IMG_VOID)
+{
+	return (IMG_UINT64)local_clock();
+}
+
+static INLINE IMG_UINT32 BridgeLatencyBucket(IMG_UINT64 ui64Ns)
+{
+	IMG_UINT32 ui32Bucket = (IMG_UINT32)fls64(ui64Ns);
+
+	return (ui32Bucket < BRIDGE_LATENCY_BUCKETS) ? ui32Bucket : BRIDGE_LATENCY_BUCKETS - 1;
+}
+
+/*
+ * Count a bridge call in this CPU's latency histograms.
+ *
+ * ui32BridgeID : dispatch table index of the call
+ * pui64WaitNs : time the call waited for gPVRSRVLock, or IMG_NULL if it
+ *               didn't take the lock itself
+ * ui64ServiceNs : time the call took once it had the lock
+ */
+static IMG_VOID BridgeLatencyRecord(IMG_UINT32 ui32BridgeID,
+									IMG_UINT64 *pui64WaitNs,
+									IMG_UINT64 ui64ServiceNs)
+{
+	BRIDGE_LATENCY *psLatency;
+
+	if(ui32BridgeID >= BRIDGE_DISPATCH_TABLE_ENTRY_COUNT)
+	{
+		return;
+	}
+
+	psLatency = get_cpu_var(gpsBridgeLatency);
+	if(psLatency)
+	{
+		psLatency += ui32BridgeID;
+		if(pui64WaitNs)
+		{
+			psLatency->aui32Wait[BridgeLatencyBucket(*pui64WaitNs)]++;
+		}
+		psLatency->aui32Service[BridgeLatencyBucket(ui64ServiceNs)]++;
+	}
+	put_cpu_var(gpsBridgeLatency);
+}
+
+static void* ProcSeqOff2ElementBridgeLatency(struct seq_file *sfile, loff_t off)
+{
+	if(!off)
+	{
+		return PVR_PROC_SEQ_START_TOKEN;
+	}
+
+	if(off > BRIDGE_DISPATCH_TABLE_ENTRY_COUNT)
+	{
+		return (void*)0;
+	}
+
+	return (void*)&g_BridgeDispatchTable[off-1];
+}
+
+static void* ProcSeqNextBridgeLatency(struct seq_file *sfile,void* el,loff_t off)
+{
+	return ProcSeqOff2ElementBridgeLatency(sfile,off);
+}
+
+/*
+ * Show the latency histograms of one bridge call, summed over all CPUs.
+ * Calls that have not been made since the last reset are left out.
+ *
+ * sfile : seq_file that handles /proc file
+ * el : the call's dispatch table entry
+ */
+static void ProcSeqShowBridgeLatency(struct seq_file *sfile,void* el)
+{
+	PVRSRV_BRIDGE_DISPATCH_TABLE_ENTRY *psEntry = (PVRSRV_BRIDGE_DISPATCH_TABLE_ENTRY*)el;
+	IMG_UINT32 ui32BridgeID;
+	BRIDGE_LATENCY sSum;
+	IMG_UINT32 ui32CPU, i;
+	IMG_UINT64 ui64Calls = 0;
+
+	if(el == PVR_PROC_SEQ_START_TOKEN)
+	{
+		seq_printf(sfile,
+				   "Bridge call latency since the last reset (write to this file to reset)\n"
+				   "Column n counts calls taking [2^(n-1), 2^n) ns, the last column longer\n"
+				   "wait: waiting for the services lock, service: holding it\n\n");
+		return;
+	}
+
+	ui32BridgeID = (IMG_UINT32)(psEntry - g_BridgeDispatchTable);
+
+	memset(&sSum, 0, sizeof(sSum));
+	for_each_possible_cpu(ui32CPU)
+	{
+		BRIDGE_LATENCY *psLatency = &per_cpu(gpsBridgeLatency, ui32CPU)[ui32BridgeID];
+
+		for(i = 0; i < BRIDGE_LATENCY_BUCKETS; i++)
+		{
+			sSum.aui32Wait[i] += psLatency->aui32Wait[i];
+			sSum.aui32Service[i] += psLatency->aui32Service[i];
+		}
+	}
+
+	for(i = 0; i < BRIDGE_LATENCY_BUCKETS; i++)
+	{
+		ui64Calls += sSum.aui32Service[i];
+	}
+	if(ui64Calls == 0)
+	{
+		return;
+	}
+
+#if defined(DEBUG_BRIDGE_KM)
+	seq_printf(sfile, "%-4u %s calls %llu\n", ui32BridgeID, psEntry->pszIOCName, ui64Calls);
+#else
+	seq_printf(sfile, "%-4u calls %llu\n", ui32BridgeID, ui64Calls);
 #endif
+
+	seq_printf(sfile, "     wait    ");
+	for(i = 0; i < BRIDGE_LATENCY_BUCKETS; i++)
+	{
+		seq_printf(sfile, " %u", sSum.aui32Wait[i]);
+	}
+	seq_printf(sfile, "\n     service ");
+	for(i = 0; i < BRIDGE_LATENCY_BUCKETS; i++)
+	{
+		seq_printf(sfile, " %u", sSum.aui32Service[i]);
+	}
+	seq_printf(sfile, "\n");
+}
+
+/*
+ * Reset the bridge latency histograms (called on any write to the file).
+ * Calls being counted meanwhile may survive the reset.
+ */
+static int ProcWriteBridgeLatency(struct file *file, const char __user *buffer,
+								  unsigned long count, void *data)
+{
+	IMG_UINT32 ui32CPU;
+
+	PVR_UNREFERENCED_PARAMETER(file);
+	PVR_UNREFERENCED_PARAMETER(buffer);
+	PVR_UNREFERENCED_PARAMETER(data);
+
+	for_each_possible_cpu(ui32CPU)
+	{
+		memset(per_cpu(gpsBridgeLatency, ui32CPU), 0,
+			   sizeof(BRIDGE_LATENCY) * BRIDGE_DISPATCH_TABLE_ENTRY_COUNT);
+	}
+
+	return (int)count;
 }
 
 #if defined(DEBUG_BRIDGE_KM)
@@ -145,11 +577,11 @@ static void ProcSeqStartstopBridgeStats(struct seq_file *sfile,IMG_BOOL start)
 {
 	if(start) 
 	{
-		LinuxLockMutexNested(&gPVRSRVLock, PVRSRV_LOCK_CLASS_BRIDGE);
+		LinuxLockRWLockShared(&gPVRSRVLock);
 	}
 	else
 	{
-		LinuxUnLockMutex(&gPVRSRVLock);
+		LinuxUnLockRWLock(&gPVRSRVLock);
 	}
 }
 
@@ -238,70 +670,76 @@ static void ProcSeqShowBridgeStats(struct seq_file *sfile,void* el)
 #endif /* DEBUG_BRIDGE_KM */
 
 
-#if defined(SUPPORT_DRI_DRM)
-int
-PVRSRV_BridgeDispatchKM(struct drm_device unref__ *dev, void *arg, struct drm_file *pFile)
-#else
-long
-PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsigned long arg)
-#endif
+/*
+ * Find the per-process data cached in a file when it was opened, if the
+ * kernel services handle of a bridge call names it.  The file holds a
+ * reference on the data, so it lives as long as the file does; the
+ * generation check is cheap insurance against a stale pointer.
+ *
+ * pFile : the file the call is made on
+ * hKernelServices : the kernel services handle the call names
+ *
+ * returns PVRSRV_PER_PROCESS_DATA* : the per-process data, or IMG_NULL if
+ *                                    the handle must be looked up
+ */
+static INLINE PVRSRV_PER_PROCESS_DATA *
+BridgeCachedPerProc(PVRSRV_BRIDGE_FILE *pFile, IMG_HANDLE hKernelServices)
 {
-	IMG_UINT32 cmd;
-#if !defined(SUPPORT_DRI_DRM)
-	PVRSRV_BRIDGE_PACKAGE *psBridgePackageUM = (PVRSRV_BRIDGE_PACKAGE *)arg;
-	PVRSRV_BRIDGE_PACKAGE sBridgePackageKM;
-#endif
-	PVRSRV_BRIDGE_PACKAGE *psBridgePackageKM;
-	IMG_UINT32 ui32PID = OSGetCurrentProcessIDKM();
-	PVRSRV_PER_PROCESS_DATA *psPerProc;
-	IMG_INT err = -EFAULT;
-
-	LinuxLockMutexNested(&gPVRSRVLock, PVRSRV_LOCK_CLASS_BRIDGE);
-
-#if defined(SUPPORT_DRI_DRM)
-	psBridgePackageKM = (PVRSRV_BRIDGE_PACKAGE *)arg;
-	PVR_ASSERT(psBridgePackageKM != IMG_NULL);
-#else
-	psBridgePackageKM = &sBridgePackageKM;
-
-	if(!OSAccessOK(PVR_VERIFY_WRITE,
-				   psBridgePackageUM,
-				   sizeof(PVRSRV_BRIDGE_PACKAGE)))
-	{
-		PVR_DPF((PVR_DBG_ERROR, "%s: Received invalid pointer to function arguments",
-				 __FUNCTION__));
+	PVRSRV_FILE_PRIVATE_DATA *psPrivateData = PRIVATE_DATA(pFile);
+	PVRSRV_PER_PROCESS_DATA *psPerProc = psPrivateData->psPerProc;
 
-		goto unlock_and_return;
-	}
-	
-	/* FIXME - Currently the CopyFromUserWrapper which collects stats about
-	 * how much data is shifted to/from userspace isn't available to us
-	 * here. */
-	if(OSCopyFromUser(IMG_NULL,
-					  psBridgePackageKM,
-					  psBridgePackageUM,
-					  sizeof(PVRSRV_BRIDGE_PACKAGE))
-	  != PVRSRV_OK)
+#if defined(DEBUG_BRIDGE_KM)
+	if(gPVRBridgePerProcCache == 0)
 	{
-		goto unlock_and_return;
+		return IMG_NULL;
 	}
 #endif
 
-	cmd = psBridgePackageKM->ui32BridgeID;
-	
-	if(cmd != PVRSRV_BRIDGE_CONNECT_SERVICES)
+	if(psPerProc == IMG_NULL ||
+	   hKernelServices != psPrivateData->hKernelServices ||
+	   psPerProc->ui32Generation != psPrivateData->ui32PerProcGeneration)
 	{
-		PVRSRV_ERROR eError;
+		return IMG_NULL;
+	}
+
+	return psPerProc;
+}
 
-		eError = PVRSRVLookupHandle(KERNEL_HANDLE_BASE,
-									(IMG_PVOID *)&psPerProc,
-									psBridgePackageKM->hKernelServices,
-									PVRSRV_HANDLE_TYPE_PERPROC_DATA);
-		if(eError != PVRSRV_OK)
+/*
+ * Find the per-process data a bridge call is made for, creating it if the
+ * call connects to services.  Called with gPVRSRVLock held.
+ *
+ * pFile : the file the call is made on
+ * psBridgePackageKM : the call, copied into the kernel
+ *
+ * returns PVRSRV_PER_PROCESS_DATA* : the per-process data, or IMG_NULL if
+ *                                    the call may not be made
+ */
+static PVRSRV_PER_PROCESS_DATA *
+BridgeLookupPerProc(PVRSRV_BRIDGE_FILE *pFile,
+					PVRSRV_BRIDGE_PACKAGE *psBridgePackageKM)
+{
+	IMG_UINT32 ui32PID = OSGetCurrentProcessIDKM();
+	PVRSRV_PER_PROCESS_DATA *psPerProc;
+
+	if(PVRSRV_GET_BRIDGE_ID(psBridgePackageKM->ui32BridgeID) !=
+	   PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_CONNECT_SERVICES))
+	{
+		psPerProc = BridgeCachedPerProc(pFile, psBridgePackageKM->hKernelServices);
+		if(psPerProc == IMG_NULL)
 		{
-			PVR_DPF((PVR_DBG_ERROR, "%s: Invalid kernel services handle (%d)",
-					 __FUNCTION__, eError));
-			goto unlock_and_return;
+			PVRSRV_ERROR eError;
+
+			eError = PVRSRVLookupHandle(KERNEL_HANDLE_BASE,
+										(IMG_PVOID *)&psPerProc,
+										psBridgePackageKM->hKernelServices,
+										PVRSRV_HANDLE_TYPE_PERPROC_DATA);
+			if(eError != PVRSRV_OK)
+			{
+				PVR_DPF((PVR_DBG_ERROR, "%s: Invalid kernel services handle (%d)",
+						 __FUNCTION__, eError));
+				return IMG_NULL;
+			}
 		}
 
 		if(psPerProc->ui32PID != ui32PID)
@@ -309,7 +747,7 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 			PVR_DPF((PVR_DBG_ERROR, "%s: Process %d tried to access data "
 					 "belonging to process %d", __FUNCTION__, ui32PID,
 					 psPerProc->ui32PID));
-			goto unlock_and_return;
+			return IMG_NULL;
 		}
 	}
 	else
@@ -320,15 +758,37 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 		{
 			PVR_DPF((PVR_DBG_ERROR, "PVRSRV_BridgeDispatchKM: "
 					 "Couldn't create per-process data area"));
-			goto unlock_and_return;
+			return IMG_NULL;
 		}
 	}
 
-	psBridgePackageKM->ui32BridgeID = PVRSRV_GET_BRIDGE_ID(psBridgePackageKM->ui32BridgeID);
+	return psPerProc;
+}
+
+/*
+ * Make one bridge call, with the checks and fix-ups that depend on the file
+ * it is made on.  Called with gPVRSRVLock held.
+ *
+ * pFile : the file the call is made on
+ * psPerProc : the per-process data the call is made for
+ * psBridgePackageKM : the call, copied into the kernel, with ui32BridgeID
+ *                     already turned into a dispatch table index
+ * bCompat : the call was made by a 32-bit process
+ *
+ * returns IMG_INT : what the ioctl returns for the call
+ */
+static IMG_INT
+BridgeDispatchCallKM(PVRSRV_BRIDGE_FILE *pFile,
+					 PVRSRV_PER_PROCESS_DATA *psPerProc,
+					 PVRSRV_BRIDGE_PACKAGE *psBridgePackageKM,
+					 IMG_BOOL bCompat)
+{
+	IMG_UINT32 cmd = psBridgePackageKM->ui32BridgeID;
+	IMG_INT err = -EFAULT;
 
 	switch(cmd)
 	{
-		case PVRSRV_BRIDGE_EXPORT_DEVICEMEM_2:
+		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_EXPORT_DEVICEMEM_2):
 		{
 			PVRSRV_FILE_PRIVATE_DATA *psPrivateData = PRIVATE_DATA(pFile);
 
@@ -336,13 +796,12 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 			{
 				PVR_DPF((PVR_DBG_ERROR, "%s: Can only export one MemInfo "
 						 "per file descriptor", __FUNCTION__));
-				err = -EINVAL;
-				goto unlock_and_return;
+				return -EINVAL;
 			}
 			break;
 		}
 
-		case PVRSRV_BRIDGE_MAP_DEV_MEMORY_2:
+		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_MAP_DEV_MEMORY_2):
 		{
 			PVRSRV_BRIDGE_IN_MAP_DEV_MEMORY *psMapDevMemIN =
 				(PVRSRV_BRIDGE_IN_MAP_DEV_MEMORY *)(IMG_UINTPTR_T)psBridgePackageKM->hParamIn;
@@ -352,14 +811,12 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 			{
 				PVR_DPF((PVR_DBG_ERROR, "%s: File descriptor has no "
 						 "associated MemInfo handle", __FUNCTION__));
-				err = -EINVAL;
-				goto unlock_and_return;
+				return -EINVAL;
 			}
 
 			if (pvr_put_user(psPrivateData->hKernelMemInfo, &psMapDevMemIN->hKernelMemInfo) != 0)
 			{
-				err = -EFAULT;
-				goto unlock_and_return;
+				return -EFAULT;
 			}
 			break;
 		}
@@ -372,7 +829,7 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 			{
 				PVR_DPF((PVR_DBG_ERROR, "%s: Import/Export handle tried "
 						 "to use privileged service", __FUNCTION__));
-				goto unlock_and_return;
+				return err;
 			}
 			break;
 		}
@@ -381,8 +838,8 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 #if defined(SUPPORT_DRI_DRM) && defined(PVR_SECURE_DRM_AUTH_EXPORT)
 	switch(cmd)
 	{
-		case PVRSRV_BRIDGE_MAP_DEV_MEMORY:
-		case PVRSRV_BRIDGE_MAP_DEVICECLASS_MEMORY:
+		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_MAP_DEV_MEMORY):
+		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_MAP_DEVICECLASS_MEMORY):
 		{
 			PVRSRV_FILE_PRIVATE_DATA *psPrivateData;
 			int authenticated = pFile->authenticated;
@@ -404,8 +861,7 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 			if (psEnvPerProc == IMG_NULL)
 			{
 				PVR_DPF((PVR_DBG_ERROR, "%s: Process private data not allocated", __FUNCTION__));
-				err = -EFAULT;
-				goto unlock_and_return;
+				return -EFAULT;
 			}
 
 			list_for_each_entry(psPrivateData, &psEnvPerProc->sDRMAuthListHead, sDRMAuthListItem)
@@ -425,8 +881,7 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 			if (!authenticated)
 			{
 				PVR_DPF((PVR_DBG_ERROR, "%s: Not authenticated for mapping device or device class memory", __FUNCTION__));
-				err = -EPERM;
-				goto unlock_and_return;
+				return -EPERM;
 			}
 			break;
 		}
@@ -435,13 +890,13 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 	}
 #endif /* defined(SUPPORT_DRI_DRM) && defined(PVR_SECURE_DRM_AUTH_EXPORT) */
 
-	err = BridgedDispatchKM(psPerProc, psBridgePackageKM);
+	err = BridgedDispatchKM(psPerProc, psBridgePackageKM, bCompat);
 	if(err != PVRSRV_OK)
-		goto unlock_and_return;
+		return err;
 
 	switch(cmd)
 	{
-		case PVRSRV_BRIDGE_EXPORT_DEVICEMEM_2:
+		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_EXPORT_DEVICEMEM_2):
 		{
 			PVRSRV_BRIDGE_OUT_EXPORTDEVICEMEM *psExportDeviceMemOUT =
 				(PVRSRV_BRIDGE_OUT_EXPORTDEVICEMEM *)(IMG_UINTPTR_T)psBridgePackageKM->hParamOut;
@@ -451,8 +906,7 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 
 			if (pvr_get_user(hMemInfo, &psExportDeviceMemOUT->hMemInfo) != 0)
 			{
-				err = -EFAULT;
-				goto unlock_and_return;
+				return -EFAULT;
 			}
 
 			/* Look up the meminfo we just exported */
@@ -462,8 +916,7 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 								  PVRSRV_HANDLE_TYPE_MEM_INFO) != PVRSRV_OK)
 			{
 				PVR_DPF((PVR_DBG_ERROR, "%s: Failed to look up export handle", __FUNCTION__));
-				err = -EFAULT;
-				goto unlock_and_return;
+				return -EFAULT;
 			}
 
 			/* Bump the refcount; decremented on release of the fd */
@@ -482,36 +935,33 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 			psKernelMemInfo->ui64Stamp = psPrivateData->ui64Stamp;
 			if (pvr_put_user(psPrivateData->ui64Stamp, &psExportDeviceMemOUT->ui64Stamp) != 0)
 			{
-				err = -EFAULT;
-				goto unlock_and_return;
+				return -EFAULT;
 			}
 #endif
 			break;
 		}
 
 #if defined(SUPPORT_MEMINFO_IDS)
-		case PVRSRV_BRIDGE_MAP_DEV_MEMORY:
-		case PVRSRV_BRIDGE_MAP_DEV_MEMORY_2:
+		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_MAP_DEV_MEMORY):
+		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_MAP_DEV_MEMORY_2):
 		{
 			PVRSRV_BRIDGE_OUT_MAP_DEV_MEMORY *psMapDeviceMemoryOUT =
 				(PVRSRV_BRIDGE_OUT_MAP_DEV_MEMORY *)(IMG_UINTPTR_T)psBridgePackageKM->hParamOut;
 			PVRSRV_FILE_PRIVATE_DATA *psPrivateData = PRIVATE_DATA(pFile);
 			if (pvr_put_user(psPrivateData->ui64Stamp, &psMapDeviceMemoryOUT->sDstClientMemInfo.ui64Stamp) != 0)
 			{
-				err = -EFAULT;
-				goto unlock_and_return;
+				return -EFAULT;
 			}
 			break;
 		}
 
-		case PVRSRV_BRIDGE_MAP_DEVICECLASS_MEMORY:
+		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_MAP_DEVICECLASS_MEMORY):
 		{
 			PVRSRV_BRIDGE_OUT_MAP_DEVICECLASS_MEMORY *psDeviceClassMemoryOUT =
 				(PVRSRV_BRIDGE_OUT_MAP_DEVICECLASS_MEMORY *)(IMG_UINTPTR_T)psBridgePackageKM->hParamOut;
 			if (pvr_put_user(++g_ui64MemInfoID, &psDeviceClassMemoryOUT->sClientMemInfo.ui64Stamp) != 0)
 			{
-				err = -EFAULT;
-				goto unlock_and_return;
+				return -EFAULT;
 			}
 			break;
 		}
@@ -521,243 +971,924 @@ PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsig
 			break;
 	}
 
-unlock_and_return:
-	LinuxUnLockMutex(&gPVRSRVLock);
-	return err;
+	return 0;
 }
 
-#if defined(CONFIG_COMPAT)
-#if defined(SUPPORT_DRI_DRM)
-int
-PVRSRV_BridgeCompatDispatchKM(struct drm_device unref__ *dev, void *arg, struct drm_file *pFile)
-#else
-long PVRSRV_BridgeCompatDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsigned long arg)
-#endif
+/*
+ * Make the calls in a PVRSRV_BRIDGE_BATCH, taking gPVRSRVLock and looking
+ * up the per-process data once for all of them.
+ *
+ * pFile : the file the batch is made on
+ * psBridgePackageKM : the batch, copied into the kernel
+ * bCompat : the batch was made by a 32-bit process
+ *
+ * returns IMG_INT : 0 if the calls were attempted (each call's result is
+ *                   returned in the batch's output), else a negative errno
+ */
+static IMG_INT
+BridgeDispatchBatchKM(PVRSRV_BRIDGE_FILE *pFile,
+					  PVRSRV_BRIDGE_PACKAGE *psBridgePackageKM,
+					  IMG_BOOL bCompat)
 {
-	struct bridge_package_from_32
-	{
-		IMG_UINT32	bridge_id;              /*!< ioctl bridge group */
-		IMG_UINT32	size;                   /*!< size of structure */
-		IMG_UINT64	addr_param_in;          /*!< input data buffer */
-		IMG_UINT64	addr_param_out;         /*!< output data buffer */
-		IMG_UINT32	in_buffer_size;         /*!< size of input data buffer */
-		IMG_UINT32	out_buffer_size;        /*!< size of output data buffer */
-		IMG_UINT64	hKernelServices;        /*!< kernel servcies handle */
-	};
-
-#if !defined(SUPPORT_DRI_DRM)
-	struct bridge_package_from_32 params;
-	struct bridge_package_from_32 * const params_addr = &params;
-#endif
-	PVRSRV_BRIDGE_PACKAGE sBridgePackageKM;
-	PVRSRV_BRIDGE_PACKAGE *psBridgePackageKM;
-	IMG_UINT32 ui32PID = OSGetCurrentProcessIDKM();
+	IMG_UINT32 ui32BridgeID = PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_BATCH);
+	PVRSRV_BRIDGE_IN_BATCH *psBatchIN;
+	PVRSRV_BRIDGE_OUT_BATCH *psBatchOUT;
 	PVRSRV_PER_PROCESS_DATA *psPerProc;
+	IMG_VOID *pvBuffer;
+	IMG_BOOL bConcurrent = IMG_TRUE;
+	IMG_UINT64 ui64Start, ui64Locked, ui64WaitNs;
+	IMG_UINT32 i;
 	IMG_INT err = -EFAULT;
- 
-	LinuxLockMutexNested(&gPVRSRVLock, PVRSRV_LOCK_CLASS_BRIDGE);
-#if defined(SUPPORT_DRI_DRM)
-	sBridgePackageKM = (PVRSRV_BRIDGE_PACKAGE)(*(PVRSRV_BRIDGE_PACKAGE*)arg);
-	psBridgePackageKM = (PVRSRV_BRIDGE_PACKAGE *)arg;
-	PVR_ASSERT(psBridgePackageKM != IMG_NULL);
-#else
-	if(!OSAccessOK(PVR_VERIFY_READ, (void *) arg, sizeof(struct bridge_package_from_32)))
+
+#if defined(DEBUG_BRIDGE_KM)
+	g_BridgeDispatchTable[ui32BridgeID].ui32CallCount++;
+	g_BridgeGlobalStats.ui32IOCTLCount++;
+#endif
+
+	if(psBridgePackageKM->ui32InBufferSize < offsetof(PVRSRV_BRIDGE_IN_BATCH, asCalls) ||
+	   psBridgePackageKM->ui32InBufferSize > sizeof(PVRSRV_BRIDGE_IN_BATCH) ||
+	   psBridgePackageKM->ui32OutBufferSize < offsetof(PVRSRV_BRIDGE_OUT_BATCH, ai32Results))
 	{
-		PVR_DPF((PVR_DBG_ERROR, "%s: Received invalid pointer to function arguments", __FUNCTION__));
-		goto unlock_and_return;
+		return -EINVAL;
 	}
 
-	if(OSCopyFromUser(NULL, params_addr, (void*) arg, sizeof(struct bridge_package_from_32))
-		!= PVRSRV_OK)
+	/* The batch is too big for the stack, but fits in a bridge buffer */
+	if(OSAcquireBridgeBuffer(&pvBuffer) != PVRSRV_OK)
 	{
-		goto unlock_and_return;
+		return -ENOMEM;
 	}
-    
-	sBridgePackageKM.ui32BridgeID = PVRSRV_GET_BRIDGE_ID(params_addr->bridge_id);
-	sBridgePackageKM.ui32Size = sizeof(sBridgePackageKM);
-	sBridgePackageKM.hParamIn = (IMG_HANDLE) ((IMG_UINTPTR_T) params_addr->addr_param_in);
-	sBridgePackageKM.hParamOut = (IMG_HANDLE) ((IMG_UINTPTR_T) params_addr->addr_param_out);
-	sBridgePackageKM.ui32InBufferSize = params_addr->in_buffer_size;
-	sBridgePackageKM.ui32OutBufferSize = params_addr->out_buffer_size;
-	sBridgePackageKM.hKernelServices = (IMG_HANDLE) ((IMG_SIZE_T) params_addr->hKernelServices);
-            
-	psBridgePackageKM = &sBridgePackageKM;
-#endif
-	if(sBridgePackageKM.ui32BridgeID != PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_CONNECT_SERVICES))
+	psBatchIN = (PVRSRV_BRIDGE_IN_BATCH *)pvBuffer;
+	psBatchOUT = (PVRSRV_BRIDGE_OUT_BATCH *)((IMG_PBYTE)pvBuffer + PVRSRV_MAX_BRIDGE_IN_SIZE);
+
+	if(CopyFromUserWrapper(IMG_NULL,
+						   ui32BridgeID,
+						   psBatchIN,
+						   psBridgePackageKM->hParamIn,
+						   psBridgePackageKM->ui32InBufferSize) != PVRSRV_OK)
 	{
-		PVRSRV_ERROR eError;
+		goto release_and_return;
+	}
 
-		eError = PVRSRVLookupHandle(KERNEL_HANDLE_BASE,
-									(IMG_PVOID *)&psPerProc,
-									psBridgePackageKM->hKernelServices,
-									PVRSRV_HANDLE_TYPE_PERPROC_DATA);
-		if(eError != PVRSRV_OK)
-		{
-			PVR_DPF((PVR_DBG_ERROR, "%s: Invalid kernel services handle (%d)",
-					 __FUNCTION__, eError));
-			goto unlock_and_return;
-		}
+	if(psBatchIN->ui32NumCalls > PVRSRV_BRIDGE_BATCH_MAX_CALLS ||
+	   psBridgePackageKM->ui32InBufferSize <
+		offsetof(PVRSRV_BRIDGE_IN_BATCH, asCalls) + psBatchIN->ui32NumCalls * sizeof(PVRSRV_BRIDGE_PACKAGE) ||
+	   psBridgePackageKM->ui32OutBufferSize <
+		offsetof(PVRSRV_BRIDGE_OUT_BATCH, ai32Results) + psBatchIN->ui32NumCalls * sizeof(IMG_INT32))
+	{
+		err = -EINVAL;
+		goto release_and_return;
+	}
 
-		if(psPerProc->ui32PID != ui32PID)
+	for(i = 0; i < psBatchIN->ui32NumCalls; i++)
+	{
+		if(!BridgeCallIsConcurrent(&psBatchIN->asCalls[i]))
 		{
-			PVR_DPF((PVR_DBG_ERROR, "%s: Process %d tried to access data "
-					 "belonging to process %d", __FUNCTION__, ui32PID,
-					 psPerProc->ui32PID));
-			goto unlock_and_return;
+			bConcurrent = IMG_FALSE;
+			break;
 		}
 	}
+
+	ui64Start = BridgeLatencyClock();
+	if(bConcurrent)
+	{
+		LinuxLockRWLockShared(&gPVRSRVLock);
+	}
 	else
 	{
-		/* lookup per-process data for this process */
-		psPerProc = PVRSRVPerProcessData(ui32PID);
-		if(psPerProc == IMG_NULL)
-		{
-			PVR_DPF((PVR_DBG_ERROR, "PVRSRV_BridgeDispatchKM: "
-					 "Couldn't create per-process data area"));
-			goto unlock_and_return;
-		}
+		LinuxLockRWLock(&gPVRSRVLock);
 	}
+	ui64Locked = BridgeLatencyClock();
+	ui64WaitNs = ui64Locked - ui64Start;
 
-	switch(sBridgePackageKM.ui32BridgeID)
+	psPerProc = BridgeLookupPerProc(pFile, psBridgePackageKM);
+	if(psPerProc == IMG_NULL)
 	{
-		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_EXPORT_DEVICEMEM_2):
-		{
-			PVRSRV_FILE_PRIVATE_DATA *psPrivateData = PRIVATE_DATA(pFile);
+		LinuxUnLockRWLock(&gPVRSRVLock);
+		BridgeLatencyRecord(ui32BridgeID, &ui64WaitNs, BridgeLatencyClock() - ui64Locked);
+		goto release_and_return;
+	}
 
-			if(psPrivateData->hKernelMemInfo)
-			{
-				PVR_DPF((PVR_DBG_ERROR, "%s: Can only export one MemInfo "
-						 "per file descriptor", __FUNCTION__));
-				err = -EINVAL;
-				goto unlock_and_return;
-			}
-			break;
-		}
+	psBatchOUT->ui32NumCallsMade = 0;
 
-		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_MAP_DEV_MEMORY_2):
-		{
-			PVRSRV_BRIDGE_IN_MAP_DEV_MEMORY *psMapDevMemIN =
-				(PVRSRV_BRIDGE_IN_MAP_DEV_MEMORY *)(IMG_UINTPTR_T)psBridgePackageKM->hParamIn;
-			PVRSRV_FILE_PRIVATE_DATA *psPrivateData = PRIVATE_DATA(pFile);
+	for(i = 0; i < psBatchIN->ui32NumCalls; i++)
+	{
+		PVRSRV_BRIDGE_PACKAGE *psCall = &psBatchIN->asCalls[i];
+		IMG_UINT64 ui64CallStart = BridgeLatencyClock();
+		IMG_INT iResult;
 
-			if(!psPrivateData->hKernelMemInfo)
-			{
-				PVR_DPF((PVR_DBG_ERROR, "%s: File descriptor has no "
-						 "associated MemInfo handle", __FUNCTION__));
-				err = -EINVAL;
-				goto unlock_and_return;
-			}
+		psCall->ui32BridgeID = PVRSRV_GET_BRIDGE_ID(psCall->ui32BridgeID);
 
-			if (pvr_put_user(psPrivateData->hKernelMemInfo, &psMapDevMemIN->hKernelMemInfo) != 0)
-			{
-				err = -EFAULT;
-				goto unlock_and_return;
-			}
-			break;
+		switch(psCall->ui32BridgeID)
+		{
+			/* These change the per-process data the batch is made for */
+			case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_CONNECT_SERVICES):
+			case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_DISCONNECT_SERVICES):
+			case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_BATCH):
+				PVR_DPF((PVR_DBG_ERROR, "%s: Bridge call %u can't be batched",
+						 __FUNCTION__, psCall->ui32BridgeID));
+				iResult = -EINVAL;
+				break;
+
+			default:
+				iResult = BridgeDispatchCallKM(pFile, psPerProc, psCall, bCompat);
+				/* The batch waited for the lock, not the call */
+				BridgeLatencyRecord(psCall->ui32BridgeID, IMG_NULL,
+									BridgeLatencyClock() - ui64CallStart);
+				break;
 		}
 
-		default:
-		{
-			PVRSRV_FILE_PRIVATE_DATA *psPrivateData = PRIVATE_DATA(pFile);
+		psBatchOUT->ai32Results[i] = iResult;
+		psBatchOUT->ui32NumCallsMade++;
 
-			if(psPrivateData->hKernelMemInfo)
-			{
-				PVR_DPF((PVR_DBG_ERROR, "%s: Import/Export handle tried "
-						 "to use privileged service", __FUNCTION__));
-				goto unlock_and_return;
-			}
+		if(iResult != 0 && (psBatchIN->ui32Flags & PVRSRV_BRIDGE_BATCH_FLAGS_STOP_ON_ERROR))
+		{
 			break;
 		}
 	}
 
-	err = BridgedDispatchKM(psPerProc, psBridgePackageKM);
-	if(err != PVRSRV_OK)
+	LinuxUnLockRWLock(&gPVRSRVLock);
+	BridgeLatencyRecord(ui32BridgeID, &ui64WaitNs, BridgeLatencyClock() - ui64Locked);
+
+	if(CopyToUserWrapper(psPerProc,
+						 ui32BridgeID,
+						 psBridgePackageKM->hParamOut,
+						 psBatchOUT,
+						 offsetof(PVRSRV_BRIDGE_OUT_BATCH, ai32Results) +
+						 psBatchOUT->ui32NumCallsMade * sizeof(IMG_INT32)) != PVRSRV_OK)
+	{
+		goto release_and_return;
+	}
+
+	err = 0;
+
+release_and_return:
+	OSReleaseBridgeBuffer(pvBuffer);
+	return err;
+}
+
+/*
+ * Free a submission ring and its handle.  Called with gPVRSRVLock held for
+ * writing.
+ *
+ * psRingKM : the ring
+ *
+ * returns PVRSRV_ERROR : PVRSRV_ERROR_STILL_MAPPED if the client still has
+ *                        the ring mapped, in which case nothing is freed
+ */
+static PVRSRV_ERROR
+BridgeFreeSubmitRing(PVRSRV_SUBMIT_RING_KM *psRingKM)
+{
+	PVRSRV_ERROR eError;
+
+	eError = OSFreePages(SUBMIT_RING_ALLOC_FLAGS,
+						 psRingKM->uiBytes,
+						 psRingKM->psRing,
+						 psRingKM->hOSMemHandle);
+	if(eError != PVRSRV_OK)
+	{
+		return eError;
+	}
+
+	eError = PVRSRVReleaseHandle(psRingKM->psPerProc->psHandleBase,
+								 psRingKM->hRing,
+								 PVRSRV_HANDLE_TYPE_SUBMIT_RING);
+	if(eError != PVRSRV_OK)
+	{
+		PVR_DPF((PVR_DBG_ERROR, "%s: Couldn't release ring handle (%d)",
+				 __FUNCTION__, eError));
+	}
+
+	OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(PVRSRV_SUBMIT_RING_KM), psRingKM, IMG_NULL);
+
+	return PVRSRV_OK;
+}
+
+/*
+ * Resource manager callback: free a submission ring whose file was closed
+ * while it was mapped through another, once the process's last connection
+ * has gone and nothing can map it any more.
+ */
+static PVRSRV_ERROR
+BridgeFreeSubmitRingCallBack(IMG_PVOID pvParam, IMG_UINT32 ui32Param, IMG_BOOL bForceCleanup)
+{
+	PVR_UNREFERENCED_PARAMETER(ui32Param);
+	PVR_UNREFERENCED_PARAMETER(bForceCleanup);
+
+	return BridgeFreeSubmitRing((PVRSRV_SUBMIT_RING_KM *)pvParam);
+}
+
+/*
+ * Free a submission ring, and its resource manager entry, unless it is
+ * still mapped.  Called with gPVRSRVLock held for writing.
+ *
+ * psRingKM : the ring
+ *
+ * returns PVRSRV_ERROR : PVRSRV_ERROR_STILL_MAPPED if the ring is mapped,
+ *                        in which case nothing is freed
+ */
+static PVRSRV_ERROR
+BridgeDestroySubmitRing(PVRSRV_SUBMIT_RING_KM *psRingKM)
+{
+	PRESMAN_ITEM hResItem = psRingKM->hResItem;
+	PVRSRV_ERROR eError;
+
+	eError = BridgeFreeSubmitRing(psRingKM);
+	if(eError != PVRSRV_OK)
+	{
+		return eError;
+	}
+
+	/* Drop the entry without calling back */
+	return ResManDissociateRes(hResItem, IMG_NULL);
+}
+
+/*
+ * Create the submission ring for the connection a
+ * PVRSRV_BRIDGE_CREATE_SUBMIT_RING is made on.
+ *
+ * pFile : the file the call is made on
+ * psBridgePackageKM : the call, copied into the kernel
+ *
+ * returns IMG_INT : what the ioctl returns
+ */
+static IMG_INT
+BridgeCreateSubmitRingKM(PVRSRV_BRIDGE_FILE *pFile,
+						 PVRSRV_BRIDGE_PACKAGE *psBridgePackageKM)
+{
+	IMG_UINT32 ui32BridgeID = PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_CREATE_SUBMIT_RING);
+	PVRSRV_FILE_PRIVATE_DATA *psPrivateData = PRIVATE_DATA(pFile);
+	PVRSRV_BRIDGE_IN_CREATE_SUBMIT_RING sCreateIN;
+	PVRSRV_BRIDGE_OUT_CREATE_SUBMIT_RING sCreateOUT;
+	PVRSRV_SUBMIT_RING_KM *psRingKM = IMG_NULL;
+	PVRSRV_PER_PROCESS_DATA *psPerProc;
+	IMG_UINT32 ui32NumSlots;
+	IMG_UINT64 ui64Start, ui64Locked, ui64WaitNs;
+	IMG_INT err = -EFAULT;
+
+#if defined(DEBUG_BRIDGE_KM)
+	g_BridgeDispatchTable[ui32BridgeID].ui32CallCount++;
+	g_BridgeGlobalStats.ui32IOCTLCount++;
+#endif
+
+	if(psBridgePackageKM->ui32InBufferSize < sizeof(sCreateIN) ||
+	   psBridgePackageKM->ui32OutBufferSize < sizeof(sCreateOUT))
+	{
+		return -EINVAL;
+	}
+
+	if(OSCopyFromUser(IMG_NULL,
+					  &sCreateIN,
+					  psBridgePackageKM->hParamIn,
+					  sizeof(sCreateIN)) != PVRSRV_OK)
+	{
+		return -EFAULT;
+	}
+
+	OSMemSet(&sCreateOUT, 0, sizeof(sCreateOUT));
+	ui32NumSlots = sCreateIN.ui32NumSlots;
+
+	LinuxLockMutexNested(&psPrivateData->sSubmitRingMutex, PVRSRV_LOCK_CLASS_SUBMIT_RING);
+
+	ui64Start = BridgeLatencyClock();
+	LinuxLockRWLock(&gPVRSRVLock);
+	ui64Locked = BridgeLatencyClock();
+
+	psPerProc = BridgeLookupPerProc(pFile, psBridgePackageKM);
+	if(psPerProc == IMG_NULL)
+	{
 		goto unlock_and_return;
+	}
 
-	switch(sBridgePackageKM.ui32BridgeID)
+	/* The ring is in the handle base the connection keeps alive */
+	if(psPerProc != psPrivateData->psPerProc ||
+	   psPrivateData->hKernelMemInfo != IMG_NULL ||
+	   psPrivateData->psSubmitRing != IMG_NULL)
 	{
-		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_EXPORT_DEVICEMEM_2):
-		{
-			PVRSRV_BRIDGE_OUT_EXPORTDEVICEMEM *psExportDeviceMemOUT =
-				(PVRSRV_BRIDGE_OUT_EXPORTDEVICEMEM *)(IMG_UINTPTR_T)psBridgePackageKM->hParamOut;
-			PVRSRV_FILE_PRIVATE_DATA *psPrivateData = PRIVATE_DATA(pFile);
-			IMG_HANDLE hMemInfo;
-			PVRSRV_KERNEL_MEM_INFO *psKernelMemInfo;
+		PVR_DPF((PVR_DBG_ERROR, "%s: Connection can't have a submission ring", __FUNCTION__));
+		sCreateOUT.eError = PVRSRV_ERROR_INVALID_PARAMS;
+		goto copy_out;
+	}
 
-			if (pvr_get_user(hMemInfo, &psExportDeviceMemOUT->hMemInfo) != 0)
-			{
-				err = -EFAULT;
-				goto unlock_and_return;
-			}
+	if(ui32NumSlots == 0 ||
+	   ui32NumSlots > PVRSRV_SUBMIT_RING_MAX_SLOTS ||
+	   (ui32NumSlots & (ui32NumSlots - 1)) != 0)
+	{
+		PVR_DPF((PVR_DBG_ERROR, "%s: Invalid number of slots (%u)", __FUNCTION__, ui32NumSlots));
+		sCreateOUT.eError = PVRSRV_ERROR_INVALID_PARAMS;
+		goto copy_out;
+	}
 
-			/* Look up the meminfo we just exported */
-			if(PVRSRVLookupHandle(KERNEL_HANDLE_BASE,
-								  (IMG_PVOID *)&psKernelMemInfo,
-								  hMemInfo,
-								  PVRSRV_HANDLE_TYPE_MEM_INFO) != PVRSRV_OK)
-			{
-				PVR_DPF((PVR_DBG_ERROR, "%s: Failed to look up export handle", __FUNCTION__));
-				err = -EFAULT;
-				goto unlock_and_return;
-			}
+	sCreateOUT.eError = OSAllocMem(PVRSRV_OS_PAGEABLE_HEAP,
+								   sizeof(PVRSRV_SUBMIT_RING_KM),
+								   (IMG_PVOID *)&psRingKM, IMG_NULL,
+								   "Submission Ring");
+	if(sCreateOUT.eError != PVRSRV_OK)
+	{
+		goto copy_out;
+	}
 
-			/* Bump the refcount; decremented on release of the fd */
-			PVRSRVKernelMemInfoIncRef(psKernelMemInfo);
+	psRingKM->uiBytes = HOST_PAGEALIGN(PVRSRV_SUBMIT_RING_SIZE(ui32NumSlots));
+	psRingKM->psPerProc = psPerProc;
+	psRingKM->ui32NumSlots = ui32NumSlots;
+	psRingKM->ui32ReadOffset = 0;
+
+	sCreateOUT.eError = OSAllocPages(SUBMIT_RING_ALLOC_FLAGS,
+									 psRingKM->uiBytes,
+									 HOST_PAGESIZE(),
+									 IMG_NULL,
+									 0,
+									 IMG_NULL,
+									 (IMG_VOID **)&psRingKM->psRing,
+									 &psRingKM->hOSMemHandle);
+	if(sCreateOUT.eError != PVRSRV_OK)
+	{
+		OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(PVRSRV_SUBMIT_RING_KM), psRingKM, IMG_NULL);
+		goto copy_out;
+	}
 
-			/* Tell the XProc about the export if required */
-			if (psKernelMemInfo->sShareMemWorkaround.bInUse)
-			{
-				BM_XProcIndexAcquire(psKernelMemInfo->sShareMemWorkaround.ui32ShareIndex);
-			}
+	OSMemSet(psRingKM->psRing, 0, psRingKM->uiBytes);
+	psRingKM->psRing->ui32NumSlots = ui32NumSlots;
 
-			psPrivateData->hKernelMemInfo = hMemInfo;
-#if defined(SUPPORT_MEMINFO_IDS)
-			psPrivateData->ui64Stamp = ++g_ui64MemInfoID;
+	sCreateOUT.eError = PVRSRVAllocHandle(psPerProc->psHandleBase,
+										  &psRingKM->hRing,
+										  psRingKM->hOSMemHandle,
+										  PVRSRV_HANDLE_TYPE_SUBMIT_RING,
+										  PVRSRV_HANDLE_ALLOC_FLAG_NONE);
+	if(sCreateOUT.eError != PVRSRV_OK)
+	{
+		OSFreePages(SUBMIT_RING_ALLOC_FLAGS, psRingKM->uiBytes,
+					psRingKM->psRing, psRingKM->hOSMemHandle);
+		OSFreeMem(PVRSRV_OS_PAGEABLE_HEAP, sizeof(PVRSRV_SUBMIT_RING_KM), psRingKM, IMG_NULL);
+		goto copy_out;
+	}
 
-			psKernelMemInfo->ui64Stamp = psPrivateData->ui64Stamp;
-			if (pvr_put_user(psPrivateData->ui64Stamp, &psExportDeviceMemOUT->ui64Stamp) != 0)
-			{
-				err = -EFAULT;
-				goto unlock_and_return;
-			}
+	psRingKM->hResItem = ResManRegisterRes(psPerProc->hResManContext,
+										   RESMAN_TYPE_SUBMIT_RING,
+										   psRingKM,
+										   0,
+										   &BridgeFreeSubmitRingCallBack);
+	if(psRingKM->hResItem == IMG_NULL)
+	{
+		(IMG_VOID) BridgeFreeSubmitRing(psRingKM);
+		sCreateOUT.eError = PVRSRV_ERROR_OUT_OF_MEMORY;
+		goto copy_out;
+	}
+
+	psPrivateData->psSubmitRing = psRingKM;
+	sCreateOUT.hRing = psRingKM->hRing;
+
+copy_out:
+	err = 0;
+	if(OSCopyToUser(IMG_NULL,
+					psBridgePackageKM->hParamOut,
+					&sCreateOUT,
+					sizeof(sCreateOUT)) != PVRSRV_OK)
+	{
+		/* The ring, if made, is freed with the connection */
+		err = -EFAULT;
+	}
+
+unlock_and_return:
+	LinuxUnLockRWLock(&gPVRSRVLock);
+	ui64WaitNs = ui64Locked - ui64Start;
+	BridgeLatencyRecord(ui32BridgeID, &ui64WaitNs, BridgeLatencyClock() - ui64Locked);
+	LinuxUnLockMutex(&psPrivateData->sSubmitRingMutex);
+	return err;
+}
+
+/*
+ * Destroy the submission ring of the connection a
+ * PVRSRV_BRIDGE_DESTROY_SUBMIT_RING is made on.
+ *
+ * pFile : the file the call is made on
+ * psBridgePackageKM : the call, copied into the kernel
+ *
+ * returns IMG_INT : what the ioctl returns
+ */
+static IMG_INT
+BridgeDestroySubmitRingKM(PVRSRV_BRIDGE_FILE *pFile,
+						  PVRSRV_BRIDGE_PACKAGE *psBridgePackageKM)
+{
+	IMG_UINT32 ui32BridgeID = PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_DESTROY_SUBMIT_RING);
+	PVRSRV_FILE_PRIVATE_DATA *psPrivateData = PRIVATE_DATA(pFile);
+	PVRSRV_BRIDGE_RETURN sRetOUT;
+	PVRSRV_PER_PROCESS_DATA *psPerProc;
+	IMG_UINT64 ui64Start, ui64Locked, ui64WaitNs;
+	IMG_INT err = -EFAULT;
+
+#if defined(DEBUG_BRIDGE_KM)
+	g_BridgeDispatchTable[ui32BridgeID].ui32CallCount++;
+	g_BridgeGlobalStats.ui32IOCTLCount++;
 #endif
-			break;
+
+	if(psBridgePackageKM->ui32OutBufferSize < sizeof(sRetOUT))
+	{
+		return -EINVAL;
+	}
+
+	OSMemSet(&sRetOUT, 0, sizeof(sRetOUT));
+
+	LinuxLockMutexNested(&psPrivateData->sSubmitRingMutex, PVRSRV_LOCK_CLASS_SUBMIT_RING);
+
+	ui64Start = BridgeLatencyClock();
+	LinuxLockRWLock(&gPVRSRVLock);
+	ui64Locked = BridgeLatencyClock();
+
+	psPerProc = BridgeLookupPerProc(pFile, psBridgePackageKM);
+	if(psPerProc == IMG_NULL)
+	{
+		goto unlock_and_return;
+	}
+
+	if(psPerProc != psPrivateData->psPerProc || psPrivateData->psSubmitRing == IMG_NULL)
+	{
+		sRetOUT.eError = PVRSRV_ERROR_INVALID_PARAMS;
+	}
+	else
+	{
+		/* Fails, leaving the ring alone, while the client has it mapped */
+		sRetOUT.eError = BridgeDestroySubmitRing(psPrivateData->psSubmitRing);
+		if(sRetOUT.eError == PVRSRV_OK)
+		{
+			psPrivateData->psSubmitRing = IMG_NULL;
 		}
+	}
 
-#if defined(SUPPORT_MEMINFO_IDS)
+	err = 0;
+	if(OSCopyToUser(IMG_NULL,
+					psBridgePackageKM->hParamOut,
+					&sRetOUT,
+					sizeof(sRetOUT)) != PVRSRV_OK)
+	{
+		err = -EFAULT;
+	}
+
+unlock_and_return:
+	LinuxUnLockRWLock(&gPVRSRVLock);
+	ui64WaitNs = ui64Locked - ui64Start;
+	BridgeLatencyRecord(ui32BridgeID, &ui64WaitNs, BridgeLatencyClock() - ui64Locked);
+	LinuxUnLockMutex(&psPrivateData->sSubmitRingMutex);
+	return err;
+}
+
+/*
+ * Make one call posted to a submission ring.  Called with gPVRSRVLock held.
+ *
+ * psPerProc : the per-process data the call is made for
+ * psSlot : the call's slot in the ring
+ * psCall : the call's ID and sizes, as copied out of the slot
+ * pvBuffer : a bridge buffer to make the call with
+ * bCompat : the ring belongs to a 32-bit process
+ *
+ * returns IMG_INT : what the ioctl would have returned for the call
+ */
+static IMG_INT
+BridgeSubmitRingCallKM(PVRSRV_PER_PROCESS_DATA *psPerProc,
+					   PVRSRV_SUBMIT_RING_SLOT *psSlot,
+					   BRIDGE_SUBMIT_RING_CALL *psCall,
+					   IMG_VOID *pvBuffer,
+					   IMG_BOOL bCompat)
+{
+	IMG_UINT32 ui32BridgeID = psCall->ui32BridgeID;
+	IMG_VOID *psBridgeIn = pvBuffer;
+	IMG_VOID *psBridgeOut = (IMG_VOID *)((IMG_PBYTE)pvBuffer + PVRSRV_MAX_BRIDGE_IN_SIZE);
+	IMG_UINT32 ui32InSize, ui32OutSize;
+	IMG_INT err;
+
+	if(ui32BridgeID >= BRIDGE_DISPATCH_TABLE_ENTRY_COUNT ||
+	   psCall->ui32InBufferSize > PVRSRV_SUBMIT_RING_SLOT_IN_SIZE ||
+	   psCall->ui32OutBufferSize > PVRSRV_SUBMIT_RING_SLOT_OUT_SIZE)
+	{
+		return -EINVAL;
+	}
+
+	switch(ui32BridgeID)
+	{
+		/* These change the connection, or depend on the file they are made on */
+		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_CONNECT_SERVICES):
+		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_DISCONNECT_SERVICES):
+		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_BATCH):
+		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_CREATE_SUBMIT_RING):
+		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_DESTROY_SUBMIT_RING):
+		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_SUBMIT_RING_DOORBELL):
+		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_EXPORT_DEVICEMEM_2):
 		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_MAP_DEV_MEMORY):
 		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_MAP_DEV_MEMORY_2):
-		{
-			PVRSRV_BRIDGE_OUT_MAP_DEV_MEMORY *psMapDeviceMemoryOUT =
-				(PVRSRV_BRIDGE_OUT_MAP_DEV_MEMORY *)(IMG_UINTPTR_T)psBridgePackageKM->hParamOut;
-			PVRSRV_FILE_PRIVATE_DATA *psPrivateData = PRIVATE_DATA(pFile);
-			if (pvr_put_user(psPrivateData->ui64Stamp, &psMapDeviceMemoryOUT->sDstClientMemInfo.ui64Stamp) != 0)
-			{
-				err = -EFAULT;
-				goto unlock_and_return;
-			}
+		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_MAP_DEVICECLASS_MEMORY):
+			PVR_DPF((PVR_DBG_ERROR, "%s: Bridge call %u can't be posted to a ring",
+					 __FUNCTION__, ui32BridgeID));
+			return -EINVAL;
+
+		default:
 			break;
+	}
+
+	/* Slots are copied as they are, so can't carry input needing conversion */
+	if(bCompat && g_BridgeDispatchTable[ui32BridgeID].pfCompatCopyIn != IMG_NULL)
+	{
+		PVR_DPF((PVR_DBG_ERROR, "%s: Bridge call %u can't be posted to a 32-bit process's ring",
+				 __FUNCTION__, ui32BridgeID));
+		return -EINVAL;
+	}
+
+#if defined(DEBUG_BRIDGE_KM)
+	g_BridgeDispatchTable[ui32BridgeID].ui32CallCount++;
+	g_BridgeGlobalStats.ui32IOCTLCount++;
+#endif
+
+	/* Zero what the wrapper uses beyond what the client passed */
+	ui32InSize = g_BridgeDispatchTable[ui32BridgeID].ui32InSize;
+	ui32OutSize = g_BridgeDispatchTable[ui32BridgeID].ui32OutSize;
+	if(ui32InSize == BRIDGE_BUFFER_SIZE_UNKNOWN)
+	{
+		ui32InSize = PVRSRV_MAX_BRIDGE_IN_SIZE;
+	}
+	if(ui32OutSize == BRIDGE_BUFFER_SIZE_UNKNOWN)
+	{
+		ui32OutSize = PVRSRV_MAX_BRIDGE_OUT_SIZE;
+	}
+	ui32InSize = MAX(ui32InSize, psCall->ui32InBufferSize);
+	ui32OutSize = MAX(ui32OutSize, psCall->ui32OutBufferSize);
+
+	OSMemCopy(psBridgeIn, psSlot->aui8In, psCall->ui32InBufferSize);
+	OSMemSet((IMG_PBYTE)psBridgeIn + psCall->ui32InBufferSize, 0,
+			 ui32InSize - psCall->ui32InBufferSize);
+	OSMemSet(psBridgeOut, 0, ui32OutSize);
+
+	err = BridgedCallKM(psPerProc, ui32BridgeID,
+						psBridgeIn, psCall->ui32InBufferSize,
+						psBridgeOut, psCall->ui32OutBufferSize);
+	if(err < 0)
+	{
+		return err;
+	}
+
+	OSMemCopy(psSlot->aui8Out, psBridgeOut, psCall->ui32OutBufferSize);
+
+	return 0;
+}
+
+/*
+ * Make the calls posted to the submission ring of the connection a
+ * PVRSRV_BRIDGE_SUBMIT_RING_DOORBELL is made on, taking gPVRSRVLock and
+ * looking up the per-process data once for all of them.
+ *
+ * pFile : the file the doorbell is rung on
+ * psBridgePackageKM : the doorbell, copied into the kernel
+ * bCompat : the doorbell was rung by a 32-bit process
+ *
+ * returns IMG_INT : 0 if the calls were attempted (each call's result is
+ *                   returned in its slot), else a negative errno
+ */
+static IMG_INT
+BridgeSubmitRingDoorbellKM(PVRSRV_BRIDGE_FILE *pFile,
+						   PVRSRV_BRIDGE_PACKAGE *psBridgePackageKM,
+						   IMG_BOOL bCompat)
+{
+	IMG_UINT32 ui32BridgeID = PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_SUBMIT_RING_DOORBELL);
+	PVRSRV_FILE_PRIVATE_DATA *psPrivateData = PRIVATE_DATA(pFile);
+	PVRSRV_BRIDGE_OUT_SUBMIT_RING_DOORBELL sDoorbellOUT;
+	PVRSRV_SUBMIT_RING_KM *psRingKM;
+	PVRSRV_SUBMIT_RING *psRing;
+	PVRSRV_PER_PROCESS_DATA *psPerProc;
+	PVRSRV_BRIDGE_PACKAGE sCall;
+	IMG_VOID *pvBuffer;
+	IMG_UINT32 ui32SlotMask, ui32NumCalls, i;
+	IMG_BOOL bConcurrent = IMG_TRUE;
+	IMG_UINT64 ui64Start, ui64Locked, ui64WaitNs;
+	IMG_INT err = -EFAULT;
+
+#if defined(DEBUG_BRIDGE_KM)
+	g_BridgeDispatchTable[ui32BridgeID].ui32CallCount++;
+	g_BridgeGlobalStats.ui32IOCTLCount++;
+#endif
+
+	if(psBridgePackageKM->ui32OutBufferSize < sizeof(sDoorbellOUT))
+	{
+		return -EINVAL;
+	}
+
+	OSMemSet(&sDoorbellOUT, 0, sizeof(sDoorbellOUT));
+
+	/* Only one doorbell at a time may drain the ring */
+	LinuxLockMutexNested(&psPrivateData->sSubmitRingMutex, PVRSRV_LOCK_CLASS_SUBMIT_RING);
+
+	psRingKM = psPrivateData->psSubmitRing;
+	if(psRingKM == IMG_NULL)
+	{
+		sDoorbellOUT.eError = PVRSRV_ERROR_INVALID_PARAMS;
+		goto copy_out;
+	}
+	psRing = psRingKM->psRing;
+	ui32SlotMask = psRingKM->ui32NumSlots - 1;
+
+	/* Read the calls posted before the write offset was advanced */
+	ui32NumCalls = READ_ONCE(psRing->ui32WriteOffset) - psRingKM->ui32ReadOffset;
+	smp_rmb();
+
+	if(ui32NumCalls > psRingKM->ui32NumSlots)
+	{
+		PVR_DPF((PVR_DBG_ERROR, "%s: Write offset is %u slots past the read offset",
+				 __FUNCTION__, ui32NumCalls));
+		sDoorbellOUT.eError = PVRSRV_ERROR_INVALID_PARAMS;
+		goto copy_out;
+	}
+
+	if(ui32NumCalls == 0)
+	{
+		goto copy_out;
+	}
+
+	/*
+	 * Copy what decides how each call is made, so the client can't change
+	 * it once it has been checked.  The lock is chosen for the whole drain.
+	 */
+	OSMemSet(&sCall, 0, sizeof(sCall));
+	for(i = 0; i < ui32NumCalls; i++)
+	{
+		PVRSRV_SUBMIT_RING_SLOT *psSlot = &psRing->asSlots[(psRingKM->ui32ReadOffset + i) & ui32SlotMask];
+		BRIDGE_SUBMIT_RING_CALL *psCall = &psRingKM->asCalls[i];
+
+		psCall->ui32BridgeID = PVRSRV_GET_BRIDGE_ID(READ_ONCE(psSlot->ui32BridgeID));
+		psCall->ui32InBufferSize = READ_ONCE(psSlot->ui32InBufferSize);
+		psCall->ui32OutBufferSize = READ_ONCE(psSlot->ui32OutBufferSize);
+
+		sCall.ui32BridgeID = psCall->ui32BridgeID;
+		if(!BridgeCallIsConcurrent(&sCall))
+		{
+			bConcurrent = IMG_FALSE;
 		}
+	}
 
-		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_MAP_DEVICECLASS_MEMORY):
+	if(OSAcquireBridgeBuffer(&pvBuffer) != PVRSRV_OK)
+	{
+		err = -ENOMEM;
+		goto unlock_and_return;
+	}
+
+	ui64Start = BridgeLatencyClock();
+	if(bConcurrent)
+	{
+		LinuxLockRWLockShared(&gPVRSRVLock);
+	}
+	else
+	{
+		LinuxLockRWLock(&gPVRSRVLock);
+	}
+	ui64Locked = BridgeLatencyClock();
+	ui64WaitNs = ui64Locked - ui64Start;
+
+	psPerProc = BridgeLookupPerProc(pFile, psBridgePackageKM);
+	if(psPerProc == IMG_NULL)
+	{
+		LinuxUnLockRWLock(&gPVRSRVLock);
+		BridgeLatencyRecord(ui32BridgeID, &ui64WaitNs, BridgeLatencyClock() - ui64Locked);
+		OSReleaseBridgeBuffer(pvBuffer);
+		goto unlock_and_return;
+	}
+
+	if(psPerProc != psPrivateData->psPerProc || psPrivateData->hKernelMemInfo != IMG_NULL)
+	{
+		sDoorbellOUT.eError = PVRSRV_ERROR_INVALID_PARAMS;
+	}
+	else
+	{
+		for(i = 0; i < ui32NumCalls; i++)
 		{
-			PVRSRV_BRIDGE_OUT_MAP_DEVICECLASS_MEMORY *psDeviceClassMemoryOUT =
-				(PVRSRV_BRIDGE_OUT_MAP_DEVICECLASS_MEMORY *)(IMG_UINTPTR_T)psBridgePackageKM->hParamOut;
-			if (pvr_put_user(++g_ui64MemInfoID, &psDeviceClassMemoryOUT->sClientMemInfo.ui64Stamp) != 0)
-			{
-				err = -EFAULT;
-				goto unlock_and_return;
-			}
-			break;
+			PVRSRV_SUBMIT_RING_SLOT *psSlot = &psRing->asSlots[psRingKM->ui32ReadOffset & ui32SlotMask];
+			BRIDGE_SUBMIT_RING_CALL *psCall = &psRingKM->asCalls[i];
+			IMG_UINT64 ui64CallStart = BridgeLatencyClock();
+
+			WRITE_ONCE(psSlot->i32Result,
+					   BridgeSubmitRingCallKM(psPerProc, psSlot, psCall, pvBuffer, bCompat));
+
+			/* The doorbell waited for the lock, not the call */
+			BridgeLatencyRecord(psCall->ui32BridgeID, IMG_NULL,
+								BridgeLatencyClock() - ui64CallStart);
+
+			/* Hand the slot back once its output is written */
+			smp_wmb();
+			psRingKM->ui32ReadOffset++;
+			WRITE_ONCE(psRing->ui32ReadOffset, psRingKM->ui32ReadOffset);
 		}
-#endif /* defined(SUPPORT_MEMINFO_IDS) */
+
+		sDoorbellOUT.ui32NumCallsMade = ui32NumCalls;
+	}
+
+	LinuxUnLockRWLock(&gPVRSRVLock);
+	BridgeLatencyRecord(ui32BridgeID, &ui64WaitNs, BridgeLatencyClock() - ui64Locked);
+	OSReleaseBridgeBuffer(pvBuffer);
+
+copy_out:
+	err = 0;
+	if(OSCopyToUser(IMG_NULL,
+					psBridgePackageKM->hParamOut,
+					&sDoorbellOUT,
+					sizeof(sDoorbellOUT)) != PVRSRV_OK)
+	{
+		err = -EFAULT;
+	}
+
+unlock_and_return:
+	LinuxUnLockMutex(&psPrivateData->sSubmitRingMutex);
+	return err;
+}
+
+/*
+ * Free what a connection holds in the bridge when its file is released.
+ * Called with gPVRSRVLock held for writing, before the connection's
+ * per-process data is released.
+ *
+ * pvPrivData : the file's PVRSRV_FILE_PRIVATE_DATA
+ */
+IMG_VOID
+LinuxBridgeReleaseFile(IMG_VOID *pvPrivData)
+{
+	PVRSRV_FILE_PRIVATE_DATA *psPrivateData = (PVRSRV_FILE_PRIVATE_DATA *)pvPrivData;
+
+	if(psPrivateData->psSubmitRing != IMG_NULL)
+	{
+		/*
+		 * The ring is mapped through the process's connections, so it may
+		 * still be mapped through another file.  If so it is left to the
+		 * resource manager, which frees it with the per-process data, by
+		 * when every file it could be mapped through has been closed.
+		 */
+		if(BridgeDestroySubmitRing(psPrivateData->psSubmitRing) != PVRSRV_OK)
+		{
+			PVR_DPF((PVR_DBG_MESSAGE, "%s: Submission ring still mapped; freeing it with the process", __FUNCTION__));
+		}
+		psPrivateData->psSubmitRing = IMG_NULL;
+	}
+}
+
+/*
+ * Make the call in a bridge package.  Calls that take gPVRSRVLock
+ * themselves are routed before it is taken.
+ *
+ * pFile : the file the call is made on
+ * psBridgePackageKM : the call, copied into the kernel
+ * bCompat : the call was made by a 32-bit process
+ *
+ * returns IMG_INT : what the ioctl returns for the call
+ */
+static IMG_INT
+BridgeDispatchPackageKM(PVRSRV_BRIDGE_FILE *pFile,
+						PVRSRV_BRIDGE_PACKAGE *psBridgePackageKM,
+						IMG_BOOL bCompat)
+{
+	PVRSRV_PER_PROCESS_DATA *psPerProc;
+	IMG_UINT64 ui64Start, ui64Locked, ui64WaitNs;
+	IMG_INT err = -EFAULT;
+
+	switch(PVRSRV_GET_BRIDGE_ID(psBridgePackageKM->ui32BridgeID))
+	{
+		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_BATCH):
+			return BridgeDispatchBatchKM(pFile, psBridgePackageKM, bCompat);
+
+		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_CREATE_SUBMIT_RING):
+			return BridgeCreateSubmitRingKM(pFile, psBridgePackageKM);
+
+		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_DESTROY_SUBMIT_RING):
+			return BridgeDestroySubmitRingKM(pFile, psBridgePackageKM);
+
+		case PVRSRV_GET_BRIDGE_ID(PVRSRV_BRIDGE_SUBMIT_RING_DOORBELL):
+			return BridgeSubmitRingDoorbellKM(pFile, psBridgePackageKM, bCompat);
 
 		default:
 			break;
 	}
 
+	ui64Start = BridgeLatencyClock();
+	if(BridgeCallIsConcurrent(psBridgePackageKM))
+	{
+		LinuxLockRWLockShared(&gPVRSRVLock);
+	}
+	else
+	{
+		LinuxLockRWLock(&gPVRSRVLock);
+	}
+	ui64Locked = BridgeLatencyClock();
+
+	psPerProc = BridgeLookupPerProc(pFile, psBridgePackageKM);
+	if(psPerProc == IMG_NULL)
+	{
+		goto unlock_and_return;
+	}
+
+	psBridgePackageKM->ui32BridgeID = PVRSRV_GET_BRIDGE_ID(psBridgePackageKM->ui32BridgeID);
+
+	err = BridgeDispatchCallKM(pFile, psPerProc, psBridgePackageKM, bCompat);
+
 unlock_and_return:
-	LinuxUnLockMutex(&gPVRSRVLock);
+	LinuxUnLockRWLock(&gPVRSRVLock);
+	ui64WaitNs = ui64Locked - ui64Start;
+	BridgeLatencyRecord(PVRSRV_GET_BRIDGE_ID(psBridgePackageKM->ui32BridgeID),
+						&ui64WaitNs, BridgeLatencyClock() - ui64Locked);
 	return err;
 }
+
+#if defined(SUPPORT_DRI_DRM)
+int
+PVRSRV_BridgeDispatchKM(struct drm_device unref__ *dev, void *arg, struct drm_file *pFile)
+#else
+long
+PVRSRV_BridgeDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsigned long arg)
+#endif
+{
+#if defined(SUPPORT_DRI_DRM)
+	IMG_BOOL bCompat = IMG_FALSE;
+
+	PVR_ASSERT(arg != IMG_NULL);
+
+#if defined(CONFIG_COMPAT)
+	/* drm_ioctl copies the package in for 32-bit callers too */
+	bCompat = in_compat_syscall() ? IMG_TRUE : IMG_FALSE;
+#endif
+	return BridgeDispatchPackageKM(pFile, (PVRSRV_BRIDGE_PACKAGE *)arg, bCompat);
+#else
+	PVRSRV_BRIDGE_PACKAGE *psBridgePackageUM = (PVRSRV_BRIDGE_PACKAGE *)arg;
+	PVRSRV_BRIDGE_PACKAGE sBridgePackageKM;
+
+	if(!OSAccessOK(PVR_VERIFY_WRITE,
+				   psBridgePackageUM,
+				   sizeof(PVRSRV_BRIDGE_PACKAGE)))
+	{
+		PVR_DPF((PVR_DBG_ERROR, "%s: Received invalid pointer to function arguments",
+				 __FUNCTION__));
+
+		return -EFAULT;
+	}
+	
+	/* FIXME - Currently the CopyFromUserWrapper which collects stats about
+	 * how much data is shifted to/from userspace isn't available to us
+	 * here. */
+	if(OSCopyFromUser(IMG_NULL,
+					  &sBridgePackageKM,
+					  psBridgePackageUM,
+					  sizeof(PVRSRV_BRIDGE_PACKAGE))
+	  != PVRSRV_OK)
+	{
+		return -EFAULT;
+	}
+
+	return BridgeDispatchPackageKM(pFile, &sBridgePackageKM, IMG_FALSE);
+#endif
+}
+
+#if defined(CONFIG_COMPAT)
+/*
+ * The bridge package as a 32-bit process lays it out.  Its pointers are
+ * passed as 64-bit values and every field is at its natural offset, so it
+ * matches PVRSRV_BRIDGE_PACKAGE and is read straight into one.
+ */
+struct bridge_package_from_32
+{
+	IMG_UINT32	bridge_id;              /*!< ioctl bridge group */
+	IMG_UINT32	size;                   /*!< size of structure */
+	IMG_UINT64	addr_param_in;          /*!< input data buffer */
+	IMG_UINT64	addr_param_out;         /*!< output data buffer */
+	IMG_UINT32	in_buffer_size;         /*!< size of input data buffer */
+	IMG_UINT32	out_buffer_size;        /*!< size of output data buffer */
+	IMG_UINT64	hKernelServices;        /*!< kernel servcies handle */
+};
+
+#if defined(SUPPORT_DRI_DRM)
+int
+PVRSRV_BridgeCompatDispatchKM(struct drm_device unref__ *dev, void *arg, struct drm_file *pFile)
+#else
+long PVRSRV_BridgeCompatDispatchKM(struct file *pFile, unsigned int unref__ ioctlCmd, unsigned long arg)
+#endif
+{
+#if defined(SUPPORT_DRI_DRM)
+	PVR_ASSERT(arg != IMG_NULL);
+
+	return BridgeDispatchPackageKM(pFile, (PVRSRV_BRIDGE_PACKAGE *)arg, IMG_TRUE);
+#else
+	PVRSRV_BRIDGE_PACKAGE sBridgePackageKM;
+	IMG_VOID *pvBridgePackageUM = compat_ptr(arg);
+
+	BUILD_BUG_ON(sizeof(struct bridge_package_from_32) != sizeof(PVRSRV_BRIDGE_PACKAGE));
+	BUILD_BUG_ON(offsetof(struct bridge_package_from_32, addr_param_in) !=
+				 offsetof(PVRSRV_BRIDGE_PACKAGE, hParamIn));
+	BUILD_BUG_ON(offsetof(struct bridge_package_from_32, in_buffer_size) !=
+				 offsetof(PVRSRV_BRIDGE_PACKAGE, ui32InBufferSize));
+	BUILD_BUG_ON(offsetof(struct bridge_package_from_32, hKernelServices) !=
+				 offsetof(PVRSRV_BRIDGE_PACKAGE, hKernelServices));
+
+	if(!OSAccessOK(PVR_VERIFY_READ, pvBridgePackageUM, sizeof(struct bridge_package_from_32)))
+	{
+		PVR_DPF((PVR_DBG_ERROR, "%s: Received invalid pointer to function arguments", __FUNCTION__));
+		return -EFAULT;
+	}
+
+	if(OSCopyFromUser(IMG_NULL, &sBridgePackageKM, pvBridgePackageUM, sizeof(sBridgePackageKM))
+		!= PVRSRV_OK)
+	{
+		return -EFAULT;
+	}
+
+	return BridgeDispatchPackageKM(pFile, &sBridgePackageKM, IMG_TRUE);
+#endif
+}
 #endif /* defined(CONFIG_COMPAT) */
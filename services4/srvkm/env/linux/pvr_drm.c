@@ -364,7 +364,7 @@ PVRDRMUnprivCmd(struct drm_device *dev, void *arg, struct drm_file *pFile)
 {
 	int ret = 0;
 
-	LinuxLockMutexNested(&gPVRSRVLock, PVRSRV_LOCK_CLASS_BRIDGE);
+	LinuxLockRWLockShared(&gPVRSRVLock);
 
 	if (arg == NULL)
 	{
@@ -386,7 +386,7 @@ PVRDRMUnprivCmd(struct drm_device *dev, void *arg, struct drm_file *pFile)
 
 	}
 
-	LinuxUnLockMutex(&gPVRSRVLock);
+	LinuxUnLockRWLock(&gPVRSRVLock);
 
 	return ret;
 }
@@ -397,11 +397,11 @@ PVRDRM_Display_ioctl(struct drm_device *dev, void *arg, struct drm_file *pFile)
 {
 	int res;
 
-	LinuxLockMutexNested(&gPVRSRVLock, PVRSRV_LOCK_CLASS_BRIDGE);
+	LinuxLockRWLock(&gPVRSRVLock);
 
 	res = PVR_DRM_MAKENAME(DISPLAY_CONTROLLER, _Ioctl)(dev, arg, pFile);
 
-	LinuxUnLockMutex(&gPVRSRVLock);
+	LinuxUnLockRWLock(&gPVRSRVLock);
 
 	return res;
 }
@@ -432,8 +432,8 @@ PVRSRVPciRemove(struct pci_dev *dev)
  * For Linux 2.6.33 and above, the DRM ioctl entry point is of the unlocked
  * variety.  The big kernel lock is still taken for ioctls, unless
  * the DRM_UNLOCKED flag is set.  If you revise one of the driver specific
- * ioctls, or add a new one, consider whether the gPVRSRVLock mutex needs
- * to be taken.
+ * ioctls, or add a new one, consider whether the gPVRSRVLock needs to be
+ * taken, and in which mode.
  */
 #define	PVR_DRM_FOPS_IOCTL	.unlocked_ioctl
 #if (LINUX_VERSION_CODE < KERNEL_VERSION(6,8,0))
@@ -0,0 +1,113 @@
+/*************************************************************************/ /*!
+@Title          Allocator trace recorder
+@Copyright      Copyright (c) Imagination Technologies Ltd. All Rights Reserved
+@Description    Record layout and hooks for the RA/BM allocation trace. The
+                record layout is shared with the host replay tool in
+                tools/intern/ratrace, so it must only ever be extended.
+@License        Dual MIT/GPLv2
+
+The contents of this file are subject to the MIT license as set out below.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public License Version 2 ("GPL") in which case the provisions
+of GPL are applicable instead of those above.
+
+If you wish to allow use of your version of this file only under the terms of
+GPL, and not to allow others to use your version of this file under the terms
+of the MIT license, indicate your decision by deleting the provisions above
+and replace them with the notice and other provisions required by GPL as set
+out in the file called "GPL-COPYING" included in this distribution. If you do
+not delete the provisions above, a recipient may use your version of this file
+under the terms of either the MIT license or GPL.
+
+This License is also included in this distribution in the file called
+"MIT-COPYING".
+
+EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/ /**************************************************************************/
+
+#ifndef __ALLOC_TRACE_H__
+#define __ALLOC_TRACE_H__
+
+#include "img_types.h"
+
+/* Record types */
+#define PVRSRV_ALLOC_TRACE_RA_CREATE	1	/* base, size, alignment=quantum, flags=RA_TRACE_FLAG_* */
+#define PVRSRV_ALLOC_TRACE_RA_DELETE	2
+#define PVRSRV_ALLOC_TRACE_RA_ADD		3	/* span added with RA_Add */
+#define PVRSRV_ALLOC_TRACE_RA_ALLOC		4	/* base is only valid if ui16Result is set */
+#define PVRSRV_ALLOC_TRACE_RA_FREE		5
+#define PVRSRV_ALLOC_TRACE_BM_ALLOC		6	/* id is the heap ID, base the device virtual address */
+#define PVRSRV_ALLOC_TRACE_BM_FREE		7
+#define PVRSRV_ALLOC_TRACE_LOST			8	/* size holds the number of records dropped */
+
+/* Flags for PVRSRV_ALLOC_TRACE_RA_CREATE */
+#define RA_TRACE_FLAG_IMPORT			0x1	/* arena imports spans from a parent */
+
+/*
+	Fixed size binary record, as read from the trace file. Every field
+	is naturally aligned so the layout is identical for 32 and 64 bit
+	consumers.
+*/
+typedef struct _PVRSRV_ALLOC_TRACE_RECORD_
+{
+	IMG_UINT64	ui64Timens;
+	IMG_UINT64	ui64Base;
+	IMG_UINT64	ui64Size;
+	IMG_UINT32	ui32ID;
+	IMG_UINT32	ui32Flags;
+	IMG_UINT32	ui32Alignment;
+	IMG_UINT16	ui16Type;
+	IMG_UINT16	ui16Result;
+} PVRSRV_ALLOC_TRACE_RECORD;
+
+#if defined(PVRSRV_ALLOC_TRACE)
+
+extern IMG_BOOL gbPVRSRVAllocTraceEnabled;
+
+IMG_VOID PVRSRVAllocTraceRecord(IMG_UINT16 ui16Type,
+								IMG_UINT32 ui32ID,
+								IMG_UINT64 ui64Base,
+								IMG_UINT64 ui64Size,
+								IMG_UINT32 ui32Alignment,
+								IMG_UINT32 ui32Flags,
+								IMG_BOOL bResult);
+
+PVRSRV_ERROR PVRSRVAllocTraceInit(IMG_VOID);
+IMG_VOID PVRSRVAllocTraceDeInit(IMG_VOID);
+
+/* The enable test is inline so a disabled recorder costs one load per call */
+#define PVR_ALLOC_TRACE(type, id, base, size, align, flags, result) \
+	do { \
+		if (gbPVRSRVAllocTraceEnabled) \
+		{ \
+			PVRSRVAllocTraceRecord(PVRSRV_ALLOC_TRACE_##type, (id), \
+								   (IMG_UINT64)(base), (IMG_UINT64)(size), \
+								   (align), (flags), (result)); \
+		} \
+	} while (0)
+
+#else /* defined(PVRSRV_ALLOC_TRACE) */
+
+#define PVR_ALLOC_TRACE(type, id, base, size, align, flags, result) \
+	((void) 0)
+
+#endif /* defined(PVRSRV_ALLOC_TRACE) */
+
+#endif /* __ALLOC_TRACE_H__ */
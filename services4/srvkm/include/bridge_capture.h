@@ -0,0 +1,159 @@
+/*************************************************************************/ /*!
+@Title          Bridge call capture
+@Copyright      Copyright (c) Imagination Technologies Ltd. All Rights Reserved
+@Description    Record layout and hooks for the bridge call capture. The
+                record layout is shared with the replay tool in
+                tools/intern/bridgereplay, so it must only ever be extended.
+@License        Dual MIT/GPLv2
+
+The contents of this file are subject to the MIT license as set out below.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public License Version 2 ("GPL") in which case the provisions
+of GPL are applicable instead of those above.
+
+If you wish to allow use of your version of this file only under the terms of
+GPL, and not to allow others to use your version of this file under the terms
+of the MIT license, indicate your decision by deleting the provisions above
+and replace them with the notice and other provisions required by GPL as set
+out in the file called "GPL-COPYING" included in this distribution. If you do
+not delete the provisions above, a recipient may use your version of this file
+under the terms of either the MIT license or GPL.
+
+This License is also included in this distribution in the file called
+"MIT-COPYING".
+
+EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/ /**************************************************************************/
+
+#ifndef __BRIDGE_CAPTURE_H__
+#define __BRIDGE_CAPTURE_H__
+
+#include "img_types.h"
+
+/* Bumped whenever the meaning of a record changes */
+#define PVRSRV_BRIDGE_CAPTURE_VERSION		1
+
+/* Record types */
+#define PVRSRV_BRIDGE_CAPTURE_START		1	/* capture (re)started: bridge ID holds the version, out size
+											   the number of bridge IDs and error sizeof(IMG_HANDLE) */
+#define PVRSRV_BRIDGE_CAPTURE_CALL		2
+#define PVRSRV_BRIDGE_CAPTURE_LOST		3	/* bridge ID holds the number of calls dropped */
+
+/* Record flags */
+#define PVRSRV_BRIDGE_CAPTURE_FLAG_HANDLES_LOST	0x1	/* more handles were used than could be recorded */
+
+/* Handle entry flags */
+#define PVRSRV_BRIDGE_CAPTURE_HANDLE_OUT	0x1	/* offset is into the output rather than the input */
+
+/* Most handle entries and input bytes kept for one call */
+#define PVRSRV_BRIDGE_CAPTURE_MAX_HANDLES	64
+#define PVRSRV_BRIDGE_CAPTURE_MAX_IN		0x1000
+
+/*
+	A call record is followed by ui32NumHandles handle entries and then
+	ui32InBufferSize bytes of input, padded to 8 bytes; ui32Size covers
+	all of it. Every field is naturally aligned so the layout is
+	identical for 32 and 64 bit consumers.
+
+	The input is the call's kernel structure, after any conversion from
+	a 32-bit caller's layout, with each handle the call looked up
+	replaced by its symbol: a number, from 1, naming the handle for the
+	rest of the capture. Output handle entries say where in the output
+	the call gave a handle back, and so bind its symbol to whatever
+	value the replay gets there.
+*/
+typedef struct _PVRSRV_BRIDGE_CAPTURE_RECORD_
+{
+	IMG_UINT64	ui64Timens;			/* when the call started */
+	IMG_UINT64	ui64Durationns;		/* time spent in the call */
+	IMG_UINT32	ui32Size;			/* bytes in the record, a multiple of 8 */
+	IMG_UINT16	ui16Type;
+	IMG_UINT16	ui16Flags;
+	IMG_UINT32	ui32PID;			/* process the call was made for */
+	IMG_UINT32	ui32BridgeID;		/* dispatch table index, not the ioctl number */
+	IMG_UINT32	ui32InBufferSize;
+	IMG_UINT32	ui32OutBufferSize;
+	IMG_INT32	i32Result;			/* negative if the call couldn't be made */
+	IMG_UINT32	ui32Error;			/* the PVRSRV_ERROR the output starts with */
+	IMG_UINT32	ui32NumHandles;
+	IMG_UINT32	ui32Reserved;
+} PVRSRV_BRIDGE_CAPTURE_RECORD;
+
+typedef struct _PVRSRV_BRIDGE_CAPTURE_HANDLE_
+{
+	IMG_UINT32	ui32Symbol;
+	IMG_UINT16	ui16Offset;			/* byte offset of the sizeof(IMG_HANDLE) handle */
+	IMG_UINT16	ui16Flags;			/* PVRSRV_BRIDGE_CAPTURE_HANDLE_* */
+} PVRSRV_BRIDGE_CAPTURE_HANDLE;
+
+/* Largest record, and so the smallest useful read of the capture file */
+#define PVRSRV_BRIDGE_CAPTURE_MAX_RECORD \
+	(sizeof(PVRSRV_BRIDGE_CAPTURE_RECORD) + \
+	 PVRSRV_BRIDGE_CAPTURE_MAX_HANDLES * sizeof(PVRSRV_BRIDGE_CAPTURE_HANDLE) + \
+	 PVRSRV_BRIDGE_CAPTURE_MAX_IN)
+
+#if defined(PVRSRV_BRIDGE_CAPTURE)
+
+/* How a handle reported through PVR_BRIDGE_CAPTURE_HANDLE was used */
+#define BRIDGE_CAPTURE_HANDLE_IN		0	/* looked up from the call's input */
+#define BRIDGE_CAPTURE_HANDLE_NEW		1	/* allocated, normally for the call's output */
+#define BRIDGE_CAPTURE_HANDLE_FOUND		2	/* an existing handle, found for the output */
+#define BRIDGE_CAPTURE_HANDLE_RELEASE	3	/* looked up from the call's input to be freed */
+
+extern IMG_BOOL gbPVRSRVBridgeCaptureEnabled;
+
+IMG_VOID *PVRSRVBridgeCaptureBegin(IMG_UINT32 ui32PID,
+								   IMG_UINT32 ui32BridgeID,
+								   IMG_VOID *psBridgeIn,
+								   IMG_UINT32 ui32InBufferSize,
+								   IMG_VOID *psBridgeOut,
+								   IMG_UINT32 ui32OutBufferSize);
+IMG_VOID PVRSRVBridgeCaptureEnd(IMG_VOID *pvCapture, IMG_INT iResult);
+IMG_VOID PVRSRVBridgeCaptureHandle(IMG_VOID *psBase,
+								   IMG_HANDLE hHandle,
+								   IMG_HANDLE *phHandle,
+								   IMG_UINT32 ui32Use);
+
+PVRSRV_ERROR PVRSRVBridgeCaptureInit(IMG_VOID);
+IMG_VOID PVRSRVBridgeCaptureDeInit(IMG_VOID);
+
+/*
+	phHandle, if not IMG_NULL, is where the handle is held; when that
+	is in the call's input or output the handle's offset is known
+	without searching for its value.
+*/
+#define PVR_BRIDGE_CAPTURE_HANDLE(psBase, hHandle, phHandle, use) \
+	do { \
+		if (gbPVRSRVBridgeCaptureEnabled) \
+		{ \
+			PVRSRVBridgeCaptureHandle((psBase), (hHandle), \
+									  (IMG_HANDLE *)(phHandle), \
+									  BRIDGE_CAPTURE_HANDLE_##use); \
+		} \
+	} while (0)
+
+#else /* defined(PVRSRV_BRIDGE_CAPTURE) */
+
+#define PVR_BRIDGE_CAPTURE_HANDLE(psBase, hHandle, phHandle, use) \
+	((void) 0)
+
+#endif /* defined(PVRSRV_BRIDGE_CAPTURE) */
+
+#endif /* __BRIDGE_CAPTURE_H__ */
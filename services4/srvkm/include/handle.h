@@ -100,6 +100,20 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  *
  * Given a handle for a resource of type eType, return the pointer to the
  * resource.
+ * Unlike the other functions here, PVRSRVLookupHandle and
+ * PVRSRVLookupHandleAnyType need not be serialised against the
+ * allocation and release of handles on the same base.  A handle that
+ * has been released, and whose slot has since been reused, is rejected.
+ *
+ * PVRSRV_ERROR PVRSRVLookupHandles(PVRSRV_HANDLE_BASE *psBase,
+ * 	PVRSRV_HANDLE_LOOKUP *psLookup, IMG_UINT32 ui32NumLookups);
+ *
+ * Look up a number of handles in one call, replacing each handle with the
+ * pointer to its resource.  Each entry, set up with PVRSRVSetHandleLookup,
+ * covers one handle or an array of handles of the same type, and the
+ * first handle that fails to look up fails the call.  Like
+ * PVRSRVLookupHandle, this need not be serialised against the allocation
+ * and release of handles.
  *
  * PVRSRV_ERROR PVRSRVLookuSubHandle(PVRSRV_HANDLE_BASE *psBase,
  * 	IMG_PVOID *ppvData, IMG_HANDLE hHandle, PVRSRV_HANDLE_TYPE eType,
@@ -164,7 +178,9 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
  * example, setting the maximum handle number to 0x7fffffff, would
  * ensure the handles would fit within a 31 bit width field.  This
  * facility should be used with caution, as it restricts the number of
- * handles that can be allocated.
+ * handles that can be allocated.  Some of the handle bits are given over
+ * to a generation count, so fewer than ui32MaxHandle handles can be
+ * allocated.
  *
  * IMG_UINT32 PVRSRVGetMaxHandle(PVRSRV_HANDLE_BASE *psBase)
  * Return the maximum handle number, or 0 if the setting of a limit
@@ -212,7 +228,8 @@ typedef enum
 	PVRSRV_HANDLE_TYPE_MMAP_INFO,
 	PVRSRV_HANDLE_TYPE_SOC_TIMER,
 	PVRSRV_HANDLE_TYPE_SYNC_INFO_MOD_OBJ,
-	PVRSRV_HANDLE_TYPE_RESITEM_INFO
+	PVRSRV_HANDLE_TYPE_RESITEM_INFO,
+	PVRSRV_HANDLE_TYPE_SUBMIT_RING
 } PVRSRV_HANDLE_TYPE;
 
 typedef enum
@@ -230,6 +247,30 @@ typedef enum
 struct _PVRSRV_HANDLE_BASE_;
 typedef struct _PVRSRV_HANDLE_BASE_ PVRSRV_HANDLE_BASE;
 
+/* Handles to be looked up by PVRSRVLookupHandles */
+typedef struct _PVRSRV_HANDLE_LOOKUP_
+{
+	/* First handle, replaced by its data pointer */
+	IMG_HANDLE			*phHandle;
+	/* Number of handles */
+	IMG_UINT32			ui32Count;
+	/* Distance between the handles, in bytes */
+	IMG_UINT32			ui32Stride;
+	PVRSRV_HANDLE_TYPE	eType;
+} PVRSRV_HANDLE_LOOKUP;
+
+#ifdef INLINE_IS_PRAGMA
+#pragma inline(PVRSRVSetHandleLookup)
+#endif
+static INLINE
+IMG_VOID PVRSRVSetHandleLookup(PVRSRV_HANDLE_LOOKUP *psLookup, IMG_HANDLE *phHandle, IMG_UINT32 ui32Count, IMG_UINT32 ui32Stride, PVRSRV_HANDLE_TYPE eType)
+{
+	psLookup->phHandle = phHandle;
+	psLookup->ui32Count = ui32Count;
+	psLookup->ui32Stride = ui32Stride;
+	psLookup->eType = eType;
+}
+
 #if defined(PVR_SECURE_HANDLES)
 extern PVRSRV_HANDLE_BASE *gpsKernelHandleBase;
 
@@ -245,6 +286,8 @@ PVRSRV_ERROR PVRSRVLookupHandleAnyType(PVRSRV_HANDLE_BASE *psBase, IMG_PVOID *pp
 
 PVRSRV_ERROR PVRSRVLookupHandle(PVRSRV_HANDLE_BASE *psBase, IMG_PVOID *ppvData, IMG_HANDLE hHandle, PVRSRV_HANDLE_TYPE eType);
 
+PVRSRV_ERROR PVRSRVLookupHandles(PVRSRV_HANDLE_BASE *psBase, PVRSRV_HANDLE_LOOKUP *psLookup, IMG_UINT32 ui32NumLookups);
+
 PVRSRV_ERROR PVRSRVLookupSubHandle(PVRSRV_HANDLE_BASE *psBase, IMG_PVOID *ppvData, IMG_HANDLE hHandle, PVRSRV_HANDLE_TYPE eType, IMG_HANDLE hAncestor);
 
 PVRSRV_ERROR PVRSRVGetParentHandle(PVRSRV_HANDLE_BASE *psBase, IMG_PVOID *phParent, IMG_HANDLE hHandle, PVRSRV_HANDLE_TYPE eType);
@@ -351,6 +394,20 @@ PVRSRV_ERROR PVRSRVLookupHandle(PVRSRV_HANDLE_BASE *psBase, IMG_PVOID *ppvData,
 	return PVRSRV_OK;
 }
 
+#ifdef INLINE_IS_PRAGMA
+#pragma inline(PVRSRVLookupHandles)
+#endif
+static INLINE
+PVRSRV_ERROR PVRSRVLookupHandles(PVRSRV_HANDLE_BASE *psBase, PVRSRV_HANDLE_LOOKUP *psLookup, IMG_UINT32 ui32NumLookups)
+{
+	PVR_UNREFERENCED_PARAMETER(psBase);
+	PVR_UNREFERENCED_PARAMETER(psLookup);
+	PVR_UNREFERENCED_PARAMETER(ui32NumLookups);
+
+	/* The handles are the data pointers */
+	return PVRSRV_OK;
+}
+
 #ifdef INLINE_IS_PRAGMA
 #pragma inline(PVRSRVLookupSubHandle)
 #endif
@@ -59,11 +59,85 @@ typedef IMG_BOOL HASH_KEY_COMP(IMG_SIZE_T uKeySize, IMG_VOID *pKey1, IMG_VOID *p
 
 typedef struct _HASH_TABLE_ HASH_TABLE;
 
+/* Flags for HASH_Create_Extended */
+
+/* Each entry is a separately allocated bucket on a chain (the default). */
+#define HASH_CREATE_CHAINED				0x0
+
+/* Entries are stored inline in the table and found by Robin Hood linear
+   probing, so inserts do not allocate and lookups do not chase pointers.
+   Keys must be unique, and the table must not be modified from a
+   HASH_Iterate callback. */
+#define HASH_CREATE_OPEN_ADDRESSING		0x1
+
+/* HASH_Retrieve and HASH_Retrieve_Extended may run concurrently with the
+   other calls, without the lock that serialises them, as RCU readers.
+   Removed entries are freed after a grace period. Keys must be unique,
+   and the flag cannot be combined with HASH_CREATE_OPEN_ADDRESSING. */
+#define HASH_CREATE_RCU					0x2
+
 typedef PVRSRV_ERROR (*HASH_pfnCallback) (
 	IMG_UINTPTR_T k,
 	IMG_UINTPTR_T v
 );
 
+/* Number of buckets in the resize latency histogram */
+#define HASH_LATENCY_BUCKETS			16
+
+/*
+ * Time spent resizing and migrating entries between the old and new
+ * tables, summed over all hash tables. Bucket 0 counts operations that
+ * took under 1024ns, bucket n operations under 1024ns << n, and the last
+ * bucket everything longer.
+ */
+typedef struct _HASH_LATENCY_STATS_
+{
+	IMG_UINT32 aui32Histogram[HASH_LATENCY_BUCKETS];
+
+	/* longest single operation, in nanoseconds */
+	IMG_UINT64 ui64Worstns;
+
+	/* number of resizes started */
+	IMG_UINT32 ui32Resizes;
+} HASH_LATENCY_STATS;
+
+/*
+ * Health of a single table, see HASH_IterateTables. Probes are the chain
+ * entries or open addressing slots whose keys HASH_Retrieve and
+ * HASH_Remove compared; an average well above one, or a large maximum,
+ * means keys are clustering. The counters are plain increments, made
+ * only by calls serialised with the table's writers; lockless lookups of
+ * a HASH_CREATE_RCU table are left out of the statistics.
+ */
+typedef struct _HASH_TABLE_STATS_
+{
+	/* HASH_CREATE_* flags the table was created with */
+	IMG_UINT32 ui32Flags;
+
+	/* current number of chains or slots, and of entries */
+	IMG_UINT32 ui32Size;
+	IMG_UINT32 ui32Count;
+
+	/* lookups that found, and did not find, their key; lockless lookups
+	   of a HASH_CREATE_RCU table are not counted */
+	IMG_UINT64 ui64Hits;
+	IMG_UINT64 ui64Misses;
+
+	/* probes over all lookups, and the most made by one lookup */
+	IMG_UINT64 ui64Probes;
+	IMG_UINT32 ui32MaxProbes;
+
+	/* resizes started, and time spent resizing and migrating entries */
+	IMG_UINT32 ui32Resizes;
+	IMG_UINT64 ui64Resizens;
+} HASH_TABLE_STATS;
+
+typedef IMG_VOID (*HASH_pfnTableCallback) (
+	const IMG_CHAR *pszName,
+	const HASH_TABLE_STATS *psStats,
+	IMG_VOID *pvData
+);
+
 /*!
 ******************************************************************************
     @Function       HASH_Func_Default
@@ -102,6 +176,8 @@ IMG_BOOL HASH_Key_Comp_Default (IMG_SIZE_T uKeySize, IMG_VOID *pKey1, IMG_VOID *
                     key size, and the supllied hash and key comparsion
                     functions.
 	                	
+    @Input          pszName - name of the table in the statistics; the
+                        string must outlive the table.
     @Input          uInitialLen - initial and minimum length of the
                         hash table, where the length refers to the number
                         of entries in the hash table, not its size in
@@ -109,10 +185,12 @@ IMG_BOOL HASH_Key_Comp_Default (IMG_SIZE_T uKeySize, IMG_VOID *pKey1, IMG_VOID *
     @Input          uKeySize - the size of the key, in bytes.
     @Input          pfnHashFunc - pointer to hash function.
     @Input          pfnKeyComp - pointer to key comparsion function.
+    @Input          ui32Flags - HASH_CREATE_* flags selecting the table
+                        implementation.
 
     @Return         IMG_NULL or hash table handle.
 ******************************************************************************/
-HASH_TABLE * HASH_Create_Extended (IMG_UINT32 uInitialLen, IMG_SIZE_T uKeySize, HASH_FUNC *pfnHashFunc, HASH_KEY_COMP *pfnKeyComp);
+HASH_TABLE * HASH_Create_Extended (const IMG_CHAR *pszName, IMG_UINT32 uInitialLen, IMG_SIZE_T uKeySize, HASH_FUNC *pfnHashFunc, HASH_KEY_COMP *pfnKeyComp, IMG_UINT32 ui32Flags);
 
 /*!
 ******************************************************************************
@@ -122,6 +200,8 @@ HASH_TABLE * HASH_Create_Extended (IMG_UINT32 uInitialLen, IMG_SIZE_T uKeySize,
                     consisting of a single IMG_UINTPTR_T, and using
                     the default hash and key comparison functions.
 	                	
+    @Input          pszName - name of the table in the statistics; the
+                        string must outlive the table.
     @Input          uInitialLen - initial and minimum length of the
                         hash table, where the length refers to the
                         number of entries in the hash table, not its size
@@ -129,7 +209,7 @@ HASH_TABLE * HASH_Create_Extended (IMG_UINT32 uInitialLen, IMG_SIZE_T uKeySize,
 
     @Return         IMG_NULL or hash table handle.
 ******************************************************************************/
-HASH_TABLE * HASH_Create (IMG_UINT32 uInitialLen);
+HASH_TABLE * HASH_Create (const IMG_CHAR *pszName, IMG_UINT32 uInitialLen);
 
 /*!
 ******************************************************************************
@@ -145,6 +225,19 @@ HASH_TABLE * HASH_Create (IMG_UINT32 uInitialLen);
 ******************************************************************************/
 IMG_VOID HASH_Delete (HASH_TABLE *pHash);
 
+/*!
+******************************************************************************
+    @Function       HASH_Discard
+
+    @Description    Delete a hash table together with any entries still in
+                    it.
+
+    @Input          pHash - hash table
+
+    @Return         None
+******************************************************************************/
+IMG_VOID HASH_Discard (HASH_TABLE *pHash);
+
 /*!
 ******************************************************************************
     @Function       HASH_Insert_Extended
@@ -241,7 +334,9 @@ IMG_UINTPTR_T HASH_Retrieve (HASH_TABLE *pHash, IMG_UINTPTR_T k);
 ******************************************************************************
     @Function       HASH_Interate
 
-    @Description    Iterate over every entry in the hash table
+    @Description    Iterate over every entry in the hash table. The table
+                    is not resized during the walk, so a callback on a
+                    chained table may remove the entry it is passed.
 
     @Input          pHash - the old hash table
     @Input          HASH_pfnCallback - the size of the old hash table
@@ -250,6 +345,44 @@ IMG_UINTPTR_T HASH_Retrieve (HASH_TABLE *pHash, IMG_UINTPTR_T k);
 ******************************************************************************/
 PVRSRV_ERROR HASH_Iterate(HASH_TABLE *pHash, HASH_pfnCallback pfnCallback);
 
+/*!
+******************************************************************************
+    @Function       HASH_GetLatencyStats
+
+    @Description    Read the resize latency histogram.
+
+    @Output         psStats - receives the histogram
+
+    @Return         None
+******************************************************************************/
+IMG_VOID HASH_GetLatencyStats (HASH_LATENCY_STATS *psStats);
+
+/*!
+******************************************************************************
+    @Function       HASH_IterateTables
+
+    @Description    Call a function with the statistics of every live hash
+                    table. Tables cannot be created or deleted until it
+                    returns, so the callback must not do either.
+
+    @Input          pfnCallback - called once per table
+    @Input          pvData - passed to the callback
+
+    @Return         None
+******************************************************************************/
+IMG_VOID HASH_IterateTables (HASH_pfnTableCallback pfnCallback, IMG_VOID *pvData);
+
+/*!
+******************************************************************************
+    @Function       HASH_ResetStats
+
+    @Description    Clear the resize latency histogram and the counters of
+                    every live hash table.
+
+    @Return         None
+******************************************************************************/
+IMG_VOID HASH_ResetStats (IMG_VOID);
+
 #ifdef HASH_TRACE
 /*!
 ******************************************************************************
@@ -54,6 +54,9 @@ extern "C" {
 #if defined(__linux__) && defined(__KERNEL__)
 #include <linux/hardirq.h>
 #include <linux/string.h>
+#include <linux/rcupdate.h>
+#include <linux/llist.h>
+#include <linux/mutex.h>
 #if defined(__arm__) || defined(__aarch64__)
 #include <asm/memory.h>
 #endif
@@ -93,6 +96,7 @@ extern "C" {
 IMG_UINT64 OSClockMonotonicus(IMG_VOID);
 #endif
 IMG_UINT32 OSClockus(IMG_VOID);
+IMG_UINT64 OSClockns64(IMG_VOID);
 IMG_UINT32 OSGetPageSize(IMG_VOID);
 PVRSRV_ERROR OSInstallDeviceLISR(IMG_VOID *pvSysData,
 								 IMG_UINT32 ui32Irq,
@@ -458,6 +462,13 @@ else alias to level 0 and declare the functions without the extra debugging para
 		OSFreeMem_Impl(flags, size, addr, blockAlloc)
 #endif
 
+/* Caches of fixed size objects, for small structures which are
+   allocated and freed at a high rate */
+IMG_HANDLE OSCreateObjectCache(IMG_CHAR *pszName, IMG_SIZE_T uObjectSize);
+IMG_VOID OSDestroyObjectCache(IMG_HANDLE hCache);
+PVRSRV_ERROR OSAllocObject(IMG_HANDLE hCache, IMG_PVOID *ppvObject);
+IMG_VOID OSFreeObject(IMG_HANDLE hCache, IMG_PVOID pvObject);
+
 
 #if defined(__linux__) || defined(__QNXNTO__)
 IMG_CPU_PHYADDR OSMemHandleToCpuPAddr(IMG_VOID *hOSMemHandle, IMG_UINTPTR_T uiByteOffset);
@@ -722,6 +733,11 @@ static inline IMG_VOID OSWriteMemoryBarrier(IMG_VOID)
 	wmb();
 }
 
+static inline IMG_VOID OSReadMemoryBarrier(IMG_VOID)
+{
+	rmb();
+}
+
 static inline IMG_VOID OSMemoryBarrier(IMG_VOID)
 {
 	mb();
@@ -734,6 +750,11 @@ static inline IMG_VOID OSMemoryBarrier(IMG_VOID)
 #endif
 static INLINE IMG_VOID OSWriteMemoryBarrier(IMG_VOID) { }
 
+#ifdef INLINE_IS_PRAGMA
+#pragma inline(OSReadMemoryBarrier)
+#endif
+static INLINE IMG_VOID OSReadMemoryBarrier(IMG_VOID) { }
+
 #ifdef INLINE_IS_PRAGMA
 #pragma inline(OSMemoryBarrier)
 #endif
@@ -741,6 +762,121 @@ static INLINE IMG_VOID OSMemoryBarrier(IMG_VOID) { }
 
 #endif /* defined(__linux__) && defined(__KERNEL__) */
 
+/*
+ * Read-copy-update. Readers bracket lockless accesses with OSRCUReadLock
+ * and OSRCUReadUnlock and load shared pointers with OSRCUDereference;
+ * writers publish with OSRCUAssignPointer and hand unlinked memory to
+ * OSCallRCU, which calls pfnFree in process context once every reader
+ * that might still see it has finished.
+ */
+struct _OS_RCU_HEAD_;
+typedef IMG_VOID (*PFN_OS_RCU_FREE)(struct _OS_RCU_HEAD_ *psHead);
+
+#if defined(__linux__) && defined(__KERNEL__)
+
+typedef struct _OS_RCU_HEAD_
+{
+	struct rcu_head sRCU;
+	struct llist_node sNode;
+	PFN_OS_RCU_FREE pfnFree;
+} OS_RCU_HEAD;
+
+static inline IMG_VOID OSRCUReadLock(IMG_VOID)
+{
+	rcu_read_lock();
+}
+
+static inline IMG_VOID OSRCUReadUnlock(IMG_VOID)
+{
+	rcu_read_unlock();
+}
+
+#define OSRCUDereference(p)			rcu_dereference(p)
+#define OSRCUAssignPointer(p, v)	rcu_assign_pointer(p, v)
+
+IMG_VOID OSCallRCU(OS_RCU_HEAD *psHead, PFN_OS_RCU_FREE pfnFree);
+IMG_VOID OSRCUBarrier(IMG_VOID);
+
+#else /* defined(__linux__) && defined(__KERNEL__) */
+
+typedef struct _OS_RCU_HEAD_
+{
+	PFN_OS_RCU_FREE pfnFree;
+} OS_RCU_HEAD;
+
+#ifdef INLINE_IS_PRAGMA
+#pragma inline(OSRCUReadLock)
+#endif
+static INLINE IMG_VOID OSRCUReadLock(IMG_VOID) { }
+
+#ifdef INLINE_IS_PRAGMA
+#pragma inline(OSRCUReadUnlock)
+#endif
+static INLINE IMG_VOID OSRCUReadUnlock(IMG_VOID) { }
+
+#define OSRCUDereference(p)			(p)
+#define OSRCUAssignPointer(p, v)	((p) = (v))
+
+#ifdef INLINE_IS_PRAGMA
+#pragma inline(OSCallRCU)
+#endif
+static INLINE IMG_VOID OSCallRCU(OS_RCU_HEAD *psHead, PFN_OS_RCU_FREE pfnFree)
+{
+	pfnFree(psHead);
+}
+
+#ifdef INLINE_IS_PRAGMA
+#pragma inline(OSRCUBarrier)
+#endif
+static INLINE IMG_VOID OSRCUBarrier(IMG_VOID) { }
+
+#endif /* defined(__linux__) && defined(__KERNEL__) */
+
+/*
+ * Sleeping mutual exclusion for code shared between operating systems.
+ * OS_DEFINE_MUTEX defines a statically initialised mutex, so it needs no
+ * create or destroy call.
+ */
+#if defined(__linux__) && defined(__KERNEL__)
+
+typedef struct mutex OS_MUTEX;
+
+#define OS_DEFINE_MUTEX(name)		DEFINE_MUTEX(name)
+
+static inline IMG_VOID OSMutexLock(OS_MUTEX *psMutex)
+{
+	mutex_lock(psMutex);
+}
+
+static inline IMG_VOID OSMutexUnlock(OS_MUTEX *psMutex)
+{
+	mutex_unlock(psMutex);
+}
+
+#else /* defined(__linux__) && defined(__KERNEL__) */
+
+typedef IMG_UINT32 OS_MUTEX;
+
+#define OS_DEFINE_MUTEX(name)		OS_MUTEX name = 0
+
+#ifdef INLINE_IS_PRAGMA
+#pragma inline(OSMutexLock)
+#endif
+static INLINE IMG_VOID OSMutexLock(OS_MUTEX *psMutex)
+{
+	PVR_UNREFERENCED_PARAMETER(psMutex);
+}
+
+#ifdef INLINE_IS_PRAGMA
+#pragma inline(OSMutexUnlock)
+#endif
+static INLINE IMG_VOID OSMutexUnlock(OS_MUTEX *psMutex)
+{
+	PVR_UNREFERENCED_PARAMETER(psMutex);
+}
+
+#endif /* defined(__linux__) && defined(__KERNEL__) */
+
 /* Atomic functions */
 PVRSRV_ERROR OSAtomicAlloc(IMG_PVOID *ppvRefCount);
 IMG_VOID OSAtomicFree(IMG_PVOID pvRefCount);
@@ -755,6 +891,8 @@ IMG_VOID OSTimeDestroy(IMG_PVOID pvData);
 #if defined(__linux__)
 IMG_VOID OSReleaseBridgeLock(IMG_VOID);
 IMG_VOID OSReacquireBridgeLock(IMG_VOID);
+PVRSRV_ERROR OSAcquireBridgeBuffer(IMG_VOID **ppvBuffer);
+IMG_VOID OSReleaseBridgeBuffer(IMG_VOID *pvBuffer);
 #else
 
 #ifdef INLINE_IS_PRAGMA
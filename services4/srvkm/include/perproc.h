@@ -63,6 +63,9 @@ typedef struct _PVRSRV_PER_PROCESS_DATA_
 	IMG_BOOL		bHandlesBatched;
 #endif  /* PVR_SECURE_HANDLES */
 	IMG_UINT32		ui32RefCount;
+	/* Differs for every per-process data area ever created, so that
+	 * a pointer kept to one can be checked cheaply */
+	IMG_UINT32		ui32Generation;
 
 	/* True if the process is the initialisation server. */
 	IMG_BOOL		bInitProcess;
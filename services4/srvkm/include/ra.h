@@ -57,6 +57,10 @@ typedef struct _BM_MAPPING_ BM_MAPPING;
 /** Enable support for arena statistics. */
 #define RA_STATS 
 
+/** Number of log2 size classes in the free extent histogram, the last
+    class also counts anything larger. */
+#define RA_FREE_EXTENT_CLASSES 32
+
 
 /** Resource arena statistics. */
 struct _RA_STATISTICS_
@@ -87,6 +91,29 @@ struct _RA_STATISTICS_
 
     /** total number of spans deallocated by the callback mechanism */
     IMG_SIZE_T uExportCount;
+
+    /** number of allocations and frees served by the quantum caches */
+    IMG_SIZE_T uQCacheHits;
+
+    /** number of cacheable allocations and frees which had to go to the arena */
+    IMG_SIZE_T uQCacheMisses;
+
+    /** number of boundary tags handed out to the arena */
+    IMG_SIZE_T uBTAllocCount;
+
+    /** number of boundary tags which had to be taken from the tag cache,
+        the rest came from the arena reserve */
+    IMG_SIZE_T uBTCacheAllocCount;
+
+    /** number of free segments in each log2 size class */
+    IMG_SIZE_T auFreeExtentCount[RA_FREE_EXTENT_CLASSES];
+
+    /** number of completely free import spans being retained */
+    IMG_SIZE_T uRetainedSpanCount;
+
+    /** number of allocations served from a retained span, each of which
+        would otherwise have needed an import */
+    IMG_SIZE_T uImportsAvoided;
 };
 typedef struct _RA_STATISTICS_ RA_STATISTICS;
 
@@ -110,6 +137,8 @@ typedef struct _RA_SEGMENT_DETAILS_ RA_SEGMENT_DETAILS;
  *  @Input uSize - the size of an initial resource span or 0.
  *  @Input pRef - the reference to return for the initial resource or 0.
  *  @Input uQuantum - the arena allocation quantum.
+ *  @Input uQCacheMax - the largest allocation served from the quantum
+ *         caches, or 0 for no quantum caching.
  *  @Input alloc - a resource allocation callback or 0.
  *  @Input free - a resource de-allocation callback or 0.
  *  @Input import_handle - handle passed to alloc and free or 0.
@@ -121,6 +150,7 @@ RA_Create (IMG_CHAR *name,
            IMG_SIZE_T uSize,
            BM_MAPPING *psMapping,
            IMG_SIZE_T uQuantum, 
+           IMG_SIZE_T uQCacheMax,
            IMG_BOOL (*imp_alloc)(IMG_VOID *_h,
                                 IMG_SIZE_T uSize,
                                 IMG_SIZE_T *pActualSize,
@@ -231,6 +261,46 @@ RA_Alloc (RA_ARENA *pArena,
 IMG_VOID 
 RA_Free (RA_ARENA *pArena, IMG_UINTPTR_T base, IMG_BOOL bFreeBackingStore);
 
+/**
+ *  @Function   RA_SetSpanRetention
+ *
+ *  @Description    Keep completely free import spans in the arena for a
+ *                  while instead of returning them to the import source
+ *                  immediately.
+ *
+ *  @Input  pArena - the arena.
+ *  @Input  uMaxBytes - most bytes of spans to retain, 0 disables retention.
+ *  @Input  ui32MaxAgems - longest time in ms a span may be retained.
+ *
+ *  @Return None
+ */
+IMG_VOID
+RA_SetSpanRetention (RA_ARENA *pArena, IMG_SIZE_T uMaxBytes, IMG_UINT32 ui32MaxAgems);
+
+/**
+ *  @Function   RA_GetRetainedBytes
+ *
+ *  @Description    Total size of the spans retained by all arenas.
+ *
+ *  @Return Number of bytes
+ */
+IMG_SIZE_T
+RA_GetRetainedBytes (IMG_VOID);
+
+/**
+ *  @Function   RA_Reclaim
+ *
+ *  @Description    Return retained spans, oldest first, and the contents of
+ *                  the quantum caches of all arenas to their import sources.
+ *                  For use under memory pressure.
+ *
+ *  @Input  uBytes - number of bytes of retained spans to release.
+ *
+ *  @Return Number of bytes of retained spans released
+ */
+IMG_SIZE_T
+RA_Reclaim (IMG_SIZE_T uBytes);
+
 
 #ifdef RA_STATS
 
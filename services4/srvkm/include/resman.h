@@ -72,6 +72,9 @@ enum {
 	
 	/* OS specific User mode Mappings: */
 	RESMAN_TYPE_OS_USERMODE_MAPPING,				/*!< OS specific User mode mappings */
+
+	/* BRIDGE: */
+	RESMAN_TYPE_SUBMIT_RING,						/*!< Bridge call submission ring */
 	
 	/* COMMON: */
 	RESMAN_TYPE_DEVICEMEM_CONTEXT,					/*!< Device Memory Context Resource */
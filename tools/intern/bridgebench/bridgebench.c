@@ -0,0 +1,857 @@
+/*************************************************************************/ /*!
+@Title          Multi-client bridge benchmark
+@Copyright      Copyright (c) Imagination Technologies Ltd. All Rights Reserved
+@Description    Runs a number of client processes, each with its own
+                services connection, issuing one kind of bridge call as
+                fast as it can, and reports the aggregate call rate.
+                Comparing calls that may run concurrently (sync object
+                queries) with ones that are always serialised shows how
+                far the bridge lets clients scale.
+@License        Dual MIT/GPLv2
+
+The contents of this file are subject to the MIT license as set out below.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public License Version 2 ("GPL") in which case the provisions
+of GPL are applicable instead of those above.
+
+If you wish to allow use of your version of this file only under the terms of
+GPL, and not to allow others to use your version of this file under the terms
+of the MIT license, indicate your decision by deleting the provisions above
+and replace them with the notice and other provisions required by GPL as set
+out in the file called "GPL-COPYING" included in this distribution. If you do
+not delete the provisions above, a recipient may use your version of this file
+under the terms of either the MIT license or GPL.
+
+This License is also included in this distribution in the file called
+"MIT-COPYING".
+
+EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/ /**************************************************************************/
+
+/*
+ * Needs a driver that srvinit has initialised, e.g. the nohw build:
+ *
+ *   bridgebench -c 4 -m token       sync token queries, may run concurrently
+ *   bridgebench -c 4 -m serial      a call that is always serialised
+ *   bridgebench -c 4 -m token -x 8  one serialised call in every 8
+ *   bridgebench -c 1 -m token -b 16 the same calls, 16 to a PVRSRV_BRIDGE_BATCH
+ *   bridgebench -c 1 -m token -r 16 the same calls, posted 16 at a time to a
+ *                                   submission ring; each doorbell's results
+ *                                   are checked, so this tests the ring too
+ *   bridgebench -c 1 -m token -l    the same calls, looking the services
+ *                                   handle up each time rather than using
+ *                                   the per-process data cached at open
+ *                                   (root, and a DEBUG_BRIDGE_KM driver)
+ *
+ * On a 64-bit kernel, running bridgebench32 (see the Makefile) with the same
+ * options measures the same calls made through the compat ioctl path.
+ */
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "img_defs.h"
+#include "services.h"
+#include "pvr_bridge.h"
+#include "sgx_bridge.h"
+
+#define BENCH_MAX_CLIENTS	64
+
+/* how many calls between looking at the clock */
+#define BENCH_CLOCK_INTERVAL	64
+
+typedef enum _BENCH_MODE_
+{
+	BENCH_MODE_TOKEN,
+	BENCH_MODE_FLUSH,
+	BENCH_MODE_SERIAL,
+} BENCH_MODE;
+
+typedef struct _BENCH_CLIENT_
+{
+	volatile IMG_BOOL bReady;
+	volatile IMG_BOOL bFailed;
+	IMG_UINT64	ui64Calls;
+	IMG_UINT64	ui64Serial;
+	IMG_UINT64	ui64MaxNs;
+	IMG_UINT64	ui64ElapsedNs;
+} BENCH_CLIENT;
+
+/* shared between the parent and the clients */
+typedef struct _BENCH_SHARED_
+{
+	volatile IMG_BOOL bGo;
+	BENCH_CLIENT asClient[BENCH_MAX_CLIENTS];
+} BENCH_SHARED;
+
+typedef struct _BENCH_CONNECTION_
+{
+	int			iFD;
+	IMG_HANDLE	hServices;
+	IMG_HANDLE	hDevCookie;
+	IMG_HANDLE	hSyncInfo;
+
+	/* the submission ring, when calls are posted to one */
+	PVRSRV_SUBMIT_RING	*psRing;
+	IMG_VOID	*pvRingMapping;
+	size_t		uiRingMappingSize;
+	IMG_UINT32	ui32RingWrite;
+} BENCH_CONNECTION;
+
+static const char *gpszDevice = "/dev/pvrsrvkm";
+static BENCH_MODE geMode = BENCH_MODE_TOKEN;
+static IMG_UINT32 gui32SerialEvery = 0;
+static IMG_UINT32 gui32Seconds = 5;
+static IMG_UINT32 gui32BatchSize = 0;
+static IMG_UINT32 gui32RingCalls = 0;
+
+#define BENCH_PERPROC_CACHE_PARAM "/sys/module/pvrsrvkm/parameters/gPVRBridgePerProcCache"
+
+/* The calls of a batch, built once and then made over and over */
+typedef struct _BENCH_BATCH_
+{
+	PVRSRV_BRIDGE_IN_BATCH	sIN;
+	PVRSRV_BRIDGE_OUT_BATCH	sOUT;
+	union
+	{
+		PVRSRV_BRIDGE_IN_SYNC_OPS_TAKE_TOKEN		sToken;
+		PVRSRV_BRIDGE_IN_SYNC_OPS_FLUSH_TO_TOKEN	sFlush;
+		PVRSRV_BRIDGE_IN_GETFREEDEVICEMEM			sSerial;
+	} auCallIN[PVRSRV_BRIDGE_BATCH_MAX_CALLS];
+	/* every output starts with the call's PVRSRV_ERROR */
+	union
+	{
+		PVRSRV_ERROR								eError;
+		PVRSRV_BRIDGE_OUT_SYNC_OPS_TAKE_TOKEN		sToken;
+		PVRSRV_BRIDGE_RETURN						sFlush;
+		PVRSRV_BRIDGE_OUT_GETFREEDEVICEMEM			sSerial;
+	} auCallOUT[PVRSRV_BRIDGE_BATCH_MAX_CALLS];
+} BENCH_BATCH;
+
+static BENCH_BATCH gsBatch;
+
+
+static IMG_UINT64 NowNs(IMG_VOID)
+{
+	struct timespec sTime;
+
+	clock_gettime(CLOCK_MONOTONIC, &sTime);
+
+	return (IMG_UINT64)sTime.tv_sec * 1000000000ULL + (IMG_UINT64)sTime.tv_nsec;
+}
+
+static int BridgeCall(BENCH_CONNECTION *psConn,
+					  IMG_UINT32 ui32BridgeID,
+					  IMG_VOID *pvParamIn,
+					  IMG_UINT32 ui32InBufferSize,
+					  IMG_VOID *pvParamOut,
+					  IMG_UINT32 ui32OutBufferSize)
+{
+	PVRSRV_BRIDGE_PACKAGE sPackage;
+
+	sPackage.ui32BridgeID = ui32BridgeID;
+	sPackage.ui32Size = sizeof(sPackage);
+	sPackage.hParamIn = (IMG_HANDLE)(IMG_UINTPTR_T)pvParamIn;
+	sPackage.hParamOut = (IMG_HANDLE)(IMG_UINTPTR_T)pvParamOut;
+	sPackage.ui32InBufferSize = ui32InBufferSize;
+	sPackage.ui32OutBufferSize = ui32OutBufferSize;
+	sPackage.hKernelServices = psConn->hServices;
+
+	return ioctl(psConn->iFD, ui32BridgeID, &sPackage);
+}
+
+/* Connect to services and allocate a sync object to query */
+static int Connect(BENCH_CONNECTION *psConn)
+{
+	PVRSRV_BRIDGE_IN_CONNECT_SERVICES sConnectIN;
+	PVRSRV_BRIDGE_OUT_CONNECT_SERVICES sConnectOUT;
+	PVRSRV_BRIDGE_OUT_ENUMDEVICE sEnumOUT;
+	PVRSRV_BRIDGE_IN_ACQUIRE_DEVICEINFO sAcquireIN;
+	PVRSRV_BRIDGE_OUT_ACQUIRE_DEVICEINFO sAcquireOUT;
+	PVRSRV_BRIDGE_IN_ALLOC_SYNC_INFO sAllocSyncIN;
+	PVRSRV_BRIDGE_OUT_ALLOC_SYNC_INFO sAllocSyncOUT;
+	IMG_UINT32 i;
+
+	memset(psConn, 0, sizeof(*psConn));
+
+	psConn->iFD = open(gpszDevice, O_RDWR);
+	if (psConn->iFD < 0)
+	{
+		fprintf(stderr, "Couldn't open %s: %s\n", gpszDevice, strerror(errno));
+		return -1;
+	}
+
+	memset(&sConnectIN, 0, sizeof(sConnectIN));
+	memset(&sConnectOUT, 0, sizeof(sConnectOUT));
+	if (BridgeCall(psConn, PVRSRV_BRIDGE_CONNECT_SERVICES,
+				   &sConnectIN, sizeof(sConnectIN),
+				   &sConnectOUT, sizeof(sConnectOUT)) != 0 ||
+		sConnectOUT.eError != PVRSRV_OK)
+	{
+		fprintf(stderr, "Couldn't connect to services (%d)\n", sConnectOUT.eError);
+		return -1;
+	}
+	psConn->hServices = (IMG_HANDLE)(IMG_UINTPTR_T)sConnectOUT.hKernelServices;
+
+	memset(&sEnumOUT, 0, sizeof(sEnumOUT));
+	if (BridgeCall(psConn, PVRSRV_BRIDGE_ENUM_DEVICES,
+				   IMG_NULL, 0, &sEnumOUT, sizeof(sEnumOUT)) != 0 ||
+		sEnumOUT.eError != PVRSRV_OK)
+	{
+		fprintf(stderr, "Couldn't enumerate devices (%d)\n", sEnumOUT.eError);
+		return -1;
+	}
+
+	for (i = 0; i < sEnumOUT.ui32NumDevices; i++)
+	{
+		if (sEnumOUT.asDeviceIdentifier[i].eDeviceType == PVRSRV_DEVICE_TYPE_SGX)
+		{
+			break;
+		}
+	}
+	if (i == sEnumOUT.ui32NumDevices)
+	{
+		fprintf(stderr, "No SGX device\n");
+		return -1;
+	}
+
+	sAcquireIN.uiDevIndex = sEnumOUT.asDeviceIdentifier[i].ui32DeviceIndex;
+	sAcquireIN.eDeviceType = PVRSRV_DEVICE_TYPE_SGX;
+	memset(&sAcquireOUT, 0, sizeof(sAcquireOUT));
+	if (BridgeCall(psConn, PVRSRV_BRIDGE_ACQUIRE_DEVICEINFO,
+				   &sAcquireIN, sizeof(sAcquireIN),
+				   &sAcquireOUT, sizeof(sAcquireOUT)) != 0 ||
+		sAcquireOUT.eError != PVRSRV_OK)
+	{
+		fprintf(stderr, "Couldn't acquire the SGX device (%d)\n", sAcquireOUT.eError);
+		return -1;
+	}
+	psConn->hDevCookie = sAcquireOUT.hDevCookie;
+
+	sAllocSyncIN.hDevCookie = psConn->hDevCookie;
+	memset(&sAllocSyncOUT, 0, sizeof(sAllocSyncOUT));
+	if (BridgeCall(psConn, PVRSRV_BRIDGE_ALLOC_SYNC_INFO,
+				   &sAllocSyncIN, sizeof(sAllocSyncIN),
+				   &sAllocSyncOUT, sizeof(sAllocSyncOUT)) != 0 ||
+		sAllocSyncOUT.eError != PVRSRV_OK)
+	{
+		fprintf(stderr, "Couldn't allocate a sync object (%d)\n", sAllocSyncOUT.eError);
+		return -1;
+	}
+	psConn->hSyncInfo = sAllocSyncOUT.hKernelSyncInfo;
+
+	return 0;
+}
+
+/* A call that is always serialised, and does next to nothing */
+static int SerialCall(BENCH_CONNECTION *psConn)
+{
+	PVRSRV_BRIDGE_IN_GETFREEDEVICEMEM sIN;
+	PVRSRV_BRIDGE_OUT_GETFREEDEVICEMEM sOUT;
+
+	memset(&sIN, 0, sizeof(sIN));
+
+	if (BridgeCall(psConn, PVRSRV_BRIDGE_GETFREE_DEVICEMEM,
+				   &sIN, sizeof(sIN), &sOUT, sizeof(sOUT)) != 0)
+	{
+		return -1;
+	}
+
+	return (sOUT.eError == PVRSRV_OK) ? 0 : -1;
+}
+
+static int TokenCall(BENCH_CONNECTION *psConn)
+{
+	PVRSRV_BRIDGE_IN_SYNC_OPS_TAKE_TOKEN sIN;
+	PVRSRV_BRIDGE_OUT_SYNC_OPS_TAKE_TOKEN sOUT;
+
+	sIN.hKernelSyncInfo = psConn->hSyncInfo;
+
+	if (BridgeCall(psConn, PVRSRV_BRIDGE_SYNC_OPS_TAKE_TOKEN,
+				   &sIN, sizeof(sIN), &sOUT, sizeof(sOUT)) != 0)
+	{
+		return -1;
+	}
+
+	return (sOUT.eError == PVRSRV_OK) ? 0 : -1;
+}
+
+/* The sync object is never used, so every token is already satisfied */
+static int FlushCall(BENCH_CONNECTION *psConn)
+{
+	PVRSRV_BRIDGE_IN_SYNC_OPS_FLUSH_TO_TOKEN sIN;
+	PVRSRV_BRIDGE_RETURN sOUT;
+
+	memset(&sIN, 0, sizeof(sIN));
+	sIN.hKernelSyncInfo = psConn->hSyncInfo;
+
+	if (BridgeCall(psConn, PVRSRV_BRIDGE_SYNC_OPS_FLUSH_TO_TOKEN,
+				   &sIN, sizeof(sIN), &sOUT, sizeof(sOUT)) != 0)
+	{
+		return -1;
+	}
+
+	return (sOUT.eError == PVRSRV_OK) ? 0 : -1;
+}
+
+/* Fill in gui32BatchSize calls of the mode being measured */
+static IMG_VOID PrepareBatch(BENCH_CONNECTION *psConn)
+{
+	IMG_UINT32 i;
+
+	memset(&gsBatch, 0, sizeof(gsBatch));
+	gsBatch.sIN.ui32Flags = PVRSRV_BRIDGE_BATCH_FLAGS_STOP_ON_ERROR;
+	gsBatch.sIN.ui32NumCalls = gui32BatchSize;
+
+	for (i = 0; i < gui32BatchSize; i++)
+	{
+		PVRSRV_BRIDGE_PACKAGE *psCall = &gsBatch.sIN.asCalls[i];
+
+		psCall->ui32Size = sizeof(*psCall);
+		psCall->hParamIn = (IMG_HANDLE)(IMG_UINTPTR_T)&gsBatch.auCallIN[i];
+		psCall->hParamOut = (IMG_HANDLE)(IMG_UINTPTR_T)&gsBatch.auCallOUT[i];
+		psCall->hKernelServices = psConn->hServices;
+
+		switch (geMode)
+		{
+			case BENCH_MODE_TOKEN:
+				psCall->ui32BridgeID = PVRSRV_BRIDGE_SYNC_OPS_TAKE_TOKEN;
+				psCall->ui32InBufferSize = sizeof(gsBatch.auCallIN[i].sToken);
+				psCall->ui32OutBufferSize = sizeof(gsBatch.auCallOUT[i].sToken);
+				gsBatch.auCallIN[i].sToken.hKernelSyncInfo = psConn->hSyncInfo;
+				break;
+			case BENCH_MODE_FLUSH:
+				psCall->ui32BridgeID = PVRSRV_BRIDGE_SYNC_OPS_FLUSH_TO_TOKEN;
+				psCall->ui32InBufferSize = sizeof(gsBatch.auCallIN[i].sFlush);
+				psCall->ui32OutBufferSize = sizeof(gsBatch.auCallOUT[i].sFlush);
+				gsBatch.auCallIN[i].sFlush.hKernelSyncInfo = psConn->hSyncInfo;
+				break;
+			default:
+				psCall->ui32BridgeID = PVRSRV_BRIDGE_GETFREE_DEVICEMEM;
+				psCall->ui32InBufferSize = sizeof(gsBatch.auCallIN[i].sSerial);
+				psCall->ui32OutBufferSize = sizeof(gsBatch.auCallOUT[i].sSerial);
+				break;
+		}
+	}
+}
+
+static int BatchCall(BENCH_CONNECTION *psConn)
+{
+	IMG_UINT32 i;
+
+	if (BridgeCall(psConn, PVRSRV_BRIDGE_BATCH,
+				   &gsBatch.sIN,
+				   offsetof(PVRSRV_BRIDGE_IN_BATCH, asCalls) +
+				   gui32BatchSize * sizeof(PVRSRV_BRIDGE_PACKAGE),
+				   &gsBatch.sOUT,
+				   offsetof(PVRSRV_BRIDGE_OUT_BATCH, ai32Results) +
+				   gui32BatchSize * sizeof(IMG_INT32)) != 0 ||
+		gsBatch.sOUT.ui32NumCallsMade != gui32BatchSize)
+	{
+		return -1;
+	}
+
+	for (i = 0; i < gui32BatchSize; i++)
+	{
+		if (gsBatch.sOUT.ai32Results[i] != 0 ||
+			gsBatch.auCallOUT[i].eError != PVRSRV_OK)
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/* Create a submission ring of at least gui32RingCalls slots and map it */
+static int CreateRing(BENCH_CONNECTION *psConn)
+{
+	PVRSRV_BRIDGE_IN_CREATE_SUBMIT_RING sCreateIN;
+	PVRSRV_BRIDGE_OUT_CREATE_SUBMIT_RING sCreateOUT;
+	PVRSRV_BRIDGE_IN_MHANDLE_TO_MMAP_DATA sMMapIN;
+	PVRSRV_BRIDGE_OUT_MHANDLE_TO_MMAP_DATA sMMapOUT;
+	IMG_VOID *pvMapping;
+
+	sCreateIN.ui32NumSlots = 1;
+	while (sCreateIN.ui32NumSlots < gui32RingCalls)
+	{
+		sCreateIN.ui32NumSlots <<= 1;
+	}
+
+	memset(&sCreateOUT, 0, sizeof(sCreateOUT));
+	if (BridgeCall(psConn, PVRSRV_BRIDGE_CREATE_SUBMIT_RING,
+				   &sCreateIN, sizeof(sCreateIN),
+				   &sCreateOUT, sizeof(sCreateOUT)) != 0 ||
+		sCreateOUT.eError != PVRSRV_OK)
+	{
+		fprintf(stderr, "Couldn't create a submission ring (%d)\n", sCreateOUT.eError);
+		return -1;
+	}
+
+	sMMapIN.hMHandle = sCreateOUT.hRing;
+	memset(&sMMapOUT, 0, sizeof(sMMapOUT));
+	if (BridgeCall(psConn, PVRSRV_BRIDGE_MHANDLE_TO_MMAP_DATA,
+				   &sMMapIN, sizeof(sMMapIN),
+				   &sMMapOUT, sizeof(sMMapOUT)) != 0 ||
+		sMMapOUT.eError != PVRSRV_OK)
+	{
+		fprintf(stderr, "Couldn't get the ring's mmap data (%d)\n", sMMapOUT.eError);
+		return -1;
+	}
+
+	pvMapping = mmap(IMG_NULL, sMMapOUT.uiRealByteSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+					 psConn->iFD, (off_t)sMMapOUT.uiMMapOffset * getpagesize());
+	if (pvMapping == MAP_FAILED)
+	{
+		perror("mmap of the submission ring");
+		return -1;
+	}
+
+	psConn->pvRingMapping = pvMapping;
+	psConn->uiRingMappingSize = sMMapOUT.uiRealByteSize;
+	psConn->psRing = (PVRSRV_SUBMIT_RING *)((IMG_PBYTE)pvMapping + sMMapOUT.uiByteOffset);
+
+	if (psConn->psRing->ui32NumSlots != sCreateIN.ui32NumSlots)
+	{
+		fprintf(stderr, "Submission ring has %u slots, not %u\n",
+				psConn->psRing->ui32NumSlots, sCreateIN.ui32NumSlots);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Unmap and destroy the submission ring, checking both work */
+static int DestroyRing(BENCH_CONNECTION *psConn)
+{
+	PVRSRV_BRIDGE_RETURN sRetOUT;
+
+	if (munmap(psConn->pvRingMapping, psConn->uiRingMappingSize) != 0)
+	{
+		perror("munmap of the submission ring");
+		return -1;
+	}
+	psConn->psRing = IMG_NULL;
+
+	memset(&sRetOUT, 0, sizeof(sRetOUT));
+	if (BridgeCall(psConn, PVRSRV_BRIDGE_DESTROY_SUBMIT_RING,
+				   IMG_NULL, 0, &sRetOUT, sizeof(sRetOUT)) != 0 ||
+		sRetOUT.eError != PVRSRV_OK)
+	{
+		fprintf(stderr, "Couldn't destroy the submission ring (%d)\n", sRetOUT.eError);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Post gui32RingCalls calls of the mode being measured, then ring the doorbell */
+static int RingCall(BENCH_CONNECTION *psConn)
+{
+	PVRSRV_SUBMIT_RING *psRing = psConn->psRing;
+	PVRSRV_BRIDGE_OUT_SUBMIT_RING_DOORBELL sDoorbellOUT;
+	IMG_UINT32 ui32Mask = psRing->ui32NumSlots - 1;
+	IMG_UINT32 ui32Write = psConn->ui32RingWrite;
+	IMG_UINT32 i;
+
+	for (i = 0; i < gui32RingCalls; i++)
+	{
+		PVRSRV_SUBMIT_RING_SLOT *psSlot = &psRing->asSlots[(ui32Write + i) & ui32Mask];
+
+		switch (geMode)
+		{
+			case BENCH_MODE_TOKEN:
+			{
+				PVRSRV_BRIDGE_IN_SYNC_OPS_TAKE_TOKEN sIN;
+
+				sIN.hKernelSyncInfo = psConn->hSyncInfo;
+				psSlot->ui32BridgeID = PVRSRV_BRIDGE_SYNC_OPS_TAKE_TOKEN;
+				psSlot->ui32InBufferSize = sizeof(sIN);
+				psSlot->ui32OutBufferSize = sizeof(PVRSRV_BRIDGE_OUT_SYNC_OPS_TAKE_TOKEN);
+				memcpy(psSlot->aui8In, &sIN, sizeof(sIN));
+				break;
+			}
+			case BENCH_MODE_FLUSH:
+			{
+				PVRSRV_BRIDGE_IN_SYNC_OPS_FLUSH_TO_TOKEN sIN;
+
+				memset(&sIN, 0, sizeof(sIN));
+				sIN.hKernelSyncInfo = psConn->hSyncInfo;
+				psSlot->ui32BridgeID = PVRSRV_BRIDGE_SYNC_OPS_FLUSH_TO_TOKEN;
+				psSlot->ui32InBufferSize = sizeof(sIN);
+				psSlot->ui32OutBufferSize = sizeof(PVRSRV_BRIDGE_RETURN);
+				memcpy(psSlot->aui8In, &sIN, sizeof(sIN));
+				break;
+			}
+			default:
+				psSlot->ui32BridgeID = PVRSRV_BRIDGE_GETFREE_DEVICEMEM;
+				psSlot->ui32InBufferSize = sizeof(PVRSRV_BRIDGE_IN_GETFREEDEVICEMEM);
+				psSlot->ui32OutBufferSize = sizeof(PVRSRV_BRIDGE_OUT_GETFREEDEVICEMEM);
+				memset(psSlot->aui8In, 0, sizeof(PVRSRV_BRIDGE_IN_GETFREEDEVICEMEM));
+				break;
+		}
+	}
+
+	ui32Write += gui32RingCalls;
+	__atomic_store_n(&psRing->ui32WriteOffset, ui32Write, __ATOMIC_RELEASE);
+
+	memset(&sDoorbellOUT, 0, sizeof(sDoorbellOUT));
+	if (BridgeCall(psConn, PVRSRV_BRIDGE_SUBMIT_RING_DOORBELL,
+				   IMG_NULL, 0, &sDoorbellOUT, sizeof(sDoorbellOUT)) != 0 ||
+		sDoorbellOUT.eError != PVRSRV_OK ||
+		sDoorbellOUT.ui32NumCallsMade != gui32RingCalls ||
+		__atomic_load_n(&psRing->ui32ReadOffset, __ATOMIC_ACQUIRE) != ui32Write)
+	{
+		return -1;
+	}
+
+	for (i = 0; i < gui32RingCalls; i++)
+	{
+		PVRSRV_SUBMIT_RING_SLOT *psSlot = &psRing->asSlots[(psConn->ui32RingWrite + i) & ui32Mask];
+		PVRSRV_ERROR eError;
+
+		/* every output starts with the call's PVRSRV_ERROR */
+		memcpy(&eError, psSlot->aui8Out, sizeof(eError));
+		if (psSlot->i32Result != 0 || eError != PVRSRV_OK)
+		{
+			return -1;
+		}
+	}
+
+	psConn->ui32RingWrite = ui32Write;
+
+	return 0;
+}
+
+static int RunClient(BENCH_SHARED *psShared, IMG_UINT32 ui32Client)
+{
+	BENCH_CLIENT *psClient = &psShared->asClient[ui32Client];
+	BENCH_CONNECTION sConn;
+	IMG_UINT64 ui64Start, ui64End, ui64Last, ui64Now;
+	IMG_UINT32 ui32Countdown = gui32SerialEvery;
+	IMG_UINT32 ui32CallsEach = 1;
+	int (*pfnCall)(BENCH_CONNECTION *);
+	int iErr;
+
+	if (Connect(&sConn) != 0)
+	{
+		psClient->bFailed = IMG_TRUE;
+		return 1;
+	}
+
+	switch (geMode)
+	{
+		case BENCH_MODE_TOKEN:
+			pfnCall = TokenCall;
+			break;
+		case BENCH_MODE_FLUSH:
+			pfnCall = FlushCall;
+			break;
+		default:
+			pfnCall = SerialCall;
+			break;
+	}
+
+	if (gui32BatchSize != 0)
+	{
+		PrepareBatch(&sConn);
+		pfnCall = BatchCall;
+		ui32CallsEach = gui32BatchSize;
+	}
+
+	if (gui32RingCalls != 0)
+	{
+		if (CreateRing(&sConn) != 0)
+		{
+			psClient->bFailed = IMG_TRUE;
+			return 1;
+		}
+		pfnCall = RingCall;
+		ui32CallsEach = gui32RingCalls;
+	}
+
+	psClient->bReady = IMG_TRUE;
+	while (!psShared->bGo)
+	{
+		sched_yield();
+	}
+
+	ui64Start = ui64Last = NowNs();
+	ui64End = ui64Start + (IMG_UINT64)gui32Seconds * 1000000000ULL;
+
+	for (;;)
+	{
+		IMG_UINT32 i;
+
+		for (i = 0; i < BENCH_CLOCK_INTERVAL; i++)
+		{
+			if (gui32SerialEvery != 0 && --ui32Countdown == 0)
+			{
+				ui32Countdown = gui32SerialEvery;
+				iErr = SerialCall(&sConn);
+				psClient->ui64Serial++;
+			}
+			else
+			{
+				iErr = pfnCall(&sConn);
+			}
+
+			if (iErr != 0)
+			{
+				fprintf(stderr, "Client %u: bridge call failed\n", ui32Client);
+				psClient->bFailed = IMG_TRUE;
+				return 1;
+			}
+		}
+
+		psClient->ui64Calls += BENCH_CLOCK_INTERVAL * ui32CallsEach;
+
+		/* worst time for a group of ioctls, a rough guide to lock waits */
+		ui64Now = NowNs();
+		if (ui64Now - ui64Last > psClient->ui64MaxNs)
+		{
+			psClient->ui64MaxNs = ui64Now - ui64Last;
+		}
+		ui64Last = ui64Now;
+
+		if (ui64Now >= ui64End)
+		{
+			break;
+		}
+	}
+
+	psClient->ui64ElapsedNs = ui64Last - ui64Start;
+
+	if (gui32RingCalls != 0 && DestroyRing(&sConn) != 0)
+	{
+		psClient->bFailed = IMG_TRUE;
+		return 1;
+	}
+
+	/* closing the connection frees the sync object */
+	close(sConn.iFD);
+
+	return 0;
+}
+
+/* Switch the driver's per-process data cache, returning 0 on success */
+static int SetPerProcCache(IMG_BOOL bEnable)
+{
+	FILE *psParam = fopen(BENCH_PERPROC_CACHE_PARAM, "w");
+	int iRet;
+
+	if (psParam == IMG_NULL)
+	{
+		perror(BENCH_PERPROC_CACHE_PARAM);
+		return -1;
+	}
+
+	iRet = (fprintf(psParam, "%d\n", bEnable ? 1 : 0) < 0) ? -1 : 0;
+	if (fclose(psParam) != 0)
+	{
+		iRet = -1;
+	}
+
+	return iRet;
+}
+
+static void Usage(const char *pszName)
+{
+	fprintf(stderr,
+			"Usage: %s [-d device] [-c clients] [-s seconds] [-m token|flush|serial] [-x n | -b n | -r n] [-l]\n"
+			"  -m token   SYNC_OPS_TAKE_TOKEN, may run concurrently (default)\n"
+			"  -m flush   SYNC_OPS_FLUSH_TO_TOKEN, may run concurrently\n"
+			"  -m serial  GETFREE_DEVICEMEM, always serialised\n"
+			"  -x n       make every nth call a serialised one\n"
+			"  -b n       make the calls n at a time with PVRSRV_BRIDGE_BATCH\n"
+			"  -r n       post the calls n at a time to a submission ring\n"
+			"  -l         look the services handle up on every call\n",
+			pszName);
+}
+
+int main(int argc, char **argv)
+{
+	BENCH_SHARED *psShared;
+	IMG_UINT32 ui32Clients = 1;
+	IMG_UINT32 i;
+	IMG_UINT64 ui64Calls = 0, ui64Serial = 0;
+	IMG_DOUBLE dRate = 0.0;
+	IMG_BOOL bLookup = IMG_FALSE;
+	int iOpt, iFailed = 0;
+
+	while ((iOpt = getopt(argc, argv, "d:c:s:m:x:b:r:lh")) != -1)
+	{
+		switch (iOpt)
+		{
+			case 'd':
+				gpszDevice = optarg;
+				break;
+			case 'c':
+				ui32Clients = (IMG_UINT32)strtoul(optarg, IMG_NULL, 0);
+				break;
+			case 's':
+				gui32Seconds = (IMG_UINT32)strtoul(optarg, IMG_NULL, 0);
+				break;
+			case 'm':
+				if (strcmp(optarg, "token") == 0)
+				{
+					geMode = BENCH_MODE_TOKEN;
+				}
+				else if (strcmp(optarg, "flush") == 0)
+				{
+					geMode = BENCH_MODE_FLUSH;
+				}
+				else if (strcmp(optarg, "serial") == 0)
+				{
+					geMode = BENCH_MODE_SERIAL;
+				}
+				else
+				{
+					Usage(argv[0]);
+					return 1;
+				}
+				break;
+			case 'x':
+				gui32SerialEvery = (IMG_UINT32)strtoul(optarg, IMG_NULL, 0);
+				break;
+			case 'b':
+				gui32BatchSize = (IMG_UINT32)strtoul(optarg, IMG_NULL, 0);
+				break;
+			case 'r':
+				gui32RingCalls = (IMG_UINT32)strtoul(optarg, IMG_NULL, 0);
+				break;
+			case 'l':
+				bLookup = IMG_TRUE;
+				break;
+			default:
+				Usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (ui32Clients == 0 || ui32Clients > BENCH_MAX_CLIENTS || gui32Seconds == 0 ||
+		gui32BatchSize > PVRSRV_BRIDGE_BATCH_MAX_CALLS ||
+		gui32RingCalls > PVRSRV_SUBMIT_RING_MAX_SLOTS ||
+		((gui32BatchSize != 0) + (gui32RingCalls != 0) + (gui32SerialEvery != 0)) > 1)
+	{
+		Usage(argv[0]);
+		return 1;
+	}
+
+	if (gui32RingCalls != 0 && sizeof(IMG_PVOID) != sizeof(IMG_UINT64))
+	{
+		/* PVRSRV_BRIDGE_OUT_MHANDLE_TO_MMAP_DATA has no 32-bit layout */
+		fprintf(stderr, "-r needs a 64-bit build\n");
+		return 1;
+	}
+
+	psShared = mmap(IMG_NULL, sizeof(*psShared), PROT_READ | PROT_WRITE,
+					MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (psShared == MAP_FAILED)
+	{
+		perror("mmap");
+		return 1;
+	}
+	memset(psShared, 0, sizeof(*psShared));
+
+	if (bLookup && SetPerProcCache(IMG_FALSE) != 0)
+	{
+		return 1;
+	}
+
+	/* one process per client, as services connections are per process */
+	for (i = 0; i < ui32Clients; i++)
+	{
+		pid_t iPID = fork();
+
+		if (iPID < 0)
+		{
+			perror("fork");
+			return 1;
+		}
+		if (iPID == 0)
+		{
+			_exit(RunClient(psShared, i));
+		}
+	}
+
+	for (i = 0; i < ui32Clients; i++)
+	{
+		while (!psShared->asClient[i].bReady && !psShared->asClient[i].bFailed)
+		{
+			usleep(1000);
+		}
+	}
+	psShared->bGo = IMG_TRUE;
+
+	for (i = 0; i < ui32Clients; i++)
+	{
+		int iStatus;
+
+		if (wait(&iStatus) < 0 || !WIFEXITED(iStatus) || WEXITSTATUS(iStatus) != 0)
+		{
+			iFailed = 1;
+		}
+	}
+
+	if (bLookup && SetPerProcCache(IMG_TRUE) != 0)
+	{
+		iFailed = 1;
+	}
+
+	printf("%u-bit clients\n", (unsigned)(sizeof(IMG_PVOID) * 8));
+	printf("%-8s %12s %12s %10s %12s\n", "client", "calls", "calls/s", "ns/call", "worst/64 us");
+	for (i = 0; i < ui32Clients; i++)
+	{
+		BENCH_CLIENT *psClient = &psShared->asClient[i];
+		IMG_DOUBLE dSeconds;
+
+		if (psClient->ui64ElapsedNs == 0)
+		{
+			continue;
+		}
+
+		dSeconds = (IMG_DOUBLE)psClient->ui64ElapsedNs / 1e9;
+		printf("%-8u %12llu %12.0f %10.0f %12.1f\n", i,
+			   (unsigned long long)psClient->ui64Calls,
+			   (IMG_DOUBLE)psClient->ui64Calls / dSeconds,
+			   (IMG_DOUBLE)psClient->ui64ElapsedNs / (IMG_DOUBLE)psClient->ui64Calls,
+			   (IMG_DOUBLE)psClient->ui64MaxNs / 1e3);
+
+		ui64Calls += psClient->ui64Calls;
+		ui64Serial += psClient->ui64Serial;
+		dRate += (IMG_DOUBLE)psClient->ui64Calls / dSeconds;
+	}
+
+	printf("total    %12llu %12.0f   (%llu serialised)\n",
+		   (unsigned long long)ui64Calls, dRate, (unsigned long long)ui64Serial);
+
+	return iFailed;
+}
@@ -0,0 +1,839 @@
+/*************************************************************************/ /*!
+@Title          Bridge capture replayer
+@Copyright      Copyright (c) Imagination Technologies Ltd. All Rights Reserved
+@Description    Records an application's bridge calls through a driver
+                built with PVRSRV_BRIDGE_CAPTURE=1, and replays them
+                against another driver, reporting what each kind of call
+                cost. Replaying one capture on successive builds of the
+                nohw driver shows where kernel-side bridge costs changed.
+@License        Dual MIT/GPLv2
+
+The contents of this file are subject to the MIT license as set out below.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public License Version 2 ("GPL") in which case the provisions
+of GPL are applicable instead of those above.
+
+If you wish to allow use of your version of this file only under the terms of
+GPL, and not to allow others to use your version of this file under the terms
+of the MIT license, indicate your decision by deleting the provisions above
+and replace them with the notice and other provisions required by GPL as set
+out in the file called "GPL-COPYING" included in this distribution. If you do
+not delete the provisions above, a recipient may use your version of this file
+under the terms of either the MIT license or GPL.
+
+This License is also included in this distribution in the file called
+"MIT-COPYING".
+
+EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/ /**************************************************************************/
+
+/*
+ * Capture (as root, on the device) by starting the recorder and then the
+ * application; stop it with ^C once the application has exited:
+ *
+ *   bridgereplay -r app.cap
+ *
+ * Replay on a driver that srvinit has initialised, built with the same
+ * bridge options as the one captured on (see the Makefile):
+ *
+ *   bridgereplay app.cap            replay once, per-call report
+ *   bridgereplay -n 20 app.cap      replay 20 times over, each time from
+ *                                   fresh connections
+ *   bridgereplay -x 42 app.cap      also skip calls with bridge ID 42
+ *
+ * Each captured process's calls are made in one connection of the
+ * replayer's, in the order they finished in. Handles are tracked by the
+ * symbols the capture named them with: a call is skipped if it uses one
+ * whose call wasn't captured or didn't succeed in the replay. Calls that
+ * pass pointers into the client or file descriptors can't be replayed
+ * and are skipped too.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "img_defs.h"
+#include "services.h"
+#include "pvr_bridge.h"
+#include "sgx_bridge.h"
+#include "bridge_capture.h"
+
+#define REPLAY_MAX_CONNECTIONS	64
+
+/* _IOC_NR is 8 bits */
+#define REPLAY_MAX_BRIDGE_IDS	256
+
+#define REPLAY_BRIDGE_ID(X)		_IOC_NR(X)
+
+/* The replayer's idea of how many bridge IDs there are, as the capture's START says */
+#define REPLAY_NUM_BRIDGE_IDS	(PVRSRV_BRIDGE_SUBMIT_RING_CMD_LAST + 1)
+
+/* Bytes read from the capture file at a time while recording */
+#define RECORD_READ_SIZE		(64 * 1024)
+
+typedef struct _REPLAY_CONNECTION_
+{
+	IMG_UINT32	ui32PID;		/* captured process the connection stands in for */
+	int			iFD;
+	IMG_HANDLE	hServices;		/* from the replayed PVRSRV_BRIDGE_CONNECT_SERVICES */
+} REPLAY_CONNECTION;
+
+typedef struct _REPLAY_STATS_
+{
+	IMG_UINT64	ui64Calls;
+	IMG_UINT64	ui64Mismatches;	/* result differed from the capture's */
+	IMG_UINT64	ui64ReplayNs;
+	IMG_UINT64	ui64ReplayMaxNs;
+	IMG_UINT64	ui64CapturedNs;
+} REPLAY_STATS;
+
+static const char *gpszDevice = "/dev/pvrsrvkm";
+static const char *gpszCaptureFile = "/sys/kernel/debug/pvrsrvkm_bridge_capture";
+static IMG_BOOL gbVerbose = IMG_FALSE;
+
+static REPLAY_CONNECTION gasConnections[REPLAY_MAX_CONNECTIONS];
+static IMG_UINT32 gui32NumConnections;
+
+/* Live handle values by symbol, 0 while unbound */
+static IMG_UINT64 *gpui64Symbols;
+static IMG_UINT32 gui32NumSymbols;
+static IMG_UINT32 gui32HandleSize;
+
+static REPLAY_STATS gasStats[REPLAY_MAX_BRIDGE_IDS];
+static IMG_BOOL gabSkip[REPLAY_MAX_BRIDGE_IDS];
+
+static IMG_UINT64 gui64Replayed;
+static IMG_UINT64 gui64SkippedNotReplayable;
+static IMG_UINT64 gui64SkippedUnbound;
+static IMG_UINT64 gui64SkippedHandlesLost;
+static IMG_UINT64 gui64SkippedNoConnection;
+static IMG_UINT64 gui64CaptureLost;
+
+/* Calls that can't be made from a capture */
+static const IMG_UINT32 gaui32NotReplayable[] =
+{
+	/* made by srvinit, which has already run */
+	PVRSRV_BRIDGE_INITSRV_CONNECT,
+	PVRSRV_BRIDGE_INITSRV_DISCONNECT,
+	PVRSRV_BRIDGE_SGXINFO_FOR_SRVINIT,
+	PVRSRV_BRIDGE_SGX_DEVINITPART2,
+
+	/* pass pointers into the client */
+	PVRSRV_BRIDGE_WRAP_EXT_MEMORY,
+	PVRSRV_BRIDGE_GET_MISC_INFO,
+	PVRSRV_BRIDGE_SGX_GETMISCINFO,
+	PVRSRV_BRIDGE_SGX_ADDSHAREDPBDESC,
+	PVRSRV_BRIDGE_SGX_READREGISTRYDWORD,
+	PVRSRV_BRIDGE_SGX_READ_HWPERF_CB,
+
+	/* pass file descriptors */
+	PVRSRV_BRIDGE_MAP_DEV_MEMORY_2,
+	PVRSRV_BRIDGE_EXPORT_DEVICEMEM_2,
+#if defined(SUPPORT_ION)
+	PVRSRV_BRIDGE_MAP_ION_HANDLE,
+#endif
+#if defined(SUPPORT_DMABUF)
+	PVRSRV_BRIDGE_MAP_DMABUF,
+#endif
+
+#if defined(PDUMP)
+	PVRSRV_BRIDGE_PDUMP_MEMPOL,
+	PVRSRV_BRIDGE_PDUMP_DUMPMEM,
+	PVRSRV_BRIDGE_PDUMP_DUMPBITMAP,
+	PVRSRV_BRIDGE_PDUMP_MEMPAGES,
+	PVRSRV_BRIDGE_SGX_PDUMP_BUFFER_ARRAY,
+	PVRSRV_BRIDGE_SGX_PDUMP_3D_SIGNATURE_REGISTERS,
+	PVRSRV_BRIDGE_SGX_PDUMP_COUNTER_REGISTERS,
+	PVRSRV_BRIDGE_SGX_PDUMP_TA_SIGNATURE_REGISTERS,
+#endif
+};
+
+static volatile sig_atomic_t gbStop;
+
+
+static IMG_UINT64 NowNs(IMG_VOID)
+{
+	struct timespec sTime;
+
+	clock_gettime(CLOCK_MONOTONIC, &sTime);
+
+	return (IMG_UINT64)sTime.tv_sec * 1000000000ULL + (IMG_UINT64)sTime.tv_nsec;
+}
+
+static void Stop(int iSignal)
+{
+	(void)iSignal;
+	gbStop = 1;
+}
+
+/* Copy whatever the driver has recorded to psOut; returns bytes copied or -1 */
+static ssize_t Drain(int iCapture, FILE *psOut, IMG_UINT8 *pui8Buffer)
+{
+	ssize_t iTotal = 0;
+
+	for (;;)
+	{
+		ssize_t iRead = read(iCapture, pui8Buffer, RECORD_READ_SIZE);
+
+		if (iRead < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (iRead < 0)
+		{
+			fprintf(stderr, "Couldn't read %s: %s\n", gpszCaptureFile, strerror(errno));
+			return -1;
+		}
+		if (iRead == 0)
+		{
+			return iTotal;
+		}
+
+		if (fwrite(pui8Buffer, 1, (size_t)iRead, psOut) != (size_t)iRead)
+		{
+			fprintf(stderr, "Couldn't write the capture: %s\n", strerror(errno));
+			return -1;
+		}
+		iTotal += iRead;
+	}
+}
+
+/* Record until interrupted, draining the driver's ring as it goes */
+static int Record(const char *pszOutput)
+{
+	IMG_UINT8 *pui8Buffer;
+	FILE *psOut;
+	int iCapture;
+	int iRet = -1;
+
+	pui8Buffer = malloc(RECORD_READ_SIZE);
+	if (pui8Buffer == IMG_NULL)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return -1;
+	}
+
+	iCapture = open(gpszCaptureFile, O_RDWR);
+	if (iCapture < 0)
+	{
+		fprintf(stderr, "Couldn't open %s: %s\n", gpszCaptureFile, strerror(errno));
+		free(pui8Buffer);
+		return -1;
+	}
+
+	psOut = fopen(pszOutput, "wb");
+	if (psOut == IMG_NULL)
+	{
+		fprintf(stderr, "Couldn't create %s: %s\n", pszOutput, strerror(errno));
+		goto exit_close;
+	}
+
+	signal(SIGINT, Stop);
+	signal(SIGTERM, Stop);
+
+	if (write(iCapture, "1", 1) != 1)
+	{
+		fprintf(stderr, "Couldn't start capturing: %s\n", strerror(errno));
+		goto exit_close_out;
+	}
+	fprintf(stderr, "Capturing; start the application, and interrupt once it has exited\n");
+
+	while (!gbStop)
+	{
+		ssize_t iCopied = Drain(iCapture, psOut, pui8Buffer);
+
+		if (iCopied < 0)
+		{
+			break;
+		}
+		if (iCopied == 0)
+		{
+			usleep(10000);
+		}
+	}
+
+	if (write(iCapture, "0", 1) != 1)
+	{
+		fprintf(stderr, "Couldn't stop capturing: %s\n", strerror(errno));
+	}
+
+	if (Drain(iCapture, psOut, pui8Buffer) >= 0)
+	{
+		iRet = 0;
+	}
+
+exit_close_out:
+	if (fclose(psOut) != 0)
+	{
+		iRet = -1;
+	}
+exit_close:
+	close(iCapture);
+	free(pui8Buffer);
+	return iRet;
+}
+
+static REPLAY_CONNECTION *GetConnection(IMG_UINT32 ui32PID)
+{
+	REPLAY_CONNECTION *psConn;
+	IMG_UINT32 i;
+
+	for (i = 0; i < gui32NumConnections; i++)
+	{
+		if (gasConnections[i].ui32PID == ui32PID)
+		{
+			return &gasConnections[i];
+		}
+	}
+
+	if (gui32NumConnections == REPLAY_MAX_CONNECTIONS)
+	{
+		return IMG_NULL;
+	}
+
+	psConn = &gasConnections[gui32NumConnections];
+	psConn->iFD = open(gpszDevice, O_RDWR);
+	if (psConn->iFD < 0)
+	{
+		fprintf(stderr, "Couldn't open %s: %s\n", gpszDevice, strerror(errno));
+		return IMG_NULL;
+	}
+	psConn->ui32PID = ui32PID;
+	psConn->hServices = IMG_NULL;
+	gui32NumConnections++;
+
+	return psConn;
+}
+
+static IMG_VOID CloseConnections(IMG_VOID)
+{
+	IMG_UINT32 i;
+
+	for (i = 0; i < gui32NumConnections; i++)
+	{
+		close(gasConnections[i].iFD);
+	}
+	gui32NumConnections = 0;
+}
+
+static IMG_UINT64 ReadHandle(const IMG_UINT8 *pui8Buffer, IMG_UINT32 ui32Offset)
+{
+	if (gui32HandleSize == sizeof(IMG_UINT64))
+	{
+		IMG_UINT64 ui64Value;
+
+		memcpy(&ui64Value, pui8Buffer + ui32Offset, sizeof(ui64Value));
+		return ui64Value;
+	}
+	else
+	{
+		IMG_UINT32 ui32Value;
+
+		memcpy(&ui32Value, pui8Buffer + ui32Offset, sizeof(ui32Value));
+		return ui32Value;
+	}
+}
+
+static IMG_VOID WriteHandle(IMG_UINT8 *pui8Buffer, IMG_UINT32 ui32Offset, IMG_UINT64 ui64Value)
+{
+	if (gui32HandleSize == sizeof(IMG_UINT64))
+	{
+		memcpy(pui8Buffer + ui32Offset, &ui64Value, sizeof(ui64Value));
+	}
+	else
+	{
+		IMG_UINT32 ui32Value = (IMG_UINT32)ui64Value;
+
+		memcpy(pui8Buffer + ui32Offset, &ui32Value, sizeof(ui32Value));
+	}
+}
+
+static int BindSymbol(IMG_UINT32 ui32Symbol, IMG_UINT64 ui64Value)
+{
+	if (ui32Symbol >= gui32NumSymbols)
+	{
+		IMG_UINT32 ui32NewNum = (ui32Symbol + 1) * 2;
+		IMG_UINT64 *pui64New = realloc(gpui64Symbols, ui32NewNum * sizeof(IMG_UINT64));
+
+		if (pui64New == IMG_NULL)
+		{
+			fprintf(stderr, "Out of memory\n");
+			return -1;
+		}
+		memset(pui64New + gui32NumSymbols, 0, (ui32NewNum - gui32NumSymbols) * sizeof(IMG_UINT64));
+		gpui64Symbols = pui64New;
+		gui32NumSymbols = ui32NewNum;
+	}
+
+	gpui64Symbols[ui32Symbol] = ui64Value;
+
+	return 0;
+}
+
+static IMG_UINT64 LookupSymbol(IMG_UINT32 ui32Symbol)
+{
+	return (ui32Symbol < gui32NumSymbols) ? gpui64Symbols[ui32Symbol] : 0;
+}
+
+/* Make one captured call; returns -1 only if the replay can't go on */
+static int ReplayCall(const PVRSRV_BRIDGE_CAPTURE_RECORD *psRecord)
+{
+	const PVRSRV_BRIDGE_CAPTURE_HANDLE *psHandles = (const PVRSRV_BRIDGE_CAPTURE_HANDLE *)(psRecord + 1);
+	const IMG_UINT8 *pui8CapturedIn = (const IMG_UINT8 *)(psHandles + psRecord->ui32NumHandles);
+	IMG_UINT64 aui64In[PVRSRV_BRIDGE_CAPTURE_MAX_IN / sizeof(IMG_UINT64)];
+	IMG_UINT64 aui64Out[PVRSRV_BRIDGE_CAPTURE_MAX_IN / sizeof(IMG_UINT64)];
+	IMG_UINT8 *pui8In = (IMG_UINT8 *)aui64In;
+	IMG_UINT8 *pui8Out = (IMG_UINT8 *)aui64Out;
+	PVRSRV_BRIDGE_PACKAGE sPackage;
+	REPLAY_STATS *psStats = &gasStats[psRecord->ui32BridgeID];
+	REPLAY_CONNECTION *psConn;
+	IMG_UINT64 ui64Start;
+	IMG_UINT64 ui64Ns;
+	IMG_INT32 i32Result;
+	IMG_UINT32 ui32Error = 0;
+	IMG_UINT32 i;
+
+	if (gabSkip[psRecord->ui32BridgeID])
+	{
+		gui64SkippedNotReplayable++;
+		return 0;
+	}
+
+	if (psRecord->ui16Flags & PVRSRV_BRIDGE_CAPTURE_FLAG_HANDLES_LOST)
+	{
+		gui64SkippedHandlesLost++;
+		return 0;
+	}
+
+	memcpy(pui8In, pui8CapturedIn, psRecord->ui32InBufferSize);
+	for (i = 0; i < psRecord->ui32NumHandles; i++)
+	{
+		IMG_UINT64 ui64Value;
+
+		if (psHandles[i].ui16Flags & PVRSRV_BRIDGE_CAPTURE_HANDLE_OUT)
+		{
+			continue;
+		}
+
+		ui64Value = LookupSymbol(psHandles[i].ui32Symbol);
+		if (ui64Value == 0)
+		{
+			gui64SkippedUnbound++;
+			return 0;
+		}
+		WriteHandle(pui8In, psHandles[i].ui16Offset, ui64Value);
+	}
+
+	psConn = GetConnection(psRecord->ui32PID);
+	if (psConn == IMG_NULL)
+	{
+		gui64SkippedNoConnection++;
+		return 0;
+	}
+
+	memset(pui8Out, 0, psRecord->ui32OutBufferSize);
+
+	sPackage.ui32BridgeID = PVRSRV_IOWR(psRecord->ui32BridgeID);
+	sPackage.ui32Size = sizeof(sPackage);
+	sPackage.hParamIn = (IMG_HANDLE)(IMG_UINTPTR_T)pui8In;
+	sPackage.hParamOut = (IMG_HANDLE)(IMG_UINTPTR_T)pui8Out;
+	sPackage.ui32InBufferSize = psRecord->ui32InBufferSize;
+	sPackage.ui32OutBufferSize = psRecord->ui32OutBufferSize;
+	sPackage.hKernelServices = psConn->hServices;
+
+	ui64Start = NowNs();
+	i32Result = ioctl(psConn->iFD, sPackage.ui32BridgeID, &sPackage);
+	ui64Ns = NowNs() - ui64Start;
+
+	if (i32Result < 0)
+	{
+		i32Result = -errno;
+	}
+	if (psRecord->ui32OutBufferSize >= sizeof(IMG_UINT32))
+	{
+		memcpy(&ui32Error, pui8Out, sizeof(ui32Error));
+	}
+
+	gui64Replayed++;
+	psStats->ui64Calls++;
+	psStats->ui64ReplayNs += ui64Ns;
+	psStats->ui64CapturedNs += psRecord->ui64Durationns;
+	if (ui64Ns > psStats->ui64ReplayMaxNs)
+	{
+		psStats->ui64ReplayMaxNs = ui64Ns;
+	}
+
+	if (i32Result != psRecord->i32Result || ui32Error != psRecord->ui32Error)
+	{
+		psStats->ui64Mismatches++;
+		if (gbVerbose)
+		{
+			fprintf(stderr, "Bridge ID %u: returned %d, error %u; captured %d, error %u\n",
+					psRecord->ui32BridgeID, i32Result, ui32Error,
+					psRecord->i32Result, psRecord->ui32Error);
+		}
+	}
+
+	if (i32Result != 0 || ui32Error != PVRSRV_OK)
+	{
+		/* Calls using what this should have given back will be skipped */
+		return 0;
+	}
+
+	if (psRecord->ui32BridgeID == REPLAY_BRIDGE_ID(PVRSRV_BRIDGE_CONNECT_SERVICES))
+	{
+		PVRSRV_BRIDGE_OUT_CONNECT_SERVICES *psConnectOUT = (PVRSRV_BRIDGE_OUT_CONNECT_SERVICES *)pui8Out;
+
+		psConn->hServices = (IMG_HANDLE)(IMG_UINTPTR_T)psConnectOUT->hKernelServices;
+	}
+
+	for (i = 0; i < psRecord->ui32NumHandles; i++)
+	{
+		if (psHandles[i].ui16Flags & PVRSRV_BRIDGE_CAPTURE_HANDLE_OUT)
+		{
+			if (BindSymbol(psHandles[i].ui32Symbol, ReadHandle(pui8Out, psHandles[i].ui16Offset)) != 0)
+			{
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/* Check a record fits in the capture and is laid out as its sizes say */
+static int CheckRecord(const PVRSRV_BRIDGE_CAPTURE_RECORD *psRecord, size_t uLeft)
+{
+	const PVRSRV_BRIDGE_CAPTURE_HANDLE *psHandles = (const PVRSRV_BRIDGE_CAPTURE_HANDLE *)(psRecord + 1);
+	IMG_UINT32 i;
+
+	if (uLeft < sizeof(*psRecord) ||
+		psRecord->ui32Size < sizeof(*psRecord) ||
+		psRecord->ui32Size > uLeft ||
+		(psRecord->ui32Size & 7) != 0)
+	{
+		return -1;
+	}
+
+	if (psRecord->ui16Type != PVRSRV_BRIDGE_CAPTURE_CALL)
+	{
+		return 0;
+	}
+
+	if (psRecord->ui32BridgeID >= REPLAY_MAX_BRIDGE_IDS ||
+		psRecord->ui32NumHandles > PVRSRV_BRIDGE_CAPTURE_MAX_HANDLES ||
+		psRecord->ui32InBufferSize > PVRSRV_BRIDGE_CAPTURE_MAX_IN ||
+		psRecord->ui32OutBufferSize > PVRSRV_BRIDGE_CAPTURE_MAX_IN ||
+		sizeof(*psRecord) + psRecord->ui32NumHandles * sizeof(*psHandles) +
+		psRecord->ui32InBufferSize > psRecord->ui32Size)
+	{
+		return -1;
+	}
+
+	for (i = 0; i < psRecord->ui32NumHandles; i++)
+	{
+		IMG_UINT32 ui32Size = (psHandles[i].ui16Flags & PVRSRV_BRIDGE_CAPTURE_HANDLE_OUT) ?
+							  psRecord->ui32OutBufferSize : psRecord->ui32InBufferSize;
+
+		if (psHandles[i].ui16Offset + gui32HandleSize > ui32Size)
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int Replay(const IMG_UINT8 *pui8Capture, size_t uSize, IMG_BOOL bForce)
+{
+	size_t uPos = 0;
+	IMG_BOOL bStarted = IMG_FALSE;
+
+	while (uPos < uSize)
+	{
+		const PVRSRV_BRIDGE_CAPTURE_RECORD *psRecord = (const PVRSRV_BRIDGE_CAPTURE_RECORD *)(pui8Capture + uPos);
+
+		if (CheckRecord(psRecord, uSize - uPos) != 0)
+		{
+			fprintf(stderr, "Bad record at offset %zu\n", uPos);
+			return -1;
+		}
+
+		switch (psRecord->ui16Type)
+		{
+			case PVRSRV_BRIDGE_CAPTURE_START:
+				if (bStarted)
+				{
+					fprintf(stderr, "More than one capture in the file\n");
+					return -1;
+				}
+				if (psRecord->ui32BridgeID != PVRSRV_BRIDGE_CAPTURE_VERSION)
+				{
+					fprintf(stderr, "Capture version %u, expected %u\n",
+							psRecord->ui32BridgeID, PVRSRV_BRIDGE_CAPTURE_VERSION);
+					return -1;
+				}
+				if (psRecord->ui32Error != sizeof(IMG_VOID *))
+				{
+					fprintf(stderr, "Captured on a %u-bit kernel; this replayer is %u-bit\n",
+							psRecord->ui32Error * 8, (IMG_UINT32)sizeof(IMG_VOID *) * 8);
+					return -1;
+				}
+				if (psRecord->ui32OutBufferSize != REPLAY_NUM_BRIDGE_IDS && !bForce)
+				{
+					fprintf(stderr, "Captured with %u bridge IDs, built for %u: "
+							"check the bridge options (or use -f)\n",
+							psRecord->ui32OutBufferSize, (IMG_UINT32)REPLAY_NUM_BRIDGE_IDS);
+					return -1;
+				}
+				gui32HandleSize = psRecord->ui32Error;
+				bStarted = IMG_TRUE;
+				break;
+
+			case PVRSRV_BRIDGE_CAPTURE_CALL:
+				if (!bStarted)
+				{
+					fprintf(stderr, "Capture doesn't start with a START record\n");
+					return -1;
+				}
+				if (ReplayCall(psRecord) != 0)
+				{
+					return -1;
+				}
+				break;
+
+			case PVRSRV_BRIDGE_CAPTURE_LOST:
+				gui64CaptureLost += psRecord->ui32BridgeID;
+				break;
+
+			default:
+				/* from a later version of the capture; skip it */
+				break;
+		}
+
+		uPos += psRecord->ui32Size;
+	}
+
+	return 0;
+}
+
+static IMG_VOID Report(IMG_UINT64 ui64ElapsedNs, IMG_UINT32 ui32Iterations)
+{
+	IMG_UINT64 ui64ReplayNs = 0;
+	IMG_UINT64 ui64CapturedNs = 0;
+	IMG_UINT32 i;
+
+	printf("%4s %10s %10s %12s %12s %12s\n",
+		   "ID", "calls", "mismatched", "mean ns", "max ns", "captured ns");
+
+	for (i = 0; i < REPLAY_MAX_BRIDGE_IDS; i++)
+	{
+		REPLAY_STATS *psStats = &gasStats[i];
+
+		if (psStats->ui64Calls == 0)
+		{
+			continue;
+		}
+
+		printf("%4u %10llu %10llu %12llu %12llu %12llu\n", i,
+			   (unsigned long long)psStats->ui64Calls,
+			   (unsigned long long)psStats->ui64Mismatches,
+			   (unsigned long long)(psStats->ui64ReplayNs / psStats->ui64Calls),
+			   (unsigned long long)psStats->ui64ReplayMaxNs,
+			   (unsigned long long)(psStats->ui64CapturedNs / psStats->ui64Calls));
+
+		ui64ReplayNs += psStats->ui64ReplayNs;
+		ui64CapturedNs += psStats->ui64CapturedNs;
+	}
+
+	printf("\n%llu calls in %u replays, %.3f s: %.0f calls/s; %.3f s in calls (%.3f s captured)\n",
+		   (unsigned long long)gui64Replayed, ui32Iterations,
+		   (double)ui64ElapsedNs / 1e9,
+		   ui64ElapsedNs ? (double)gui64Replayed * 1e9 / (double)ui64ElapsedNs : 0.0,
+		   (double)ui64ReplayNs / 1e9, (double)ui64CapturedNs / 1e9);
+
+	printf("Skipped %llu not replayable, %llu using unbound handles, %llu with lost handles, "
+		   "%llu without a connection; %llu lost from the capture\n",
+		   (unsigned long long)gui64SkippedNotReplayable,
+		   (unsigned long long)gui64SkippedUnbound,
+		   (unsigned long long)gui64SkippedHandlesLost,
+		   (unsigned long long)gui64SkippedNoConnection,
+		   (unsigned long long)gui64CaptureLost);
+}
+
+static IMG_UINT8 *ReadCapture(const char *pszFile, size_t *puSize)
+{
+	IMG_UINT8 *pui8Capture;
+	FILE *psFile;
+	long lSize;
+
+	psFile = fopen(pszFile, "rb");
+	if (psFile == IMG_NULL)
+	{
+		fprintf(stderr, "Couldn't open %s: %s\n", pszFile, strerror(errno));
+		return IMG_NULL;
+	}
+
+	if (fseek(psFile, 0, SEEK_END) != 0 || (lSize = ftell(psFile)) < 0 ||
+		fseek(psFile, 0, SEEK_SET) != 0)
+	{
+		fprintf(stderr, "Couldn't size %s\n", pszFile);
+		fclose(psFile);
+		return IMG_NULL;
+	}
+
+	/* records are read in place, so keep them aligned */
+	pui8Capture = malloc((size_t)lSize + sizeof(IMG_UINT64));
+	if (pui8Capture == IMG_NULL)
+	{
+		fprintf(stderr, "Out of memory\n");
+		fclose(psFile);
+		return IMG_NULL;
+	}
+
+	if (fread(pui8Capture, 1, (size_t)lSize, psFile) != (size_t)lSize)
+	{
+		fprintf(stderr, "Couldn't read %s\n", pszFile);
+		free(pui8Capture);
+		fclose(psFile);
+		return IMG_NULL;
+	}
+
+	fclose(psFile);
+	*puSize = (size_t)lSize;
+
+	return pui8Capture;
+}
+
+static void Usage(const char *pszName)
+{
+	fprintf(stderr,
+			"Usage: %s [-d device] [-c capture-file] -r output\n"
+			"       %s [-d device] [-n iterations] [-x bridge-id]... [-f] [-v] capture\n",
+			pszName, pszName);
+}
+
+int main(int argc, char **argv)
+{
+	const char *pszRecord = IMG_NULL;
+	IMG_UINT32 ui32Iterations = 1;
+	IMG_BOOL bForce = IMG_FALSE;
+	IMG_UINT8 *pui8Capture;
+	IMG_UINT64 ui64Start;
+	size_t uSize;
+	IMG_UINT32 i;
+	int iOpt;
+
+	for (i = 0; i < sizeof(gaui32NotReplayable) / sizeof(gaui32NotReplayable[0]); i++)
+	{
+		gabSkip[REPLAY_BRIDGE_ID(gaui32NotReplayable[i])] = IMG_TRUE;
+	}
+
+	while ((iOpt = getopt(argc, argv, "d:c:r:n:x:fvh")) != -1)
+	{
+		switch (iOpt)
+		{
+			case 'd':
+				gpszDevice = optarg;
+				break;
+			case 'c':
+				gpszCaptureFile = optarg;
+				break;
+			case 'r':
+				pszRecord = optarg;
+				break;
+			case 'n':
+				ui32Iterations = (IMG_UINT32)strtoul(optarg, IMG_NULL, 0);
+				break;
+			case 'x':
+			{
+				IMG_UINT32 ui32ID = (IMG_UINT32)strtoul(optarg, IMG_NULL, 0);
+
+				if (ui32ID >= REPLAY_MAX_BRIDGE_IDS)
+				{
+					Usage(argv[0]);
+					return 1;
+				}
+				gabSkip[ui32ID] = IMG_TRUE;
+				break;
+			}
+			case 'f':
+				bForce = IMG_TRUE;
+				break;
+			case 'v':
+				gbVerbose = IMG_TRUE;
+				break;
+			default:
+				Usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (pszRecord != IMG_NULL)
+	{
+		return (Record(pszRecord) == 0) ? 0 : 1;
+	}
+
+	if (optind != argc - 1 || ui32Iterations == 0)
+	{
+		Usage(argv[0]);
+		return 1;
+	}
+
+	pui8Capture = ReadCapture(argv[optind], &uSize);
+	if (pui8Capture == IMG_NULL)
+	{
+		return 1;
+	}
+
+	ui64Start = NowNs();
+
+	for (i = 0; i < ui32Iterations; i++)
+	{
+		int iRet = Replay(pui8Capture, uSize, bForce);
+
+		/* Closing the connections frees whatever the application left */
+		CloseConnections();
+		if (gpui64Symbols != IMG_NULL)
+		{
+			memset(gpui64Symbols, 0, gui32NumSymbols * sizeof(IMG_UINT64));
+		}
+
+		if (iRet != 0)
+		{
+			free(pui8Capture);
+			return 1;
+		}
+	}
+
+	Report(NowNs() - ui64Start, ui32Iterations);
+
+	free(gpui64Symbols);
+	free(pui8Capture);
+
+	return 0;
+}
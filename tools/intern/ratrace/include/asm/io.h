@@ -0,0 +1 @@
+/* Host build stand-in for <asm/io.h>; intentionally empty. */
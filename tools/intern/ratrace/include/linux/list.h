@@ -0,0 +1,13 @@
+/*
+	Host build stand-in for <linux/list.h>: only the type is needed to
+	compile the services headers outside the kernel.
+*/
+#ifndef __RATRACE_LINUX_LIST_H__
+#define __RATRACE_LINUX_LIST_H__
+
+struct list_head
+{
+	struct list_head *next, *prev;
+};
+
+#endif /* __RATRACE_LINUX_LIST_H__ */
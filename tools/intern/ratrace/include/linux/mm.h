@@ -0,0 +1,21 @@
+/*
+	Host build stand-in for <linux/mm.h>: just enough for the services
+	headers included by ra.c and hash.c to compile.
+*/
+#ifndef __RATRACE_LINUX_MM_H__
+#define __RATRACE_LINUX_MM_H__
+
+#define PAGE_SHIFT	12
+#define PAGE_SIZE	(1UL << PAGE_SHIFT)
+
+typedef unsigned int gfp_t;
+typedef unsigned long dma_addr_t;
+
+struct page;
+struct file;
+struct vm_area_struct;
+
+struct page *vmalloc_to_page(const void *pvAddr);
+unsigned long page_to_phys(struct page *psPage);
+
+#endif /* __RATRACE_LINUX_MM_H__ */
@@ -0,0 +1 @@
+/* Host build stand-in for <linux/slab.h>; intentionally empty. */
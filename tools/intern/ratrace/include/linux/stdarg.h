@@ -0,0 +1,10 @@
+/*
+	Host build stand-in for <linux/stdarg.h>, which lists.h includes when
+	built against a recent kernel.
+*/
+#ifndef __RATRACE_LINUX_STDARG_H__
+#define __RATRACE_LINUX_STDARG_H__
+
+#include <stdarg.h>
+
+#endif /* __RATRACE_LINUX_STDARG_H__ */
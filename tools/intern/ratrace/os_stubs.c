@@ -0,0 +1,141 @@
+/*************************************************************************/ /*!
+@Title          Host OS stubs for the RA trace replay tool
+@Copyright      Copyright (c) Imagination Technologies Ltd. All Rights Reserved
+@Description    Minimal userspace implementations of the OS functions used
+                by ra.c and hash.c. OSClockus follows the replayed trace
+                rather than the wall clock, so age based policies see the
+                recorded timing.
+@License        Dual MIT/GPLv2
+
+The contents of this file are subject to the MIT license as set out below.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public License Version 2 ("GPL") in which case the provisions
+of GPL are applicable instead of those above.
+
+If you wish to allow use of your version of this file only under the terms of
+GPL, and not to allow others to use your version of this file under the terms
+of the MIT license, indicate your decision by deleting the provisions above
+and replace them with the notice and other provisions required by GPL as set
+out in the file called "GPL-COPYING" included in this distribution. If you do
+not delete the provisions above, a recipient may use your version of this file
+under the terms of either the MIT license or GPL.
+
+This License is also included in this distribution in the file called
+"MIT-COPYING".
+
+EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/ /**************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "services_headers.h"
+
+#include "os_stubs.h"
+
+/* timestamp of the record being replayed, in nanoseconds */
+IMG_UINT64 gui64ReplayTimens = 0;
+
+IMG_UINT32 OSClockus(IMG_VOID)
+{
+	return (IMG_UINT32)(gui64ReplayTimens / 1000);
+}
+
+/* real time, so latencies measured inside the allocator are genuine */
+IMG_UINT64 OSClockns64(IMG_VOID)
+{
+	struct timespec sTime;
+
+	clock_gettime(CLOCK_MONOTONIC, &sTime);
+	return (IMG_UINT64)sTime.tv_sec * 1000000000ULL + (IMG_UINT64)sTime.tv_nsec;
+}
+
+IMG_VOID OSMemCopy(IMG_VOID *pvDst, IMG_VOID *pvSrc, IMG_SIZE_T uiSize)
+{
+	memcpy(pvDst, pvSrc, uiSize);
+}
+
+IMG_VOID OSMemSet(IMG_VOID *pvDest, IMG_UINT8 ui8Value, IMG_SIZE_T uSize)
+{
+	memset(pvDest, ui8Value, uSize);
+}
+
+IMG_INT32 OSSNPrintf(IMG_CHAR *pStr, IMG_SIZE_T uSize, const IMG_CHAR *pszFormat, ...)
+{
+	va_list argList;
+	IMG_INT32 iCount;
+
+	va_start(argList, pszFormat);
+	iCount = (IMG_INT32)vsnprintf(pStr, uSize, pszFormat, argList);
+	va_end(argList);
+
+	return iCount;
+}
+
+PVRSRV_ERROR OSAllocMem_Impl(IMG_UINT32 ui32Flags, IMG_SIZE_T uSize, IMG_PVOID *ppvLinAddr, IMG_HANDLE *phBlockAlloc)
+{
+	PVR_UNREFERENCED_PARAMETER(ui32Flags);
+	PVR_UNREFERENCED_PARAMETER(phBlockAlloc);
+
+	*ppvLinAddr = malloc(uSize);
+
+	return (*ppvLinAddr != IMG_NULL) ? PVRSRV_OK : PVRSRV_ERROR_OUT_OF_MEMORY;
+}
+
+PVRSRV_ERROR OSFreeMem_Impl(IMG_UINT32 ui32Flags, IMG_SIZE_T uSize, IMG_PVOID pvLinAddr, IMG_HANDLE hBlockAlloc)
+{
+	PVR_UNREFERENCED_PARAMETER(ui32Flags);
+	PVR_UNREFERENCED_PARAMETER(uSize);
+	PVR_UNREFERENCED_PARAMETER(hBlockAlloc);
+
+	free(pvLinAddr);
+
+	return PVRSRV_OK;
+}
+
+/* an object cache is represented by its object size */
+IMG_HANDLE OSCreateObjectCache(IMG_CHAR *pszName, IMG_SIZE_T uObjectSize)
+{
+	PVR_UNREFERENCED_PARAMETER(pszName);
+
+	return (IMG_HANDLE)uObjectSize;
+}
+
+IMG_VOID OSDestroyObjectCache(IMG_HANDLE hCache)
+{
+	PVR_UNREFERENCED_PARAMETER(hCache);
+}
+
+PVRSRV_ERROR OSAllocObject(IMG_HANDLE hCache, IMG_PVOID *ppvObject)
+{
+	*ppvObject = malloc((size_t)hCache);
+
+	return (*ppvObject != IMG_NULL) ? PVRSRV_OK : PVRSRV_ERROR_OUT_OF_MEMORY;
+}
+
+IMG_VOID OSFreeObject(IMG_HANDLE hCache, IMG_PVOID pvObject)
+{
+	PVR_UNREFERENCED_PARAMETER(hCache);
+
+	free(pvObject);
+}
@@ -0,0 +1,12 @@
+/*
+	Interface between the replay tool and its OS stubs.
+*/
+#ifndef __RATRACE_OS_STUBS_H__
+#define __RATRACE_OS_STUBS_H__
+
+#include "img_types.h"
+
+/* set by the replay loop before each record is applied */
+extern IMG_UINT64 gui64ReplayTimens;
+
+#endif /* __RATRACE_OS_STUBS_H__ */
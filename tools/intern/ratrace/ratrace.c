@@ -0,0 +1,571 @@
+/*************************************************************************/ /*!
+@Title          RA allocation trace replay tool
+@Copyright      Copyright (c) Imagination Technologies Ltd. All Rights Reserved
+@Description    Replays a capture read from <debugfs>/pvrsrvkm/alloc_trace
+                against the resource allocator built for the host, under a
+                chosen quantum cache and span retention policy, and reports
+                throughput and per-arena fragmentation.
+@License        Dual MIT/GPLv2
+
+The contents of this file are subject to the MIT license as set out below.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+Alternatively, the contents of this file may be used under the terms of
+the GNU General Public License Version 2 ("GPL") in which case the provisions
+of GPL are applicable instead of those above.
+
+If you wish to allow use of your version of this file only under the terms of
+GPL, and not to allow others to use your version of this file under the terms
+of the MIT license, indicate your decision by deleting the provisions above
+and replace them with the notice and other provisions required by GPL as set
+out in the file called "GPL-COPYING" included in this distribution. If you do
+not delete the provisions above, a recipient may use your version of this file
+under the terms of either the MIT license or GPL.
+
+This License is also included in this distribution in the file called
+"MIT-COPYING".
+
+EXCEPT AS OTHERWISE STATED IN A NEGOTIATED AGREEMENT: (A) THE SOFTWARE IS
+PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+PURPOSE AND NONINFRINGEMENT; AND (B) IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/ /**************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "services_headers.h"
+#include "hash.h"
+#include "ra.h"
+#include "alloc_trace.h"
+
+#include "os_stubs.h"
+
+/* imported spans are handed out from here upwards, one range per arena */
+#define REPLAY_IMPORT_BASE		((IMG_UINTPTR_T)1 << 40)
+#define REPLAY_IMPORT_STRIDE	((IMG_UINTPTR_T)1 << 36)
+
+/* big enough for RA_GetStats on any arena */
+#define REPLAY_STATS_SIZE		(1024 * 1024)
+
+typedef struct _REPLAY_POLICY_
+{
+	IMG_SIZE_T	uQCacheMax;
+	IMG_SIZE_T	uRetainMaxBytes;
+	IMG_UINT32	ui32RetainMaxAgems;
+} REPLAY_POLICY;
+
+typedef struct _REPLAY_ARENA_
+{
+	IMG_UINT32	ui32ID;
+	RA_ARENA	*psArena;
+
+	/* recorded base -> replayed base + 1, so a stored 0 is never valid */
+	HASH_TABLE	*psBaseHash;
+	IMG_UINT32	ui32Live;
+
+	/* next address handed out by the fake import source */
+	IMG_UINTPTR_T uiNextImport;
+
+	IMG_CHAR	szName[32];
+
+	struct _REPLAY_ARENA_ *psNext;
+} REPLAY_ARENA;
+
+typedef struct _REPLAY_COUNTS_
+{
+	IMG_UINT32	ui32RAAllocs;
+	IMG_UINT32	ui32RAFrees;
+	IMG_UINT32	ui32BMAllocs;
+	IMG_UINT32	ui32BMFrees;
+	IMG_UINT32	ui32TraceFailures;
+	IMG_UINT32	ui32ReplayFailures;
+	IMG_UINT32	ui32Unmatched;
+	IMG_UINT64	ui64Lost;
+} REPLAY_COUNTS;
+
+static REPLAY_ARENA *gpsArenas = IMG_NULL;
+static IMG_UINT32 gui32ArenaIndex = 0;
+
+/* keys gathered by _CollectKey when tearing an arena down */
+static IMG_UINTPTR_T *gpuiKeys;
+static IMG_UINT32 gui32KeyCount;
+
+static IMG_BOOL gbVerbose = IMG_FALSE;
+
+
+static IMG_BOOL
+_ImportAlloc (IMG_VOID *pvHandle,
+			  IMG_SIZE_T uSize,
+			  IMG_SIZE_T *pActualSize,
+			  BM_MAPPING **ppsMapping,
+			  IMG_UINT32 uFlags,
+			  IMG_PVOID pvPrivData,
+			  IMG_UINT32 ui32PrivDataLength,
+			  IMG_UINTPTR_T *pBase)
+{
+	REPLAY_ARENA *psReplay = (REPLAY_ARENA *)pvHandle;
+
+	PVR_UNREFERENCED_PARAMETER(uFlags);
+	PVR_UNREFERENCED_PARAMETER(pvPrivData);
+	PVR_UNREFERENCED_PARAMETER(ui32PrivDataLength);
+
+	*pBase = psReplay->uiNextImport;
+	*pActualSize = uSize;
+	*ppsMapping = IMG_NULL;
+	psReplay->uiNextImport += uSize;
+
+	return IMG_TRUE;
+}
+
+static IMG_VOID
+_ImportFree (IMG_VOID *pvHandle, IMG_UINTPTR_T base, BM_MAPPING *psMapping)
+{
+	/* imported address space is never reused, so there is nothing to do */
+	PVR_UNREFERENCED_PARAMETER(pvHandle);
+	PVR_UNREFERENCED_PARAMETER(base);
+	PVR_UNREFERENCED_PARAMETER(psMapping);
+}
+
+static REPLAY_ARENA *
+_FindArena (IMG_UINT32 ui32ID)
+{
+	REPLAY_ARENA **ppsReplay;
+
+	/* traces tend to hit the same arena repeatedly, so move each hit to
+	   the front of the list */
+	for (ppsReplay = &gpsArenas; *ppsReplay != IMG_NULL; ppsReplay = &(*ppsReplay)->psNext)
+	{
+		REPLAY_ARENA *psReplay = *ppsReplay;
+
+		if (psReplay->ui32ID == ui32ID)
+		{
+			*ppsReplay = psReplay->psNext;
+			psReplay->psNext = gpsArenas;
+			gpsArenas = psReplay;
+			return psReplay;
+		}
+	}
+	return IMG_NULL;
+}
+
+static PVRSRV_ERROR
+_CollectKey (IMG_UINTPTR_T k, IMG_UINTPTR_T v)
+{
+	PVR_UNREFERENCED_PARAMETER(v);
+
+	gpuiKeys[gui32KeyCount++] = k;
+
+	return PVRSRV_OK;
+}
+
+static IMG_VOID
+_PrintStats (REPLAY_ARENA *psReplay)
+{
+	IMG_CHAR *pszBuffer = malloc(REPLAY_STATS_SIZE);
+	IMG_CHAR *pszStr = pszBuffer;
+	IMG_UINT32 ui32Len = REPLAY_STATS_SIZE;
+	IMG_CHAR *pszChain;
+
+	if (pszBuffer == IMG_NULL)
+	{
+		return;
+	}
+
+	pszBuffer[0] = '\0';
+	RA_GetStats (psReplay->psArena, &pszStr, &ui32Len);
+
+	/* the segment chain is of no use in a summary */
+	pszChain = strstr(pszBuffer, "  segment Chain:");
+	if (pszChain != IMG_NULL)
+	{
+		*pszChain = '\0';
+	}
+
+	printf("%s", pszBuffer);
+	free(pszBuffer);
+}
+
+static IMG_VOID
+_CreateArena (PVRSRV_ALLOC_TRACE_RECORD *psRecord, REPLAY_POLICY *psPolicy)
+{
+	IMG_BOOL bImport = (psRecord->ui32Flags & RA_TRACE_FLAG_IMPORT) ? IMG_TRUE : IMG_FALSE;
+	REPLAY_ARENA *psReplay;
+
+	if (_FindArena (psRecord->ui32ID) != IMG_NULL)
+	{
+		fprintf(stderr, "ratrace: arena %u created twice, ignoring\n", psRecord->ui32ID);
+		return;
+	}
+
+	psReplay = calloc(1, sizeof(*psReplay));
+	if (psReplay == IMG_NULL)
+	{
+		fprintf(stderr, "ratrace: out of memory\n");
+		exit(1);
+	}
+
+	psReplay->ui32ID = psRecord->ui32ID;
+	psReplay->uiNextImport = REPLAY_IMPORT_BASE + gui32ArenaIndex++ * REPLAY_IMPORT_STRIDE;
+	snprintf(psReplay->szName, sizeof(psReplay->szName), "arena %u%s",
+			 psRecord->ui32ID, bImport ? " (import)" : "");
+
+	psReplay->psBaseHash = HASH_Create ("ratrace bases", 64);
+	psReplay->psArena = RA_Create (psReplay->szName,
+								   (IMG_UINTPTR_T)psRecord->ui64Base,
+								   (IMG_SIZE_T)psRecord->ui64Size,
+								   IMG_NULL,
+								   psRecord->ui32Alignment,
+								   psPolicy->uQCacheMax,
+								   bImport ? _ImportAlloc : IMG_NULL,
+								   bImport ? _ImportFree : IMG_NULL,
+								   IMG_NULL,
+								   psReplay);
+	if (psReplay->psBaseHash == IMG_NULL || psReplay->psArena == IMG_NULL)
+	{
+		fprintf(stderr, "ratrace: failed to create arena %u\n", psRecord->ui32ID);
+		exit(1);
+	}
+
+	if (bImport)
+	{
+		RA_SetSpanRetention (psReplay->psArena, psPolicy->uRetainMaxBytes,
+							 psPolicy->ui32RetainMaxAgems);
+	}
+
+	psReplay->psNext = gpsArenas;
+	gpsArenas = psReplay;
+}
+
+static IMG_VOID
+_DeleteArena (REPLAY_ARENA *psReplay, IMG_BOOL bReport)
+{
+	REPLAY_ARENA **ppsReplay;
+	IMG_UINT32 i;
+
+	if (bReport)
+	{
+		_PrintStats (psReplay);
+	}
+
+	/* free whatever the trace left allocated */
+	gpuiKeys = malloc((psReplay->ui32Live + 1) * sizeof(IMG_UINTPTR_T));
+	gui32KeyCount = 0;
+	HASH_Iterate (psReplay->psBaseHash, _CollectKey);
+	for (i = 0; i < gui32KeyCount; i++)
+	{
+		IMG_UINTPTR_T uiBase = HASH_Remove (psReplay->psBaseHash, gpuiKeys[i]);
+
+		RA_Free (psReplay->psArena, uiBase - 1, IMG_FALSE);
+	}
+	free(gpuiKeys);
+	gpuiKeys = IMG_NULL;
+
+	RA_Delete (psReplay->psArena);
+	HASH_Delete (psReplay->psBaseHash);
+
+	for (ppsReplay = &gpsArenas; *ppsReplay != IMG_NULL; ppsReplay = &(*ppsReplay)->psNext)
+	{
+		if (*ppsReplay == psReplay)
+		{
+			*ppsReplay = psReplay->psNext;
+			break;
+		}
+	}
+	free(psReplay);
+}
+
+static IMG_VOID
+_Replay (PVRSRV_ALLOC_TRACE_RECORD *psRecords,
+		 IMG_SIZE_T uRecordCount,
+		 REPLAY_POLICY *psPolicy,
+		 REPLAY_COUNTS *psCounts)
+{
+	IMG_SIZE_T i;
+
+	for (i = 0; i < uRecordCount; i++)
+	{
+		PVRSRV_ALLOC_TRACE_RECORD *psRecord = &psRecords[i];
+		REPLAY_ARENA *psReplay = IMG_NULL;
+		IMG_UINTPTR_T uiBase;
+
+		gui64ReplayTimens = psRecord->ui64Timens;
+
+		switch (psRecord->ui16Type)
+		{
+			case PVRSRV_ALLOC_TRACE_RA_DELETE:
+			case PVRSRV_ALLOC_TRACE_RA_ADD:
+			case PVRSRV_ALLOC_TRACE_RA_ALLOC:
+			case PVRSRV_ALLOC_TRACE_RA_FREE:
+				psReplay = _FindArena (psRecord->ui32ID);
+				if (psReplay == IMG_NULL)
+				{
+					/* created before the capture started, or lost */
+					psCounts->ui32Unmatched++;
+					continue;
+				}
+				break;
+			default:
+				break;
+		}
+
+		switch (psRecord->ui16Type)
+		{
+			case PVRSRV_ALLOC_TRACE_RA_CREATE:
+				_CreateArena (psRecord, psPolicy);
+				break;
+
+			case PVRSRV_ALLOC_TRACE_RA_DELETE:
+				_DeleteArena (psReplay, gbVerbose);
+				break;
+
+			case PVRSRV_ALLOC_TRACE_RA_ADD:
+				RA_Add (psReplay->psArena, (IMG_UINTPTR_T)psRecord->ui64Base,
+						(IMG_SIZE_T)psRecord->ui64Size);
+				break;
+
+			case PVRSRV_ALLOC_TRACE_RA_ALLOC:
+				psCounts->ui32RAAllocs++;
+				if (!psRecord->ui16Result)
+				{
+					psCounts->ui32TraceFailures++;
+				}
+
+				if (!RA_Alloc (psReplay->psArena, (IMG_SIZE_T)psRecord->ui64Size,
+							   IMG_NULL, IMG_NULL, psRecord->ui32Flags,
+							   psRecord->ui32Alignment, 0, IMG_NULL, 0, &uiBase))
+				{
+					psCounts->ui32ReplayFailures++;
+					break;
+				}
+
+				if (!psRecord->ui16Result)
+				{
+					/* nothing in the trace will free it */
+					RA_Free (psReplay->psArena, uiBase, IMG_FALSE);
+					break;
+				}
+
+				/* a free lost from the capture leaves a stale mapping behind */
+				if (HASH_Remove (psReplay->psBaseHash, (IMG_UINTPTR_T)psRecord->ui64Base) != 0)
+				{
+					psReplay->ui32Live--;
+					psCounts->ui32Unmatched++;
+				}
+				if (!HASH_Insert (psReplay->psBaseHash, (IMG_UINTPTR_T)psRecord->ui64Base, uiBase + 1))
+				{
+					fprintf(stderr, "ratrace: out of memory\n");
+					exit(1);
+				}
+				psReplay->ui32Live++;
+				break;
+
+			case PVRSRV_ALLOC_TRACE_RA_FREE:
+				psCounts->ui32RAFrees++;
+				uiBase = HASH_Remove (psReplay->psBaseHash, (IMG_UINTPTR_T)psRecord->ui64Base);
+				if (uiBase == 0)
+				{
+					psCounts->ui32Unmatched++;
+					break;
+				}
+				psReplay->ui32Live--;
+				RA_Free (psReplay->psArena, uiBase - 1,
+						 psRecord->ui32Flags ? IMG_TRUE : IMG_FALSE);
+				break;
+
+			case PVRSRV_ALLOC_TRACE_BM_ALLOC:
+				/* the RA operations BM_Alloc made are in the trace already */
+				psCounts->ui32BMAllocs++;
+				break;
+
+			case PVRSRV_ALLOC_TRACE_BM_FREE:
+				psCounts->ui32BMFrees++;
+				break;
+
+			case PVRSRV_ALLOC_TRACE_LOST:
+				psCounts->ui64Lost += psRecord->ui64Size;
+				break;
+
+			default:
+				fprintf(stderr, "ratrace: unknown record type %u at record %lu\n",
+						psRecord->ui16Type, (unsigned long)i);
+				break;
+		}
+	}
+}
+
+static IMG_UINT64
+_Now (IMG_VOID)
+{
+	struct timespec sTime;
+
+	clock_gettime(CLOCK_MONOTONIC, &sTime);
+
+	return (IMG_UINT64)sTime.tv_sec * 1000000000ULL + (IMG_UINT64)sTime.tv_nsec;
+}
+
+static PVRSRV_ALLOC_TRACE_RECORD *
+_ReadTrace (const IMG_CHAR *pszFile, IMG_SIZE_T *puRecordCount)
+{
+	PVRSRV_ALLOC_TRACE_RECORD *psRecords;
+	FILE *psFile;
+	long lSize;
+
+	psFile = fopen(pszFile, "rb");
+	if (psFile == IMG_NULL)
+	{
+		perror(pszFile);
+		return IMG_NULL;
+	}
+
+	if (fseek(psFile, 0, SEEK_END) != 0 || (lSize = ftell(psFile)) < 0)
+	{
+		perror(pszFile);
+		fclose(psFile);
+		return IMG_NULL;
+	}
+	rewind(psFile);
+
+	if (lSize % sizeof(PVRSRV_ALLOC_TRACE_RECORD) != 0)
+	{
+		fprintf(stderr, "ratrace: %s: trailing partial record ignored\n", pszFile);
+	}
+
+	*puRecordCount = (IMG_SIZE_T)lSize / sizeof(PVRSRV_ALLOC_TRACE_RECORD);
+	psRecords = malloc(*puRecordCount * sizeof(PVRSRV_ALLOC_TRACE_RECORD) + 1);
+	if (psRecords == IMG_NULL
+		|| fread(psRecords, sizeof(PVRSRV_ALLOC_TRACE_RECORD), *puRecordCount, psFile) != *puRecordCount)
+	{
+		fprintf(stderr, "ratrace: failed to read %s\n", pszFile);
+		free(psRecords);
+		fclose(psFile);
+		return IMG_NULL;
+	}
+
+	fclose(psFile);
+	return psRecords;
+}
+
+static IMG_VOID
+_Usage (const IMG_CHAR *pszName)
+{
+	fprintf(stderr,
+			"usage: %s [-q qcache-bytes] [-r retain-bytes] [-a retain-age-ms] [-n passes] [-v] trace\n"
+			"  -q  largest allocation served from the quantum caches, 0 disables\n"
+			"  -r  free import span bytes each import arena may retain, 0 disables\n"
+			"  -a  longest a retained span is kept, in milliseconds of trace time\n"
+			"  -n  replay the trace this many times, for steadier timing\n"
+			"  -v  also report arenas as the trace deletes them\n",
+			pszName);
+}
+
+int main(int argc, char **argv)
+{
+	REPLAY_POLICY sPolicy = { 0, 0, 0 };
+	REPLAY_COUNTS sCounts;
+	PVRSRV_ALLOC_TRACE_RECORD *psRecords;
+	IMG_SIZE_T uRecordCount;
+	IMG_UINT32 ui32Passes = 1;
+	IMG_UINT32 ui32Pass;
+	IMG_UINT64 ui64Elapsedns = 0;
+	IMG_UINT64 ui64Ops;
+	int iOpt;
+
+	while ((iOpt = getopt(argc, argv, "q:r:a:n:v")) != -1)
+	{
+		switch (iOpt)
+		{
+			case 'q':
+				sPolicy.uQCacheMax = (IMG_SIZE_T)strtoull(optarg, IMG_NULL, 0);
+				break;
+			case 'r':
+				sPolicy.uRetainMaxBytes = (IMG_SIZE_T)strtoull(optarg, IMG_NULL, 0);
+				break;
+			case 'a':
+				sPolicy.ui32RetainMaxAgems = (IMG_UINT32)strtoul(optarg, IMG_NULL, 0);
+				break;
+			case 'n':
+				ui32Passes = (IMG_UINT32)strtoul(optarg, IMG_NULL, 0);
+				break;
+			case 'v':
+				gbVerbose = IMG_TRUE;
+				break;
+			default:
+				_Usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (optind != argc - 1 || ui32Passes == 0)
+	{
+		_Usage(argv[0]);
+		return 1;
+	}
+
+	psRecords = _ReadTrace(argv[optind], &uRecordCount);
+	if (psRecords == IMG_NULL)
+	{
+		return 1;
+	}
+
+	for (ui32Pass = 0; ui32Pass < ui32Passes; ui32Pass++)
+	{
+		IMG_BOOL bLastPass = (ui32Pass == ui32Passes - 1) ? IMG_TRUE : IMG_FALSE;
+		IMG_UINT64 ui64Start;
+
+		memset(&sCounts, 0, sizeof(sCounts));
+		gui32ArenaIndex = 0;
+
+		ui64Start = _Now();
+		_Replay (psRecords, uRecordCount, &sPolicy, &sCounts);
+		ui64Elapsedns += _Now() - ui64Start;
+
+		/* arenas still alive at the end of the capture are the interesting ones */
+		if (bLastPass)
+		{
+			printf("Arenas live at the end of the trace:\n");
+		}
+		while (gpsArenas != IMG_NULL)
+		{
+			_DeleteArena (gpsArenas, bLastPass);
+		}
+	}
+
+	ui64Ops = (IMG_UINT64)(sCounts.ui32RAAllocs + sCounts.ui32RAFrees) * ui32Passes;
+
+	printf("\nPolicy: qcache %lu bytes, retain %lu bytes for %u ms\n",
+		   (unsigned long)sPolicy.uQCacheMax,
+		   (unsigned long)sPolicy.uRetainMaxBytes,
+		   sPolicy.ui32RetainMaxAgems);
+	printf("Records: %lu (RA allocs %u, RA frees %u, BM allocs %u, BM frees %u)\n",
+		   (unsigned long)uRecordCount, sCounts.ui32RAAllocs, sCounts.ui32RAFrees,
+		   sCounts.ui32BMAllocs, sCounts.ui32BMFrees);
+	printf("Failed allocs: %u in trace, %u in replay\n",
+		   sCounts.ui32TraceFailures, sCounts.ui32ReplayFailures);
+	if (sCounts.ui64Lost != 0 || sCounts.ui32Unmatched != 0)
+	{
+		printf("Incomplete trace: %llu records lost, %u operations unmatched\n",
+			   (unsigned long long)sCounts.ui64Lost, sCounts.ui32Unmatched);
+	}
+	printf("Throughput: %llu RA ops in %.3f ms over %u pass(es), %.0f ops/s\n",
+		   (unsigned long long)ui64Ops, (double)ui64Elapsedns / 1e6, ui32Passes,
+		   ui64Elapsedns ? (double)ui64Ops * 1e9 / (double)ui64Elapsedns : 0.0);
+
+	free(psRecords);
+	return 0;
+}